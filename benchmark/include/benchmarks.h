@@ -0,0 +1,74 @@
+#pragma once
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Every benchmark takes the command line arguments that follow its name and returns the process exit code
+
+		// BVH build time and quality over triangle soups of 1K to 50M triangles, and depth of every builder over a degenerate geometric series
+		// Fails if a builder goes deeper than BVH_MAX_DEPTH
+		// Arguments: [max triangles] [num threads]
+		int bvh_build(int argc, char** argv);
+
+		// Closest hit traversal speed and node memory of the binary and wide node formats over a terrain
+		// Arguments: [num triangles] [num threads]
+		int bvh_traversal(int argc, char** argv);
+
+		// Packet traversal of primary and shadow rays against single ray traversal, and single ray traversal of incoherent rays
+		// Arguments: [num triangles] [num threads]
+		int ray_packets(int argc, char** argv);
+
+		// Edge-avoiding a-trous filtering of noisy 1080p and 4K radiance buffers, with the error against the noise free image
+		// Arguments: [num iterations] [num threads]
+		int denoiser(int argc, char** argv);
+
+		// Closest hit traversal of a particle cloud as built-in spheres and boxes and as custom primitives handed to an intersection function
+		// Arguments: [num particles] [num threads]
+		int procedural(int argc, char** argv);
+
+		// Per frame rebuild of the top level structure over moving instances with the binned SAH, LBVH and HLBVH builders, with the quality of the result
+		// Arguments: [num instances] [num threads]
+		int tlas_rebuild(int argc, char** argv);
+
+		// Per frame update of a deforming terrain by a full rebuild, a refit and a refit with the rebuild of its degraded subtrees, with the quality of the result
+		// Arguments: [num triangles] [num threads]
+		int blas_update(int argc, char** argv);
+
+		// Build of a terrain structure in both node formats against its load from a memory mapped cache file, with the traversal speed of both
+		// Arguments: [num triangles] [num threads] [cache directory]
+		int bvh_cache(int argc, char** argv);
+
+		// Frames of primary rays and incoherent streams against a paged terrain structure under shrinking budgets, with the page hit rate and stall time of every frame
+		// Arguments: [num triangles] [num threads] [directory of the paged file]
+		int bvh_paging(int argc, char** argv);
+
+		// Load of a terrain scene file by mapping it against reading it in memory
+		// Arguments: [num triangles] [directory of the file]
+		int scene_load(int argc, char** argv);
+
+		// Frames of varying CPU and GPU time through a ring of 1, 2 and 3 frame slots against a simulated queue, with the throughput and the CPU stall of every depth
+		// Fails if a slot is recorded into while the queue still uses it
+		// Arguments: [num frames] [CPU ms per frame] [GPU ms per frame] [jitter percent]
+		int frame_pipelining(int argc, char** argv);
+
+		// Uniform, skewed, nested and fine grained parallel loops and frames of dependent stages on the work stealing scheduler against the thread pool, from 1 to N threads
+		// Arguments: [max threads] [iterations per task]
+		int task_scheduler(int argc, char** argv);
+
+		// Frames recorded into per thread command contexts of the software backend with shuffled submission indices, from 1 to N threads
+		// Fails if the flush does not follow the submission indices or if the pool grows once warm
+		// Arguments: [max threads] [iterations per command]
+		int command_contexts(int argc, char** argv);
+
+		// Frames of clears, transitions and dispatches recorded into command streams against vectors of fixed size commands, with the cost of the merge and of the translation
+		// Fails if the merged streams do not give the result of the full replay, keep a redundant transition, or allocate for a frame that is not larger than the previous ones
+		// Arguments: [commands per frame] [num streams]
+		int command_stream(int argc, char** argv);
+
+		// Random graphs of passes reading and writing transient and imported resources, with the cost of culling them and of batching their transitions
+		// Fails if the culling differs from a brute force one, if a pass does not find its resources in the state it declared or if a transition is not needed
+		// Arguments: [max passes]
+		int render_graph(int argc, char** argv);
+	}
+}
\ No newline at end of file
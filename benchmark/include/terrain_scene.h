@@ -0,0 +1,36 @@
+#pragma once
+
+// Internal includes
+#include "raytracing_descriptor.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Dimensions of the image the primary rays are generated over
+		#define TERRAIN_IMAGE_WIDTH 1280
+		#define TERRAIN_IMAGE_HEIGHT 720
+
+		struct TTerrain
+		{
+			std::vector<float> vertices;
+			std::vector<uint32_t> indices;
+		};
+
+		// Height field over [0, 100]^2 with two triangles per cell
+		void generate_terrain(uint32_t numTriangles, TTerrain& terrain);
+
+		// Geometry descriptor that references the buffers of a terrain
+		TGeometryDescriptor terrain_geometry(const TTerrain& terrain);
+
+		// Pinhole camera above a corner of the terrain, looking across it, one ray per pixel in row order
+		void generate_primary_rays(std::vector<TRay>& rays);
+
+		// Rays from random points above the terrain in random directions, as bounces would produce
+		void generate_incoherent_rays(std::vector<TRay>& rays);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+// Internal includes
+#include "benchmarks.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+#include "terrain_scene.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of simulated frames, the deformation grows from one frame to the next
+		#define BLAS_UPDATE_NUM_FRAMES 16
+
+		// Swirl the terrain around its center and lift waves on it, the closer to the center the faster the vertices turn
+		// Neighbouring rings drift apart, so the subtrees that were compact at build time grow over the frames
+		static void deform_terrain(const std::vector<float>& restVertices, uint32_t frameIdx, std::vector<float>& vertices)
+		{
+			vertices.resize(restVertices.size());
+			for (size_t vertexIdx = 0; vertexIdx < restVertices.size(); vertexIdx += 3)
+			{
+				float x = restVertices[vertexIdx] - 50.0f;
+				float z = restVertices[vertexIdx + 2] - 50.0f;
+				float radius = sqrtf(x * x + z * z);
+				float angle = 0.3f * frameIdx * std::max(0.0f, 1.0f - radius / 70.0f);
+				vertices[vertexIdx] = 50.0f + x * cosf(angle) - z * sinf(angle);
+				vertices[vertexIdx + 1] = restVertices[vertexIdx + 1] + 2.0f * sinf(0.2f * radius - 0.5f * frameIdx);
+				vertices[vertexIdx + 2] = 50.0f + x * sinf(angle) + z * cosf(angle);
+			}
+		}
+
+		// Trace a set of rays, returns the time in seconds and the number of hits
+		static double trace_rays(const cpu_raytracing::TTopLevelAccelerationStructure& accelerationStructure, const std::vector<TRay>& rays, TTaskScheduler& taskScheduler, uint32_t& numHits)
+		{
+			const uint32_t numTasks = TERRAIN_IMAGE_HEIGHT;
+			const uint32_t raysPerTask = (uint32_t)rays.size() / numTasks;
+			std::vector<uint32_t> taskHits(numTasks);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			taskScheduler.parallel_for(numTasks, [&](uint32_t taskIdx, uint32_t)
+			{
+				uint32_t hits = 0;
+				for (uint32_t rayIdx = taskIdx * raysPerTask; rayIdx < (taskIdx + 1) * raysPerTask; ++rayIdx)
+				{
+					THit hit;
+					hits += cpu_raytracing::intersect_closest(accelerationStructure, rays[rayIdx], 0xFF, hit) ? 1 : 0;
+				}
+				taskHits[taskIdx] = hits;
+			});
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			numHits = 0;
+			for (uint32_t hits : taskHits)
+			{
+				numHits += hits;
+			}
+			return elapsed.count();
+		}
+
+		int blas_update(int argc, char** argv)
+		{
+			uint32_t numTriangles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 1000000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			initialize_triangle_intersection();
+
+			TTerrain terrain;
+			generate_terrain(numTriangles, terrain);
+			std::vector<float> restVertices = terrain.vertices;
+			TGeometryDescriptor geometry = terrain_geometry(terrain);
+			geometry.allowUpdate = true;
+
+			std::vector<TRay> primaryRays;
+			generate_primary_rays(primaryRays);
+
+			printf("blas_update: %u triangles, %u frames, %u threads\n", (uint32_t)terrain.indices.size() / 3, BLAS_UPDATE_NUM_FRAMES, taskScheduler.num_threads());
+			printf("%8s %12s %12s %14s %12s %12s %12s %14s %10s\n", "update", "frame (ms)", "refit nodes", "rebuilt nodes", "subtrees", "merged", "SAH cost", "primary Mray/s", "hits");
+
+			// The same deformation applied by rebuilding the structure every frame, by refitting it and by refitting it and rebuilding the degraded subtrees
+			const char* modeNames[] = { "rebuild", "refit", "partial" };
+			for (uint32_t modeIdx = 0; modeIdx < 3; ++modeIdx)
+			{
+				deform_terrain(restVertices, 0, terrain.vertices);
+				cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, BVHNodeFormat::Binary, &taskScheduler);
+				if (modeIdx == 1)
+				{
+					bottomLevel->refitState.rebuildThreshold = FLT_MAX;
+				}
+
+				// A single instance with an identity transform
+				TInstanceDescriptor instance = {};
+				instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+				instance.bottomLevel = (BottomLevelAccelerationStructure)bottomLevel;
+				instance.mask = 0xFF;
+				cpu_raytracing::TTopLevelAccelerationStructure* topLevel = cpu_raytracing::create_top_level_acceleration_structure(&instance, 1, BVHBuildMode::BinnedSAH, &taskScheduler);
+
+				double totalTime = 0.0;
+				uint64_t refitNodes = 0;
+				uint64_t rebuiltNodes = 0;
+				uint32_t rebuiltSubtrees = 0;
+				uint32_t mergedSubtrees = 0;
+				for (uint32_t frameIdx = 1; frameIdx <= BLAS_UPDATE_NUM_FRAMES; ++frameIdx)
+				{
+					deform_terrain(restVertices, frameIdx, terrain.vertices);
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					if (modeIdx == 0)
+					{
+						cpu_raytracing::destroy_bottom_level_acceleration_structure(bottomLevel);
+						bottomLevel = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, BVHNodeFormat::Binary, &taskScheduler);
+						topLevel->instances[0].bottomLevel = bottomLevel;
+					}
+					else
+					{
+						TBVHRefitStatistics statistics;
+						cpu_raytracing::update_bottom_level_acceleration_structure(*bottomLevel, geometry, &taskScheduler, &statistics);
+						refitNodes += statistics.refitNodes;
+						rebuiltNodes += statistics.rebuiltNodes;
+						rebuiltSubtrees += statistics.rebuiltSubtrees;
+						mergedSubtrees += statistics.mergedSubtrees;
+					}
+					cpu_raytracing::refresh_instance_bounds(*topLevel, bottomLevel);
+					cpu_raytracing::rebuild_top_level_acceleration_structure(*topLevel, &taskScheduler);
+					totalTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				}
+
+				// The rebuild recreates every node of the structure
+				if (modeIdx == 0)
+				{
+					rebuiltNodes = (uint64_t)bottomLevel->bvh.nodes.size() * BLAS_UPDATE_NUM_FRAMES;
+				}
+
+				uint32_t numHits;
+				double traceTime = trace_rays(*topLevel, primaryRays, taskScheduler, numHits);
+				printf("%8s %12.2f %12llu %14llu %12u %12u %12.2f %14.2f %10u\n", modeNames[modeIdx], totalTime / BLAS_UPDATE_NUM_FRAMES * 1e3,
+					(unsigned long long)(refitNodes / BLAS_UPDATE_NUM_FRAMES), (unsigned long long)(rebuiltNodes / BLAS_UPDATE_NUM_FRAMES), rebuiltSubtrees, mergedSubtrees,
+					bvh_sah_cost(bottomLevel->bvh), primaryRays.size() / traceTime * 1e-6, numHits);
+
+				cpu_raytracing::destroy_top_level_acceleration_structure(topLevel);
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(bottomLevel);
+			}
+
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
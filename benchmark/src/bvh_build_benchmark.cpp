@@ -0,0 +1,148 @@
+// Internal includes
+#include "benchmarks.h"
+#include "bvh.h"
+#include "lbvh.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Fill a cube with random triangles, their size shrinks with their number so that the density stays the same
+		static void generate_triangle_soup(uint32_t numTriangles, std::vector<TAABB>& triangleBounds)
+		{
+			std::mt19937 generator(numTriangles);
+			std::uniform_real_distribution<float> position(0.0f, 100.0f);
+			std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+			float triangleSize = 100.0f / cbrtf((float)numTriangles);
+
+			triangleBounds.resize(numTriangles);
+			for (uint32_t triIdx = 0; triIdx < numTriangles; ++triIdx)
+			{
+				float v0[3] = { position(generator), position(generator), position(generator) };
+				TAABB& bounds = triangleBounds[triIdx];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					float v1 = v0[axis] + offset(generator) * triangleSize;
+					float v2 = v0[axis] + offset(generator) * triangleSize;
+					bounds.min[axis] = std::min(std::min(v0[axis], v1), v2);
+					bounds.max[axis] = std::max(std::max(v0[axis], v1), v2);
+				}
+			}
+		}
+
+		// Triangles that shrink and get closer to the origin geometrically, the heuristic only peels the largest ones off at every level
+		// Every fourth one is at the origin, so that the smallest scales end up with identical centroids
+		static void generate_geometric_series(uint32_t numTriangles, std::vector<TAABB>& triangleBounds)
+		{
+			triangleBounds.resize(numTriangles);
+			for (uint32_t triIdx = 0; triIdx < numTriangles; ++triIdx)
+			{
+				float position = (triIdx % 4 == 0) ? 0.0f : 100.0f * exp2f(-200.0f * triIdx / numTriangles);
+				TAABB& bounds = triangleBounds[triIdx];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					bounds.min[axis] = position * 0.75f;
+					bounds.max[axis] = position * 1.25f;
+				}
+			}
+		}
+
+		// Level of the deepest leaf, the children of every node come after it
+		static uint32_t bvh_depth(const TBVH& bvh, std::vector<uint32_t>& depths)
+		{
+			depths.assign(bvh.nodes.size(), 0);
+			uint32_t maxDepth = 0;
+			for (uint32_t nodeIdx = 0; nodeIdx < (uint32_t)bvh.nodes.size(); ++nodeIdx)
+			{
+				const TBVHNode& node = bvh.nodes[nodeIdx];
+				maxDepth = std::max(maxDepth, depths[nodeIdx]);
+				if (node.count != 0 || bvh.nodes.size() == 1) continue;
+				depths[node.leftFirst] = depths[nodeIdx] + 1;
+				depths[node.leftFirst + 1] = depths[nodeIdx] + 1;
+			}
+			return maxDepth;
+		}
+
+		// Builds of a degenerate input with every builder, fails if one of them goes deeper than the traversal stacks
+		static int build_degenerate(uint32_t numTriangles, TTaskScheduler& taskScheduler)
+		{
+			std::vector<TAABB> triangleBounds;
+			generate_geometric_series(numTriangles, triangleBounds);
+			printf("degenerate: %u triangles of a geometric series, %u levels at most\n", numTriangles, BVH_MAX_DEPTH);
+			printf("%12s %12s %12s %12s\n", "builder", "build (ms)", "SAH cost", "depth");
+
+			TBVH bvh;
+			TLBVHBuilder lbvhBuilder;
+			std::vector<uint32_t> depths;
+			int result = 0;
+			const char* builderNames[] = { "unbounded", "SAH", "LBVH", "HLBVH" };
+			for (uint32_t builderIdx = 0; builderIdx < 4; ++builderIdx)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				if (builderIdx < 2)
+				{
+					build_bvh(triangleBounds.data(), numTriangles, bvh, &taskScheduler, 1, builderIdx == 0 ? UINT32_MAX : BVH_MAX_DEPTH);
+				}
+				else
+				{
+					build_lbvh(lbvhBuilder, triangleBounds.data(), numTriangles, bvh, &taskScheduler, builderIdx == 3);
+				}
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+				// The unbounded build only shows how deep the heuristic alone goes
+				uint32_t depth = bvh_depth(bvh, depths);
+				bool valid = builderIdx == 0 || depth <= BVH_MAX_DEPTH;
+				printf("%12s %12.3f %12.2f %12u%s\n", builderNames[builderIdx], elapsed.count() * 1e3, bvh_sah_cost(bvh), depth, valid ? "" : " too deep");
+				result |= valid ? 0 : 1;
+			}
+			return result;
+		}
+
+		int bvh_build(int argc, char** argv)
+		{
+			uint32_t maxTriangles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 50000000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			printf("bvh_build: %u threads\n", taskScheduler.num_threads());
+			printf("%12s %12s %12s %12s %12s\n", "triangles", "build (ms)", "Mtris/s", "SAH cost", "nodes");
+
+			const uint32_t sizeArray[] = { 1000, 10000, 100000, 1000000, 10000000, 50000000 };
+			for (uint32_t numTriangles : sizeArray)
+			{
+				if (numTriangles > maxTriangles) break;
+
+				std::vector<TAABB> triangleBounds;
+				generate_triangle_soup(numTriangles, triangleBounds);
+
+				// Small inputs are built several times and the best run is kept
+				uint32_t numRuns = std::max(1u, std::min(20u, 2000000 / numTriangles));
+				double bestTime = 1e30;
+				TBVH bvh;
+				for (uint32_t runIdx = 0; runIdx < numRuns; ++runIdx)
+				{
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					build_bvh(triangleBounds.data(), numTriangles, bvh, &taskScheduler);
+					std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+					bestTime = std::min(bestTime, elapsed.count());
+				}
+
+				printf("%12u %12.3f %12.2f %12.2f %12u\n", numTriangles, bestTime * 1e3, numTriangles / bestTime * 1e-6, bvh_sah_cost(bvh), (uint32_t)bvh.nodes.size());
+			}
+
+			int result = build_degenerate(std::min(maxTriangles, 100000u), taskScheduler);
+			taskScheduler.destroy();
+			return result;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+// Internal includes
+#include "benchmarks.h"
+#include "bvh_cache.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+#include "terrain_scene.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		static double elapsed_milliseconds(std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// Trace the primary rays against a single instance of a bottom level structure, returns the time in milliseconds and the number of hits
+		static double trace_bottom_level(const cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel, const std::vector<TRay>& rays, TTaskScheduler& taskScheduler, uint32_t& numHits)
+		{
+			TInstanceDescriptor instance = {};
+			instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+			instance.bottomLevel = (BottomLevelAccelerationStructure)bottomLevel;
+			instance.mask = 0xFF;
+			cpu_raytracing::TTopLevelAccelerationStructure* topLevel = cpu_raytracing::create_top_level_acceleration_structure(&instance, 1, BVHBuildMode::BinnedSAH, &taskScheduler);
+
+			const uint32_t numTasks = TERRAIN_IMAGE_HEIGHT;
+			const uint32_t raysPerTask = (uint32_t)rays.size() / numTasks;
+			std::vector<uint32_t> taskHits(numTasks);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			taskScheduler.parallel_for(numTasks, [&](uint32_t taskIdx, uint32_t)
+			{
+				uint32_t hits = 0;
+				for (uint32_t rayIdx = taskIdx * raysPerTask; rayIdx < (taskIdx + 1) * raysPerTask; ++rayIdx)
+				{
+					THit hit;
+					hits += cpu_raytracing::intersect_closest(*topLevel, rays[rayIdx], 0xFF, hit) ? 1 : 0;
+				}
+				taskHits[taskIdx] = hits;
+			});
+			double traceTime = elapsed_milliseconds(start);
+			cpu_raytracing::destroy_top_level_acceleration_structure(topLevel);
+
+			numHits = 0;
+			for (uint32_t hits : taskHits)
+			{
+				numHits += hits;
+			}
+			return traceTime;
+		}
+
+		int bvh_cache(int argc, char** argv)
+		{
+			uint32_t numTriangles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 1000000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+			const char* cacheDirectory = argc > 2 ? argv[2] : ".";
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			initialize_triangle_intersection();
+
+			TTerrain terrain;
+			generate_terrain(numTriangles, terrain);
+			TGeometryDescriptor geometry = terrain_geometry(terrain);
+
+			std::vector<TRay> primaryRays;
+			generate_primary_rays(primaryRays);
+
+			printf("bvh_cache: %u triangles, %u threads, cache in %s\n", (uint32_t)terrain.indices.size() / 3, taskScheduler.num_threads(), cacheDirectory);
+			printf("%8s %10s %10s %10s %10s %10s %12s %12s %10s %10s\n", "format", "build ms", "hash ms", "save ms", "file MB", "load ms", "trace ms", "cached ms", "hits", "cached");
+
+			// The structure is built and written, then loaded back from the file, the first trace of the loaded one pages the file in
+			// The file was just written so its pages are usually still in the page cache of the system, a cold start also reads them from the disk
+			const char* formatNames[] = { "binary", "wide8" };
+			for (uint32_t formatIdx = 0; formatIdx < 2; ++formatIdx)
+			{
+				BVHNodeFormat::Type format = (BVHNodeFormat::Type)formatIdx;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				cpu_raytracing::TBottomLevelAccelerationStructure* built = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, format, &taskScheduler);
+				double buildTime = elapsed_milliseconds(start);
+
+				start = std::chrono::steady_clock::now();
+				uint64_t key = cpu_raytracing::bvh_cache_key(geometry, format);
+				double hashTime = elapsed_milliseconds(start);
+
+				char fileName[32];
+				snprintf(fileName, sizeof(fileName), "/%016llx.bvh", (unsigned long long)key);
+				std::string path = std::string(cacheDirectory) + fileName;
+				start = std::chrono::steady_clock::now();
+				bool saved = cpu_raytracing::save_bottom_level_acceleration_structure(*built, key, path.c_str());
+				double saveTime = elapsed_milliseconds(start);
+				if (!saved)
+				{
+					printf("%8s cannot write %s\n", formatNames[formatIdx], path.c_str());
+					cpu_raytracing::destroy_bottom_level_acceleration_structure(built);
+					continue;
+				}
+
+				// A hit of the cache is the hash of the geometry and the mapping of the file
+				start = std::chrono::steady_clock::now();
+				cpu_raytracing::TBottomLevelAccelerationStructure* cached = cpu_raytracing::create_cached_bottom_level_acceleration_structure(geometry, format, &taskScheduler, cacheDirectory);
+				double loadTime = elapsed_milliseconds(start);
+
+				uint32_t builtHits;
+				uint32_t cachedHits;
+				double cachedTraceTime = trace_bottom_level(cached, primaryRays, taskScheduler, cachedHits);
+				double builtTraceTime = trace_bottom_level(built, primaryRays, taskScheduler, builtHits);
+				printf("%8s %10.2f %10.2f %10.2f %10.2f %10.2f %12.2f %12.2f %10u %10u\n", formatNames[formatIdx], buildTime, hashTime, saveTime,
+					cached->mappedFile.size / (1024.0 * 1024.0), loadTime, builtTraceTime, cachedTraceTime, builtHits, cachedHits);
+
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(cached);
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(built);
+				remove(path.c_str());
+			}
+
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+// Internal includes
+#include "benchmarks.h"
+#include "bvh_cache.h"
+#include "bvh_paging.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+#include "terrain_scene.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of frames traced with every budget, the first one starts without any resident page
+		#define PAGING_NUM_FRAMES 4
+
+		// Side in pixels of the tiles the primary rays are traced in, the same as the tiles of the software backend
+		#define PAGING_TILE_SIZE 64
+
+		static double elapsed_milliseconds(std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// Trace a frame against a single instance of a bottom level structure: the primary rays one at a time in tiles, then the incoherent rays as one stream per thread,
+		// so that a stream reads every page it misses once. Both defer the pages they reach that are not resident. Returns the time in milliseconds and the number of hits
+		static double trace_frame(const cpu_raytracing::TTopLevelAccelerationStructure& topLevel, const std::vector<TRay>& primaryRays, const std::vector<TRay>& incoherentRays, TTaskScheduler& taskScheduler, uint32_t& numHits)
+		{
+			const uint32_t numTilesX = (TERRAIN_IMAGE_WIDTH + PAGING_TILE_SIZE - 1) / PAGING_TILE_SIZE;
+			const uint32_t numTiles = numTilesX * ((TERRAIN_IMAGE_HEIGHT + PAGING_TILE_SIZE - 1) / PAGING_TILE_SIZE);
+			const uint32_t numStreams = taskScheduler.num_threads();
+			std::vector<uint32_t> taskHits(numTiles + numStreams, 0);
+			std::vector<THit> hits(incoherentRays.size());
+			std::vector<uint8_t> found(incoherentRays.size());
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			taskScheduler.parallel_for(numTiles, [&](uint32_t tileIdx, uint32_t)
+			{
+				uint32_t tileX = (tileIdx % numTilesX) * PAGING_TILE_SIZE;
+				uint32_t tileY = (tileIdx / numTilesX) * PAGING_TILE_SIZE;
+				for (uint32_t y = tileY; y < std::min(tileY + PAGING_TILE_SIZE, (uint32_t)TERRAIN_IMAGE_HEIGHT); ++y)
+				{
+					for (uint32_t x = tileX; x < std::min(tileX + PAGING_TILE_SIZE, (uint32_t)TERRAIN_IMAGE_WIDTH); ++x)
+					{
+						THit hit;
+						taskHits[tileIdx] += cpu_raytracing::intersect_closest(topLevel, primaryRays[y * TERRAIN_IMAGE_WIDTH + x], 0xFF, hit) ? 1 : 0;
+					}
+				}
+			});
+			taskScheduler.parallel_for(numStreams, [&](uint32_t streamIdx, uint32_t)
+			{
+				size_t first = incoherentRays.size() * streamIdx / numStreams;
+				uint32_t streamSize = (uint32_t)(incoherentRays.size() * (streamIdx + 1) / numStreams - first);
+				cpu_raytracing::intersect_closest_stream(topLevel, incoherentRays.data() + first, streamSize, 0xFF, hits.data() + first, found.data() + first);
+				for (uint32_t rayIdx = 0; rayIdx < streamSize; ++rayIdx)
+				{
+					taskHits[numTiles + streamIdx] += found[first + rayIdx];
+				}
+			});
+			double traceTime = elapsed_milliseconds(start);
+
+			numHits = 0;
+			for (uint32_t hitCount : taskHits)
+			{
+				numHits += hitCount;
+			}
+			return traceTime;
+		}
+
+		static cpu_raytracing::TTopLevelAccelerationStructure* create_single_instance(const cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel, TTaskScheduler& taskScheduler)
+		{
+			TInstanceDescriptor instance = {};
+			instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+			instance.bottomLevel = (BottomLevelAccelerationStructure)bottomLevel;
+			instance.mask = 0xFF;
+			return cpu_raytracing::create_top_level_acceleration_structure(&instance, 1, BVHBuildMode::BinnedSAH, &taskScheduler);
+		}
+
+		int bvh_paging(int argc, char** argv)
+		{
+			uint32_t numTriangles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 2000000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+			const char* directory = argc > 2 ? argv[2] : ".";
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			initialize_triangle_intersection();
+
+			TTerrain terrain;
+			generate_terrain(numTriangles, terrain);
+			TGeometryDescriptor geometry = terrain_geometry(terrain);
+
+			std::vector<TRay> primaryRays;
+			std::vector<TRay> incoherentRays;
+			generate_primary_rays(primaryRays);
+			generate_incoherent_rays(incoherentRays);
+
+			// The resident structure gives the reference number of hits and the time of a frame without paging
+			cpu_raytracing::TBottomLevelAccelerationStructure* resident = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, BVHNodeFormat::Binary, &taskScheduler);
+			cpu_raytracing::TTopLevelAccelerationStructure* residentTopLevel = create_single_instance(resident, taskScheduler);
+			uint32_t residentHits;
+			double residentTime = trace_frame(*residentTopLevel, primaryRays, incoherentRays, taskScheduler, residentHits);
+			cpu_raytracing::destroy_top_level_acceleration_structure(residentTopLevel);
+			cpu_raytracing::destroy_bottom_level_acceleration_structure(resident);
+
+			// Write the paged file once, every budget then opens it with a cold cache
+			uint64_t key = cpu_raytracing::bvh_cache_key(geometry, BVHNodeFormat::Binary);
+			char fileName[32];
+			snprintf(fileName, sizeof(fileName), "/%016llx.bvhp", (unsigned long long)key);
+			std::string path = std::string(directory) + fileName;
+			remove(path.c_str());
+			cpu_raytracing::TBVHPageCache writeCache;
+			cpu_raytracing::init_bvh_page_cache(writeCache, 0);
+			cpu_raytracing::TBottomLevelAccelerationStructure* paged = cpu_raytracing::create_paged_bottom_level_acceleration_structure(geometry, &taskScheduler, directory, writeCache);
+			if (paged->pageTable == nullptr)
+			{
+				printf("bvh_paging: cannot write %s\n", path.c_str());
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(paged);
+				cpu_raytracing::destroy_bvh_page_cache(writeCache);
+				taskScheduler.destroy();
+				return 1;
+			}
+			uint64_t pageBytes = 0;
+			uint32_t numPages = (uint32_t)paged->pageTable->pages.size();
+			for (const cpu_raytracing::TBVHPage& page : paged->pageTable->pages)
+			{
+				pageBytes += page.size;
+			}
+			cpu_raytracing::destroy_bottom_level_acceleration_structure(paged);
+			cpu_raytracing::destroy_bvh_page_cache(writeCache);
+
+			printf("bvh_paging: %u triangles, %u threads, %u pages, %.2f MB of pages in %s\n", (uint32_t)terrain.indices.size() / 3, taskScheduler.num_threads(), numPages, pageBytes / (1024.0 * 1024.0), directory);
+			printf("resident: %.2f ms per frame, %u hits\n", residentTime, residentHits);
+			printf("%10s %6s %10s %10s %10s %10s %10s %10s %12s %10s\n", "budget MB", "frame", "trace ms", "hit rate", "misses", "deferred", "stall ms", "loaded MB", "resident MB", "hits");
+
+			// The budgets are fractions of the pages, the whole structure down to a sixteenth of it
+			const uint32_t budgetDivisors[] = { 1, 2, 4, 16 };
+			for (uint32_t divisor : budgetDivisors)
+			{
+				uint64_t budget = pageBytes / divisor;
+				cpu_raytracing::TBVHPageCache cache;
+				cpu_raytracing::init_bvh_page_cache(cache, budget);
+				cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel = cpu_raytracing::open_paged_bottom_level_acceleration_structure(geometry, key, path.c_str(), cache);
+				cpu_raytracing::TTopLevelAccelerationStructure* topLevel = create_single_instance(bottomLevel, taskScheduler);
+
+				for (uint32_t frameIdx = 0; frameIdx < PAGING_NUM_FRAMES; ++frameIdx)
+				{
+					uint32_t numHits;
+					double traceTime = trace_frame(*topLevel, primaryRays, incoherentRays, taskScheduler, numHits);
+					cpu_raytracing::TBVHPageStatistics statistics;
+					cpu_raytracing::collect_bvh_page_statistics(cache, statistics);
+					uint64_t numAccesses = statistics.pageHits + statistics.pageMisses;
+					printf("%10.2f %6u %10.2f %9.2f%% %10llu %10llu %10.2f %10.2f %12.2f %10u%s\n", budget / (1024.0 * 1024.0), frameIdx, traceTime,
+						numAccesses > 0 ? 100.0 * statistics.pageHits / numAccesses : 100.0, (unsigned long long)statistics.pageMisses, (unsigned long long)statistics.deferredRays,
+						statistics.stallTime, statistics.loadedBytes / (1024.0 * 1024.0), statistics.residentBytes / (1024.0 * 1024.0), numHits, numHits == residentHits ? "" : " mismatch");
+				}
+
+				cpu_raytracing::destroy_top_level_acceleration_structure(topLevel);
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(bottomLevel);
+				cpu_raytracing::destroy_bvh_page_cache(cache);
+			}
+
+			remove(path.c_str());
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+// Internal includes
+#include "benchmarks.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+#include "terrain_scene.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of timed runs, the best one is kept
+		#define TRAVERSAL_NUM_RUNS 3
+
+		// Trace a set of rays, returns the best time in seconds and the number of hits
+		static double trace_rays(const cpu_raytracing::TTopLevelAccelerationStructure& accelerationStructure, const std::vector<TRay>& rays, TTaskScheduler& taskScheduler, uint32_t& numHits)
+		{
+			const uint32_t numTasks = TERRAIN_IMAGE_HEIGHT;
+			const uint32_t raysPerTask = (uint32_t)rays.size() / numTasks;
+			std::vector<uint32_t> taskHits(numTasks);
+
+			double bestTime = 1e30;
+			for (uint32_t runIdx = 0; runIdx < TRAVERSAL_NUM_RUNS; ++runIdx)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				taskScheduler.parallel_for(numTasks, [&](uint32_t taskIdx, uint32_t)
+				{
+					uint32_t hits = 0;
+					for (uint32_t rayIdx = taskIdx * raysPerTask; rayIdx < (taskIdx + 1) * raysPerTask; ++rayIdx)
+					{
+						THit hit;
+						hits += cpu_raytracing::intersect_closest(accelerationStructure, rays[rayIdx], 0xFF, hit) ? 1 : 0;
+					}
+					taskHits[taskIdx] = hits;
+				});
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				bestTime = std::min(bestTime, elapsed.count());
+			}
+
+			numHits = 0;
+			for (uint32_t hits : taskHits)
+			{
+				numHits += hits;
+			}
+			return bestTime;
+		}
+
+		int bvh_traversal(int argc, char** argv)
+		{
+			uint32_t numTriangles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 1000000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+
+			TTerrain terrain;
+			generate_terrain(numTriangles, terrain);
+			TGeometryDescriptor geometry = terrain_geometry(terrain);
+
+			std::vector<TRay> primaryRays, incoherentRays;
+			generate_primary_rays(primaryRays);
+			generate_incoherent_rays(incoherentRays);
+
+			printf("bvh_traversal: %u triangles, %u rays, %u threads\n", geometry.indexCount / 3, (uint32_t)primaryRays.size(), taskScheduler.num_threads());
+			printf("%8s %8s %10s %10s %12s %14s %16s %10s\n", "isa", "format", "nodes", "bytes/node", "nodes (MB)", "primary Mray/s", "incoherent Mray/s", "hits");
+
+			// Every supported intersection kernel is measured against both node formats
+			const char* instructionSetNames[] = { "sse", "avx2", "avx512" };
+			const BVHNodeFormat::Type formatArray[] = { BVHNodeFormat::Binary, BVHNodeFormat::Wide8 };
+			const char* formatNames[] = { "binary", "wide8" };
+			for (uint32_t configIdx = 0; configIdx < 6; ++configIdx)
+			{
+				SIMDInstructionSet::Type instructionSet = (SIMDInstructionSet::Type)(configIdx / 2);
+				if (!initialize_triangle_intersection(instructionSet)) break;
+				uint32_t formatIdx = configIdx % 2;
+				BVHNodeFormat::Type format = formatArray[formatIdx];
+				cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, format, &taskScheduler);
+
+				// A single instance with an identity transform
+				TInstanceDescriptor instance = {};
+				instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+				instance.bottomLevel = (BottomLevelAccelerationStructure)bottomLevel;
+				instance.mask = 0xFF;
+				cpu_raytracing::TTopLevelAccelerationStructure* topLevel = cpu_raytracing::create_top_level_acceleration_structure(&instance, 1, BVHBuildMode::BinnedSAH, &taskScheduler);
+
+				uint32_t numNodes = format == BVHNodeFormat::Wide8 ? (uint32_t)bottomLevel->bvh8.nodes.size() : (uint32_t)bottomLevel->bvh.nodes.size();
+				uint32_t nodeSize = format == BVHNodeFormat::Wide8 ? (uint32_t)sizeof(TBVH8Node) : (uint32_t)sizeof(TBVHNode);
+
+				uint32_t primaryHits, incoherentHits;
+				double primaryTime = trace_rays(*topLevel, primaryRays, taskScheduler, primaryHits);
+				double incoherentTime = trace_rays(*topLevel, incoherentRays, taskScheduler, incoherentHits);
+
+				printf("%8s %8s %10u %10u %12.2f %14.2f %16.2f %10u\n", instructionSetNames[instructionSet], formatNames[formatIdx], numNodes, nodeSize, (double)numNodes * nodeSize / (1024.0 * 1024.0),
+					primaryRays.size() / primaryTime * 1e-6, incoherentRays.size() / incoherentTime * 1e-6, primaryHits + incoherentHits);
+
+				cpu_raytracing::destroy_top_level_acceleration_structure(topLevel);
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(bottomLevel);
+			}
+
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
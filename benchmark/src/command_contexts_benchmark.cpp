@@ -0,0 +1,148 @@
+// Internal includes
+#include "benchmarks.h"
+#include "software_backend.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of frames recorded with every thread count, and number of contexts of a frame per thread
+		#define CONTEXTS_NUM_FRAMES 32
+		#define CONTEXTS_PER_THREAD 4
+
+		// Commands recorded into every context, the work of a command stands for the state it computes before being recorded
+		#define CONTEXTS_NUM_COMMANDS 64
+
+		// Stands for the work of recording a command, iterations of a xorshift
+		static uint32_t record_work(uint32_t seed, uint32_t iterations)
+		{
+			uint32_t state = seed | 1;
+			for (uint32_t iterationIdx = 0; iterationIdx < iterations; ++iterationIdx)
+			{
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+			}
+			return state;
+		}
+
+		// Clear color of a context, its channels encode the submission index and the frame so that the presented pixel tells which context was submitted last
+		static void context_color(uint32_t submissionIndex, uint32_t frameIdx, float* color)
+		{
+			color[0] = (submissionIndex & 0xFF) / 255.0f;
+			color[1] = ((submissionIndex >> 8) & 0xFF) / 255.0f;
+			color[2] = (frameIdx & 0xFF) / 255.0f;
+			color[3] = 1.0f;
+		}
+
+		int command_contexts(int argc, char** argv)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			uint32_t maxThreads = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : (hardwareThreads > 0 ? hardwareThreads : 1);
+			uint32_t workScale = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 4000;
+			maxThreads = maxThreads > 0 ? maxThreads : 1;
+
+			printf("command_contexts: 1 to %u threads, %u contexts per thread, %u commands per context, %u iterations per command\n", maxThreads, CONTEXTS_PER_THREAD, CONTEXTS_NUM_COMMANDS, workScale);
+			printf("%8s %10s %12s %12s %9s %8s %8s\n", "threads", "contexts", "record ms", "flush ms", "speedup", "order", "pooled");
+
+			uint32_t numFailures = 0;
+			double baseRecordTime = 0.0;
+			for (uint32_t numThreads = 1; ; numThreads = std::min(2 * numThreads, maxThreads))
+			{
+				TTaskScheduler scheduler;
+				scheduler.init(numThreads);
+
+				// A single tile frame buffer, so that the flush stays cheap next to the recording
+				TGraphicSettings settings;
+				settings.width = 64;
+				settings.height = 64;
+				settings.fullscreen = false;
+				settings.backend = RenderingBackEnd::Software;
+				settings.bvhNodeFormat = BVHNodeFormat::Wide8;
+				settings.topLevelBuildMode = BVHBuildMode::HLBVH;
+				settings.bvhPageBudget = 0;
+				settings.progressiveTimeBudget = 0.0f;
+				settings.denoise = false;
+				settings.taskScheduler = &scheduler;
+				RenderEnvironment renderEnvironment = software::render_system::create_render_environment(settings);
+
+				// Every thread count records the same number of contexts per thread, the submission indices are shuffled every frame
+				uint32_t numContexts = numThreads * CONTEXTS_PER_THREAD;
+				std::vector<uint32_t> submissionIndices(numContexts);
+				std::vector<CommandContext> contexts(numContexts);
+				std::vector<CommandContext> previousContexts;
+				uint32_t randomState = 12345;
+				double recordTime = 0.0;
+				double flushTime = 0.0;
+				bool ordered = true;
+				bool pooled = true;
+				for (uint32_t frameIdx = 0; frameIdx < CONTEXTS_NUM_FRAMES; ++frameIdx)
+				{
+					for (uint32_t contextIdx = 0; contextIdx < numContexts; ++contextIdx)
+					{
+						submissionIndices[contextIdx] = contextIdx * 7 + 1;
+					}
+					for (uint32_t contextIdx = numContexts - 1; contextIdx > 0; --contextIdx)
+					{
+						randomState = randomState * 1664525u + 1013904223u;
+						std::swap(submissionIndices[contextIdx], submissionIndices[(randomState >> 8) % (contextIdx + 1)]);
+					}
+
+					software::render_system::initialize_frame(renderEnvironment);
+					Framebuffer frameBuffer = software::render_system::default_frame_buffer(renderEnvironment);
+
+					// The threads acquire their contexts in whatever order they pick the tasks
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					scheduler.parallel_for(numContexts, [&](uint32_t contextIdx, uint32_t)
+					{
+						CommandContext context = software::render_system::acquire_command_context(renderEnvironment, submissionIndices[contextIdx]);
+						contexts[contextIdx] = context;
+						float color[4];
+						for (uint32_t commandIdx = 0; commandIdx < CONTEXTS_NUM_COMMANDS; ++commandIdx)
+						{
+							uint32_t value = record_work(frameIdx * 131 + contextIdx * CONTEXTS_NUM_COMMANDS + commandIdx, workScale);
+							context_color(submissionIndices[contextIdx], frameIdx + (value == 0 ? 1 : 0), color);
+							software::framebuffer::clear(context, frameBuffer, color);
+						}
+					});
+					std::chrono::steady_clock::time_point recorded = std::chrono::steady_clock::now();
+					software::render_system::flush_command_list(renderEnvironment);
+					software::render_system::present(renderEnvironment);
+					recordTime += std::chrono::duration<double, std::milli>(recorded - start).count();
+					flushTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recorded).count();
+
+					// The context with the largest submission index is executed last whichever thread recorded it
+					float color[4];
+					context_color(*std::max_element(submissionIndices.begin(), submissionIndices.end()), frameIdx, color);
+					uint32_t expected = (uint32_t)(color[0] * 255.0f + 0.5f) | ((uint32_t)(color[1] * 255.0f + 0.5f) << 8) | ((uint32_t)(color[2] * 255.0f + 0.5f) << 16) | (255u << 24);
+					ordered &= software::render_system::presented_image(renderEnvironment)[0] == expected;
+
+					// After the first frame, the contexts come from the pool
+					std::sort(contexts.begin(), contexts.end());
+					pooled &= previousContexts.empty() || previousContexts == contexts;
+					previousContexts = contexts;
+				}
+				software::render_system::destroy_render_environment(renderEnvironment);
+				scheduler.destroy();
+
+				// The speedup is the one of the recording of a context against the single thread run, there are more contexts with more threads
+				double recordTimePerContext = recordTime / numContexts;
+				baseRecordTime = numThreads == 1 ? recordTimePerContext : baseRecordTime;
+				printf("%8u %10u %12.3f %12.3f %8.2fx %8s %8s\n", numThreads, numContexts, recordTime / CONTEXTS_NUM_FRAMES, flushTime / CONTEXTS_NUM_FRAMES,
+					baseRecordTime / recordTimePerContext, ordered ? "ok" : "wrong", pooled ? "ok" : "grown");
+				numFailures += (ordered ? 0 : 1) + (pooled ? 0 : 1);
+				if (numThreads == maxThreads) break;
+			}
+			return numFailures == 0 ? 0 : 1;
+		}
+	}
+}
\ No newline at end of file
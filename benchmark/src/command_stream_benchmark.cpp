@@ -0,0 +1,378 @@
+// Internal includes
+#include "benchmarks.h"
+#include "command_stream.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of recorded frames, and frame buffers the commands target
+		#define STREAM_NUM_FRAMES 32
+		#define STREAM_NUM_TARGETS 8
+
+		// A command as the backends used to record it, with room for the payload of every type
+		struct TFatCommand
+		{
+			CommandType::Type type;
+			Framebuffer frameBuffer;
+			float color[4];
+			ResourceState::Type before;
+			ResourceState::Type after;
+			TRayTracingPipeline pipeline;
+			TPathTracingPipeline pathTracingPipeline;
+			TopLevelAccelerationStructure accelerationStructure;
+		};
+
+		// What a frame records, generated ahead so that both layouts record the same commands
+		struct TStreamOp
+		{
+			CommandType::Type type;
+			uint32_t target;
+			float color[4];
+			ResourceState::Type before;
+			ResourceState::Type after;
+		};
+
+		// Content and state of the frame buffers a translation works on
+		struct TTranslatedTargets
+		{
+			float color[STREAM_NUM_TARGETS][4];
+			ResourceState::Type state[STREAM_NUM_TARGETS];
+			uint64_t checksum;
+			uint32_t invalidBarriers;
+		};
+
+		static uint32_t next_random(uint32_t& state)
+		{
+			state = state * 1664525u + 1013904223u;
+			return state >> 8;
+		}
+
+		// Clears, dispatches that read their frame buffer and transitions, a third of the transitions being to the state the frame buffer is already in
+		static void generate_frame(std::vector<TStreamOp>& ops, uint32_t numCommands, uint32_t& randomState)
+		{
+			ResourceState::Type states[STREAM_NUM_TARGETS];
+			bool transitioned[STREAM_NUM_TARGETS];
+			for (uint32_t targetIdx = 0; targetIdx < STREAM_NUM_TARGETS; ++targetIdx)
+			{
+				states[targetIdx] = ResourceState::Present;
+				transitioned[targetIdx] = false;
+			}
+
+			ops.clear();
+			while (ops.size() < numCommands)
+			{
+				TStreamOp op;
+				op.target = next_random(randomState) % STREAM_NUM_TARGETS;
+				uint32_t kind = next_random(randomState) % 10;
+				if (kind < 4)
+				{
+					op.type = CommandType::Clear;
+					for (uint32_t channelIdx = 0; channelIdx < 4; ++channelIdx)
+					{
+						op.color[channelIdx] = (next_random(randomState) % 256) / 255.0f;
+					}
+				}
+				else if (kind < 7)
+				{
+					op.type = CommandType::DispatchRays;
+				}
+				else
+				{
+					// The redundant transitions come after one that the merge has seen, like a second clear of the frame buffer in a frame
+					ResourceState::Type after = next_random(randomState) % 3 == 0 ? ResourceState::UnorderedAccess : ResourceState::RenderTarget;
+					after = transitioned[op.target] && next_random(randomState) % 3 == 0 ? states[op.target] : after;
+					if (after == states[op.target] && !transitioned[op.target]) continue;
+					op.type = CommandType::Barrier;
+					op.before = states[op.target];
+					op.after = after;
+					states[op.target] = after;
+					transitioned[op.target] = true;
+				}
+				ops.push_back(op);
+			}
+		}
+
+		static void reset_targets(TTranslatedTargets& targets)
+		{
+			for (uint32_t targetIdx = 0; targetIdx < STREAM_NUM_TARGETS; ++targetIdx)
+			{
+				for (uint32_t channelIdx = 0; channelIdx < 4; ++channelIdx)
+				{
+					targets.color[targetIdx][channelIdx] = 0.0f;
+				}
+				targets.state[targetIdx] = ResourceState::Present;
+			}
+		}
+
+		static uint64_t color_bits(const float* color)
+		{
+			uint64_t bits[2];
+			memcpy(bits, color, sizeof(bits));
+			return bits[0] * 31 + bits[1];
+		}
+
+		// The dispatches fold the content of their frame buffer in the checksum, so a clear that was wrongly dropped changes it
+		static void translate_clear(TTranslatedTargets& targets, Framebuffer frameBuffer, const float* color)
+		{
+			memcpy(targets.color[frameBuffer - 1], color, 4 * sizeof(float));
+		}
+
+		static void translate_dispatch(TTranslatedTargets& targets, Framebuffer frameBuffer)
+		{
+			targets.checksum = targets.checksum * 1099511628211ull + color_bits(targets.color[frameBuffer - 1]);
+		}
+
+		static void translate_barrier(TTranslatedTargets& targets, Framebuffer frameBuffer, ResourceState::Type before, ResourceState::Type after)
+		{
+			targets.invalidBarriers += targets.state[frameBuffer - 1] != before || before == after ? 1 : 0;
+			targets.state[frameBuffer - 1] = after;
+		}
+
+		// The frame ends with the frame buffers back in the present state and their content in the checksum
+		static void end_frame(TTranslatedTargets& targets)
+		{
+			for (uint32_t targetIdx = 0; targetIdx < STREAM_NUM_TARGETS; ++targetIdx)
+			{
+				targets.checksum = targets.checksum * 1099511628211ull + color_bits(targets.color[targetIdx]);
+				targets.state[targetIdx] = ResourceState::Present;
+			}
+		}
+
+		// Record a batch of transitions larger than a block of the arena, and check that the merge and the translation see every one of them in order
+		// Returns the number of barrier commands the batch was split into, or 0 if a transition was lost or is invalid
+		static uint32_t record_oversized_barrier(TCommandStream& stream, uint32_t numTransitions)
+		{
+			ResourceState::Type states[STREAM_NUM_TARGETS];
+			for (uint32_t targetIdx = 0; targetIdx < STREAM_NUM_TARGETS; ++targetIdx)
+			{
+				states[targetIdx] = ResourceState::Present;
+			}
+			std::vector<TResourceTransition> transitions(numTransitions);
+			for (uint32_t transitionIdx = 0; transitionIdx < numTransitions; ++transitionIdx)
+			{
+				uint32_t targetIdx = transitionIdx % STREAM_NUM_TARGETS;
+				ResourceState::Type after = states[targetIdx] == ResourceState::RenderTarget ? ResourceState::UnorderedAccess : ResourceState::RenderTarget;
+				TResourceTransition transition = { targetIdx + 1, states[targetIdx], after };
+				transitions[transitionIdx] = transition;
+				states[targetIdx] = after;
+			}
+
+			reset_command_stream(stream);
+			record_barrier(stream, transitions.data(), numTransitions);
+			TCommandStream* streamPointer = &stream;
+			merge_command_streams(&streamPointer, 1);
+
+			TTranslatedTargets targets;
+			reset_targets(targets);
+			targets.invalidBarriers = 0;
+			uint32_t numTranslated = 0;
+			uint32_t numBarriers = 0;
+			for (const TCommandHeader* command = stream.first; command != nullptr; command = command->next)
+			{
+				if (command->type != CommandType::Barrier) continue;
+				const TBarrierCommand& barrier = *(const TBarrierCommand*)command;
+				for (uint32_t transitionIdx = 0; transitionIdx < barrier.numTransitions; ++transitionIdx)
+				{
+					const TResourceTransition& transition = barrier.transitions[transitionIdx];
+					translate_barrier(targets, transition.frameBuffer, transition.before, transition.after);
+				}
+				numTranslated += barrier.numTransitions;
+				numBarriers++;
+			}
+			return numTranslated == numTransitions && targets.invalidBarriers == 0 ? numBarriers : 0;
+		}
+
+		int command_stream(int argc, char** argv)
+		{
+			uint32_t numCommands = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 100000;
+			uint32_t numStreams = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 8;
+			numStreams = numStreams > 0 ? numStreams : 1;
+			printf("command_stream: %u commands per frame over %u streams, %u frame buffers\n", numCommands, numStreams, STREAM_NUM_TARGETS);
+
+			TRayTracingPipeline pipeline;
+			memset(&pipeline, 0, sizeof(pipeline));
+
+			// Every stream records a contiguous part of the commands, the streams are in submission order
+			std::vector<TStreamOp> ops;
+			std::vector<std::vector<TFatCommand>> fatLists(numStreams);
+			std::vector<TCommandStream> streams(numStreams);
+			std::vector<TCommandStream*> streamPointers(numStreams);
+			for (uint32_t streamIdx = 0; streamIdx < numStreams; ++streamIdx)
+			{
+				init_command_stream(streams[streamIdx]);
+				streamPointers[streamIdx] = &streams[streamIdx];
+			}
+
+			TTranslatedTargets fatTargets;
+			TTranslatedTargets streamTargets;
+			reset_targets(fatTargets);
+			reset_targets(streamTargets);
+			fatTargets.checksum = streamTargets.checksum = 0;
+			fatTargets.invalidBarriers = streamTargets.invalidBarriers = 0;
+
+			double fatRecordTime = 0.0, fatTranslateTime = 0.0;
+			double streamRecordTime = 0.0, streamMergeTime = 0.0, streamTranslateTime = 0.0;
+			uint64_t numSkipped = 0;
+			uint64_t streamBytes = 0;
+			uint32_t growingFrames = 0;
+			size_t warmBlocks = 0;
+			std::vector<uint64_t> highWaterMarks(numStreams, 0);
+			std::vector<size_t> streamBlocks(numStreams, 0);
+			uint32_t randomState = 4242;
+			for (uint32_t frameIdx = 0; frameIdx < STREAM_NUM_FRAMES; ++frameIdx)
+			{
+				generate_frame(ops, numCommands, randomState);
+				uint32_t opsPerStream = (numCommands + numStreams - 1) / numStreams;
+
+				// The commands as they used to be recorded, every entry as large as the largest payload
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (uint32_t streamIdx = 0; streamIdx < numStreams; ++streamIdx)
+				{
+					std::vector<TFatCommand>& commands = fatLists[streamIdx];
+					commands.clear();
+					for (uint32_t opIdx = streamIdx * opsPerStream; opIdx < std::min((streamIdx + 1) * opsPerStream, numCommands); ++opIdx)
+					{
+						const TStreamOp& op = ops[opIdx];
+						TFatCommand command;
+						command.type = op.type;
+						command.frameBuffer = op.target + 1;
+						memcpy(command.color, op.color, sizeof(command.color));
+						command.before = op.before;
+						command.after = op.after;
+						command.pipeline = pipeline;
+						command.accelerationStructure = 0;
+						commands.push_back(command);
+					}
+				}
+				std::chrono::steady_clock::time_point recorded = std::chrono::steady_clock::now();
+				for (uint32_t streamIdx = 0; streamIdx < numStreams; ++streamIdx)
+				{
+					for (const TFatCommand& command : fatLists[streamIdx])
+					{
+						switch (command.type)
+						{
+							case CommandType::Clear: translate_clear(fatTargets, command.frameBuffer, command.color); break;
+							case CommandType::DispatchRays: translate_dispatch(fatTargets, command.frameBuffer); break;
+							case CommandType::Barrier: translate_barrier(fatTargets, command.frameBuffer, command.before, command.after); break;
+							default: break;
+						};
+					}
+				}
+				end_frame(fatTargets);
+				fatRecordTime += std::chrono::duration<double, std::milli>(recorded - start).count();
+				fatTranslateTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recorded).count();
+
+				// The same commands in the streams, merged before they are translated
+				start = std::chrono::steady_clock::now();
+				for (uint32_t streamIdx = 0; streamIdx < numStreams; ++streamIdx)
+				{
+					TCommandStream& stream = streams[streamIdx];
+					reset_command_stream(stream);
+					for (uint32_t opIdx = streamIdx * opsPerStream; opIdx < std::min((streamIdx + 1) * opsPerStream, numCommands); ++opIdx)
+					{
+						const TStreamOp& op = ops[opIdx];
+						switch (op.type)
+						{
+							case CommandType::Clear: record_clear(stream, op.target + 1, op.color); break;
+							case CommandType::DispatchRays: record_dispatch_rays(stream, op.target + 1, 0, pipeline); break;
+							case CommandType::Barrier:
+							{
+								TResourceTransition transition = { op.target + 1, op.before, op.after };
+								record_barrier(stream, &transition, 1);
+							}
+							break;
+							default: break;
+						};
+					}
+				}
+				recorded = std::chrono::steady_clock::now();
+				numSkipped += merge_command_streams(streamPointers.data(), numStreams);
+				std::chrono::steady_clock::time_point merged = std::chrono::steady_clock::now();
+				for (uint32_t streamIdx = 0; streamIdx < numStreams; ++streamIdx)
+				{
+					for (const TCommandHeader* command = streams[streamIdx].first; command != nullptr; command = command->next)
+					{
+						switch (command->type)
+						{
+							case CommandType::Clear:
+							{
+								const TClearCommand& clear = *(const TClearCommand*)command;
+								translate_clear(streamTargets, clear.target.frameBuffer, clear.color);
+							}
+							break;
+							case CommandType::DispatchRays:
+							{
+								translate_dispatch(streamTargets, ((const TDispatchRaysCommand*)command)->target.frameBuffer);
+							}
+							break;
+							case CommandType::Barrier:
+							{
+								const TBarrierCommand& barrier = *(const TBarrierCommand*)command;
+								for (uint32_t transitionIdx = 0; transitionIdx < barrier.numTransitions; ++transitionIdx)
+								{
+									const TResourceTransition& transition = barrier.transitions[transitionIdx];
+									translate_barrier(streamTargets, transition.frameBuffer, transition.before, transition.after);
+								}
+							}
+							break;
+							default:
+							break;
+						};
+					}
+				}
+				end_frame(streamTargets);
+				streamRecordTime += std::chrono::duration<double, std::milli>(recorded - start).count();
+				streamMergeTime += std::chrono::duration<double, std::milli>(merged - recorded).count();
+				streamTranslateTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - merged).count();
+
+				// The frames differ in size, an arena only allocates a block when its stream goes further than in any previous frame
+				size_t numBlocks = 0;
+				bool growing = false;
+				for (uint32_t streamIdx = 0; streamIdx < numStreams; ++streamIdx)
+				{
+					const TCommandStream& stream = streams[streamIdx];
+					uint64_t usedBytes = (uint64_t)stream.arena.currentBlock * stream.arena.blockSize + stream.arena.offset;
+					growing |= stream.arena.blocks.size() != streamBlocks[streamIdx] && usedBytes <= highWaterMarks[streamIdx];
+					highWaterMarks[streamIdx] = std::max(highWaterMarks[streamIdx], usedBytes);
+					streamBlocks[streamIdx] = stream.arena.blocks.size();
+					numBlocks += stream.arena.blocks.size();
+					streamBytes += usedBytes;
+				}
+				growingFrames += growing ? 1 : 0;
+				warmBlocks = numBlocks;
+			}
+
+			// The merged streams must leave the frame buffers exactly as the full replay, with only valid transitions
+			double totalCommands = (double)numCommands * STREAM_NUM_FRAMES;
+			bool match = fatTargets.checksum == streamTargets.checksum;
+			bool validBarriers = streamTargets.invalidBarriers == 0;
+			printf("%-12s %10s %14s %14s %16s %10s\n", "layout", "bytes/cmd", "record ns/cmd", "merge ns/cmd", "translate ns/cmd", "skipped");
+			printf("%-12s %10u %14.2f %14s %16.2f %10s\n", "fat vector", (uint32_t)sizeof(TFatCommand), fatRecordTime * 1e6 / totalCommands, "-", fatTranslateTime * 1e6 / totalCommands, "-");
+			printf("%-12s %10.1f %14.2f %14.2f %16.2f %9.1f%%\n", "stream", streamBytes / totalCommands, streamRecordTime * 1e6 / totalCommands, streamMergeTime * 1e6 / totalCommands,
+				streamTranslateTime * 1e6 / totalCommands, 100.0 * numSkipped / totalCommands);
+			printf("result %s, transitions %s (%u redundant ones without the merge), arenas %s (%zu blocks of %u bytes)\n", match ? "match" : "MISMATCH", validBarriers ? "valid" : "INVALID", fatTargets.invalidBarriers / STREAM_NUM_FRAMES, growingFrames == 0 ? "stable" : "GROWING",
+				warmBlocks, (uint32_t)FRAME_ARENA_BLOCK_SIZE);
+
+			// A batch of transitions that spans several blocks, as the render graph records when many frame buffers change state together
+			uint32_t numOversizedTransitions = 3 * FRAME_ARENA_BLOCK_SIZE / (uint32_t)sizeof(TResourceTransition);
+			uint32_t numOversizedBarriers = record_oversized_barrier(streams[0], numOversizedTransitions);
+			printf("oversized barrier: %u transitions %s, recorded as %u barriers over %u blocks\n", numOversizedTransitions, numOversizedBarriers != 0 ? "valid" : "INVALID",
+				numOversizedBarriers, streams[0].arena.currentBlock + 1);
+
+			for (TCommandStream& stream : streams)
+			{
+				destroy_command_stream(stream);
+			}
+			return match && validBarriers && growingFrames == 0 && numOversizedBarriers != 0 ? 0 : 1;
+		}
+	}
+}
\ No newline at end of file
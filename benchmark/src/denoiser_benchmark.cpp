@@ -0,0 +1,134 @@
+// Internal includes
+#include "benchmarks.h"
+#include "denoiser.h"
+#include "raytracing_descriptor.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of timed runs, the best one is kept
+		#define DENOISER_NUM_RUNS 3
+
+		// Side of the blocks of the synthetic image, every block is a flat surface with its own normal and albedo
+		#define DENOISER_BLOCK_SIZE 96
+
+		struct TDenoiserImage
+		{
+			TTextureDescriptor reference;
+			TTextureDescriptor noisy;
+			TTextureDescriptor albedo;
+			TTextureDescriptor normal;
+			TTextureDescriptor depth;
+		};
+
+		static void allocate_texture(TTextureDescriptor& texture, uint32_t width, uint32_t height, uint32_t numChannels)
+		{
+			texture.width = width;
+			texture.height = height;
+			texture.data.resize((size_t)numChannels * width * height);
+		}
+
+		// Blocks of flat surfaces under a smooth light, the noisy version has the variance of a few path traced samples per pixel
+		static void generate_image(uint32_t width, uint32_t height, TDenoiserImage& image)
+		{
+			allocate_texture(image.reference, width, height, 3);
+			allocate_texture(image.noisy, width, height, 3);
+			allocate_texture(image.albedo, width, height, 3);
+			allocate_texture(image.normal, width, height, 3);
+			allocate_texture(image.depth, width, height, 1);
+
+			uint32_t randomState = 12345;
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					size_t pixelIdx = (size_t)y * width + x;
+					uint32_t blockIdx = (y / DENOISER_BLOCK_SIZE) * 97 + x / DENOISER_BLOCK_SIZE;
+
+					// Normal tilted per block, albedo per block and a depth that grows toward the top of the image
+					float normal[3] = { 0.4f * sinf(blockIdx * 1.7f), 1.0f, 0.4f * cosf(blockIdx * 2.3f) };
+					float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+					float irradiance = 0.2f + 0.8f * std::max(0.0f, (0.3f * normal[0] + 0.9f * normal[1] + 0.3f * normal[2]) / length) * (0.5f + 0.5f * (float)x / width);
+					for (uint32_t channel = 0; channel < 3; ++channel)
+					{
+						float albedo = 0.2f + 0.6f * (float)((blockIdx * 7 + channel * 3) % 5) / 4.0f;
+						image.albedo.data[3 * pixelIdx + channel] = albedo;
+						image.normal.data[3 * pixelIdx + channel] = normal[channel] / length;
+						image.reference.data[3 * pixelIdx + channel] = albedo * irradiance;
+					}
+					image.depth.data[pixelIdx] = 2.0f + 20.0f * (1.0f - (float)y / height) + (blockIdx % 3);
+
+					// Same noise on the three channels, like the paths of a diffuse scene lit by a white light
+					float noise = -logf(1.0f - next_random(randomState) * 0.999f);
+					for (uint32_t channel = 0; channel < 3; ++channel)
+					{
+						image.noisy.data[3 * pixelIdx + channel] = image.reference.data[3 * pixelIdx + channel] * noise;
+					}
+				}
+			}
+		}
+
+		static double root_mean_square_error(const TTextureDescriptor& image, const TTextureDescriptor& reference)
+		{
+			double sum = 0.0;
+			for (size_t valueIdx = 0; valueIdx < reference.data.size(); ++valueIdx)
+			{
+				double difference = image.data[valueIdx] - reference.data[valueIdx];
+				sum += difference * difference;
+			}
+			return sqrt(sum / reference.data.size());
+		}
+
+		int denoiser(int argc, char** argv)
+		{
+			uint32_t numIterations = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : default_denoiser_settings().numIterations;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			TDenoiserSettings settings = default_denoiser_settings();
+			settings.numIterations = numIterations;
+
+			printf("denoiser: %u iterations, %u threads\n", numIterations, taskScheduler.num_threads());
+			printf("%12s %10s %10s %12s %12s\n", "resolution", "ms", "Mpixel/s", "rmse noisy", "rmse output");
+
+			const uint32_t resolutions[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+			for (uint32_t resolutionIdx = 0; resolutionIdx < 2; ++resolutionIdx)
+			{
+				uint32_t width = resolutions[resolutionIdx][0];
+				uint32_t height = resolutions[resolutionIdx][1];
+				TDenoiserImage image;
+				generate_image(width, height, image);
+
+				// The first run sizes the scratch, the timed ones do not allocate
+				TDenoiser denoiserScratch = {};
+				TTextureDescriptor output;
+				double bestTime = 1e30;
+				for (uint32_t runIdx = 0; runIdx <= DENOISER_NUM_RUNS; ++runIdx)
+				{
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					denoise(denoiserScratch, image.noisy, image.albedo, image.normal, image.depth, settings, taskScheduler, output);
+					std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+					bestTime = runIdx > 0 ? std::min(bestTime, elapsed.count()) : bestTime;
+				}
+
+				char resolutionName[32];
+				snprintf(resolutionName, sizeof(resolutionName), "%ux%u", width, height);
+				printf("%12s %10.2f %10.2f %12.4f %12.4f\n", resolutionName, bestTime * 1e3, (double)width * height / bestTime * 1e-6,
+					root_mean_square_error(image.noisy, image.reference), root_mean_square_error(output, image.reference));
+			}
+
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
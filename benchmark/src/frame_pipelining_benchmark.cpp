@@ -0,0 +1,190 @@
+// Internal includes
+#include "benchmarks.h"
+#include "frame_ring.h"
+
+// External includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// A frame submitted to the simulated queue
+		struct TSimulatedSubmission
+		{
+			uint64_t fenceValue;
+			uint32_t slot;
+			std::chrono::microseconds duration;
+		};
+
+		// A queue that executes the submissions in order on its own thread and signals their fence value once done, stands for the GPU
+		struct TSimulatedQueue
+		{
+			std::thread thread;
+			std::mutex mutex;
+			std::condition_variable submitCondition;
+			std::condition_variable completedCondition;
+			std::deque<TSimulatedSubmission> submissions;
+			std::atomic<uint64_t> completedValue;
+			bool shutdown;
+
+			// Set while the queue executes a submission that uses a slot, the CPU must never record into a busy slot
+			std::atomic<uint32_t> busySlots[FRAME_RING_MAX_DEPTH];
+		};
+
+		static void simulated_queue_loop(TSimulatedQueue& queue)
+		{
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			while (true)
+			{
+				queue.submitCondition.wait(lock, [&]() { return queue.shutdown || !queue.submissions.empty(); });
+				if (queue.submissions.empty()) return;
+				TSimulatedSubmission submission = queue.submissions.front();
+				queue.submissions.pop_front();
+				lock.unlock();
+
+				// The GPU works on its own, the thread does not take CPU time from the recording thread while it executes
+				std::this_thread::sleep_for(submission.duration);
+
+				lock.lock();
+				queue.busySlots[submission.slot].store(0);
+				queue.completedValue.store(submission.fenceValue);
+				queue.completedCondition.notify_all();
+			}
+		}
+
+		static void wait_for_simulated_fence(TSimulatedQueue& queue, uint64_t fenceValue)
+		{
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			queue.completedCondition.wait(lock, [&]() { return queue.completedValue.load() >= fenceValue; });
+		}
+
+		// Keep the recording thread busy for a duration, stands for the CPU side of a frame
+		static void record_frame(std::chrono::microseconds duration)
+		{
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + duration;
+			while (std::chrono::steady_clock::now() < end)
+			{
+			}
+		}
+
+		struct TPipeliningResult
+		{
+			double totalTime;
+			double stallTime;
+			uint64_t maxFramesInFlight;
+			uint32_t violations;
+		};
+
+		// Run the frames through a ring of depth slots against the simulated queue, checking that no slot is recorded into while the queue uses it
+		// and that no more than depth frames are ever in flight
+		static TPipeliningResult run_frames(uint32_t depth, const std::vector<std::chrono::microseconds>& cpuTimes, const std::vector<std::chrono::microseconds>& gpuTimes)
+		{
+			TSimulatedQueue queue;
+			queue.completedValue.store(0);
+			queue.shutdown = false;
+			for (uint32_t slotIdx = 0; slotIdx < FRAME_RING_MAX_DEPTH; ++slotIdx)
+			{
+				queue.busySlots[slotIdx].store(0);
+			}
+			queue.thread = std::thread(simulated_queue_loop, std::ref(queue));
+
+			TFrameRing ring;
+			init_frame_ring(ring, depth);
+			TPipeliningResult result = {};
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (uint32_t frameIdx = 0; frameIdx < (uint32_t)cpuTimes.size(); ++frameIdx)
+			{
+				// Only wait for the frame that last used the slot
+				uint32_t slot = next_frame_slot(ring);
+				uint64_t waitValue = acquire_frame_slot(ring, slot, queue.completedValue.load());
+				if (waitValue != 0)
+				{
+					std::chrono::steady_clock::time_point stallStart = std::chrono::steady_clock::now();
+					wait_for_simulated_fence(queue, waitValue);
+					result.stallTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stallStart).count();
+				}
+
+				// Check the invariants before recording into the slot
+				if (queue.busySlots[slot].load() != 0) result.violations++;
+				uint64_t framesInFlight = frame_ring_drain_value(ring) - queue.completedValue.load();
+				if (framesInFlight >= depth) result.violations++;
+				result.maxFramesInFlight = framesInFlight + 1 > result.maxFramesInFlight ? framesInFlight + 1 : result.maxFramesInFlight;
+
+				record_frame(cpuTimes[frameIdx]);
+
+				// Submit the frame and signal its fence value after it
+				TSimulatedSubmission submission;
+				submission.fenceValue = submit_frame_slot(ring);
+				submission.slot = slot;
+				submission.duration = gpuTimes[frameIdx];
+				queue.busySlots[slot].store(1);
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.submissions.push_back(submission);
+				queue.submitCondition.notify_one();
+			}
+			wait_for_simulated_fence(queue, frame_ring_drain_value(ring));
+			result.totalTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			{
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.shutdown = true;
+				queue.submitCondition.notify_one();
+			}
+			queue.thread.join();
+			return result;
+		}
+
+		int frame_pipelining(int argc, char** argv)
+		{
+			uint32_t numFrames = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 240;
+			double cpuTime = argc > 1 ? atof(argv[1]) : 4.0;
+			double gpuTime = argc > 2 ? atof(argv[2]) : 5.0;
+			double jitter = argc > 3 ? atof(argv[3]) / 100.0 : 0.5;
+
+			// Both sides of every frame vary uniformly around their mean, the same sequence is used for every depth
+			std::vector<std::chrono::microseconds> cpuTimes(numFrames);
+			std::vector<std::chrono::microseconds> gpuTimes(numFrames);
+			uint32_t seed = 0x9E3779B9u;
+			double cpuSum = 0.0;
+			double gpuSum = 0.0;
+			for (uint32_t frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				double cpuScale = 1.0 + jitter * ((seed >> 8) / 8388608.0 - 1.0);
+				seed = seed * 1664525u + 1013904223u;
+				double gpuScale = 1.0 + jitter * ((seed >> 8) / 8388608.0 - 1.0);
+				cpuTimes[frameIdx] = std::chrono::microseconds((int64_t)(cpuTime * cpuScale * 1000.0));
+				gpuTimes[frameIdx] = std::chrono::microseconds((int64_t)(gpuTime * gpuScale * 1000.0));
+				cpuSum += cpuTimes[frameIdx].count() / 1000.0;
+				gpuSum += gpuTimes[frameIdx].count() / 1000.0;
+			}
+
+			printf("frame_pipelining: %u frames, %.2f ms CPU, %.2f ms GPU, %.0f%% jitter\n", numFrames, cpuTime, gpuTime, jitter * 100.0);
+			printf("serial bound: %.2f ms, overlapped bound: %.2f ms\n", cpuSum + gpuSum, cpuSum > gpuSum ? cpuSum : gpuSum);
+			printf("%6s %10s %10s %10s %10s %10s %10s\n", "depth", "total ms", "ms/frame", "speedup", "stall ms", "in flight", "violations");
+
+			// A depth of 1 waits for the GPU to drain every frame, as present used to
+			double serialTime = 0.0;
+			uint32_t numViolations = 0;
+			for (uint32_t depth = 1; depth <= FRAME_RING_MAX_DEPTH; ++depth)
+			{
+				TPipeliningResult result = run_frames(depth, cpuTimes, gpuTimes);
+				serialTime = depth == 1 ? result.totalTime : serialTime;
+				numViolations += result.violations;
+				printf("%6u %10.2f %10.3f %9.2fx %10.2f %10llu %10u\n", depth, result.totalTime, result.totalTime / numFrames, serialTime / result.totalTime,
+					result.stallTime, (unsigned long long)result.maxFramesInFlight, result.violations);
+			}
+			return numViolations == 0 ? 0 : 1;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Internal includes
+#include "benchmarks.h"
+
+// External includes
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+struct TBenchmark
+{
+	const char* name;
+	int(*function)(int argc, char** argv);
+};
+
+// The set of benchmarks that can be run
+static const TBenchmark benchmarkArray[] =
+{
+	{ "bvh_build", dxr_demo::benchmark::bvh_build },
+	{ "bvh_traversal", dxr_demo::benchmark::bvh_traversal },
+	{ "ray_packets", dxr_demo::benchmark::ray_packets },
+	{ "denoiser", dxr_demo::benchmark::denoiser },
+	{ "procedural", dxr_demo::benchmark::procedural },
+	{ "tlas_rebuild", dxr_demo::benchmark::tlas_rebuild },
+	{ "blas_update", dxr_demo::benchmark::blas_update },
+	{ "bvh_cache", dxr_demo::benchmark::bvh_cache },
+	{ "bvh_paging", dxr_demo::benchmark::bvh_paging },
+	{ "scene_load", dxr_demo::benchmark::scene_load },
+	{ "frame_pipelining", dxr_demo::benchmark::frame_pipelining },
+	{ "task_scheduler", dxr_demo::benchmark::task_scheduler },
+	{ "command_contexts", dxr_demo::benchmark::command_contexts },
+	{ "command_stream", dxr_demo::benchmark::command_stream },
+	{ "render_graph", dxr_demo::benchmark::render_graph },
+};
+
+int main(int argc, char** argv)
+{
+	const uint32_t numBenchmarks = sizeof(benchmarkArray) / sizeof(benchmarkArray[0]);
+	if (argc > 1)
+	{
+		for (uint32_t benchmarkIdx = 0; benchmarkIdx < numBenchmarks; ++benchmarkIdx)
+		{
+			if (strcmp(argv[1], benchmarkArray[benchmarkIdx].name) == 0)
+			{
+				return benchmarkArray[benchmarkIdx].function(argc - 2, argv + 2);
+			}
+		}
+	}
+
+	// Unknown or missing benchmark name
+	printf("usage: benchmark <name> [arguments]\n");
+	for (uint32_t benchmarkIdx = 0; benchmarkIdx < numBenchmarks; ++benchmarkIdx)
+	{
+		printf("  %s\n", benchmarkArray[benchmarkIdx].name);
+	}
+	return 1;
+}
\ No newline at end of file
@@ -0,0 +1,186 @@
+// Internal includes
+#include "benchmarks.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+#include "terrain_scene.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of timed runs, the best one is kept
+		#define PROCEDURAL_NUM_RUNS 3
+
+		// Root data of the hit group of the custom spheres
+		struct TSphereHitGroupData
+		{
+			const float* boxes;
+		};
+
+		// Intersection function of the custom primitives, the same inscribed spheres as the built-in kernels one primitive at a time
+		static bool intersect_custom_spheres(const void* rootData, const TRay& ray, const uint32_t* primitiveIndices, uint32_t numPrimitives, float& tMax, THit& hit)
+		{
+			const float* boxes = ((const TSphereHitGroupData*)rootData)->boxes;
+			float lengthSquared = ray.direction[0] * ray.direction[0] + ray.direction[1] * ray.direction[1] + ray.direction[2] * ray.direction[2];
+			bool found = false;
+			for (uint32_t primitiveIdx = 0; primitiveIdx < numPrimitives; ++primitiveIdx)
+			{
+				const float* box = boxes + 6 * primitiveIndices[primitiveIdx];
+				float radius = 0.5f * std::min(std::min(box[3] - box[0], box[4] - box[1]), box[5] - box[2]);
+				float toCenter[3], offset[3];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					toCenter[axis] = 0.5f * (box[axis] + box[axis + 3]) - ray.origin[axis];
+				}
+				float tCenter = (toCenter[0] * ray.direction[0] + toCenter[1] * ray.direction[1] + toCenter[2] * ray.direction[2]) / lengthSquared;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					offset[axis] = ray.direction[axis] * tCenter - toCenter[axis];
+				}
+				float chordSquared = radius * radius - (offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+				if (chordSquared < 0.0f) continue;
+
+				float halfChord = sqrtf(chordSquared / lengthSquared);
+				float t = tCenter - halfChord >= ray.tMin ? tCenter - halfChord : tCenter + halfChord;
+				if (t < ray.tMin || t >= tMax) continue;
+
+				tMax = t;
+				hit.t = t;
+				hit.u = hit.v = 0.0f;
+				hit.primitiveIndex = primitiveIndices[primitiveIdx];
+				found = true;
+			}
+			return found;
+		}
+
+		// Particles in a slab above the terrain, the box of every one of them is the cube its sphere is inscribed in
+		static void generate_particles(uint32_t numParticles, std::vector<float>& boxes)
+		{
+			std::mt19937 generator(7);
+			std::uniform_real_distribution<float> position(0.0f, 100.0f);
+			std::uniform_real_distribution<float> height(0.0f, 10.0f);
+			std::uniform_real_distribution<float> radius(0.05f, 0.15f);
+
+			boxes.resize(6 * (size_t)numParticles);
+			for (uint32_t particleIdx = 0; particleIdx < numParticles; ++particleIdx)
+			{
+				float center[3] = { position(generator), height(generator), position(generator) };
+				float particleRadius = radius(generator);
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					boxes[6 * (size_t)particleIdx + axis] = center[axis] - particleRadius;
+					boxes[6 * (size_t)particleIdx + axis + 3] = center[axis] + particleRadius;
+				}
+			}
+		}
+
+		// Trace a set of rays, returns the best time in seconds and the number of hits
+		static double trace_rays(const cpu_raytracing::TTopLevelAccelerationStructure& accelerationStructure, const std::vector<TRay>& rays, TTaskScheduler& taskScheduler, uint32_t& numHits)
+		{
+			const uint32_t numTasks = TERRAIN_IMAGE_HEIGHT;
+			const uint32_t raysPerTask = (uint32_t)rays.size() / numTasks;
+			std::vector<uint32_t> taskHits(numTasks);
+
+			double bestTime = 1e30;
+			for (uint32_t runIdx = 0; runIdx < PROCEDURAL_NUM_RUNS; ++runIdx)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				taskScheduler.parallel_for(numTasks, [&](uint32_t taskIdx, uint32_t)
+				{
+					uint32_t hits = 0;
+					for (uint32_t rayIdx = taskIdx * raysPerTask; rayIdx < (taskIdx + 1) * raysPerTask; ++rayIdx)
+					{
+						THit hit;
+						hits += cpu_raytracing::intersect_closest(accelerationStructure, rays[rayIdx], 0xFF, hit) ? 1 : 0;
+					}
+					taskHits[taskIdx] = hits;
+				});
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				bestTime = std::min(bestTime, elapsed.count());
+			}
+
+			numHits = 0;
+			for (uint32_t hits : taskHits)
+			{
+				numHits += hits;
+			}
+			return bestTime;
+		}
+
+		int procedural(int argc, char** argv)
+		{
+			uint32_t numParticles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 1000000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			initialize_triangle_intersection();
+
+			std::vector<float> boxes;
+			generate_particles(numParticles, boxes);
+			std::vector<TRay> primaryRays, incoherentRays;
+			generate_primary_rays(primaryRays);
+			generate_incoherent_rays(incoherentRays);
+
+			// The custom spheres are intersected by the function of the only hit group
+			THitGroupRecord hitGroup = {};
+			hitGroup.intersection = intersect_custom_spheres;
+			TSphereHitGroupData hitGroupData = { boxes.data() };
+			memcpy(hitGroup.rootData, &hitGroupData, sizeof(hitGroupData));
+			TShaderBindingTable shaderBindingTable = {};
+			shaderBindingTable.hitGroups = &hitGroup;
+			shaderBindingTable.numHitGroups = 1;
+
+			const char* instructionSetNames[] = { "sse", "avx2", "avx512" };
+			printf("procedural: %u particles, %u rays, %u threads, %s kernels\n", numParticles, (uint32_t)primaryRays.size(), taskScheduler.num_threads(), instructionSetNames[triangle_intersection_api().instructionSet]);
+			printf("%8s %8s %12s %14s %16s %10s\n", "type", "format", "groups (MB)", "primary Mray/s", "incoherent Mray/s", "hits");
+
+			// The built-in kernels in both node formats, against the intersection function that has to leave the traversal for every leaf
+			const GeometryType::Type typeArray[] = { GeometryType::Spheres, GeometryType::Spheres, GeometryType::CustomPrimitives, GeometryType::Boxes, GeometryType::Boxes };
+			const BVHNodeFormat::Type formatArray[] = { BVHNodeFormat::Binary, BVHNodeFormat::Wide8, BVHNodeFormat::Binary, BVHNodeFormat::Binary, BVHNodeFormat::Wide8 };
+			const char* typeNames[] = { "spheres", "boxes", "custom" };
+			const char* formatNames[] = { "binary", "wide8" };
+			for (uint32_t configIdx = 0; configIdx < 5; ++configIdx)
+			{
+				TGeometryDescriptor geometry = {};
+				geometry.type = typeArray[configIdx];
+				geometry.aabbBuffer = boxes.data();
+				geometry.aabbCount = numParticles;
+				geometry.aabbStride = 6 * sizeof(float);
+				geometry.opaque = true;
+				cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, formatArray[configIdx], &taskScheduler);
+
+				// A single instance with an identity transform
+				TInstanceDescriptor instance = {};
+				instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+				instance.bottomLevel = (BottomLevelAccelerationStructure)bottomLevel;
+				instance.mask = 0xFF;
+				cpu_raytracing::TTopLevelAccelerationStructure* topLevel = cpu_raytracing::create_top_level_acceleration_structure(&instance, 1, BVHBuildMode::BinnedSAH, &taskScheduler);
+				cpu_raytracing::bind_shader_binding_table(*topLevel, &shaderBindingTable);
+
+				uint32_t primaryHits, incoherentHits;
+				double primaryTime = trace_rays(*topLevel, primaryRays, taskScheduler, primaryHits);
+				double incoherentTime = trace_rays(*topLevel, incoherentRays, taskScheduler, incoherentHits);
+
+				printf("%8s %8s %12.2f %14.2f %16.2f %10u\n", typeNames[geometry.type - GeometryType::Spheres], formatNames[bottomLevel->nodeFormat], bottomLevel->primitiveGroups.size() * sizeof(float) / (1024.0 * 1024.0),
+					primaryRays.size() / primaryTime * 1e-6, incoherentRays.size() / incoherentTime * 1e-6, primaryHits + incoherentHits);
+
+				cpu_raytracing::destroy_top_level_acceleration_structure(topLevel);
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(bottomLevel);
+			}
+
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
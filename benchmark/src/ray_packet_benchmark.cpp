@@ -0,0 +1,206 @@
+// Internal includes
+#include "benchmarks.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+#include "terrain_scene.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of timed runs, the best one is kept
+		#define PACKET_NUM_RUNS 3
+
+		// Position of the point light the shadow rays are traced towards
+		static const float lightPosition[3] = { 80.0f, 40.0f, 20.0f };
+
+		namespace TraversalMode
+		{
+			enum Type
+			{
+				Single,
+				Packet8,
+				Packet16
+			};
+		}
+
+		struct TTraversalResult
+		{
+			double time;
+			uint32_t numHits;
+		};
+
+		// Ray index of the lane of a packet, packets cover 4x2 or 4x4 pixel tiles of the image
+		static inline uint32_t tile_ray_index(uint32_t packetIdx, uint32_t lane, uint32_t packetHeight)
+		{
+			const uint32_t tilesPerRow = TERRAIN_IMAGE_WIDTH / 4;
+			uint32_t tileX = packetIdx % tilesPerRow;
+			uint32_t tileY = packetIdx / tilesPerRow;
+			return (tileY * packetHeight + lane / 4) * TERRAIN_IMAGE_WIDTH + tileX * 4 + lane % 4;
+		}
+
+		// Trace a set of rays in image order with one of the traversal modes and a combination of RayFlags, hits are written in the order of the rays
+		static TTraversalResult trace_rays(const cpu_raytracing::TTopLevelAccelerationStructure& accelerationStructure, const std::vector<TRay>& rays, TraversalMode::Type mode, uint32_t rayFlags,
+			TTaskScheduler& taskScheduler, std::vector<THit>& hits, std::vector<bool>& found)
+		{
+			uint32_t numRays = (uint32_t)rays.size();
+			uint32_t packetSize = mode == TraversalMode::Packet8 ? 8 : (mode == TraversalMode::Packet16 ? 16 : 1);
+			uint32_t numTasks = TERRAIN_IMAGE_HEIGHT / 4;
+			uint32_t packetsPerTask = numRays / packetSize / numTasks;
+
+			// Every task owns its slice of the outputs, nothing is allocated while timing
+			std::vector<uint8_t> hitFlags(numRays);
+			std::vector<uint32_t> taskHits(numTasks);
+			hits.resize(numRays);
+
+			TTraversalResult result = { 1e30, 0 };
+			for (uint32_t runIdx = 0; runIdx < PACKET_NUM_RUNS; ++runIdx)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				taskScheduler.parallel_for(numTasks, [&](uint32_t taskIdx, uint32_t)
+				{
+					uint32_t numHits = 0;
+					switch (mode)
+					{
+					case TraversalMode::Single:
+					{
+						for (uint32_t rayIdx = taskIdx * packetsPerTask; rayIdx < (taskIdx + 1) * packetsPerTask; ++rayIdx)
+						{
+							hitFlags[rayIdx] = cpu_raytracing::intersect_ray(accelerationStructure, rays[rayIdx], rayFlags, 0xFF, hits[rayIdx]) ? 1 : 0;
+							numHits += hitFlags[rayIdx];
+						}
+					}
+					break;
+					case TraversalMode::Packet8:
+					case TraversalMode::Packet16:
+					{
+						TRay packetRays[RAY_PACKET_MAX_SIZE];
+						THit packetHits[RAY_PACKET_MAX_SIZE];
+						for (uint32_t packetIdx = taskIdx * packetsPerTask; packetIdx < (taskIdx + 1) * packetsPerTask; ++packetIdx)
+						{
+							for (uint32_t lane = 0; lane < packetSize; ++lane)
+							{
+								packetRays[lane] = rays[tile_ray_index(packetIdx, lane, packetSize / 4)];
+							}
+
+							uint32_t hitMask = cpu_raytracing::intersect_packet(accelerationStructure, packetRays, packetSize, rayFlags, 0xFF, packetHits);
+							for (uint32_t lane = 0; lane < packetSize; ++lane)
+							{
+								uint32_t rayIdx = tile_ray_index(packetIdx, lane, packetSize / 4);
+								hitFlags[rayIdx] = (hitMask >> lane) & 1;
+								hits[rayIdx] = packetHits[lane];
+								numHits += hitFlags[rayIdx];
+							}
+						}
+					}
+					break;
+					};
+					taskHits[taskIdx] = numHits;
+				});
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				result.time = std::min(result.time, elapsed.count());
+			}
+
+			result.numHits = 0;
+			for (uint32_t numHits : taskHits)
+			{
+				result.numHits += numHits;
+			}
+			found.assign(hitFlags.begin(), hitFlags.end());
+			return result;
+		}
+
+		// Rays from the primary hits towards the light, the directions are not normalized so that the light is at t = 1
+		static void generate_shadow_rays(const std::vector<TRay>& primaryRays, const std::vector<THit>& primaryHits, const std::vector<bool>& primaryFound, std::vector<TRay>& rays)
+		{
+			rays.resize(primaryRays.size());
+			for (uint32_t rayIdx = 0; rayIdx < (uint32_t)primaryRays.size(); ++rayIdx)
+			{
+				TRay& ray = rays[rayIdx];
+				const TRay& primaryRay = primaryRays[rayIdx];
+				float t = primaryFound[rayIdx] ? primaryHits[rayIdx].t : 150.0f;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					ray.origin[axis] = primaryRay.origin[axis] + t * primaryRay.direction[axis];
+					ray.direction[axis] = lightPosition[axis] - ray.origin[axis];
+				}
+				ray.tMin = 1e-3f;
+				ray.tMax = 1.0f;
+			}
+		}
+
+		int ray_packets(int argc, char** argv)
+		{
+			uint32_t numTriangles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 1000000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			initialize_triangle_intersection();
+
+			TTerrain terrain;
+			generate_terrain(numTriangles, terrain);
+			TGeometryDescriptor geometry = terrain_geometry(terrain);
+
+			std::vector<TRay> primaryRays, incoherentRays, shadowRays;
+			generate_primary_rays(primaryRays);
+			generate_incoherent_rays(incoherentRays);
+
+			printf("ray_packets: %u triangles, %u rays, %u threads\n", geometry.indexCount / 3, (uint32_t)primaryRays.size(), taskScheduler.num_threads());
+			printf("%8s %12s %10s %10s %10s %10s\n", "format", "rays", "mode", "Mray/s", "speedup", "hits");
+
+			const BVHNodeFormat::Type formatArray[] = { BVHNodeFormat::Binary, BVHNodeFormat::Wide8 };
+			const char* formatNames[] = { "binary", "wide8" };
+			const char* modeNames[] = { "single", "packet8", "packet16" };
+			for (uint32_t formatIdx = 0; formatIdx < 2; ++formatIdx)
+			{
+				cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, formatArray[formatIdx], &taskScheduler);
+
+				// A single instance with an identity transform
+				TInstanceDescriptor instance = {};
+				instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+				instance.bottomLevel = (BottomLevelAccelerationStructure)bottomLevel;
+				instance.mask = 0xFF;
+				cpu_raytracing::TTopLevelAccelerationStructure* topLevel = cpu_raytracing::create_top_level_acceleration_structure(&instance, 1, BVHBuildMode::BinnedSAH, &taskScheduler);
+
+				// The shadow rays start where the primary rays hit
+				std::vector<THit> hits;
+				std::vector<bool> found;
+				trace_rays(*topLevel, primaryRays, TraversalMode::Single, RayFlags::None, taskScheduler, hits, found);
+				generate_shadow_rays(primaryRays, hits, found, shadowRays);
+
+				// Coherent rays are traced alone and by packets, incoherent ones alone since neither packets nor sorting them by origin and octant made them faster
+				// The occlusion rows trace the shadow rays again with the any hit traversal, they must find as many hits as the closest hit ones
+				const std::vector<TRay>* rayArray[] = { &primaryRays, &shadowRays, &shadowRays, &incoherentRays };
+				const char* rayNames[] = { "primary", "shadow", "occlusion", "incoherent" };
+				const uint32_t rayFlagArray[] = { RayFlags::None, RayFlags::None, RayFlags::AcceptFirstHit, RayFlags::None };
+				const TraversalMode::Type modes[] = { TraversalMode::Single, TraversalMode::Packet8, TraversalMode::Packet16 };
+				for (uint32_t rayIdx = 0; rayIdx < 4; ++rayIdx)
+				{
+					uint32_t numModes = rayIdx < 3 ? 3 : 1;
+					double singleTime = 0.0;
+					for (uint32_t modeIdx = 0; modeIdx < numModes; ++modeIdx)
+					{
+						TTraversalResult result = trace_rays(*topLevel, *rayArray[rayIdx], modes[modeIdx], rayFlagArray[rayIdx], taskScheduler, hits, found);
+						singleTime = modeIdx == 0 ? result.time : singleTime;
+						printf("%8s %12s %10s %10.2f %9.2fx %10u\n", formatNames[formatIdx], rayNames[rayIdx], modeNames[modes[modeIdx]],
+							rayArray[rayIdx]->size() / result.time * 1e-6, singleTime / result.time, result.numHits);
+					}
+				}
+
+				cpu_raytracing::destroy_top_level_acceleration_structure(topLevel);
+				cpu_raytracing::destroy_bottom_level_acceleration_structure(bottomLevel);
+			}
+
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
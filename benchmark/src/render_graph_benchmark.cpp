@@ -0,0 +1,360 @@
+// Internal includes
+#include "benchmarks.h"
+#include "render_graph.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of timed compilations of every graph, the best one is kept
+		#define GRAPH_NUM_RUNS 8
+
+		// Passes per transient resource, and imported resources (the outputs among them)
+		#define GRAPH_PASSES_PER_RESOURCE 8
+		#define GRAPH_NUM_IMPORTED 4
+		#define GRAPH_NUM_OUTPUTS 2
+
+		static uint32_t next_random(uint32_t& state)
+		{
+			state = state * 1664525u + 1013904223u;
+			return state >> 8;
+		}
+
+		static void empty_pass(CommandContext, void*)
+		{
+		}
+
+		// Passes that read a few resources that were written before and write one or two, some of them writing what nothing reads
+		// The reads are shader resources, the writes render targets or unordered accesses
+		static void build_graph(TRenderGraph& graph, uint32_t numPasses, uint32_t seed)
+		{
+			reset_render_graph(graph);
+			uint32_t randomState = seed;
+			for (uint32_t importedIdx = 0; importedIdx < GRAPH_NUM_IMPORTED; ++importedIdx)
+			{
+				uint32_t resource = import_render_graph_resource(graph, importedIdx + 1, ResourceState::Present, ResourceState::Present);
+				if (importedIdx < GRAPH_NUM_OUTPUTS)
+				{
+					mark_render_graph_output(graph, resource);
+				}
+			}
+			uint32_t numTransients = numPasses / GRAPH_PASSES_PER_RESOURCE + 1;
+			for (uint32_t transientIdx = 0; transientIdx < numTransients; ++transientIdx)
+			{
+				create_render_graph_resource(graph, GRAPH_NUM_IMPORTED + transientIdx + 1);
+			}
+
+			// Resources in the order they were written, the reads only pick among them so that the graph is valid
+			uint32_t numResources = (uint32_t)graph.resources.size();
+			std::vector<uint32_t> written;
+			std::vector<uint8_t> everWritten(numResources, 0);
+			for (uint32_t importedIdx = 0; importedIdx < GRAPH_NUM_IMPORTED; ++importedIdx)
+			{
+				written.push_back(importedIdx);
+				everWritten[importedIdx] = 1;
+			}
+			for (uint32_t passIdx = 0; passIdx < numPasses; ++passIdx)
+			{
+				uint32_t pass = add_render_pass(graph, "pass", empty_pass, nullptr, next_random(randomState) % 64 == 0);
+
+				// A resource is written at most once per pass, and read from a recent writer most of the time like the chains of a frame
+				uint32_t writes[2];
+				uint32_t numWrites = 1 + next_random(randomState) % 2;
+				for (uint32_t writeIdx = 0; writeIdx < numWrites; ++writeIdx)
+				{
+					writes[writeIdx] = next_random(randomState) % 4 == 0 ? next_random(randomState) % GRAPH_NUM_OUTPUTS : next_random(randomState) % numResources;
+				}
+				numWrites = numWrites == 2 && writes[0] == writes[1] ? 1 : numWrites;
+
+				uint32_t numReads = next_random(randomState) % 4;
+				for (uint32_t readIdx = 0; readIdx < numReads; ++readIdx)
+				{
+					uint32_t window = std::min((uint32_t)written.size(), 32u);
+					uint32_t resource = written[written.size() - 1 - next_random(randomState) % window];
+					bool writtenToo = false;
+					for (uint32_t writeIdx = 0; writeIdx < numWrites; ++writeIdx)
+					{
+						writtenToo |= writes[writeIdx] == resource;
+					}
+					bool readBefore = false;
+					for (uint32_t accessIdx = graph.passes[pass].firstAccess; accessIdx < graph.accesses.size(); ++accessIdx)
+					{
+						readBefore |= graph.accesses[accessIdx].resource == resource;
+					}
+					if (!writtenToo && !readBefore)
+					{
+						add_render_pass_access(graph, pass, resource, RenderGraphAccess::Read, ResourceState::ShaderResource);
+					}
+				}
+				for (uint32_t writeIdx = 0; writeIdx < numWrites; ++writeIdx)
+				{
+					uint32_t resource = writes[writeIdx];
+					RenderGraphAccess::Type type = everWritten[resource] && next_random(randomState) % 3 == 0 ? RenderGraphAccess::ReadWrite : RenderGraphAccess::Write;
+					ResourceState::Type state = next_random(randomState) % 2 == 0 ? ResourceState::RenderTarget : ResourceState::UnorderedAccess;
+					add_render_pass_access(graph, pass, resource, type, state);
+					everWritten[resource] = 1;
+					if (written.back() != resource)
+					{
+						written.push_back(resource);
+					}
+				}
+			}
+		}
+
+		// Passes to keep found by iterating until nothing changes, with the producer of every read found by scanning the passes backward
+		// The rounds go from the last pass to the first one, so that a chain of producers is usually reached in a single round
+		static std::vector<uint8_t> reference_alive_passes(const TRenderGraph& graph)
+		{
+			uint32_t numPasses = (uint32_t)graph.passes.size();
+			std::vector<uint8_t> alive(numPasses, 0);
+			for (uint32_t passIdx = 0; passIdx < numPasses; ++passIdx)
+			{
+				alive[passIdx] = graph.passes[passIdx].sideEffects ? 1 : 0;
+			}
+			for (uint32_t resourceIdx = 0; resourceIdx < graph.resources.size(); ++resourceIdx)
+			{
+				if (!graph.resources[resourceIdx].output) continue;
+				for (uint32_t passIdx = numPasses; passIdx-- > 0; )
+				{
+					const TRenderGraphPass& pass = graph.passes[passIdx];
+					bool writes = false;
+					for (uint32_t accessIdx = pass.firstAccess; accessIdx < pass.firstAccess + pass.numAccesses; ++accessIdx)
+					{
+						writes |= graph.accesses[accessIdx].resource == resourceIdx && graph.accesses[accessIdx].type != RenderGraphAccess::Read;
+					}
+					if (writes)
+					{
+						alive[passIdx] = 1;
+						break;
+					}
+				}
+			}
+
+			bool changed = true;
+			while (changed)
+			{
+				changed = false;
+				for (uint32_t passIdx = numPasses; passIdx-- > 0; )
+				{
+					if (!alive[passIdx]) continue;
+					const TRenderGraphPass& pass = graph.passes[passIdx];
+					for (uint32_t accessIdx = pass.firstAccess; accessIdx < pass.firstAccess + pass.numAccesses; ++accessIdx)
+					{
+						const TRenderGraphAccess& access = graph.accesses[accessIdx];
+						if (access.type == RenderGraphAccess::Write) continue;
+						for (uint32_t producerIdx = passIdx; producerIdx-- > 0; )
+						{
+							const TRenderGraphPass& producer = graph.passes[producerIdx];
+							bool writes = false;
+							for (uint32_t otherIdx = producer.firstAccess; otherIdx < producer.firstAccess + producer.numAccesses; ++otherIdx)
+							{
+								writes |= graph.accesses[otherIdx].resource == access.resource && graph.accesses[otherIdx].type != RenderGraphAccess::Read;
+							}
+							if (writes)
+							{
+								changed |= alive[producerIdx] == 0;
+								alive[producerIdx] = 1;
+								break;
+							}
+						}
+					}
+				}
+			}
+			return alive;
+		}
+
+		// What the replay of a compiled graph found, the counts without merging are one batch per pass that needs a transition
+		struct TGraphCheck
+		{
+			bool culledAsReference;
+			bool statesValid;
+			uint32_t numStateChanges;
+			uint32_t numUnmergedBatches;
+		};
+
+		// Replay the batches and the passes with the state of every resource: each access must find its state, each transition must start from the current one
+		// and the imported resources must end in their final state. The state changes are counted independently of the compilation
+		static TGraphCheck check_compiled_graph(const TRenderGraph& graph, const TCompiledRenderGraph& compiled)
+		{
+			TGraphCheck check;
+			std::vector<uint8_t> alive = reference_alive_passes(graph);
+			std::vector<uint32_t> expectedPasses;
+			for (uint32_t passIdx = 0; passIdx < alive.size(); ++passIdx)
+			{
+				if (alive[passIdx]) expectedPasses.push_back(passIdx);
+			}
+			check.culledAsReference = expectedPasses == compiled.passes;
+
+			uint32_t numResources = (uint32_t)graph.resources.size();
+			std::vector<ResourceState::Type> states(numResources);
+			std::vector<uint8_t> known(numResources);
+			std::vector<ResourceState::Type> expectedStates(numResources);
+			std::vector<uint8_t> expectedKnown(numResources);
+			std::vector<uint32_t> resourceIndex(numResources + GRAPH_NUM_IMPORTED + 2, RENDER_GRAPH_INVALID_INDEX);
+			for (uint32_t resourceIdx = 0; resourceIdx < numResources; ++resourceIdx)
+			{
+				states[resourceIdx] = expectedStates[resourceIdx] = graph.resources[resourceIdx].initialState;
+				known[resourceIdx] = expectedKnown[resourceIdx] = graph.resources[resourceIdx].imported ? 1 : 0;
+				resourceIndex[graph.resources[resourceIdx].frameBuffer] = resourceIdx;
+			}
+
+			check.statesValid = true;
+			check.numStateChanges = 0;
+			check.numUnmergedBatches = 0;
+			uint32_t batchIdx = 0;
+			uint32_t numExecuted = (uint32_t)compiled.passes.size();
+			for (uint32_t slot = 0; slot <= numExecuted; ++slot)
+			{
+				if (batchIdx < compiled.batches.size() && compiled.batches[batchIdx].slot == slot)
+				{
+					const TRenderGraphBarrierBatch& batch = compiled.batches[batchIdx++];
+					for (uint32_t transitionIdx = batch.firstTransition; transitionIdx < batch.firstTransition + batch.numTransitions; ++transitionIdx)
+					{
+						const TResourceTransition& transition = compiled.transitions[transitionIdx];
+						uint32_t resource = resourceIndex[transition.frameBuffer];
+						check.statesValid &= known[resource] && states[resource] == transition.before && transition.before != transition.after;
+						states[resource] = transition.after;
+					}
+				}
+
+				// The state changes the passes need, a pass that needs one counts as one batch without merging
+				bool needsBatch = false;
+				if (slot < numExecuted)
+				{
+					const TRenderGraphPass& pass = graph.passes[compiled.passes[slot]];
+					for (uint32_t accessIdx = pass.firstAccess; accessIdx < pass.firstAccess + pass.numAccesses; ++accessIdx)
+					{
+						const TRenderGraphAccess& access = graph.accesses[accessIdx];
+						if (expectedKnown[access.resource] && expectedStates[access.resource] != access.state)
+						{
+							check.numStateChanges++;
+							needsBatch = true;
+						}
+						expectedStates[access.resource] = access.state;
+						expectedKnown[access.resource] = 1;
+						check.statesValid &= !known[access.resource] || states[access.resource] == access.state;
+						states[access.resource] = access.state;
+						known[access.resource] = 1;
+					}
+				}
+				else
+				{
+					for (uint32_t resourceIdx = 0; resourceIdx < numResources; ++resourceIdx)
+					{
+						const TRenderGraphResource& resource = graph.resources[resourceIdx];
+						if (!resource.imported) continue;
+						if (expectedStates[resourceIdx] != resource.finalState)
+						{
+							check.numStateChanges++;
+							needsBatch = true;
+						}
+						check.statesValid &= states[resourceIdx] == resource.finalState;
+					}
+				}
+				check.numUnmergedBatches += needsBatch ? 1 : 0;
+			}
+			check.statesValid &= batchIdx == compiled.batches.size();
+			return check;
+		}
+
+		// Transitions the execution of a graph issued, counted by a backend that records nothing
+		static uint32_t numExecutedBatches = 0;
+		static uint32_t numExecutedTransitions = 0;
+
+		static void count_transitions(CommandContext, const TResourceTransition*, uint32_t numTransitions)
+		{
+			numExecutedBatches++;
+			numExecutedTransitions += numTransitions;
+		}
+
+		// The frame of the renderer that clears twice: the first clear is culled and the back buffer only goes to the render target state once
+		static bool check_double_clear()
+		{
+			TRenderGraph graph;
+			TCompiledRenderGraph compiled;
+			uint32_t backBuffer = import_render_graph_resource(graph, 1, ResourceState::Present, ResourceState::Present);
+			mark_render_graph_output(graph, backBuffer);
+			for (uint32_t clearIdx = 0; clearIdx < 2; ++clearIdx)
+			{
+				uint32_t pass = add_render_pass(graph, "clear", empty_pass, nullptr);
+				add_render_pass_access(graph, pass, backBuffer, RenderGraphAccess::Write, ResourceState::RenderTarget);
+			}
+			if (!compile_render_graph(graph, compiled)) return false;
+
+			// Executing the graph issues its batches as they were compiled
+			GPUBackendAPI gpuBackendAPI = {};
+			gpuBackendAPI.frame_buffer_api.transition = count_transitions;
+			numExecutedBatches = 0;
+			numExecutedTransitions = 0;
+			execute_render_graph(graph, compiled, gpuBackendAPI, 0);
+			return numExecutedBatches == 2 && numExecutedTransitions == 2 && compiled.passes.size() == 1 && compiled.passes[0] == 1 && compiled.transitions.size() == 2 && compiled.batches.size() == 2
+				&& compiled.transitions[0].before == ResourceState::Present && compiled.transitions[0].after == ResourceState::RenderTarget
+				&& compiled.transitions[1].before == ResourceState::RenderTarget && compiled.transitions[1].after == ResourceState::Present;
+		}
+
+		// A read of a transient resource that nothing wrote, and a pass that sees a resource in two states, do not compile
+		static bool check_invalid_graphs()
+		{
+			TRenderGraph graph;
+			TCompiledRenderGraph compiled;
+			uint32_t transient = create_render_graph_resource(graph, 1);
+			uint32_t pass = add_render_pass(graph, "read", empty_pass, nullptr);
+			add_render_pass_access(graph, pass, transient, RenderGraphAccess::Read, ResourceState::ShaderResource);
+			bool undefinedRead = !compile_render_graph(graph, compiled);
+
+			reset_render_graph(graph);
+			uint32_t imported = import_render_graph_resource(graph, 1, ResourceState::Present, ResourceState::Present);
+			pass = add_render_pass(graph, "both", empty_pass, nullptr);
+			add_render_pass_access(graph, pass, imported, RenderGraphAccess::Read, ResourceState::ShaderResource);
+			add_render_pass_access(graph, pass, imported, RenderGraphAccess::Write, ResourceState::RenderTarget);
+			bool twoStates = !compile_render_graph(graph, compiled);
+			return undefinedRead && twoStates;
+		}
+
+		int render_graph(int argc, char** argv)
+		{
+			uint32_t maxPasses = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 16384;
+			maxPasses = maxPasses > 0 ? maxPasses : 1;
+
+			bool doubleClear = check_double_clear();
+			bool invalidGraphs = check_invalid_graphs();
+			printf("render_graph: up to %u passes, double clear %s, invalid graphs %s\n", maxPasses, doubleClear ? "ok" : "WRONG", invalidGraphs ? "rejected" : "ACCEPTED");
+			printf("%8s %10s %8s %12s %12s %12s %12s %10s %8s\n", "passes", "resources", "culled", "transitions", "naive batch", "batches", "compile us", "ns/pass", "result");
+
+			uint32_t numFailures = (doubleClear ? 0 : 1) + (invalidGraphs ? 0 : 1);
+			TRenderGraph graph;
+			TCompiledRenderGraph compiled;
+			for (uint32_t numPasses = 256; ; numPasses = std::min(numPasses * 4, maxPasses))
+			{
+				build_graph(graph, numPasses, numPasses * 7 + 1);
+
+				// The compiled graph keeps its memory, the runs after the first one do not allocate
+				bool compiles = true;
+				double bestTime = 1e30;
+				for (uint32_t runIdx = 0; runIdx < GRAPH_NUM_RUNS; ++runIdx)
+				{
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					compiles &= compile_render_graph(graph, compiled);
+					double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+					bestTime = time < bestTime ? time : bestTime;
+				}
+
+				// The transitions are the state changes of the kept passes, nothing more
+				TGraphCheck check = check_compiled_graph(graph, compiled);
+				bool valid = compiles && check.culledAsReference && check.statesValid && check.numStateChanges == compiled.transitions.size() && compiled.batches.size() <= check.numUnmergedBatches;
+				numFailures += valid ? 0 : 1;
+				printf("%8u %10u %8u %12u %12u %12u %12.1f %10.1f %8s\n", numPasses, (uint32_t)graph.resources.size(), compiled.numCulledPasses, (uint32_t)compiled.transitions.size(),
+					check.numUnmergedBatches, (uint32_t)compiled.batches.size(), bestTime, bestTime * 1000.0 / numPasses, valid ? "ok" : (check.culledAsReference ? "INVALID" : "CULLING"));
+				if (numPasses == maxPasses) break;
+			}
+			return numFailures == 0 ? 0 : 1;
+		}
+	}
+}
\ No newline at end of file
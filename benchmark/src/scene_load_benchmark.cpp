@@ -0,0 +1,111 @@
+// Internal includes
+#include "benchmarks.h"
+#include "demo_scene.h"
+#include "terrain_scene.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of timed runs, the best one is kept
+		#define SCENE_LOAD_NUM_RUNS 5
+
+		static double elapsed_milliseconds(std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// Read every page of the vertices and indices of a scene, like the build of its acceleration structures would
+		static uint64_t touch_meshes(const TDemoScene& scene)
+		{
+			uint64_t sum = 0;
+			for (const TDemoMesh& mesh : scene.meshes)
+			{
+				for (uint32_t indexIdx = 0; indexIdx < mesh.indexCount; indexIdx += 1024)
+				{
+					sum += mesh.indices[indexIdx];
+				}
+				for (uint32_t valueIdx = 0; valueIdx < 3 * mesh.vertexCount; valueIdx += 1024)
+				{
+					sum += (uint64_t)mesh.vertices[valueIdx];
+				}
+			}
+			return sum;
+		}
+
+		int scene_load(int argc, char** argv)
+		{
+			uint32_t numTriangles = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 4000000;
+			std::string path = std::string(argc > 1 ? argv[1] : ".") + "/scene_load.scene";
+
+			// A terrain with a single instance, written in the scene file format
+			TTerrain terrain;
+			generate_terrain(numTriangles, terrain);
+			TDemoScene scene = TDemoScene();
+			TDemoMesh mesh;
+			mesh.vertices = terrain.vertices.data();
+			mesh.indices = terrain.indices.data();
+			mesh.vertexCount = (uint32_t)terrain.vertices.size() / 3;
+			mesh.indexCount = (uint32_t)terrain.indices.size();
+			scene.meshes.push_back(mesh);
+			TDemoMaterial material = { { 0.8f, 0.8f, 0.8f }, SCENE_FILE_NO_TEXTURE };
+			scene.materials.push_back(material);
+			TDemoInstance instance = { 0, 0 };
+			scene.instances.push_back(instance);
+			const float identity[12] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+			scene.transforms.assign(identity, identity + 12);
+			scene.firstAnimatedInstance = 1;
+			if (!save_demo_scene(scene, path.c_str()))
+			{
+				printf("scene_load: cannot write %s\n", path.c_str());
+				return 1;
+			}
+
+			// The mapping is compared with reading the whole file in memory, the file is in the page cache of the system for both
+			double mapTime = 1e30;
+			double mapTouchTime = 1e30;
+			double readTime = 1e30;
+			uint64_t fileSize = 0;
+			uint64_t checksum = 0;
+			for (uint32_t runIdx = 0; runIdx < SCENE_LOAD_NUM_RUNS; ++runIdx)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				TDemoScene loaded = TDemoScene();
+				if (!load_demo_scene(path.c_str(), loaded))
+				{
+					printf("scene_load: cannot load %s\n", path.c_str());
+					return 1;
+				}
+				mapTime = std::min(mapTime, elapsed_milliseconds(start));
+				checksum += touch_meshes(loaded);
+				mapTouchTime = std::min(mapTouchTime, elapsed_milliseconds(start));
+				fileSize = loaded.file.mappedFile.size;
+				release_demo_scene(loaded);
+
+				start = std::chrono::steady_clock::now();
+				std::ifstream file(path.c_str(), std::ios::binary);
+				std::vector<char> content((size_t)fileSize);
+				file.read(content.data(), (std::streamsize)fileSize);
+				readTime = std::min(readTime, elapsed_milliseconds(start));
+				checksum += (uint64_t)content[content.size() / 2];
+			}
+			remove(path.c_str());
+
+			printf("scene_load: %u triangles, %.2f MB file (checksum %llu)\n", mesh.indexCount / 3, fileSize / (1024.0 * 1024.0), (unsigned long long)checksum);
+			printf("%20s %10s %10s\n", "load", "ms", "GB/s");
+			printf("%20s %10.3f %10.2f\n", "map", mapTime, fileSize / (mapTime * 1e6));
+			printf("%20s %10.3f %10.2f\n", "map + page in", mapTouchTime, fileSize / (mapTouchTime * 1e6));
+			printf("%20s %10.3f %10.2f\n", "read copy", readTime, fileSize / (readTime * 1e6));
+			return 0;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+// Internal includes
+#include "benchmarks.h"
+#include "task_scheduler.h"
+#include "thread_pool.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of timed runs of every workload, the best one is kept
+		#define SCHEDULER_NUM_RUNS 3
+
+		// Tasks of the flat workloads, and outer and inner tasks of the nested one
+		#define SCHEDULER_NUM_TASKS 16384
+		#define SCHEDULER_NUM_OUTER_TASKS 64
+		#define SCHEDULER_NUM_INNER_TASKS 256
+
+		// Tasks of the fine workload, that cost a fraction of the others like the per-instance updates, and the grain the scheduler runs them by
+		#define SCHEDULER_NUM_FINE_TASKS 262144
+		#define SCHEDULER_FINE_WORK_DIVISOR 64
+		#define SCHEDULER_FINE_GRAIN_SIZE 256
+
+		// Tasks of the stages of a simulated frame: scene update, culling and command recording, and number of frames
+		#define SCHEDULER_NUM_UPDATE_TASKS 256
+		#define SCHEDULER_NUM_CULL_TASKS 1024
+		#define SCHEDULER_NUM_RECORD_TASKS 64
+		#define SCHEDULER_NUM_FRAMES 16
+
+		// Stands for the work of a task, iterations of a xorshift whose result the checksums are made of
+		static uint32_t spin_work(uint32_t seed, uint32_t iterations)
+		{
+			uint32_t state = seed | 1;
+			for (uint32_t iterationIdx = 0; iterationIdx < iterations; ++iterationIdx)
+			{
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+			}
+			return state;
+		}
+
+		// The cost of the skewed tasks grows with their index, like tiles that cover more and more of the scene
+		static uint32_t skewed_iterations(uint32_t taskIdx, uint32_t workScale)
+		{
+			return workScale / 8 + (uint32_t)((uint64_t)workScale * 4 * taskIdx * taskIdx / ((uint64_t)SCHEDULER_NUM_TASKS * SCHEDULER_NUM_TASKS));
+		}
+
+		static uint64_t checksum(const std::vector<uint32_t>& results)
+		{
+			uint64_t sum = 0;
+			for (uint32_t result : results)
+			{
+				sum += result;
+			}
+			return sum;
+		}
+
+		template<typename TFunctor>
+		static double best_time(const TFunctor& functor)
+		{
+			double bestTime = 1e30;
+			for (uint32_t runIdx = 0; runIdx < SCHEDULER_NUM_RUNS; ++runIdx)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				functor();
+				double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				bestTime = time < bestTime ? time : bestTime;
+			}
+			return bestTime;
+		}
+
+		// Context of the tasks of a simulated frame, every stage reads the results of the previous one
+		struct TFrameStages
+		{
+			uint32_t workScale;
+			uint32_t frameIndex;
+			std::vector<uint32_t> update;
+			std::vector<uint32_t> cull;
+			std::vector<uint32_t> record;
+		};
+
+		static void update_task(void* userData, uint32_t taskIndex, uint32_t)
+		{
+			TFrameStages& stages = *(TFrameStages*)userData;
+			stages.update[taskIndex] = spin_work(stages.frameIndex * 7919 + taskIndex, stages.workScale);
+		}
+
+		static void cull_task(void* userData, uint32_t taskIndex, uint32_t)
+		{
+			TFrameStages& stages = *(TFrameStages*)userData;
+			stages.cull[taskIndex] = spin_work(stages.update[taskIndex % SCHEDULER_NUM_UPDATE_TASKS] + taskIndex, stages.workScale / 4);
+		}
+
+		static void record_task(void* userData, uint32_t taskIndex, uint32_t)
+		{
+			TFrameStages& stages = *(TFrameStages*)userData;
+			uint32_t seed = 0;
+			const uint32_t cullPerRecord = SCHEDULER_NUM_CULL_TASKS / SCHEDULER_NUM_RECORD_TASKS;
+			for (uint32_t cullIdx = taskIndex * cullPerRecord; cullIdx < (taskIndex + 1) * cullPerRecord; ++cullIdx)
+			{
+				seed += stages.cull[cullIdx];
+			}
+			stages.record[taskIndex] = spin_work(seed, stages.workScale * 2);
+		}
+
+		// Run the frames as chains of stages joined by dependency counters, returns the checksum of the recorded results
+		static uint64_t run_frames(TTaskScheduler* scheduler, uint32_t workScale)
+		{
+			TFrameStages stages;
+			stages.workScale = workScale;
+			stages.update.resize(SCHEDULER_NUM_UPDATE_TASKS);
+			stages.cull.resize(SCHEDULER_NUM_CULL_TASKS);
+			stages.record.resize(SCHEDULER_NUM_RECORD_TASKS);
+			uint64_t sum = 0;
+			for (uint32_t frameIdx = 0; frameIdx < SCHEDULER_NUM_FRAMES; ++frameIdx)
+			{
+				stages.frameIndex = frameIdx;
+				if (scheduler == nullptr)
+				{
+					for (uint32_t taskIdx = 0; taskIdx < SCHEDULER_NUM_UPDATE_TASKS; ++taskIdx) update_task(&stages, taskIdx, 0);
+					for (uint32_t taskIdx = 0; taskIdx < SCHEDULER_NUM_CULL_TASKS; ++taskIdx) cull_task(&stages, taskIdx, 0);
+					for (uint32_t taskIdx = 0; taskIdx < SCHEDULER_NUM_RECORD_TASKS; ++taskIdx) record_task(&stages, taskIdx, 0);
+				}
+				else
+				{
+					// The three stages are submitted at once, the later ones wait on the counter of the previous one
+					TTaskCounter updateCounter;
+					TTaskCounter cullCounter;
+					TTaskCounter recordCounter;
+					TTask updateTask = { update_task, &stages, 0, SCHEDULER_NUM_UPDATE_TASKS, &updateCounter, 1 };
+					TTask cullTask = { cull_task, &stages, 0, SCHEDULER_NUM_CULL_TASKS, &cullCounter, 1 };
+					TTask recordTask = { record_task, &stages, 0, SCHEDULER_NUM_RECORD_TASKS, &recordCounter, 1 };
+					scheduler->submit(updateTask);
+					scheduler->submit(cullTask, &updateCounter);
+					scheduler->submit(recordTask, &cullCounter);
+					scheduler->wait(recordCounter);
+					scheduler->wait(cullCounter);
+					scheduler->wait(updateCounter);
+				}
+				sum += checksum(stages.record);
+			}
+			return sum;
+		}
+
+		int task_scheduler(int argc, char** argv)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			uint32_t maxThreads = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : (hardwareThreads > 0 ? hardwareThreads : 1);
+			uint32_t workScale = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 2000;
+			maxThreads = maxThreads > 0 ? maxThreads : 1;
+
+			// Reference results on the calling thread alone
+			std::vector<uint32_t> results(SCHEDULER_NUM_TASKS);
+			for (uint32_t taskIdx = 0; taskIdx < SCHEDULER_NUM_TASKS; ++taskIdx) results[taskIdx] = spin_work(taskIdx, workScale);
+			uint64_t uniformReference = checksum(results);
+			for (uint32_t taskIdx = 0; taskIdx < SCHEDULER_NUM_TASKS; ++taskIdx) results[taskIdx] = spin_work(taskIdx, skewed_iterations(taskIdx, workScale));
+			uint64_t skewedReference = checksum(results);
+			for (uint32_t taskIdx = 0; taskIdx < SCHEDULER_NUM_TASKS; ++taskIdx) results[taskIdx] = spin_work(taskIdx, workScale);
+			uint64_t nestedReference = checksum(results);
+			uint64_t framesReference = run_frames(nullptr, workScale);
+			std::vector<uint32_t> fineResults(SCHEDULER_NUM_FINE_TASKS);
+			for (uint32_t taskIdx = 0; taskIdx < SCHEDULER_NUM_FINE_TASKS; ++taskIdx) fineResults[taskIdx] = spin_work(taskIdx, workScale / SCHEDULER_FINE_WORK_DIVISOR);
+			uint64_t fineReference = checksum(fineResults);
+
+			printf("task_scheduler: 1 to %u threads, %u iterations per task\n", maxThreads, workScale);
+			printf("%8s %-10s %12s %12s %12s %12s %12s %9s\n", "threads", "executor", "uniform ms", "skewed ms", "nested ms", "frames ms", "fine ms", "speedup");
+
+			uint32_t numMismatches = 0;
+			double baseTime = 0.0;
+
+			// Powers of two up to the largest count, which is always measured
+			for (uint32_t numThreads = 1; ; numThreads = std::min(2 * numThreads, maxThreads))
+			{
+				// The pool shares the tasks through a single counter and runs the nested loops inline
+				{
+					// A pool that is not initialized runs everything on the calling thread, init(0) would spawn a worker per hardware thread
+					TThreadPool threadPool;
+					if (numThreads > 1)
+					{
+						threadPool.init(numThreads - 1);
+					}
+					std::vector<uint64_t> sums(4, 0);
+					double uniformTime = best_time([&]()
+					{
+						threadPool.parallel_for(SCHEDULER_NUM_TASKS, [&](uint32_t taskIdx, uint32_t) { results[taskIdx] = spin_work(taskIdx, workScale); });
+						sums[0] = checksum(results);
+					});
+					double skewedTime = best_time([&]()
+					{
+						threadPool.parallel_for(SCHEDULER_NUM_TASKS, [&](uint32_t taskIdx, uint32_t) { results[taskIdx] = spin_work(taskIdx, skewed_iterations(taskIdx, workScale)); });
+						sums[1] = checksum(results);
+					});
+					double nestedTime = best_time([&]()
+					{
+						threadPool.parallel_for(SCHEDULER_NUM_OUTER_TASKS, [&](uint32_t outerIdx, uint32_t)
+						{
+							threadPool.parallel_for(SCHEDULER_NUM_INNER_TASKS, [&](uint32_t innerIdx, uint32_t)
+							{
+								uint32_t taskIdx = outerIdx * SCHEDULER_NUM_INNER_TASKS + innerIdx;
+								results[taskIdx] = spin_work(taskIdx, workScale);
+							});
+						});
+						sums[2] = checksum(results);
+					});
+					double fineTime = best_time([&]()
+					{
+						threadPool.parallel_for(SCHEDULER_NUM_FINE_TASKS, [&](uint32_t taskIdx, uint32_t) { fineResults[taskIdx] = spin_work(taskIdx, workScale / SCHEDULER_FINE_WORK_DIVISOR); });
+						sums[3] = checksum(fineResults);
+					});
+					bool match = sums[0] == uniformReference && sums[1] == skewedReference && sums[2] == nestedReference && sums[3] == fineReference;
+					numMismatches += match ? 0 : 1;
+					printf("%8u %-10s %12.2f %12.2f %12.2f %12s %12.2f %9s%s\n", numThreads, "pool", uniformTime, skewedTime, nestedTime, "-", fineTime, "-", match ? "" : " mismatch");
+					threadPool.destroy();
+				}
+
+				// The scheduler splits the ranges and steals, the nested loops and the stages of the frames spread over every thread
+				{
+					TTaskScheduler scheduler;
+					scheduler.init(numThreads);
+					std::vector<uint64_t> sums(5, 0);
+					double uniformTime = best_time([&]()
+					{
+						scheduler.parallel_for(SCHEDULER_NUM_TASKS, [&](uint32_t taskIdx, uint32_t) { results[taskIdx] = spin_work(taskIdx, workScale); });
+						sums[0] = checksum(results);
+					});
+					double skewedTime = best_time([&]()
+					{
+						scheduler.parallel_for(SCHEDULER_NUM_TASKS, [&](uint32_t taskIdx, uint32_t) { results[taskIdx] = spin_work(taskIdx, skewed_iterations(taskIdx, workScale)); });
+						sums[1] = checksum(results);
+					});
+					double nestedTime = best_time([&]()
+					{
+						scheduler.parallel_for(SCHEDULER_NUM_OUTER_TASKS, [&](uint32_t outerIdx, uint32_t)
+						{
+							scheduler.parallel_for(SCHEDULER_NUM_INNER_TASKS, [&](uint32_t innerIdx, uint32_t)
+							{
+								uint32_t taskIdx = outerIdx * SCHEDULER_NUM_INNER_TASKS + innerIdx;
+								results[taskIdx] = spin_work(taskIdx, workScale);
+							});
+						});
+						sums[2] = checksum(results);
+					});
+					double framesTime = best_time([&]()
+					{
+						sums[3] = run_frames(&scheduler, workScale);
+					});
+
+					// The fine tasks are run by grains, a steal per task would cost more than the task
+					double fineTime = best_time([&]()
+					{
+						scheduler.parallel_for(SCHEDULER_NUM_FINE_TASKS, [&](uint32_t taskIdx, uint32_t) { fineResults[taskIdx] = spin_work(taskIdx, workScale / SCHEDULER_FINE_WORK_DIVISOR); }, SCHEDULER_FINE_GRAIN_SIZE);
+						sums[4] = checksum(fineResults);
+					});
+					bool match = sums[0] == uniformReference && sums[1] == skewedReference && sums[2] == nestedReference && sums[3] == framesReference && sums[4] == fineReference;
+					numMismatches += match ? 0 : 1;
+
+					// The speedup is the one of the whole scheduler row against its single thread run
+					double totalTime = uniformTime + skewedTime + nestedTime + framesTime + fineTime;
+					baseTime = numThreads == 1 ? totalTime : baseTime;
+					printf("%8u %-10s %12.2f %12.2f %12.2f %12.2f %12.2f %8.2fx%s\n", numThreads, "scheduler", uniformTime, skewedTime, nestedTime, framesTime, fineTime, baseTime / totalTime, match ? "" : " mismatch");
+					scheduler.destroy();
+				}
+				if (numThreads == maxThreads) break;
+			}
+			return numMismatches == 0 ? 0 : 1;
+		}
+	}
+}
\ No newline at end of file
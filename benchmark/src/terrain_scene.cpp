@@ -0,0 +1,107 @@
+// Internal includes
+#include "terrain_scene.h"
+
+// External includes
+#include <algorithm>
+#include <math.h>
+#include <random>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Height field over [0, 100]^2 with two triangles per cell
+		void generate_terrain(uint32_t numTriangles, TTerrain& terrain)
+		{
+			uint32_t resolution = std::max(2u, (uint32_t)sqrtf(numTriangles * 0.5f));
+			std::mt19937 generator(resolution);
+			std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+
+			for (uint32_t z = 0; z <= resolution; ++z)
+			{
+				for (uint32_t x = 0; x <= resolution; ++x)
+				{
+					float px = 100.0f * x / resolution;
+					float pz = 100.0f * z / resolution;
+					terrain.vertices.push_back(px);
+					terrain.vertices.push_back(3.0f * sinf(0.15f * px) * cosf(0.2f * pz) + sinf(0.9f * px + 0.7f * pz) + noise(generator));
+					terrain.vertices.push_back(pz);
+				}
+			}
+
+			for (uint32_t z = 0; z < resolution; ++z)
+			{
+				for (uint32_t x = 0; x < resolution; ++x)
+				{
+					uint32_t v0 = z * (resolution + 1) + x;
+					const uint32_t quad[6] = { v0, v0 + resolution + 1, v0 + 1, v0 + 1, v0 + resolution + 1, v0 + resolution + 2 };
+					terrain.indices.insert(terrain.indices.end(), quad, quad + 6);
+				}
+			}
+		}
+
+		// Pinhole camera above a corner of the terrain, looking across it
+		void generate_primary_rays(std::vector<TRay>& rays)
+		{
+			const float position[3] = { -10.0f, 25.0f, -10.0f };
+			const float forward[3] = { 0.6f, -0.38f, 0.6f };
+			const float right[3] = { 0.707f, 0.0f, -0.707f };
+			const float up[3] = { forward[1] * right[2] - forward[2] * right[1], forward[2] * right[0] - forward[0] * right[2], forward[0] * right[1] - forward[1] * right[0] };
+			float aspectRatio = (float)TERRAIN_IMAGE_WIDTH / TERRAIN_IMAGE_HEIGHT;
+
+			rays.resize(TERRAIN_IMAGE_WIDTH * TERRAIN_IMAGE_HEIGHT);
+			for (uint32_t y = 0; y < TERRAIN_IMAGE_HEIGHT; ++y)
+			{
+				for (uint32_t x = 0; x < TERRAIN_IMAGE_WIDTH; ++x)
+				{
+					float px = (2.0f * (x + 0.5f) / TERRAIN_IMAGE_WIDTH - 1.0f) * 0.577f * aspectRatio;
+					float py = (1.0f - 2.0f * (y + 0.5f) / TERRAIN_IMAGE_HEIGHT) * 0.577f;
+					TRay& ray = rays[y * TERRAIN_IMAGE_WIDTH + x];
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						ray.origin[axis] = position[axis];
+						ray.direction[axis] = forward[axis] + px * right[axis] + py * up[axis];
+					}
+					ray.tMin = 0.0f;
+					ray.tMax = 1e30f;
+				}
+			}
+		}
+
+		// Rays from random points above the terrain in random directions, as bounces would produce
+		void generate_incoherent_rays(std::vector<TRay>& rays)
+		{
+			std::mt19937 generator(1);
+			std::uniform_real_distribution<float> position(0.0f, 100.0f);
+			std::uniform_real_distribution<float> height(4.0f, 6.0f);
+			std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+			rays.resize(TERRAIN_IMAGE_WIDTH * TERRAIN_IMAGE_HEIGHT);
+			for (TRay& ray : rays)
+			{
+				ray.origin[0] = position(generator);
+				ray.origin[1] = height(generator);
+				ray.origin[2] = position(generator);
+				ray.direction[0] = direction(generator);
+				ray.direction[1] = direction(generator);
+				ray.direction[2] = direction(generator);
+				ray.tMin = 0.0f;
+				ray.tMax = 1e30f;
+			}
+		}
+
+		TGeometryDescriptor terrain_geometry(const TTerrain& terrain)
+		{
+			TGeometryDescriptor geometry;
+			geometry.type = GeometryType::Triangles;
+			geometry.vertexBuffer = terrain.vertices.data();
+			geometry.vertexCount = (uint32_t)terrain.vertices.size() / 3;
+			geometry.vertexStride = 3 * sizeof(float);
+			geometry.indexBuffer = terrain.indices.data();
+			geometry.indexCount = (uint32_t)terrain.indices.size();
+			geometry.opaque = true;
+			geometry.allowUpdate = false;
+			return geometry;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+// Internal includes
+#include "benchmarks.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+#include "terrain_scene.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace dxr_demo
+{
+	namespace benchmark
+	{
+		// Number of simulated frames, the best rebuild is kept
+		#define TLAS_REBUILD_NUM_FRAMES 16
+
+		// Number of triangles of the patch of terrain every instance is a copy of
+		#define TLAS_REBUILD_PATCH_TRIANGLES 512
+
+		// Patches of terrain of random sizes scattered over the terrain of the other benchmarks, they drift a little every frame
+		static void generate_instance_transforms(uint32_t numInstances, uint32_t frameIdx, std::vector<float>& transforms)
+		{
+			std::mt19937 generator(5);
+			std::uniform_real_distribution<float> position(0.0f, 100.0f);
+			std::uniform_real_distribution<float> height(0.0f, 10.0f);
+			std::uniform_real_distribution<float> scale(0.002f, 0.01f);
+			std::uniform_real_distribution<float> phase(0.0f, 6.2831853f);
+
+			transforms.assign(12 * (size_t)numInstances, 0.0f);
+			for (uint32_t instanceIdx = 0; instanceIdx < numInstances; ++instanceIdx)
+			{
+				float* transform = &transforms[12 * (size_t)instanceIdx];
+				float instanceScale = scale(generator);
+				float instancePhase = phase(generator);
+				transform[0] = transform[5] = transform[10] = instanceScale;
+				transform[3] = position(generator) + 0.5f * sinf(instancePhase + 0.1f * frameIdx);
+				transform[7] = height(generator);
+				transform[11] = position(generator) + 0.5f * cosf(instancePhase + 0.1f * frameIdx);
+			}
+		}
+
+		// Trace a set of rays, returns the time in seconds and the number of hits
+		static double trace_rays(const cpu_raytracing::TTopLevelAccelerationStructure& accelerationStructure, const std::vector<TRay>& rays, TTaskScheduler& taskScheduler, uint32_t& numHits)
+		{
+			const uint32_t numTasks = TERRAIN_IMAGE_HEIGHT;
+			const uint32_t raysPerTask = (uint32_t)rays.size() / numTasks;
+			std::vector<uint32_t> taskHits(numTasks);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			taskScheduler.parallel_for(numTasks, [&](uint32_t taskIdx, uint32_t)
+			{
+				uint32_t hits = 0;
+				for (uint32_t rayIdx = taskIdx * raysPerTask; rayIdx < (taskIdx + 1) * raysPerTask; ++rayIdx)
+				{
+					THit hit;
+					hits += cpu_raytracing::intersect_closest(accelerationStructure, rays[rayIdx], 0xFF, hit) ? 1 : 0;
+				}
+				taskHits[taskIdx] = hits;
+			});
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			numHits = 0;
+			for (uint32_t hits : taskHits)
+			{
+				numHits += hits;
+			}
+			return elapsed.count();
+		}
+
+		int tlas_rebuild(int argc, char** argv)
+		{
+			uint32_t numInstances = argc > 0 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 100000;
+			uint32_t numThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 0;
+
+			TTaskScheduler taskScheduler;
+			taskScheduler.init(numThreads);
+			initialize_triangle_intersection();
+
+			TTerrain terrain;
+			generate_terrain(TLAS_REBUILD_PATCH_TRIANGLES, terrain);
+			TGeometryDescriptor geometry = terrain_geometry(terrain);
+			cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel = cpu_raytracing::create_bottom_level_acceleration_structure(geometry, BVHNodeFormat::Binary, &taskScheduler);
+
+			std::vector<float> transforms;
+			generate_instance_transforms(numInstances, 0, transforms);
+			std::vector<TInstanceDescriptor> instances(numInstances);
+			for (uint32_t instanceIdx = 0; instanceIdx < numInstances; ++instanceIdx)
+			{
+				TInstanceDescriptor& instance = instances[instanceIdx];
+				std::copy(&transforms[12 * (size_t)instanceIdx], &transforms[12 * (size_t)instanceIdx] + 12, instance.transform);
+				instance.bottomLevel = (BottomLevelAccelerationStructure)bottomLevel;
+				instance.instanceID = instanceIdx;
+				instance.mask = 0xFF;
+				instance.hitGroupIndex = 0;
+			}
+
+			std::vector<TRay> primaryRays;
+			generate_primary_rays(primaryRays);
+
+			printf("tlas_rebuild: %u instances, %u threads\n", numInstances, taskScheduler.num_threads());
+			printf("%8s %12s %12s %12s %12s %14s %10s\n", "builder", "update (ms)", "rebuild (ms)", "Minst/s", "SAH cost", "primary Mray/s", "hits");
+
+			// Every frame moves all the instances and rebuilds the hierarchy over them, as the software backend does in initialize_frame
+			const char* buildModeNames[] = { "sah", "lbvh", "hlbvh" };
+			for (uint32_t modeIdx = 0; modeIdx < 3; ++modeIdx)
+			{
+				BVHBuildMode::Type buildMode = (BVHBuildMode::Type)modeIdx;
+				cpu_raytracing::TTopLevelAccelerationStructure* topLevel = cpu_raytracing::create_top_level_acceleration_structure(instances.data(), numInstances, buildMode, &taskScheduler);
+
+				double bestUpdate = 1e30;
+				double bestRebuild = 1e30;
+				for (uint32_t frameIdx = 1; frameIdx <= TLAS_REBUILD_NUM_FRAMES; ++frameIdx)
+				{
+					generate_instance_transforms(numInstances, frameIdx, transforms);
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					cpu_raytracing::update_instance_transforms(*topLevel, 0, numInstances, transforms.data(), &taskScheduler);
+					std::chrono::steady_clock::time_point updated = std::chrono::steady_clock::now();
+					cpu_raytracing::rebuild_top_level_acceleration_structure(*topLevel, &taskScheduler);
+					std::chrono::steady_clock::time_point rebuilt = std::chrono::steady_clock::now();
+					bestUpdate = std::min(bestUpdate, std::chrono::duration<double>(updated - start).count());
+					bestRebuild = std::min(bestRebuild, std::chrono::duration<double>(rebuilt - updated).count());
+				}
+
+				uint32_t numHits;
+				double traceTime = trace_rays(*topLevel, primaryRays, taskScheduler, numHits);
+				printf("%8s %12.3f %12.3f %12.2f %12.2f %14.2f %10u\n", buildModeNames[modeIdx], bestUpdate * 1e3, bestRebuild * 1e3, numInstances / bestRebuild * 1e-6,
+					bvh_sah_cost(topLevel->bvh), primaryRays.size() / traceTime * 1e-6, numHits);
+
+				cpu_raytracing::destroy_top_level_acceleration_structure(topLevel);
+			}
+
+			cpu_raytracing::destroy_bottom_level_acceleration_structure(bottomLevel);
+			taskScheduler.destroy();
+			return 0;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Forward declaration
+	class TTaskScheduler;
+
+	struct TAABB
+	{
+		float min[3];
+		float max[3];
+	};
+
+	struct TBVHNode
+	{
+		// Nodes are carved out of a pre-allocated arena, they are not initialized on allocation
+		TBVHNode() {}
+
+		// Bounds of the node
+		float min[3];
+
+		// Interior node: index of the left child, the right one is right after it. Leaf: index of the first primitive
+		uint32_t leftFirst;
+
+		float max[3];
+
+		// Number of primitives of a leaf, 0 for an interior node
+		uint32_t count;
+	};
+
+	struct TBVH
+	{
+		// Nodes of the hierarchy, the root is the first one
+		std::vector<TBVHNode> nodes;
+
+		// Leaves reference ranges of this array, which holds indices in the source primitives
+		std::vector<uint32_t> primitiveIndices;
+	};
+
+	// Maximal number of primitives in a leaf
+	#define BVH_MAX_LEAF_SIZE 4
+
+	// Relative cost of traversing a node and intersecting a primitive
+	#define BVH_TRAVERSAL_COST 1.0f
+	#define BVH_INTERSECTION_COST 1.0f
+
+	// Deepest level of a leaf, the root being at level 0. The traversal stacks are sized for it, the builders fall back to balanced splits to stay within it
+	#define BVH_MAX_DEPTH 64
+
+	// Build a binary hierarchy over a set of primitive bounds with a binned surface area heuristic
+	// If a task scheduler is provided, the top of the tree is split in parallel and the subtrees are built by separate tasks
+	// Primitives that are intersected leafWidth at a time are costed by groups, and leaves can then hold up to max(BVH_MAX_LEAF_SIZE, leafWidth) of them
+	// Nodes whose primitives only fit in balanced subtrees under maxDepth are split at their median centroid instead of the heuristic (a subtree built under a node passes what is left of the depth)
+	void build_bvh(const TAABB* primitiveBounds, uint32_t numPrimitives, TBVH& bvh, TTaskScheduler* taskScheduler = nullptr, uint32_t leafWidth = 1, uint32_t maxDepth = BVH_MAX_DEPTH);
+
+	// Surface area heuristic cost of a hierarchy, relative to the area of its root
+	// The leaves are costed by the groups of leafWidth primitives they are intersected by, like build_bvh does. The binary leaves of a bottom level already count groups
+	float bvh_sah_cost(const TBVH& bvh, uint32_t leafWidth = 1);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+// Internal includes
+#include "bvh.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Number of children of a wide node
+	#define BVH8_WIDTH 8
+
+	// Node with up to 8 children, whose bounds are stored as 8 bit offsets on a per node grid (80 bytes)
+	struct TBVH8Node
+	{
+		// Nodes are carved out of a pre-allocated arena, they are not initialized on allocation
+		TBVH8Node() {}
+
+		// Origin of the quantization grid and power of two exponent of its cell size on every axis
+		float origin[3];
+		int8_t exponent[3];
+
+		// Bit i is set if child i is an interior node
+		uint8_t innerMask;
+
+		// The interior children are stored contiguously from childBaseIndex, in slot order
+		uint32_t childBaseIndex;
+
+		// The primitive groups of the leaf children are stored contiguously from primitiveBaseIndex (in groups)
+		uint32_t primitiveBaseIndex;
+
+		// Leaf child: offset from primitiveBaseIndex (5 low bits) and group count (3 high bits). 0 for an empty slot
+		uint8_t meta[BVH8_WIDTH];
+
+		// Quantized bounds of the children, per axis so that all the children of an axis are loaded at once
+		uint8_t quantizedMin[3][BVH8_WIDTH];
+		uint8_t quantizedMax[3][BVH8_WIDTH];
+	};
+
+	struct TBVH8
+	{
+		// Nodes of the hierarchy, the root is the first one
+		std::vector<TBVH8Node> nodes;
+
+		// Leaves reference ranges of this array, which holds indices in the source primitives
+		// Every leaf is padded with BVH8_INVALID_PRIMITIVE up to a multiple of the group width
+		std::vector<uint32_t> primitiveIndices;
+		uint32_t groupWidth;
+	};
+
+	// Index of the primitives that pad the leaves
+	#define BVH8_INVALID_PRIMITIVE 0xFFFFFFFFu
+
+	// Cell size of a quantization grid from its exponent
+	inline float bvh8_scale(int8_t exponent)
+	{
+		union { uint32_t bits; float value; } scale;
+		scale.bits = (uint32_t)(exponent + 127) << 23;
+		return scale.value;
+	}
+
+	// Collapse a binary hierarchy into a wide one, whose leaves reference groups of groupWidth primitives
+	// The leaves of the binary hierarchy must fit in 7 groups
+	void build_bvh8(const TBVH& bvh, TBVH8& bvh8, uint32_t groupWidth = 1);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+// Internal includes
+#include "cpu_raytracing.h"
+
+// External includes
+#include <stdint.h>
+
+namespace dxr_demo
+{
+	namespace cpu_raytracing
+	{
+		// Version of the layout of the cache files, files of another version are ignored and rebuilt
+		#define BVH_CACHE_VERSION 1
+
+		// Alignment of the sections of a cache file, relative to its first byte
+		#define BVH_CACHE_SECTION_ALIGNMENT 64
+
+		// Key of the structure of a geometry, hashes the primitives and everything the built structure depends on: node layout and width of the intersection kernels
+		uint64_t bvh_cache_key(const TGeometryDescriptor& geometry, BVHNodeFormat::Type nodeFormat);
+
+		// Write a structure built by create_bottom_level_acceleration_structure to a cache file, returns false if the file cannot be written
+		// The file is written next to its final path and renamed once complete, a reader never maps a partial file
+		bool save_bottom_level_acceleration_structure(const TBottomLevelAccelerationStructure& accelerationStructure, uint64_t key, const char* path);
+
+		// Map a cache file and use its sections as the arrays of a structure, nothing is copied or patched since the nodes only hold indices
+		// Returns null if the file does not exist, was written for another key or version, or is truncated
+		TBottomLevelAccelerationStructure* load_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, uint64_t key, const char* path);
+
+		// Load the structure of a geometry from its file in cacheDirectory, or build it and write the file if there is none
+		// The geometries that allow updates are always built, their structure is modified in place
+		TBottomLevelAccelerationStructure* create_cached_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, BVHNodeFormat::Type nodeFormat, TTaskScheduler* taskScheduler, const char* cacheDirectory);
+	}
+}
\ No newline at end of file
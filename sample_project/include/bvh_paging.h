@@ -0,0 +1,175 @@
+#pragma once
+
+// Internal includes
+#include "cpu_raytracing.h"
+
+// External includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace cpu_raytracing
+	{
+		// Version of the layout of the paged files, files of another version are ignored and rebuilt
+		#define BVH_PAGE_VERSION 1
+
+		// Largest size in bytes of the nodes and primitive groups of a page, a leaf that is larger on its own gets a page of its size
+		#define BVH_PAGE_TARGET_SIZE (256 * 1024)
+
+		// Alignment of the pages in a paged file, relative to its first byte
+		#define BVH_PAGE_FILE_ALIGNMENT 4096
+
+		// Count of the resident leaves that stand for a page, their leftFirst is the index of the page
+		#define BVH_PAGE_LEAF_COUNT 0xFFFFFFFFu
+
+		// Bits of the state of a page, the lowest ones count the traversals that read it or wait for it
+		#define BVH_PAGE_RESIDENT 0x80000000u
+		#define BVH_PAGE_REQUESTED 0x40000000u
+		#define BVH_PAGE_PIN_MASK 0x3FFFFFFFu
+
+		// Forward declaration
+		struct TBVHPageCache;
+
+		struct TBVHPage
+		{
+			// Location of the page in the file, number of its nodes and of the groups that follow them
+			uint64_t offset;
+			uint64_t size;
+			uint32_t numNodes;
+			uint32_t numGroups;
+
+			// Nodes of the subtree, the root is the first one and the leaves reference the groups of the page, empty while the page is not resident
+			std::vector<uint8_t> data;
+
+			// Resident leaf that references the page, the rays put aside are tested against its bounds before the page is read for them
+			TBVHNode leaf;
+
+			// Residency and pins, and value of the use clock of the cache when the page was last read
+			std::atomic<uint32_t> state;
+			std::atomic<uint64_t> lastUse;
+		};
+
+		struct TBVHPageTable
+		{
+			// Subtrees of the structure, the resident top of the hierarchy references them by index
+			std::vector<TBVHPage> pages;
+
+			// File the pages are read from, only the loader thread of the cache reads it
+			std::string path;
+			std::ifstream file;
+			TBVHPageCache* cache;
+		};
+
+		struct TBVHPageCache
+		{
+			// Bytes of the pages that can be resident at once, and bytes of the resident ones
+			uint64_t budget;
+			std::atomic<uint64_t> residentBytes;
+
+			// Incremented by every read of a page and every load, orders the pages from the least recently used
+			std::atomic<uint64_t> useClock;
+
+			// The loader thread reads the requested pages in the order they were requested
+			std::thread loader;
+			std::mutex mutex;
+			std::condition_variable requestCondition;
+			std::condition_variable loadedCondition;
+			std::deque<std::pair<TBVHPageTable*, uint32_t>> requests;
+			std::vector<TBVHPageTable*> tables;
+			TBVHPageTable* loadingTable;
+			bool shutdown;
+
+			// Counters since the statistics were last collected
+			std::atomic<uint64_t> pageHits;
+			std::atomic<uint64_t> pageMisses;
+			std::atomic<uint64_t> deferredRays;
+			std::atomic<uint64_t> stallNanoseconds;
+			std::atomic<uint64_t> loadedBytes;
+		};
+
+		struct TBVHPageStatistics
+		{
+			// Traversals that found their page resident and that did not
+			uint64_t pageHits;
+			uint64_t pageMisses;
+
+			// Rays that were put aside until their page was loaded
+			uint64_t deferredRays;
+
+			// Time the traversal threads waited for pages in milliseconds, summed over the threads
+			double stallTime;
+
+			// Bytes read from the disk, and bytes resident when the statistics were collected
+			uint64_t loadedBytes;
+			uint64_t residentBytes;
+		};
+
+		// A ray that reached a page that is not resident, and the distance at which it enters the bounds of the page
+		struct TDeferredPageRay
+		{
+			uint32_t rayIndex;
+			uint32_t instanceIndex;
+			uint32_t pageIndex;
+			float tEnter;
+		};
+
+		// Rays a traversal put aside, filled by the traversal of the ray rayIndex through the instance instanceIndex
+		struct TBVHPageDeferral
+		{
+			uint32_t rayIndex;
+			uint32_t instanceIndex;
+			std::vector<TDeferredPageRay> rays;
+		};
+
+		// Start the loader thread of a cache that keeps at most budget bytes of pages resident, and stop it once every paged structure is destroyed
+		void init_bvh_page_cache(TBVHPageCache& cache, uint64_t budget);
+		void destroy_bvh_page_cache(TBVHPageCache& cache);
+
+		// Counters of the cache since the previous call, they are reset
+		void collect_bvh_page_statistics(TBVHPageCache& cache, TBVHPageStatistics& statistics);
+
+		// Write a binary structure built by create_bottom_level_acceleration_structure as a resident top and pages of subtrees, returns false if it cannot be written
+		// The subtrees that fit in BVH_PAGE_TARGET_SIZE become pages, their nodes and groups are renumbered so that every page stands on its own
+		bool save_paged_bottom_level_acceleration_structure(const TBottomLevelAccelerationStructure& accelerationStructure, uint64_t key, const char* path);
+
+		// Read the resident top of a paged file, the pages are loaded by the cache as the traversal reaches them
+		// Returns null if the file does not exist, was written for another key or version, or is truncated
+		TBottomLevelAccelerationStructure* open_paged_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, uint64_t key, const char* path, TBVHPageCache& cache);
+
+		// Open the paged file of a geometry in directory, or build the structure and write the file if there is none
+		// The geometries that allow updates and the custom primitives are not paged, nor is a structure whose file cannot be written
+		TBottomLevelAccelerationStructure* create_paged_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, TTaskScheduler* taskScheduler, const char* directory, TBVHPageCache& cache);
+
+		// Unregister the pages of a structure from their cache and release them, called by destroy_bottom_level_acceleration_structure
+		void close_bvh_page_table(TBVHPageTable* pageTable);
+
+		// Pin a page and return its nodes, or count a miss and return null if it is not resident
+		// The page is not requested, the rays that missed it are put aside and request it once their traversal is over
+		const uint8_t* acquire_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex);
+
+		// Pin a page and queue its load if it is neither resident nor requested yet, without waiting for it
+		// The pin keeps the page resident from its load until release_bvh_page, so that the traversals that requested it read it before it is evicted
+		void request_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex);
+
+		// Pin a page and return its nodes if it is resident, the access is not counted and a page that is not resident is not requested
+		const uint8_t* try_acquire_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex);
+
+		// Return the nodes of a page pinned by request_bvh_page, waiting for the loader thread if it is not resident yet
+		// The access is not counted again, it follows an acquire_bvh_page that missed
+		const uint8_t* wait_for_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex);
+
+		// Unpin a page, the cache can evict it once no traversal holds it
+		inline void release_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex)
+		{
+			pageTable.pages[pageIndex].state.fetch_sub(1);
+		}
+	}
+}
\ No newline at end of file
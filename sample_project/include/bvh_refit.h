@@ -0,0 +1,123 @@
+#pragma once
+
+// Internal includes
+#include "bvh.h"
+
+// External includes
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Growth of the cost of a subtree, relative to its cost when it was built, past which the update tries to rebuild it
+	#define BVH_REFIT_REBUILD_THRESHOLD 1.25f
+
+	// Largest number of leaves of the subtrees the update rebuilds, the levels above them are refit
+	#define BVH_REFIT_SUBTREE_MAX_LEAVES 256
+
+	// Largest number of leaves of the subtree two sibling subtrees are merged in when the cost of their parent grew past the threshold
+	#define BVH_REFIT_MERGE_MAX_LEAVES 4096
+
+	// Index of the empty slots of the leaf items, the same value as TRIANGLE_INVALID_PRIMITIVE
+	#define BVH_REFIT_INVALID_PRIMITIVE 0xFFFFFFFFu
+
+	// Part of the hierarchy that is rebuilt as a whole from its primitives
+	struct TBVHRefitSubtree
+	{
+		// Root of the subtree, it keeps its slot while the nodes under it are rewritten
+		uint32_t root;
+
+		// Level of the root in the hierarchy, a rebuild keeps the leaves within BVH_MAX_DEPTH
+		uint32_t depth;
+
+		// Pairs of nodes and range of leaf items the subtree owns, a rebuild that needs fewer of them leaves the others unused for the next one
+		std::vector<uint32_t> pairs;
+		uint32_t firstItem;
+		uint32_t numItems;
+	};
+
+	// Scratch of the rebuild of a subtree, one per thread
+	struct TBVHSubtreeScratch
+	{
+		// Primitives of the subtree and their bounds
+		std::vector<uint32_t> primitives;
+		std::vector<TAABB> bounds;
+
+		// New hierarchy over the primitives, the cost of the subtree of each of its nodes, and the nodes left to write with their slot
+		TBVH bvh;
+		std::vector<float> costs;
+		std::vector<uint32_t> stack;
+	};
+
+	// What a hierarchy needs to be updated in place when its primitives move, instead of being rebuilt
+	struct TBVHRefitState
+	{
+		// Parent of every node, the root is its own parent
+		std::vector<uint32_t> parents;
+
+		// Number of children that reached every interior node, it is never reset: the counters are even between two refits and the arrival that makes one odd is the second one
+		std::unique_ptr<std::atomic<uint32_t>[]> visits;
+
+		// Surface area heuristic cost of the subtree of every node, not normalized. The leaves are costed by their items
+		std::vector<float> costs;
+
+		// Cost of every subtree root and of their parents when their topology was last picked
+		// A rebuild that does not lower the cost still becomes the reference, the node is only tried again once its cost grew by the threshold again
+		std::vector<float> referenceCosts;
+
+		// The leaves reference items of itemWidth slots, every slot holds the index of a primitive or BVH_REFIT_INVALID_PRIMITIVE
+		// The items of a subtree are contiguous, a rebuild redistributes its primitives over them
+		uint32_t itemWidth;
+		std::vector<uint32_t> items;
+
+		// Bounds of every primitive, written by the caller before every update
+		std::vector<TAABB> primitiveBounds;
+
+		// Subtrees that cover every leaf, the nodes above them are only refit
+		std::vector<TBVHRefitSubtree> subtrees;
+
+		// Growth of the cost of a subtree past which it is rebuilt, BVH_REFIT_REBUILD_THRESHOLD unless changed after prepare_bvh_refit (FLT_MAX only refits)
+		float rebuildThreshold;
+
+		// Subtrees whose cost grew past the threshold during the current update, and the nodes and the cost every rebuild replaced (0 if it was not worth it)
+		std::vector<uint32_t> degradedSubtrees;
+		std::vector<uint32_t> rebuiltNodes;
+		std::vector<float> rebuildGains;
+
+		// Parents of two subtrees whose cost still grew past the threshold once the subtrees were rebuilt, as the indices of their two subtrees
+		std::vector<uint32_t> degradedParents;
+
+		// First item and number of items of every range the update redistributed, the caller rewrites what it derived from them
+		std::vector<uint32_t> rebuiltItemRanges;
+
+		std::vector<TBVHSubtreeScratch> scratch;
+	};
+
+	struct TBVHRefitStatistics
+	{
+		// Interior nodes whose bounds were recomputed from their children, and nodes of the subtrees that were rebuilt
+		uint32_t refitNodes;
+		uint32_t rebuiltNodes;
+		uint32_t rebuiltSubtrees;
+
+		// Pairs of sibling subtrees that were rebuilt as one
+		uint32_t mergedSubtrees;
+
+		// Cost of the hierarchy after the update, relative to the area of its root like bvh_sah_cost
+		float sahCost;
+	};
+
+	// Record the parents of the nodes of a freshly built hierarchy and split it in the subtrees that can be rebuilt
+	// The leaves reference numItems items of itemWidth slots, the items of every subtree must be contiguous. primitiveBounds must already hold the bounds of the primitives
+	void prepare_bvh_refit(const TBVH& bvh, const uint32_t* items, uint32_t numItems, uint32_t itemWidth, TBVHRefitState& state);
+
+	// Update a hierarchy whose leaves have new bounds, they must already be written in the leaf nodes and primitiveBounds must hold the new bounds of the primitives
+	// The interior nodes are refit bottom up in parallel, every leaf walks up to the first node whose other child is not done yet
+	// The subtrees whose cost grew past rebuildThreshold times their reference cost are rebuilt from their primitives with the binned surface area heuristic of build_bvh,
+	// the leaves that cost the least to merge are merged until the new topology fits in the nodes and the items of the subtree
+	// When the cost of the parent of two subtrees still grew past the threshold once they are rebuilt, primitives moved from one to the other and the parent is rebuilt with both of them as one subtree
+	// A rebuild writes its nodes in the slots of the subtree and its primitives in the items of the subtree, the levels above it stay valid. The items it rewrote are listed in rebuiltItemRanges
+	void refit_bvh(TBVH& bvh, TBVHRefitState& state, TTaskScheduler* taskScheduler, TBVHRefitStatistics& statistics);
+}
\ No newline at end of file
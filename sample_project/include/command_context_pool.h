@@ -0,0 +1,69 @@
+#pragma once
+
+// External includes
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Pool of the command contexts of a backend. The contexts are kept from one frame to the next, a frame acquires them from any thread
+	// and the flush reads them back in increasing submission index, so that the submission does not depend on the timing of the threads
+	template<typename TContext>
+	class TCommandContextPool
+	{
+	public:
+		// Context that no other thread acquired this frame, create is only called when every context of the pool is taken
+		// Returns null if create does. The submission indices must be unique within a frame
+		template<typename TCreate>
+		TContext* acquire(uint32_t submissionIndex, const TCreate& create)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_acquired.size() == _contexts.size())
+			{
+				TContext* context = create();
+				if (context == nullptr) return nullptr;
+				_contexts.push_back(context);
+			}
+			TContext* context = _contexts[_acquired.size()];
+			_acquired.push_back(std::make_pair(submissionIndex, context));
+			return context;
+		}
+
+		// Number of contexts acquired since the last reset
+		uint32_t num_acquired() const
+		{
+			return (uint32_t)_acquired.size();
+		}
+
+		// The contexts acquired this frame in increasing submission index, only called once the recording threads are done
+		const std::vector<std::pair<uint32_t, TContext*>>& sorted_contexts()
+		{
+			std::sort(_acquired.begin(), _acquired.end(), [](const std::pair<uint32_t, TContext*>& first, const std::pair<uint32_t, TContext*>& second) { return first.first < second.first; });
+			for (uint32_t contextIdx = 1; contextIdx < _acquired.size(); ++contextIdx)
+			{
+				assert(_acquired[contextIdx - 1].first != _acquired[contextIdx].first);
+			}
+			return _acquired;
+		}
+
+		// Make every context available again for the next frame
+		void reset()
+		{
+			_acquired.clear();
+		}
+
+		// Every context of the pool, acquired or not, for the backend to release them
+		const std::vector<TContext*>& contexts() const
+		{
+			return _contexts;
+		}
+
+	private:
+		std::mutex _mutex;
+		std::vector<TContext*> _contexts;
+		std::vector<std::pair<uint32_t, TContext*>> _acquired;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+
+// Internal includes
+#include "gpu_types.h"
+#include "raytracing_descriptor.h"
+
+// External includes
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Size of the blocks of a frame arena, a command never crosses two of them
+	#define FRAME_ARENA_BLOCK_SIZE (64 * 1024)
+
+	// Number of frame buffers whose state the merge of the streams of a frame keeps track of, the commands on the others are left as they are
+	#define COMMAND_STREAM_MAX_TRACKED_TARGETS 16
+
+	// Bump allocator whose memory is released all at once when the frame is reset. The blocks are kept from one frame to the next,
+	// so once the arena reached the size of the largest frame it no longer touches the heap
+	struct TFrameArena
+	{
+		std::vector<uint8_t*> blocks;
+		uint32_t blockSize;
+
+		// Block that is allocated from and offset of its first free byte
+		uint32_t currentBlock;
+		uint32_t offset;
+	};
+
+	// Init and destruction of an arena, the first block is allocated by the first allocation
+	void init_frame_arena(TFrameArena& arena, uint32_t blockSize = FRAME_ARENA_BLOCK_SIZE);
+	void destroy_frame_arena(TFrameArena& arena);
+
+	// Make the memory of every block available again, the pointers handed out before are no longer valid
+	void reset_frame_arena(TFrameArena& arena);
+
+	// Aligned memory from the current block, the next block is used when it does not fit. The size must fit in a block
+	void* allocate_from_frame_arena(TFrameArena& arena, uint32_t size, uint32_t alignment);
+
+	namespace CommandType
+	{
+		enum Type
+		{
+			Clear,
+			Barrier,
+			DispatchRays,
+			TracePaths,
+
+			// Command that the merge of the streams removed, the backends skip it
+			Skipped
+		};
+	}
+
+	// Every command starts with its header, the commands of a stream are chained in recording order
+	struct TCommandHeader
+	{
+		CommandType::Type type;
+		TCommandHeader* next;
+	};
+
+	// Every command but the barrier writes a single frame buffer, it starts with this header so that the frame buffer is read without knowing the command
+	struct TTargetCommandHeader
+	{
+		TCommandHeader header;
+		Framebuffer frameBuffer;
+	};
+
+	struct TClearCommand
+	{
+		TTargetCommandHeader target;
+		float color[4];
+	};
+
+	// The transitions of a barrier are issued together, they follow the command in the arena
+	struct TBarrierCommand
+	{
+		TCommandHeader header;
+		uint32_t numTransitions;
+		TResourceTransition transitions[1];
+	};
+
+	// The pipelines are copied in the command, the data they point to must stay valid until the command list is flushed
+	struct TDispatchRaysCommand
+	{
+		TTargetCommandHeader target;
+		TopLevelAccelerationStructure accelerationStructure;
+		TRayTracingPipeline pipeline;
+	};
+
+	struct TTracePathsCommand
+	{
+		TTargetCommandHeader target;
+		TopLevelAccelerationStructure accelerationStructure;
+		TPathTracingPipeline pipeline;
+	};
+
+	// The chain of commands is walked through their headers, a new command type must start with one of them
+	static_assert(offsetof(TTargetCommandHeader, header) == 0, "The target header must start with the command header");
+	static_assert(offsetof(TBarrierCommand, header) == 0, "A barrier must start with its header");
+	static_assert(offsetof(TClearCommand, target) == 0, "A clear must start with its target header");
+	static_assert(offsetof(TDispatchRaysCommand, target) == 0, "A dispatch must start with its target header");
+	static_assert(offsetof(TTracePathsCommand, target) == 0, "A trace must start with its target header");
+
+	// Commands that one thread recorded for the current frame, they live in the arena of the stream until it is reset
+	// The stream only holds plain data, the backends translate it when the command list is flushed
+	struct TCommandStream
+	{
+		TFrameArena arena;
+		TCommandHeader* first;
+		TCommandHeader* last;
+		uint32_t numCommands;
+	};
+
+	// Init and destruction of a stream
+	void init_command_stream(TCommandStream& stream, uint32_t blockSize = FRAME_ARENA_BLOCK_SIZE);
+	void destroy_command_stream(TCommandStream& stream);
+
+	// Drop the commands of the previous frame and reset the arena behind them
+	void reset_command_stream(TCommandStream& stream);
+
+	// Append a command to the stream, a barrier whose transitions do not fit in a block of the arena is recorded as several ones
+	void record_clear(TCommandStream& stream, Framebuffer frameBuffer, const float* color);
+	void record_barrier(TCommandStream& stream, const TResourceTransition* transitions, uint32_t numTransitions);
+	void record_dispatch_rays(TCommandStream& stream, Framebuffer frameBuffer, TopLevelAccelerationStructure accelerationStructure, const TRayTracingPipeline& pipeline);
+	void record_trace_paths(TCommandStream& stream, Framebuffer frameBuffer, TopLevelAccelerationStructure accelerationStructure, const TPathTracingPipeline& pipeline);
+
+	// Go over the streams of a frame in submission order and mark as skipped the commands that have no effect: the transitions to the state
+	// the frame buffer is already in, and the clears that a later clear overwrites before any other command uses the frame buffer
+	// Returns the number of clears and transitions that were skipped
+	uint32_t merge_command_streams(TCommandStream* const* streams, uint32_t numStreams);
+}
\ No newline at end of file
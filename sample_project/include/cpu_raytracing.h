@@ -0,0 +1,153 @@
+#pragma once
+
+// Internal includes
+#include "bvh.h"
+#include "bvh8.h"
+#include "bvh_refit.h"
+#include "lbvh.h"
+#include "mapped_file.h"
+#include "raytracing_descriptor.h"
+#include "triangle_intersection.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Forward declaration
+	class TTaskScheduler;
+
+	namespace cpu_raytracing
+	{
+		// Forward declaration
+		struct TBVHPageTable;
+
+		struct TBottomLevelAccelerationStructure
+		{
+			// Layout of the hierarchy, only the matching one is filled
+			BVHNodeFormat::Type nodeFormat;
+			TBVH bvh;
+			TBVH8 bvh8;
+
+			// Bounds of the primitives
+			TAABB bounds;
+
+			// Flag of the geometry, tested by the rays that only consider opaque geometries, and kind of its primitives
+			bool opaque;
+			GeometryType::Type geometryType;
+
+			// Primitives in the layout of the intersection kernels picked at creation, leaves reference groups of them
+			// The custom primitives have no groups, their binary leaves reference the primitive indices of the hierarchy and numGroups is their count
+			const TIntersectPrimitiveGroupsFunction* intersect_groups;
+			uint32_t groupWidth;
+			uint32_t groupSize;
+			uint32_t numGroups;
+			std::vector<float> primitiveGroups;
+
+			// The geometry can be updated, and what the refit of its hierarchy needs
+			bool allowUpdate;
+			TBVHRefitState refitState;
+
+			// Arrays the traversal reads, they point in the storage above or in the cache file the structure was loaded from
+			// A structure loaded from a cache file keeps it mapped and leaves the storage above empty
+			const TBVHNode* nodes;
+			const TBVH8Node* wideNodes;
+			const uint32_t* primitiveIndices;
+			const float* groups;
+			TMappedFile mappedFile;
+
+			// Pages of a structure opened from a paged file, null otherwise, see bvh_paging.h
+			// The resident binary nodes reference them with leaves of BVH_PAGE_LEAF_COUNT primitives and groups is null
+			TBVHPageTable* pageTable;
+		};
+
+		struct TInstance
+		{
+			// Transforms between the space of the bottom level structure and the world, 3x4 row major
+			float objectToWorld[12];
+			float worldToObject[12];
+
+			const TBottomLevelAccelerationStructure* bottomLevel;
+			uint32_t instanceID;
+			uint32_t mask;
+			uint32_t hitGroupIndex;
+		};
+
+		struct TTopLevelAccelerationStructure
+		{
+			// Hierarchy over the world space bounds of the instances, the builder it is rebuilt with and the scratch of the linear builders
+			TBVH bvh;
+			BVHBuildMode::Type buildMode;
+			TLBVHBuilder lbvhBuilder;
+
+			// The instances moved since the hierarchy was built
+			bool needsRebuild;
+
+			// Instances, in the order they were provided
+			std::vector<TInstance> instances;
+			std::vector<TAABB> instanceBounds;
+
+			// Records the custom primitives find their intersection function in, the instances of custom primitives are skipped while it is null
+			const TShaderBindingTable* shaderBindingTable;
+		};
+
+		// Creation and destruction of an acceleration structure over a triangle mesh or a set of procedural primitives, the task scheduler is optional
+		// The custom primitives always get a binary hierarchy, their leaves are handed to the intersection function of the hit group
+		TBottomLevelAccelerationStructure* create_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, BVHNodeFormat::Type nodeFormat, TTaskScheduler* taskScheduler);
+		void destroy_bottom_level_acceleration_structure(TBottomLevelAccelerationStructure* accelerationStructure);
+
+		// Bring an acceleration structure created with allowUpdate up to date with the new positions of its primitives, the geometry must have the same primitives
+		// The primitive groups and the leaves are recomputed, the hierarchy is refit and its most degraded subtrees are rebuilt, see refit_bvh
+		// The statistics of the refit are written if they are requested
+		void update_bottom_level_acceleration_structure(TBottomLevelAccelerationStructure& accelerationStructure, const TGeometryDescriptor& geometry, TTaskScheduler* taskScheduler, TBVHRefitStatistics* statistics = nullptr);
+
+		// Creation and destruction of an acceleration structure over instances, their bottom level handles must be TBottomLevelAccelerationStructure pointers
+		// The hierarchy is built with the given mode at creation and by every rebuild
+		TTopLevelAccelerationStructure* create_top_level_acceleration_structure(const TInstanceDescriptor* instances, uint32_t numInstances, BVHBuildMode::Type buildMode, TTaskScheduler* taskScheduler);
+		void destroy_top_level_acceleration_structure(TTopLevelAccelerationStructure* accelerationStructure);
+
+		// Bind the shader binding table whose intersection functions the traversal calls on the custom primitives, null to unbind it
+		void bind_shader_binding_table(TTopLevelAccelerationStructure& accelerationStructure, const TShaderBindingTable* shaderBindingTable);
+
+		// Replace the transforms of a range of instances, the hierarchy over the instances is stale until the structure is rebuilt
+		void update_instance_transforms(TTopLevelAccelerationStructure& accelerationStructure, uint32_t firstInstance, uint32_t numInstances, const float* transforms, TTaskScheduler* taskScheduler);
+
+		// Recompute the world space bounds of the instances of a bottom level structure that was updated, the hierarchy over the instances is then stale
+		void refresh_instance_bounds(TTopLevelAccelerationStructure& accelerationStructure, const TBottomLevelAccelerationStructure* bottomLevel);
+
+		// Rebuild the hierarchy over the instances if they moved, must happen before rays are traced against the structure
+		void rebuild_top_level_acceleration_structure(TTopLevelAccelerationStructure& accelerationStructure, TTaskScheduler* taskScheduler);
+
+		// Find the closest intersection of a ray with the instances that match the mask, returns false if there is none
+		bool intersect_closest(const TTopLevelAccelerationStructure& accelerationStructure, const TRay& ray, uint32_t instanceMask, THit& hit);
+
+		// Same as intersect_closest with a combination of RayFlags, the traversal is instantiated for every combination of the flags that change it
+		// With RayFlags::AcceptFirstHit the traversal stops at the first intersection it finds, this is the occlusion query of the shadow rays
+		bool intersect_ray(const TTopLevelAccelerationStructure& accelerationStructure, const TRay& ray, uint32_t rayFlags, uint32_t instanceMask, THit& hit);
+
+		// Largest number of rays intersect_closest_packet traces together
+		#define RAY_PACKET_MAX_SIZE 16
+
+		// Closest intersections of a packet of coherent rays, such as the primary rays of a pixel tile or their shadow rays
+		// Nodes the whole packet misses are culled with a single frustum test when the directions of the rays share their signs
+		// Returns the mask of the rays that hit something, only their hits are written
+		uint32_t intersect_closest_packet(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t instanceMask, THit* hits);
+
+		// Packet version of intersect_ray, the rays that accept their first hit leave the packet as soon as they found one
+		uint32_t intersect_packet(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t rayFlags, uint32_t instanceMask, THit* hits);
+
+		// Closest intersections of a stream of incoherent rays, such as bounces
+		// The pages that are not resident are read once for the whole stream, found receives 1 for the rays that hit
+		void intersect_closest_stream(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t instanceMask, THit* hits, uint8_t* found);
+
+		// Stream version of intersect_ray
+		void intersect_stream(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t rayFlags, uint32_t instanceMask, THit* hits, uint8_t* found);
+
+		// Implementation of TRayDispatchContext::trace_ray
+		void trace_ray(const TRayDispatchContext& context, const TRay& ray, uint32_t rayFlags, uint32_t instanceMask, void* payload);
+
+		// Run the ray generation function over a rectangle of the dispatch, output is RGBA32F with a stride in pixels
+		void dispatch_rays_region(const TRayDispatchContext& context, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, float* output, uint32_t outputStride);
+	}
+}
\ No newline at end of file
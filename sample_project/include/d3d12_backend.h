@@ -27,6 +27,7 @@ namespace dxr_demo
 			float get_time(RenderEnvironment render_environement);
 
 			bool initialize_frame(RenderEnvironment render_environement);
+			CommandContext acquire_command_context(RenderEnvironment render_environement, uint32_t submissionIndex);
 			bool flush_command_list(RenderEnvironment render_environement);
 			bool present(RenderEnvironment render_environement);
 		}
@@ -36,11 +37,13 @@ namespace dxr_demo
 			void show(RenderWindow window);
 			void hide(RenderWindow window);
 			bool is_active(RenderWindow window);
+			void swap(RenderWindow window);
 		}
 
 		namespace framebuffer
 		{
-			void clear(Framebuffer frame_buffer, const float* clearColor);
+			void clear(CommandContext command_context, Framebuffer frame_buffer, const float* clearColor);
+			void transition(CommandContext command_context, const TResourceTransition* transitions, uint32_t numTransitions);
 		}
 	}
 }
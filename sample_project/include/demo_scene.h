@@ -0,0 +1,107 @@
+#pragma once
+
+// Internal includes
+#include "raytracing_descriptor.h"
+#include "scene_file.h"
+#include "texture_descriptor.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	struct TCamera
+	{
+		// Position and orthonormal basis of the camera
+		float position[3];
+		float forward[3];
+		float right[3];
+		float up[3];
+
+		// Tangent of half the vertical field of view
+		float tanHalfFov;
+	};
+
+	struct TDemoMesh
+	{
+		// Three floats per vertex and three indices per triangle, in the storage of the scene or in the file it was loaded from
+		const float* vertices;
+		const uint32_t* indices;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+	};
+
+	struct TDemoMaterial
+	{
+		float albedo[3];
+
+		// Texture the albedo is multiplied by, SCENE_FILE_NO_TEXTURE if there is none
+		uint32_t textureIndex;
+	};
+
+	struct TDemoInstance
+	{
+		uint32_t meshIndex;
+		uint32_t materialIndex;
+	};
+
+	struct TDemoScene
+	{
+		// Meshes of the scene, each one gets a bottom level acceleration structure
+		std::vector<TDemoMesh> meshes;
+
+		// Materials of the instances and the textures they reference
+		std::vector<TDemoMaterial> materials;
+		std::vector<TTextureView> textures;
+
+		// Instances of the meshes and their transforms (12 floats each), the instances after firstAnimatedInstance move over time
+		std::vector<TDemoInstance> instances;
+		std::vector<float> transforms;
+		uint32_t firstAnimatedInstance;
+
+		// Point of view and lighting
+		TCamera camera;
+		float lightDirection[3];
+
+		// Vertices and indices of a scene built in memory, a scene loaded from a file leaves them empty and keeps the file mapped instead
+		std::vector<float> vertexStorage;
+		std::vector<uint32_t> indexStorage;
+		TSceneFile file;
+	};
+
+	// Fill the scene with a ground plane, a few boxes and a ring of small instanced cubes
+	void build_demo_scene(TDemoScene& scene);
+
+	// Map a scene file, the meshes and the textures of the scene point in the mapping instead of being copied
+	// The records of the file are checked against each other, the content of the index buffers is trusted. Returns false if the file cannot be used
+	bool load_demo_scene(const char* path, TDemoScene& scene);
+
+	// Write the scene in the scene file format, returns false if the file cannot be written
+	bool save_demo_scene(const TDemoScene& scene, const char* path);
+
+	// Unmap the file of a loaded scene, its meshes and textures are invalid afterwards
+	void release_demo_scene(TDemoScene& scene);
+
+	// Move the animated instances to their position at a given time (in seconds)
+	void update_demo_scene(TDemoScene& scene, float time);
+
+	// Number of instances that update_demo_scene moves, they start at firstAnimatedInstance
+	uint32_t num_demo_animated_instances(const TDemoScene& scene);
+
+	// Move a single animated instance, the instances are independent so they can be updated from several threads
+	void update_demo_instance(TDemoScene& scene, uint32_t animatedIdx, float time);
+
+	// Geometry descriptor that matches a mesh of the scene
+	TGeometryDescriptor demo_mesh_geometry(const TDemoMesh& mesh);
+
+	// Instance descriptors of the scene, bottomLevels holds the acceleration structure of every mesh
+	void demo_scene_instances(const TDemoScene& scene, const BottomLevelAccelerationStructure* bottomLevels, std::vector<TInstanceDescriptor>& instances);
+
+	// Pipeline that renders the scene with direct lighting and hard shadows
+	TRayTracingPipeline demo_scene_pipeline(const TDemoScene& scene);
+
+	// Pipeline that path traces the scene, lit by the sun and the sky
+	// hitGroups receives the shader binding table, one record per instance, it must outlive the pipeline
+	TPathTracingPipeline demo_scene_path_tracing_pipeline(const TDemoScene& scene, std::vector<THitGroupRecord>& hitGroups);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+// Internal includes
+#include "texture_descriptor.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Forward declaration
+	class TTaskScheduler;
+
+	struct TDenoiserSettings
+	{
+		// Number of a-trous iterations, the step between the taps doubles at every one of them (1, 2, 4, ...)
+		uint32_t numIterations;
+
+		// Luminance edge stopping, in standard deviations of the luminance of the pixel
+		float colorPhi;
+
+		// The normal weight is the cosine between the normals raised to the power 2^normalSharpness
+		uint32_t normalSharpness;
+
+		// Depth edge stopping, relative to the depth of the pixel and to the step of the iteration
+		float depthPhi;
+	};
+
+	// Planar scratch of the filter, it is sized for the largest frame and reused from one call to the next
+	struct TDenoiser
+	{
+		// Dimensions the buffers were allocated for
+		uint32_t width;
+		uint32_t height;
+
+		// Irradiance (radiance divided by the albedo, three planes) and its luminance variance, ping-ponged between the iterations
+		std::vector<float> irradiance[2];
+		std::vector<float> variance[2];
+
+		// Guides of the edge stopping functions, the normal is stored as three planes
+		std::vector<float> normals;
+		std::vector<float> depth;
+	};
+
+	// Settings that work for the path traced demo scene
+	TDenoiserSettings default_denoiser_settings();
+
+	// Edge-avoiding a-trous filter of a noisy radiance buffer, guided by the albedo, normal and depth of the first hits
+	// radiance, albedo, normal and output hold three floats per pixel and depth one, all in scanline order. Pixels with a zero normal (sky) are left untouched
+	// Every iteration is a single row parallel pass that filters four pixels at once, the last one modulates the albedo back into output
+	void denoise(TDenoiser& denoiser, const TTextureDescriptor& radiance, const TTextureDescriptor& albedo, const TTextureDescriptor& normal, const TTextureDescriptor& depth,
+		const TDenoiserSettings& settings, TTaskScheduler& taskScheduler, TTextureDescriptor& output);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+// External includes
+#include <stdint.h>
+
+namespace dxr_demo
+{
+	// Largest number of frames the CPU can record while the GPU executes the previous ones
+	#define FRAME_RING_MAX_DEPTH 3
+
+	// Tracks the fence value that ends the last submission of every frame slot, a slot owns the resources of a frame (command allocator, back buffer)
+	// and can only be reused once the GPU is past that value. The fence values are signaled in submission order on a single queue
+	struct TFrameRing
+	{
+		// Number of slots and slot of the frame being recorded
+		uint32_t depth;
+		uint32_t currentSlot;
+
+		// Last fence value handed out by submit_frame_slot
+		uint64_t signaledValue;
+
+		// Fence value that ends the last submission of every slot, 0 if it has not been submitted since the ring was reset
+		uint64_t slotFenceValues[FRAME_RING_MAX_DEPTH];
+	};
+
+	// Init a ring of depth slots, clamped to [1, FRAME_RING_MAX_DEPTH]. The fence values start after initialValue
+	void init_frame_ring(TFrameRing& ring, uint32_t depth, uint64_t initialValue = 0);
+
+	// Slot that follows the current one in submission order
+	uint32_t next_frame_slot(const TFrameRing& ring);
+
+	// Make slot the current one and return the fence value the CPU has to wait for before reusing its resources
+	// Returns 0 if the GPU is already past it according to completedValue, or if the slot was never submitted
+	uint64_t acquire_frame_slot(TFrameRing& ring, uint32_t slot, uint64_t completedValue);
+
+	// Hand out the fence value to signal once the work of the current slot is submitted, the slot keeps it until its next submission
+	uint64_t submit_frame_slot(TFrameRing& ring);
+
+	// Fence value the GPU has to reach for every submitted slot to be done
+	uint64_t frame_ring_drain_value(const TFrameRing& ring);
+
+	// Forget the submissions of every slot once the ring was drained, the fence values keep increasing
+	void reset_frame_ring(TFrameRing& ring);
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 // Internal includes
 #include "gpu_types.h"
 #include "texture_descriptor.h"
+#include "raytracing_descriptor.h"
 
 // External includes
 #include <stdint.h>
@@ -10,11 +11,18 @@
 
 namespace dxr_demo
 {
+	// Forward declaration
+	class TTaskScheduler;
+
 	namespace RenderingBackEnd
 	{
 		enum Type
 		{
-			D3D12
+			D3D12,
+			// Headless backend without window nor device, used to measure the CPU side of the frame
+			Null,
+			// CPU backend that renders into a tiled frame buffer on the task scheduler of the renderer
+			Software
 		};
 	}
 
@@ -24,6 +32,30 @@ namespace dxr_demo
 		uint32_t width;
 		uint32_t height;
 		bool fullscreen;
+		RenderingBackEnd::Type backend;
+
+		// Node layout of the acceleration structures built by the backends that trace on the CPU, and builder of their top level ones
+		BVHNodeFormat::Type bvhNodeFormat;
+		BVHBuildMode::Type topLevelBuildMode;
+
+		// Directory the bottom level structures of the backends that trace on the CPU are cached in, keyed by the content of their geometry. Empty disables the cache
+		std::string bvhCacheDirectory;
+
+		// Bytes of bottom level subtrees the backends that trace on the CPU keep in memory, the others are paged in from files in the cache directory as rays reach them
+		// The CPU plays the role of the adapter whose dedicated memory bounds the GPU backends, zero keeps every structure resident
+		uint64_t bvhPageBudget;
+
+		// Milliseconds per frame the path tracer may spend converging a still image, zero renders one sample per frame of an animated scene
+		float progressiveTimeBudget;
+
+		// Filter the path traced image with the denoiser
+		bool denoise;
+
+		// Scene file the renderer maps, the built-in demo scene is used when it is empty or cannot be loaded
+		std::string scenePath;
+
+		// Scheduler of the renderer, filled by TRenderer::init. The backends spread their work over its threads from the thread that renders
+		TTaskScheduler* taskScheduler;
 		uint64_t platformData[6];
 	};
 
@@ -42,6 +74,10 @@ namespace dxr_demo
 		uint64_t (*frame_index)(RenderEnvironment renderEnv);
 
 		bool (*initialize_frame)(RenderEnvironment render_environement);
+
+		// Command context of the current frame, the calling thread records into it while the other threads record into theirs
+		// flush_command_list submits the contexts of the frame in increasing submission index, whatever the order they were acquired in. The indices must be unique within a frame
+		CommandContext (*acquire_command_context)(RenderEnvironment render_environement, uint32_t submissionIndex);
 		bool (*flush_command_list)(RenderEnvironment render_environement);
 		bool (*present)(RenderEnvironment render_environement);
 	};
@@ -57,7 +93,38 @@ namespace dxr_demo
 	struct GPUFrameBufferAPI
 	{
 		// Framebuffer manipulation functions
-		void(*clear)(Framebuffer frame_buffer, const float* color);
+		void(*clear)(CommandContext command_context, Framebuffer frame_buffer, const float* color);
+
+		// Record a batch of state changes, issued together before the commands recorded after it. The frame buffers start and end every frame in the present state
+		void(*transition)(CommandContext command_context, const TResourceTransition* transitions, uint32_t numTransitions);
+	};
+
+	struct GPUAccelerationStructureAPI
+	{
+		// Bottom level acceleration structures, built once over a triangle mesh
+		BottomLevelAccelerationStructure(*create_bottom_level_acceleration_structure)(RenderEnvironment render_environment, const TGeometryDescriptor& geometry);
+		void(*destroy_bottom_level_acceleration_structure)(RenderEnvironment render_environment, BottomLevelAccelerationStructure acceleration_structure);
+
+		// Refit a bottom level acceleration structure created with allowUpdate over the new positions of its primitives, the geometry must have the same primitives
+		// The top level ones that instance it are rebuilt by the next initialize_frame
+		void(*update_bottom_level_acceleration_structure)(RenderEnvironment render_environment, BottomLevelAccelerationStructure acceleration_structure, const TGeometryDescriptor& geometry);
+
+		// Top level acceleration structures, built over instances of bottom level ones that must outlive them
+		TopLevelAccelerationStructure(*create_top_level_acceleration_structure)(RenderEnvironment render_environment, const TInstanceDescriptor* instances, uint32_t numInstances);
+		void(*destroy_top_level_acceleration_structure)(RenderEnvironment render_environment, TopLevelAccelerationStructure acceleration_structure);
+
+		// Replace the transforms (12 floats each) of a range of instances, the cost only depends on the number of instances
+		// The hierarchy over the instances is rebuilt once by the next initialize_frame, however many updates happened
+		void(*update_instance_transforms)(RenderEnvironment render_environment, TopLevelAccelerationStructure acceleration_structure, uint32_t firstInstance, uint32_t numInstances, const float* transforms);
+	};
+
+	struct GPURayTracingAPI
+	{
+		// Record the execution of the ray generation function over every pixel of the frame buffer
+		void(*dispatch_rays)(CommandContext command_context, Framebuffer frame_buffer, TopLevelAccelerationStructure acceleration_structure, const TRayTracingPipeline& pipeline);
+
+		// Record the rendering of one path traced sample per pixel of the frame buffer, with the stages of the pipeline run over the whole frame
+		void(*trace_paths)(CommandContext command_context, Framebuffer frame_buffer, TopLevelAccelerationStructure acceleration_structure, const TPathTracingPipeline& pipeline);
 	};
 
 	struct GPUBackendAPI
@@ -65,6 +132,10 @@ namespace dxr_demo
 		GPURenderSystemAPI render_system_api;
 		GPUWindowAPI window_api;
 		GPUFrameBufferAPI frame_buffer_api;
+
+		// Only filled by the backends that support ray tracing
+		GPUAccelerationStructureAPI acceleration_structure_api;
+		GPURayTracingAPI ray_tracing_api;
 	};
 
 	// Initialize the target api
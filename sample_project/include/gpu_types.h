@@ -9,4 +9,27 @@ namespace dxr_demo
 	typedef uint64_t RenderEnvironment;
 	typedef uint64_t RenderWindow;
 	typedef uint64_t Framebuffer;
+	typedef uint64_t CommandContext;
+	typedef uint64_t BottomLevelAccelerationStructure;
+	typedef uint64_t TopLevelAccelerationStructure;
+
+	// States a frame buffer goes through, translated to the ones of the API by the backends that track them
+	namespace ResourceState
+	{
+		enum Type
+		{
+			Present,
+			RenderTarget,
+			UnorderedAccess,
+			ShaderResource
+		};
+	}
+
+	// Change of the state of a frame buffer, the commands recorded after it see the new state
+	struct TResourceTransition
+	{
+		Framebuffer frameBuffer;
+		ResourceState::Type before;
+		ResourceState::Type after;
+	};
 }
\ No newline at end of file
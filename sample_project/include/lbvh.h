@@ -0,0 +1,39 @@
+#pragma once
+
+// Internal includes
+#include "bvh.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Scratch of the linear builder, it is sized for the largest build and reused from one build to the next
+	struct TLBVHBuilder
+	{
+		// Morton code of every primitive in the high half and its index in the low one, ping-ponged by the radix sort
+		std::vector<uint64_t> keys[2];
+
+		// Centroid bounds and digit histograms of every chunk of the primitives
+		std::vector<TAABB> chunkBounds;
+		std::vector<uint32_t> histograms;
+
+		// First sorted primitive of every cluster followed by the number of primitives, and number of clusters that start in every chunk
+		std::vector<uint32_t> clusterStarts;
+		std::vector<uint32_t> chunkClusters;
+
+		// Root of the subtree of every cluster and index of the first node below it
+		std::vector<TBVHNode> clusterRoots;
+		std::vector<uint32_t> clusterDescendants;
+
+		// Order of the clusters while the levels above them are split
+		std::vector<uint32_t> clusterOrder;
+	};
+
+	// Build a binary hierarchy with one primitive per leaf by sorting the primitives along a Morton curve over their centroids
+	// The sorted primitives are cut in clusters (the cells of a 16^3 grid) whose subtrees are emitted in parallel by splitting at the highest differing bit of the codes
+	// The levels above the clusters are split the same way, or with a binned surface area heuristic weighted by the size of the clusters if sahTopLevels is set (HLBVH)
+	// Nothing is allocated once the scratch and the hierarchy have reached the number of primitives
+	void build_lbvh(TLBVHBuilder& builder, const TAABB* primitiveBounds, uint32_t numPrimitives, TBVH& bvh, TTaskScheduler* taskScheduler = nullptr, bool sahTopLevels = false);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+// External includes
+#include <stdint.h>
+
+namespace dxr_demo
+{
+	// Read only view of a whole file mapped in the address space, the pages are loaded by the system when they are first touched
+	struct TMappedFile
+	{
+		// First byte of the file, page aligned, and size of the file in bytes
+		const uint8_t* data;
+		uint64_t size;
+
+		// Handles of the file and of its mapping on Windows
+		void* fileHandle;
+		void* mappingHandle;
+	};
+
+	// Map a file, returns false if it does not exist, is empty or cannot be mapped
+	bool map_file(const char* path, TMappedFile& file);
+
+	// Release a mapped file, the pointers into it are invalid afterwards. Does nothing on a file that is not mapped
+	void unmap_file(TMappedFile& file);
+}
\ No newline at end of file
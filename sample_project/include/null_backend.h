@@ -0,0 +1,45 @@
+#pragma once
+
+// Internal includes
+#include "gpu_backend.h"
+
+namespace dxr_demo
+{
+	namespace null
+	{
+		namespace render_system
+		{
+			bool init_render_system();
+			void shutdown_render_system();
+
+			RenderEnvironment create_render_environment(const TGraphicSettings& graphic_settings);
+			void destroy_render_environment(RenderEnvironment render_environment);
+
+			RenderWindow render_window(RenderEnvironment render_environement);
+			Framebuffer default_frame_buffer(RenderEnvironment renderEnv);
+
+			uint64_t frame_index(RenderEnvironment renderEnv);
+
+			float get_time(RenderEnvironment render_environement);
+
+			bool initialize_frame(RenderEnvironment render_environement);
+			CommandContext acquire_command_context(RenderEnvironment render_environement, uint32_t submissionIndex);
+			bool flush_command_list(RenderEnvironment render_environement);
+			bool present(RenderEnvironment render_environement);
+		}
+
+		namespace window
+		{
+			void show(RenderWindow window);
+			void hide(RenderWindow window);
+			bool is_active(RenderWindow window);
+			void swap(RenderWindow window);
+		}
+
+		namespace framebuffer
+		{
+			void clear(CommandContext command_context, Framebuffer frame_buffer, const float* clearColor);
+			void transition(CommandContext command_context, const TResourceTransition* transitions, uint32_t numTransitions);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,284 @@
+#pragma once
+
+// Internal includes
+#include "gpu_types.h"
+
+// External includes
+#include <stdint.h>
+
+namespace dxr_demo
+{
+	namespace GeometryType
+	{
+		enum Type
+		{
+			// Indexed triangles of the vertex and index buffers
+			Triangles,
+			// Procedural primitives of the AABB buffer: the sphere inscribed in every box (its radius is half the smallest side), the boxes themselves,
+			// or whatever the intersection function of the hit group of the instance finds in them
+			Spheres,
+			Boxes,
+			CustomPrimitives
+		};
+	}
+
+	// Triangle mesh or set of procedural primitives an acceleration structure is built from
+	struct TGeometryDescriptor
+	{
+		// Kind of primitives of the geometry, only the matching buffers are read
+		GeometryType::Type type;
+
+		// Vertex positions (three floats), vertexStride bytes apart
+		const float* vertexBuffer;
+		uint32_t vertexCount;
+		uint32_t vertexStride;
+
+		// Three indices per triangle
+		const uint32_t* indexBuffer;
+		uint32_t indexCount;
+
+		// Bounds of the procedural primitives, six floats each (min then max), aabbStride bytes apart
+		const float* aabbBuffer;
+		uint32_t aabbCount;
+		uint32_t aabbStride;
+
+		// Rays traced with RayFlags::OpaqueOnly ignore the geometries that are not opaque
+		bool opaque;
+
+		// The primitives can be moved after the creation of the acceleration structure, which is then updated in place instead of rebuilt
+		// The hierarchy of such a geometry is always binary, the bounds of wide nodes are quantized against their parent and cannot be refit
+		bool allowUpdate;
+	};
+
+	namespace BVHNodeFormat
+	{
+		enum Type
+		{
+			// Two children per node with full precision bounds
+			Binary,
+			// Eight children per node with bounds quantized on 8 bits, fewer and smaller nodes to fetch
+			Wide8
+		};
+	}
+
+	namespace BVHBuildMode
+	{
+		enum Type
+		{
+			// Binned surface area heuristic, the best hierarchy but the slowest build
+			BinnedSAH,
+			// Primitives sorted along a Morton curve and split at the bits of their codes, built in a few linear passes
+			LBVH,
+			// LBVH under a grid of clusters whose hierarchy is built with the surface area heuristic
+			HLBVH
+		};
+	}
+
+	// Placement of a bottom level acceleration structure in a top level one
+	struct TInstanceDescriptor
+	{
+		// Object to world transform, 3x4 row major matrix
+		float transform[12];
+
+		// Acceleration structure the instance is a copy of
+		BottomLevelAccelerationStructure bottomLevel;
+
+		// Value reported in the hits of the instance
+		uint32_t instanceID;
+
+		// The instance is only visible to the rays whose mask shares a bit with this one
+		uint32_t mask;
+
+		// Record of the geometry of the instance in the shader binding table of the path tracing pipeline
+		uint32_t hitGroupIndex;
+	};
+
+	// Options of a traced ray, they select a traversal kernel specialized for them
+	namespace RayFlags
+	{
+		enum Type
+		{
+			None = 0x0,
+			// Stop at the first intersection found rather than the closest one, for occlusion rays
+			AcceptFirstHit = 0x1,
+			// Ignore the triangles whose counter clockwise side faces away from the ray
+			CullBackFaces = 0x2,
+			// Ignore the geometries that are not opaque
+			OpaqueOnly = 0x4,
+			// Do not call the closest hit function of the pipeline, only the miss function is called
+			SkipClosestHit = 0x8
+		};
+	}
+
+	struct TRay
+	{
+		float origin[3];
+		float tMin;
+		float direction[3];
+		float tMax;
+	};
+
+	struct THit
+	{
+		// Distance along the ray
+		float t;
+
+		// Barycentric coordinates of the hit relative to the second and third vertices
+		float u;
+		float v;
+
+		// Index of the triangle or procedural primitive in the source geometry
+		uint32_t primitiveIndex;
+
+		// Index of the instance in the top level acceleration structure and its user value
+		uint32_t instanceIndex;
+		uint32_t instanceID;
+	};
+
+	// Forward declaration
+	struct TRayDispatchContext;
+
+	// Called once per pixel of the dispatch, writes the RGBA result of the pixel
+	typedef void(*TRayGenerationFunction)(const TRayDispatchContext& context, uint32_t x, uint32_t y, float* outputColor);
+
+	// Called on the closest intersection of a traced ray
+	typedef void(*TClosestHitFunction)(const TRayDispatchContext& context, const TRay& ray, const THit& hit, void* payload);
+
+	// Called when a traced ray doesn't intersect anything
+	typedef void(*TMissFunction)(const TRayDispatchContext& context, const TRay& ray, void* payload);
+
+	struct TRayTracingPipeline
+	{
+		TRayGenerationFunction ray_generation;
+		TClosestHitFunction closest_hit;
+		TMissFunction miss;
+
+		// Data handed to every function of the pipeline, it must stay valid until the command list is flushed
+		const void* userData;
+	};
+
+	struct TRayDispatchContext
+	{
+		// Pipeline the dispatch was issued with
+		const TRayTracingPipeline* pipeline;
+
+		// Dimensions of the dispatch
+		uint32_t width;
+		uint32_t height;
+
+		// Backend data of the top level acceleration structure the rays are traced against
+		const void* accelerationStructure;
+
+		// Trace a ray with a combination of RayFlags against the instances that match the mask, calls the closest hit or the miss function with the payload
+		void(*trace_ray)(const TRayDispatchContext& context, const TRay& ray, uint32_t rayFlags, uint32_t instanceMask, void* payload);
+	};
+
+	// Response of a surface (or of the sky for the rays that miss) computed by the shading stage of the path tracer
+	struct TSurfaceSample
+	{
+		// Radiance that leaves the surface toward the origin of the ray
+		float emission[3];
+
+		// Ray toward a light and the radiance it brings back if it is not occluded, already weighted by the surface response
+		// The ray is ignored when the radiance is zero
+		TRay shadowRay;
+		float directRadiance[3];
+
+		// Continuation of the path, the throughput is multiplied by bounceWeight and the path ends when it is zero
+		TRay bounceRay;
+		float bounceWeight[3];
+
+		// Attributes of the surface that guide the denoiser, the albedo is one and the normal zero for the rays that miss
+		float albedo[3];
+		float normal[3];
+	};
+
+	// Hits that share a hit group, one array per field of THit. rayIndices locate the ray of every hit in the arrays handed along with the batch
+	struct THitGroupBatch
+	{
+		uint32_t count;
+		const uint32_t* rayIndices;
+		const float* t;
+		const float* u;
+		const float* v;
+		const uint32_t* primitiveIndices;
+		const uint32_t* instanceIDs;
+	};
+
+	// Called over a range of the pixels of the frame, writes one camera ray per pixel
+	typedef void(*TGenerateCameraRaysFunction)(const void* userData, uint32_t width, uint32_t height, const uint32_t* pixelIndices, uint32_t count, uint32_t* randomStates, TRay* rays);
+
+	// Called once per batch of closest hits of a hit group, writes the samples of the rays of the batch
+	typedef void(*TClosestHitBatchFunction)(const void* userData, const void* rootData, const THitGroupBatch& batch, const TRay* rays, uint32_t* randomStates, TSurfaceSample* samples);
+
+	// Called once per batch of hits on the geometries that are not opaque, accepted has one entry per hit of the batch and is set to 0 for the hits to ignore
+	// The rays of the ignored hits are traced again beyond them
+	typedef void(*TAnyHitBatchFunction)(const void* userData, const void* rootData, const THitGroupBatch& batch, const TRay* rays, uint8_t* accepted);
+
+	// Called by the traversal on the leaves of procedural geometries, intersects a range of their primitives
+	// Shortens tMax and fills the t, u, v and primitiveIndex fields of the hit if one is found
+	typedef bool(*TIntersectionFunction)(const void* rootData, const TRay& ray, const uint32_t* primitiveIndices, uint32_t numPrimitives, float& tMax, THit& hit);
+
+	// Called once per batch of rays that left the scene, writes their samples
+	typedef void(*TMissBatchFunction)(const void* userData, const void* rootData, const uint32_t* rayIndices, uint32_t count, const TRay* rays, TSurfaceSample* samples);
+
+	// Bytes of constants a record of the shader binding table carries, a record is a cache line on 64 bit targets
+	#define SHADER_RECORD_ROOT_DATA_SIZE 40
+
+	// Functions of the hit group of a geometry and the constants they are called with
+	// any_hit is optional and only called for the geometries that are not opaque, intersection is only called for procedural geometries
+	struct THitGroupRecord
+	{
+		TClosestHitBatchFunction closest_hit;
+		TAnyHitBatchFunction any_hit;
+		TIntersectionFunction intersection;
+		alignas(8) uint8_t rootData[SHADER_RECORD_ROOT_DATA_SIZE];
+	};
+
+	struct TMissRecord
+	{
+		TMissBatchFunction miss;
+		alignas(8) uint8_t rootData[SHADER_RECORD_ROOT_DATA_SIZE];
+	};
+
+	// Records the hits are dispatched to, the hit group of a hit is the one of the instance that is hit
+	struct TShaderBindingTable
+	{
+		const THitGroupRecord* hitGroups;
+		uint32_t numHitGroups;
+		TMissRecord miss;
+	};
+
+	// Functions of a wavefront path tracer, each one processes a whole range of paths at once
+	struct TPathTracingPipeline
+	{
+		TGenerateCameraRaysFunction generate_camera_rays;
+
+		// The extended paths are sorted by hit group and every record is called once per batch of its hits, the records must stay valid until the command list is flushed
+		TShaderBindingTable shaderBindingTable;
+
+		// Maximal number of surfaces a path can bounce on
+		uint32_t maxDepth;
+
+		// Milliseconds a trace may spend adding samples to the accumulation, a single sample is traced when it is zero
+		float timeBudget;
+
+		// Identifier of what is rendered, the accumulated samples are discarded when it changes (camera move, scene update)
+		uint64_t accumulationId;
+
+		// Filter the accumulated image with the denoiser before it reaches the frame buffer
+		bool denoise;
+
+		// Data handed to every function of the pipeline, it must stay valid until the command list is flushed
+		const void* userData;
+	};
+
+	// Uniform number in [0, 1[ from the random state of a path
+	inline float next_random(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+}
\ No newline at end of file
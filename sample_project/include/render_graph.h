@@ -0,0 +1,121 @@
+#pragma once
+
+// Internal includes
+#include "gpu_backend.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Index of a pass or a resource that does not exist
+	#define RENDER_GRAPH_INVALID_INDEX 0xFFFFFFFFu
+
+	// Records the commands of a pass into the context of the frame
+	typedef void (*TRenderPassFunction)(CommandContext commandContext, void* userData);
+
+	namespace RenderGraphAccess
+	{
+		enum Type
+		{
+			// The pass uses the content of the resource
+			Read,
+
+			// The pass replaces the whole content of the resource, what was written before is not needed by it
+			Write,
+
+			// The pass updates part of the content, what was written before is kept
+			ReadWrite
+		};
+	}
+
+	struct TRenderGraphResource
+	{
+		Framebuffer frameBuffer;
+
+		// The imported resources come in and leave the frame in a given state, the transient ones are created in the state of their first use
+		bool imported;
+		ResourceState::Type initialState;
+		ResourceState::Type finalState;
+
+		// The content of an output is needed after the frame, its last writer is never culled
+		bool output;
+	};
+
+	struct TRenderGraphAccess
+	{
+		uint32_t resource;
+		RenderGraphAccess::Type type;
+		ResourceState::Type state;
+	};
+
+	struct TRenderGraphPass
+	{
+		const char* name;
+		TRenderPassFunction function;
+		void* userData;
+
+		// A pass with side effects outside of the graph is never culled
+		bool sideEffects;
+
+		// Accesses of the pass, they follow each other in the accesses of the graph
+		uint32_t firstAccess;
+		uint32_t numAccesses;
+	};
+
+	// Passes of a frame and the resources they declare to read and write. The graph is built again every frame, reset keeps the memory of the previous one
+	// The passes are declared in an order that is valid to execute them in, a pass only reads what the passes declared before it wrote
+	struct TRenderGraph
+	{
+		std::vector<TRenderGraphResource> resources;
+		std::vector<TRenderGraphPass> passes;
+		std::vector<TRenderGraphAccess> accesses;
+	};
+
+	// Transitions issued together before a pass, the batch after the last pass brings the imported resources to their final state
+	struct TRenderGraphBarrierBatch
+	{
+		// Index in the executed passes of the pass the batch comes before
+		uint32_t slot;
+		uint32_t firstTransition;
+		uint32_t numTransitions;
+	};
+
+	// What a graph compiles to: the passes to execute in order and the barrier batches between them
+	struct TCompiledRenderGraph
+	{
+		std::vector<uint32_t> passes;
+		std::vector<TRenderGraphBarrierBatch> batches;
+		std::vector<TResourceTransition> transitions;
+		uint32_t numCulledPasses;
+
+		// Scratch of the compilation, kept to avoid allocations from one frame to the next
+		std::vector<uint32_t> producers;
+		std::vector<uint32_t> lastWriters;
+		std::vector<uint32_t> lastUses;
+		std::vector<ResourceState::Type> states;
+		std::vector<uint8_t> statesKnown;
+		std::vector<uint8_t> alive;
+	};
+
+	// Drop the passes and resources of the previous frame
+	void reset_render_graph(TRenderGraph& graph);
+
+	// Declare the resources of the frame, returns their index in the graph
+	uint32_t import_render_graph_resource(TRenderGraph& graph, Framebuffer frameBuffer, ResourceState::Type initialState, ResourceState::Type finalState);
+	uint32_t create_render_graph_resource(TRenderGraph& graph, Framebuffer frameBuffer);
+	void mark_render_graph_output(TRenderGraph& graph, uint32_t resource);
+
+	// Declare a pass and its accesses, the accesses of a pass must be declared before the next pass is added
+	uint32_t add_render_pass(TRenderGraph& graph, const char* name, TRenderPassFunction function, void* userData, bool sideEffects = false);
+	void add_render_pass_access(TRenderGraph& graph, uint32_t pass, uint32_t resource, RenderGraphAccess::Type type, ResourceState::Type state);
+
+	// Cull the passes whose writes reach neither an output nor a kept pass, then place the transitions the kept passes need in as few batches as possible
+	// A transition goes in the batch of an earlier pass when the resource is not used in between, so that the batches of several passes are merged
+	// Returns false if a pass reads a transient resource that nothing wrote before it, or uses a resource in two states
+	bool compile_render_graph(const TRenderGraph& graph, TCompiledRenderGraph& compiled);
+
+	// Record the batches and the passes of a compiled graph into a context
+	void execute_render_graph(const TRenderGraph& graph, const TCompiledRenderGraph& compiled, const GPUBackendAPI& gpuBackendAPI, CommandContext commandContext);
+}
\ No newline at end of file
@@ -2,9 +2,14 @@
 
 // Internal includes
 #include "gpu_backend.h"
+#include "demo_scene.h"
+#include "render_graph.h"
+#include "task_scheduler.h"
 
 // External includes
+#if defined(_WIN32)
 #include <windows.h>
+#endif
 #include <stdint.h>
 #include <vector>
 
@@ -13,7 +18,11 @@ namespace dxr_demo
 	class TRenderer
 	{
 	public:
+	#if defined(_WIN32)
 		TRenderer(HINSTANCE hInstance, int nCmdShow);
+	#else
+		TRenderer();
+	#endif
 		~TRenderer();
 
 		// Init and destruction
@@ -32,15 +41,42 @@ namespace dxr_demo
 		// Return the current render environement
 		RenderEnvironment render_environement();
 
+		// Scheduler that the update, the render and the backend share
+		TTaskScheduler& task_scheduler();
+
+	private:
+		// Passes of the frame graph, the user data is the renderer
+		static void clear_pass(CommandContext commandContext, void* userData);
+		static void trace_pass(CommandContext commandContext, void* userData);
+
 	private:
 		// D3D Data
 		RenderEnvironment _renderEnvironement;
 		RenderWindow _renderWindow;
 		const GPUBackendAPI* _gpuBackendAPI;
 
+		// Work stealing scheduler, its threads are owned by the thread that called init
+		TTaskScheduler _taskScheduler;
+
 		// Input data
 		std::vector<char> _inputData;
 
+		// Scene data
+		TDemoScene _scene;
+		std::vector<BottomLevelAccelerationStructure> _sceneBottomLevels;
+		TopLevelAccelerationStructure _sceneTopLevel;
+		TRayTracingPipeline _rayTracingPipeline;
+		TPathTracingPipeline _pathTracingPipeline;
+		std::vector<THitGroupRecord> _hitGroupRecords;
+
+		// The scene only animates when the frames do not accumulate, the camera of the accumulated samples is kept to detect its moves
+		bool _animateScene;
+		TCamera _accumulatedCamera;
+
+		// Passes of the frame and what they compiled to, rebuilt every frame
+		TRenderGraph _renderGraph;
+		TCompiledRenderGraph _compiledRenderGraph;
+
 		// Rendering data
 		bool _isRunning;
 	};
@@ -0,0 +1,152 @@
+#pragma once
+
+// Internal includes
+#include "mapped_file.h"
+
+// External includes
+#include <stdint.h>
+#include <fstream>
+#include <string>
+
+namespace dxr_demo
+{
+	// Version of the layout of the scene files, files of another version are refused
+	#define SCENE_FILE_VERSION 1
+
+	// Alignment of the sections of a scene file, relative to its first byte
+	#define SCENE_FILE_SECTION_ALIGNMENT 64
+
+	// Texture index of the materials that have none
+	#define SCENE_FILE_NO_TEXTURE 0xFFFFFFFFu
+
+	namespace SceneSection
+	{
+		enum Type
+		{
+			// A single TSceneFileSettings
+			Settings,
+			// TSceneFileMesh records, they reference ranges of the vertices and indices
+			Meshes,
+			// Three floats per vertex
+			Vertices,
+			// Three indices per triangle, relative to the first vertex of their mesh
+			Indices,
+			// TSceneFileMaterial records
+			Materials,
+			// TSceneFileTexture records, they reference ranges of the texels
+			Textures,
+			// Floats, numChannels per texel in row order
+			Texels,
+			// TSceneFileInstance records
+			Instances,
+			Count
+		};
+	}
+
+	// Records of the sections, they have the same layout on every platform the demo builds for
+	struct TSceneFileSettings
+	{
+		// Camera position and orthonormal basis, tangent of half its vertical field of view
+		float cameraPosition[3];
+		float cameraForward[3];
+		float cameraRight[3];
+		float cameraUp[3];
+		float tanHalfFov;
+
+		// Normalized direction toward the sun
+		float lightDirection[3];
+
+		// The instances from this one on are animated by the demo, the number of instances if none are
+		uint32_t firstAnimatedInstance;
+		uint32_t padding;
+	};
+
+	struct TSceneFileMesh
+	{
+		uint64_t firstVertex;
+		uint64_t firstIndex;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+	};
+
+	struct TSceneFileMaterial
+	{
+		float albedo[3];
+		uint32_t textureIndex;
+	};
+
+	struct TSceneFileTexture
+	{
+		uint64_t firstTexel;
+		uint32_t width;
+		uint32_t height;
+		uint32_t numChannels;
+		uint32_t padding;
+	};
+
+	struct TSceneFileInstance
+	{
+		// 3x4 row major object to world transform
+		float transform[12];
+		uint32_t meshIndex;
+		uint32_t materialIndex;
+	};
+
+	// Entry of the table of contents, a section that is absent has no elements
+	struct TSceneFileSection
+	{
+		uint64_t offset;
+		uint64_t count;
+		uint32_t elementSize;
+		uint32_t padding;
+	};
+
+	// First bytes of a scene file, the table of contents has an entry for every section type
+	struct TSceneFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t numSections;
+		uint32_t padding;
+		TSceneFileSection sections[SceneSection::Count];
+	};
+
+	// A scene file mapped in memory, the sections are used where they are
+	struct TSceneFile
+	{
+		TMappedFile mappedFile;
+		const TSceneFileHeader* header;
+	};
+
+	// Map a scene file and check its header and table of contents, returns false if it does not exist, has another version or is truncated
+	bool open_scene_file(const char* path, TSceneFile& file);
+	void close_scene_file(TSceneFile& file);
+
+	// Elements of a section, elementSize must match the size the file was written with. Returns null and a count of 0 for an absent section
+	const void* scene_file_section(const TSceneFile& file, SceneSection::Type section, uint32_t elementSize, uint64_t& count);
+
+	// Writes a scene file one section after the other, a section can be written in several pieces so that large inputs are streamed
+	// The table of contents is written last, the file is written next to its final path and renamed once complete
+	struct TSceneFileWriter
+	{
+		std::ofstream stream;
+		std::string path;
+		TSceneFileHeader header;
+
+		// Section being written and the offset of the end of the file
+		SceneSection::Type currentSection;
+		uint64_t offset;
+	};
+
+	// Start a scene file, returns false if it cannot be created
+	bool begin_scene_file(TSceneFileWriter& writer, const char* path);
+
+	// Start a section, every type can only be written once
+	void begin_scene_section(TSceneFileWriter& writer, SceneSection::Type section, uint32_t elementSize);
+
+	// Append elements to the current section
+	void write_scene_section(TSceneFileWriter& writer, const void* elements, uint64_t count);
+
+	// Write the table of contents and move the file to its path, returns false if a write failed
+	bool end_scene_file(TSceneFileWriter& writer);
+}
\ No newline at end of file
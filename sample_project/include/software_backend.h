@@ -0,0 +1,75 @@
+#pragma once
+
+// Internal includes
+#include "gpu_backend.h"
+
+namespace dxr_demo
+{
+	// Forward declaration
+	namespace cpu_raytracing
+	{
+		struct TBVHPageStatistics;
+	}
+
+	namespace software
+	{
+		namespace render_system
+		{
+			bool init_render_system();
+			void shutdown_render_system();
+
+			RenderEnvironment create_render_environment(const TGraphicSettings& graphic_settings);
+			void destroy_render_environment(RenderEnvironment render_environment);
+
+			RenderWindow render_window(RenderEnvironment render_environement);
+			Framebuffer default_frame_buffer(RenderEnvironment renderEnv);
+
+			uint64_t frame_index(RenderEnvironment renderEnv);
+
+			float get_time(RenderEnvironment render_environement);
+
+			bool initialize_frame(RenderEnvironment render_environement);
+			CommandContext acquire_command_context(RenderEnvironment render_environement, uint32_t submissionIndex);
+			bool flush_command_list(RenderEnvironment render_environement);
+			bool present(RenderEnvironment render_environement);
+
+			// Last presented image, RGBA8 in scanline order
+			const uint32_t* presented_image(RenderEnvironment render_environement);
+
+			// Page hits, misses and stall time of the bottom level structures during the last flushed frame, returns false if they are not paged
+			bool bvh_page_statistics(RenderEnvironment render_environement, cpu_raytracing::TBVHPageStatistics& statistics);
+		}
+
+		namespace window
+		{
+			void show(RenderWindow window);
+			void hide(RenderWindow window);
+			bool is_active(RenderWindow window);
+			void swap(RenderWindow window);
+		}
+
+		namespace framebuffer
+		{
+			void clear(CommandContext command_context, Framebuffer frame_buffer, const float* clearColor);
+			void transition(CommandContext command_context, const TResourceTransition* transitions, uint32_t numTransitions);
+		}
+
+		namespace acceleration_structure
+		{
+			BottomLevelAccelerationStructure create_bottom_level_acceleration_structure(RenderEnvironment render_environment, const TGeometryDescriptor& geometry);
+			void destroy_bottom_level_acceleration_structure(RenderEnvironment render_environment, BottomLevelAccelerationStructure acceleration_structure);
+			void update_bottom_level_acceleration_structure(RenderEnvironment render_environment, BottomLevelAccelerationStructure acceleration_structure, const TGeometryDescriptor& geometry);
+
+			TopLevelAccelerationStructure create_top_level_acceleration_structure(RenderEnvironment render_environment, const TInstanceDescriptor* instances, uint32_t numInstances);
+			void destroy_top_level_acceleration_structure(RenderEnvironment render_environment, TopLevelAccelerationStructure acceleration_structure);
+
+			void update_instance_transforms(RenderEnvironment render_environment, TopLevelAccelerationStructure acceleration_structure, uint32_t firstInstance, uint32_t numInstances, const float* transforms);
+		}
+
+		namespace raytracing
+		{
+			void dispatch_rays(CommandContext command_context, Framebuffer frame_buffer, TopLevelAccelerationStructure acceleration_structure, const TRayTracingPipeline& pipeline);
+			void trace_paths(CommandContext command_context, Framebuffer frame_buffer, TopLevelAccelerationStructure acceleration_structure, const TPathTracingPipeline& pipeline);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+
+// Internal includes
+#include "thread_pool.h"
+
+// External includes
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Number of tasks a deque holds, a task that does not fit is run by the thread that pushes it
+	#define TASK_DEQUE_CAPACITY 4096
+
+	// Thread index of the threads that do not belong to a scheduler
+	#define TASK_SCHEDULER_NO_THREAD 0xFFFFFFFFu
+
+	// Forward declaration
+	struct TTaskCounter;
+
+	// A task runs function over the indices [begin, end[, and decrements its counter once done
+	// A range of more than grainSize indices is split in halves as it runs, the upper half being pushed for the other threads to steal. A grain size of 0 counts as 1
+	struct TTask
+	{
+		TTaskFunction function;
+		void* userData;
+		uint32_t begin;
+		uint32_t end;
+		TTaskCounter* counter;
+		uint32_t grainSize;
+	};
+
+	// Counts the tasks of a group that are not done yet, the tasks submitted with the counter as their dependency only start once it drops to zero
+	// A counter can be reused or destroyed once a wait on it returned
+	struct TTaskCounter
+	{
+		TTaskCounter();
+
+		std::atomic<uint32_t> pending;
+
+		// Threads that are still reading the counter after their decrement, a wait only returns once there are none
+		std::atomic<uint32_t> releasing;
+
+		// Tasks that depend on the counter, pushed by the thread that finishes its last task
+		std::mutex mutex;
+		std::vector<TTask> continuations;
+	};
+
+	// Chase-Lev work stealing deque of a fixed capacity: the owner thread pushes and pops at the bottom, the other threads steal at the top
+	// The fields of the slots are atomics so that a thief can read a slot the owner rewrites, the copy is discarded when its steal fails
+	class TTaskDeque
+	{
+	public:
+		TTaskDeque();
+
+		// Owner side, push returns false if the deque is full
+		bool push(const TTask& task);
+		bool pop(TTask& task);
+
+		// Thief side, returns false if the deque is empty or another thread took the task first
+		bool steal(TTask& task);
+
+	private:
+		struct TTaskSlot
+		{
+			std::atomic<TTaskFunction> function;
+			std::atomic<void*> userData;
+			std::atomic<uint32_t> begin;
+			std::atomic<uint32_t> end;
+			std::atomic<TTaskCounter*> counter;
+			std::atomic<uint32_t> grainSize;
+		};
+
+		void write_slot(int64_t index, const TTask& task);
+		void read_slot(int64_t index, TTask& task) const;
+
+	private:
+		// Top and bottom sit on their own cache lines, the thieves only write the top
+		std::atomic<int64_t> _top;
+		uint8_t _topPadding[64 - sizeof(int64_t)];
+		std::atomic<int64_t> _bottom;
+		uint8_t _bottomPadding[64 - sizeof(int64_t)];
+		TTaskSlot _slots[TASK_DEQUE_CAPACITY];
+	};
+
+	// Scheduler where every thread owns a deque of tasks and steals from the others once its own is empty
+	// The thread that calls init is thread 0 and owns the first deque, submit, wait and parallel_for can only be called by it or from within a task
+	class TTaskScheduler
+	{
+	public:
+		TTaskScheduler();
+		~TTaskScheduler();
+
+		// Init and destruction, the calling thread counts as one of the threads and 0 means one per hardware thread
+		void init(uint32_t numThreads = 0);
+		void destroy();
+
+		// Number of threads that run tasks (workers + calling thread)
+		uint32_t num_threads() const;
+
+		// Push a task on the deque of the calling thread, its counter is incremented right away
+		// With a dependency, the task is held until the dependency counter drops to zero
+		void submit(const TTask& task, TTaskCounter* dependency = nullptr);
+
+		// Run tasks until the counter drops to zero, the calling thread helps whichever group they belong to
+		void wait(TTaskCounter& counter);
+
+		// Run numTasks tasks across the threads, returns when all of them are done. The range is split in halves that the idle threads steal,
+		// so nested calls and tasks of uneven cost balance themselves. The halves stop being split once they hold grainSize tasks or less,
+		// the tasks that are too cheap to be worth a steal are run back to back by the thread that holds their range
+		void parallel_for(uint32_t numTasks, TTaskFunction function, void* userData, uint32_t grainSize = 1);
+
+		template<typename TFunctor>
+		void parallel_for(uint32_t numTasks, const TFunctor& functor, uint32_t grainSize = 1)
+		{
+			parallel_for(numTasks, &invoke_functor<TFunctor>, (void*)&functor, grainSize);
+		}
+
+	private:
+		template<typename TFunctor>
+		static void invoke_functor(void* userData, uint32_t taskIndex, uint32_t threadIndex)
+		{
+			(*(const TFunctor*)userData)(taskIndex, threadIndex);
+		}
+
+		// Index of the calling thread, TASK_SCHEDULER_NO_THREAD if it does not belong to the scheduler
+		uint32_t thread_index() const;
+
+		void worker_loop(uint32_t threadIndex);
+		void push_task(uint32_t threadIndex, const TTask& task);
+		bool find_task(uint32_t threadIndex, TTask& task);
+		void execute_task(uint32_t threadIndex, TTask task);
+		void complete_task(uint32_t threadIndex, TTaskCounter& counter);
+
+	private:
+		// Worker threads, and one deque per thread (the first one belongs to the thread that called init)
+		std::vector<std::thread> _workers;
+		std::vector<TTaskDeque*> _deques;
+
+		// Tasks sitting in the deques, the workers sleep while there are none
+		std::atomic<uint32_t> _queuedTasks;
+		std::atomic<uint32_t> _sleepingWorkers;
+		std::mutex _mutex;
+		std::condition_variable _wakeCondition;
+		bool _shutdown;
+
+		// Thread that called init
+		std::thread::id _ownerThread;
+	};
+}
\ No newline at end of file
@@ -12,4 +12,23 @@ namespace dxr_demo
 		uint32_t height;
 		std::vector<float> data;
 	};
+
+	// Texture that does not own its texels, they live in a TTextureDescriptor or in memory the view does not manage, such as a mapped scene file
+	struct TTextureView
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t numChannels;
+		const float* data;
+	};
+
+	inline TTextureView texture_view(const TTextureDescriptor& texture, uint32_t numChannels)
+	{
+		TTextureView view;
+		view.width = texture.width;
+		view.height = texture.height;
+		view.numChannels = numChannels;
+		view.data = texture.data.data();
+		return view;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+// External includes
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Signature of a task, the thread index is 0 for the calling thread and [1, num_threads[ for the workers
+	typedef void(*TTaskFunction)(void* userData, uint32_t taskIndex, uint32_t threadIndex);
+
+	// Workers that share the tasks of a single parallel_for through one counter, the nested calls run inline on the thread that makes them
+	// The renderer and the scene converter run on TTaskScheduler, this pool is only kept as the baseline the task_scheduler benchmark measures it against
+	class TThreadPool
+	{
+	public:
+		TThreadPool();
+		~TThreadPool();
+
+		// Init and destruction, 0 workers means one per hardware thread minus the calling one
+		void init(uint32_t numWorkers = 0);
+		void destroy();
+
+		// Number of threads that take part to a parallel_for (workers + calling thread)
+		uint32_t num_threads() const;
+
+		// Run numTasks tasks across the workers and the calling thread, returns when all of them are done
+		void parallel_for(uint32_t numTasks, TTaskFunction function, void* userData);
+
+		template<typename TFunctor>
+		void parallel_for(uint32_t numTasks, const TFunctor& functor)
+		{
+			parallel_for(numTasks, &invoke_functor<TFunctor>, (void*)&functor);
+		}
+
+	private:
+		template<typename TFunctor>
+		static void invoke_functor(void* userData, uint32_t taskIndex, uint32_t threadIndex)
+		{
+			(*(const TFunctor*)userData)(taskIndex, threadIndex);
+		}
+
+		void worker_loop(uint32_t threadIndex);
+		void run_tasks(uint32_t threadIndex);
+
+	private:
+		// Worker threads
+		std::vector<std::thread> _workers;
+
+		// Only one parallel_for can be in flight at a time
+		std::mutex _submitMutex;
+
+		// Synchronization with the workers
+		std::mutex _mutex;
+		std::condition_variable _wakeCondition;
+		std::condition_variable _doneCondition;
+		uint64_t _generation;
+		uint32_t _activeWorkers;
+		bool _shutdown;
+
+		// Job that is currently being processed
+		TTaskFunction _function;
+		void* _userData;
+		uint32_t _numTasks;
+		std::atomic<uint32_t> _nextTask;
+	};
+}
\ No newline at end of file
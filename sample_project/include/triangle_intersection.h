@@ -0,0 +1,127 @@
+#pragma once
+
+// Internal includes
+#include "raytracing_descriptor.h"
+
+// External includes
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace dxr_demo
+{
+	namespace SIMDInstructionSet
+	{
+		enum Type
+		{
+			SSE,
+			AVX2,
+			AVX512
+		};
+	}
+
+	// Triangles are stored by groups of TTriangleIntersectionAPI::width, in structure of arrays:
+	// v0.x, v0.y, v0.z, edge1.x, edge1.y, edge1.z, edge2.x, edge2.y, edge2.z and primitive index, width values each
+	#define TRIANGLE_GROUP_NUM_ARRAYS 10
+
+	// Lanes of a group that hold no triangle are zeroed, with this primitive index
+	#define TRIANGLE_INVALID_PRIMITIVE 0xFFFFFFFFu
+
+	// The built-in procedural primitives are stored the same way, spheres as center.x, center.y, center.z, radius squared and primitive index
+	// The empty lanes have a negative squared radius
+	#define SPHERE_GROUP_NUM_ARRAYS 5
+
+	// Boxes as min.x, min.y, min.z, max.x, max.y, max.z and primitive index, the empty lanes have TRIANGLE_INVALID_PRIMITIVE as index
+	#define BOX_GROUP_NUM_ARRAYS 7
+
+	// Index of the lowest bit set in a non zero mask
+	inline uint32_t first_bit_index(uint32_t mask)
+	{
+	#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (uint32_t)index;
+	#else
+		return (uint32_t)__builtin_ctz(mask);
+	#endif
+	}
+
+	// Closest intersection of a ray with a range of primitive groups, shortens tMax and fills the hit if one is found
+	typedef bool(*TIntersectPrimitiveGroupsFunction)(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit);
+
+	// The kernels are instantiated for every combination of the ray flags that change the triangle test, RayFlags::AcceptFirstHit and RayFlags::CullBackFaces
+	// They are the lowest bits of the ray flags, so the flags masked with INTERSECTION_KERNEL_VARIANT_MASK index the variants
+	// Face culling only applies to triangles, the variants of the procedural primitives ignore it
+	#define INTERSECTION_KERNEL_NUM_VARIANTS 4
+	#define INTERSECTION_KERNEL_VARIANT_MASK (RayFlags::AcceptFirstHit | RayFlags::CullBackFaces)
+
+	// Keep the closest of the lanes of a mask, or the first one when any hit will do, shortens tMax and fills the hit
+	template<uint32_t Flags>
+	inline bool select_lane_hit(uint32_t mask, const float* tArray, const float* uArray, const float* vArray, const uint32_t* primitiveIndices, float& tMax, THit& hit)
+	{
+		bool found = false;
+		for (; mask != 0; mask &= mask - 1)
+		{
+			uint32_t lane = first_bit_index(mask);
+			if (tArray[lane] < tMax)
+			{
+				tMax = tArray[lane];
+				hit.t = tArray[lane];
+				hit.u = uArray[lane];
+				hit.v = vArray[lane];
+				hit.primitiveIndex = primitiveIndices[lane];
+				found = true;
+				if (Flags & RayFlags::AcceptFirstHit) break;
+			}
+		}
+		return found;
+	}
+
+	struct TTriangleIntersectionAPI
+	{
+		SIMDInstructionSet::Type instructionSet;
+
+		// Number of primitives tested at once
+		uint32_t width;
+
+		// Kernels indexed by the ray flags, the first one returns the closest hit
+		const TIntersectPrimitiveGroupsFunction* intersect_triangles;
+		const TIntersectPrimitiveGroupsFunction* intersect_spheres;
+		const TIntersectPrimitiveGroupsFunction* intersect_boxes;
+	};
+
+	// Most capable instruction set of the processor and the operating system
+	SIMDInstructionSet::Type detect_instruction_set();
+
+	// Pick the kernels of an instruction set, returns false if it is not supported
+	bool initialize_triangle_intersection(SIMDInstructionSet::Type instructionSet);
+
+	// Pick the kernels of the most capable instruction set, only the first call does something
+	void initialize_triangle_intersection();
+
+	// Request the selected kernels
+	const TTriangleIntersectionAPI& triangle_intersection_api();
+
+	// Kernels of every instruction set, each one lives in a translation unit built for its instruction set
+	namespace sse
+	{
+		extern const TIntersectPrimitiveGroupsFunction intersect_triangles[INTERSECTION_KERNEL_NUM_VARIANTS];
+		extern const TIntersectPrimitiveGroupsFunction intersect_spheres[INTERSECTION_KERNEL_NUM_VARIANTS];
+		extern const TIntersectPrimitiveGroupsFunction intersect_boxes[INTERSECTION_KERNEL_NUM_VARIANTS];
+	}
+
+	namespace avx2
+	{
+		extern const TIntersectPrimitiveGroupsFunction intersect_triangles[INTERSECTION_KERNEL_NUM_VARIANTS];
+		extern const TIntersectPrimitiveGroupsFunction intersect_spheres[INTERSECTION_KERNEL_NUM_VARIANTS];
+		extern const TIntersectPrimitiveGroupsFunction intersect_boxes[INTERSECTION_KERNEL_NUM_VARIANTS];
+	}
+
+	namespace avx512
+	{
+		extern const TIntersectPrimitiveGroupsFunction intersect_triangles[INTERSECTION_KERNEL_NUM_VARIANTS];
+		extern const TIntersectPrimitiveGroupsFunction intersect_spheres[INTERSECTION_KERNEL_NUM_VARIANTS];
+		extern const TIntersectPrimitiveGroupsFunction intersect_boxes[INTERSECTION_KERNEL_NUM_VARIANTS];
+	}
+}
\ No newline at end of file
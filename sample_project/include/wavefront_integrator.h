@@ -0,0 +1,104 @@
+#pragma once
+
+// Internal includes
+#include "cpu_raytracing.h"
+#include "raytracing_descriptor.h"
+#include "texture_descriptor.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Forward declaration
+	class TTaskScheduler;
+
+	namespace cpu_raytracing
+	{
+		// State of the paths that are still alive, one array per field so that every stage only touches what it needs
+		struct TPathQueue
+		{
+			uint32_t numPaths;
+			std::vector<uint32_t> pixelIndices;
+			std::vector<uint32_t> randomStates;
+			std::vector<float> throughputs;
+			std::vector<TRay> rays;
+		};
+
+		// Buffers of the wavefront integrator, they are sized for the largest frame and reused from one frame to the next
+		struct TWavefrontIntegrator
+		{
+			// Dimensions the buffers were allocated for
+			uint32_t width;
+			uint32_t height;
+
+			// Pixels in the order the camera rays are generated, 4x4 tiles so that consecutive rays form coherent packets
+			std::vector<uint32_t> pixelOrder;
+
+			// Paths of the current bounce and survivors of the next one
+			TPathQueue queues[2];
+
+			// Outputs of the extension and shading stages, indexed like the current queue
+			std::vector<THit> hits;
+			std::vector<uint8_t> found;
+			std::vector<TSurfaceSample> samples;
+
+			// Shadow rays packed per chunk and the path each one belongs to, the hits are reused to trace them
+			std::vector<TRay> shadowRays;
+			std::vector<uint32_t> shadowPaths;
+
+			// Scratch of the sorts by hit group and number of survivors of every chunk of the compaction
+			std::vector<uint64_t> sortKeys;
+			std::vector<uint32_t> chunkOffsets;
+
+			// Hits of every chunk gathered by hit group for the batched calls of the shader binding table, and the verdicts of the any hit functions
+			std::vector<uint32_t> batchRayIndices;
+			std::vector<float> batchT;
+			std::vector<float> batchU;
+			std::vector<float> batchV;
+			std::vector<uint32_t> batchPrimitiveIndices;
+			std::vector<uint32_t> batchInstanceIDs;
+			std::vector<uint8_t> batchAccepted;
+
+			// RGB radiance of the frame in scanline order
+			std::vector<float> radiance;
+
+			// Albedo, normal and depth of the first surface seen by every pixel in scanline order, they guide the denoiser
+			std::vector<float> albedo;
+			std::vector<float> normals;
+			std::vector<float> depth;
+		};
+
+		// Average of the samples traced since the last reset, used to converge while the image does not change
+		struct TProgressiveAccumulator
+		{
+			// RGB average of the radiance of every sample in scanline order
+			TTextureDescriptor accumulation;
+
+			// Average of the first hit attributes, three floats per pixel for the albedo and the normal, one for the depth
+			TTextureDescriptor albedo;
+			TTextureDescriptor normal;
+			TTextureDescriptor depth;
+
+			// Number of samples in the average and identifier of the image they belong to
+			uint32_t numSamples;
+			uint64_t accumulationId;
+
+			// Index of the next sample, it is never reset so that the random sequences do not repeat
+			uint32_t sampleIndex;
+		};
+
+		// Render one sample per pixel by running the generate, extend, shade, connect-shadow and compaction stages bounce after bounce
+		// Every stage is a parallel_for over chunks of the queues, nothing is allocated once the buffers have reached the frame size
+		// The functions of the shader binding table are called once per hit group and chunk with the hits of the chunk that belong to it
+		void render_wavefront(TWavefrontIntegrator& integrator, const TTopLevelAccelerationStructure& accelerationStructure, const TPathTracingPipeline& pipeline,
+			uint32_t width, uint32_t height, uint32_t sampleIndex, TTaskScheduler& taskScheduler);
+
+		// Add as many samples per pixel to the accumulation as the time budget of the pipeline allows, at least one
+		// The accumulation is cleared first if the identifier of the pipeline or the dimensions differ from the previous call
+		// Returns the number of samples that were traced
+		uint32_t render_progressive(TProgressiveAccumulator& accumulator, TWavefrontIntegrator& integrator, const TTopLevelAccelerationStructure& accelerationStructure,
+			const TPathTracingPipeline& pipeline, uint32_t width, uint32_t height, TTaskScheduler& taskScheduler);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+// Internal includes
+#include "bvh8.h"
+
+// External includes
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+namespace dxr_demo
+{
+	static inline float half_area(const TBVHNode& node)
+	{
+		float dx = node.max[0] - node.min[0];
+		float dy = node.max[1] - node.min[1];
+		float dz = node.max[2] - node.min[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	// Smallest power of two exponent for which 255 cells cover the extent
+	static int8_t quantization_exponent(float extent)
+	{
+		int32_t exponent = extent > 0.0f ? (int32_t)ceilf(log2f(extent / 255.0f)) : -126;
+		exponent = std::max(-126, std::min(127, exponent));
+		while (exponent < 127 && bvh8_scale((int8_t)exponent) * 255.0f < extent)
+		{
+			exponent++;
+		}
+		return (int8_t)exponent;
+	}
+
+	// Quantize the bounds of a child, rounding outwards so that the decoded box always contains the original one
+	static void quantize_bounds(TBVH8Node& node, uint32_t slot, const TBVHNode& child)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float scale = bvh8_scale(node.exponent[axis]);
+			int32_t qMin = (int32_t)floorf((child.min[axis] - node.origin[axis]) / scale);
+			int32_t qMax = (int32_t)ceilf((child.max[axis] - node.origin[axis]) / scale);
+			qMin = std::max(0, std::min(255, qMin));
+			qMax = std::max(0, std::min(255, qMax));
+			while (qMin > 0 && node.origin[axis] + qMin * scale > child.min[axis]) qMin--;
+			while (qMax < 255 && node.origin[axis] + qMax * scale < child.max[axis]) qMax++;
+			node.quantizedMin[axis][slot] = (uint8_t)qMin;
+			node.quantizedMax[axis][slot] = (uint8_t)qMax;
+		}
+	}
+
+	void build_bvh8(const TBVH& bvh, TBVH8& bvh8, uint32_t groupWidth)
+	{
+		bvh8.nodes.clear();
+		bvh8.primitiveIndices.clear();
+		bvh8.groupWidth = groupWidth;
+		if (bvh.nodes.empty()) return;
+
+		// Every wide node replaces at least 7 binary ones, except on the last levels
+		bvh8.nodes.reserve(bvh.nodes.size() / 4 + 1);
+		bvh8.primitiveIndices.reserve(bvh.primitiveIndices.size());
+
+		// Pairs of binary node and wide node that still have to be filled
+		std::vector<std::pair<uint32_t, uint32_t>> pendingNodes;
+		bvh8.nodes.resize(1);
+		pendingNodes.push_back(std::make_pair(0u, 0u));
+
+		while (!pendingNodes.empty())
+		{
+			uint32_t binaryIndex = pendingNodes.back().first;
+			uint32_t wideIndex = pendingNodes.back().second;
+			pendingNodes.pop_back();
+			const TBVHNode& binaryNode = bvh.nodes[binaryIndex];
+
+			// Pull the grandchildren up, always opening the interior child with the largest area
+			uint32_t children[BVH8_WIDTH];
+			uint32_t numChildren = 0;
+			if (binaryNode.count != 0)
+			{
+				children[numChildren++] = binaryIndex;
+			}
+			else
+			{
+				children[numChildren++] = binaryNode.leftFirst;
+				children[numChildren++] = binaryNode.leftFirst + 1;
+				while (numChildren < BVH8_WIDTH)
+				{
+					int32_t bestChild = -1;
+					float bestArea = -1.0f;
+					for (uint32_t childIdx = 0; childIdx < numChildren; ++childIdx)
+					{
+						const TBVHNode& child = bvh.nodes[children[childIdx]];
+						if (child.count == 0 && half_area(child) > bestArea)
+						{
+							bestArea = half_area(child);
+							bestChild = (int32_t)childIdx;
+						}
+					}
+					if (bestChild < 0) break;
+
+					uint32_t leftIndex = bvh.nodes[children[bestChild]].leftFirst;
+					children[bestChild] = leftIndex;
+					children[numChildren++] = leftIndex + 1;
+				}
+			}
+
+			// Allocate the interior children next to each other
+			uint32_t numInnerChildren = 0;
+			for (uint32_t childIdx = 0; childIdx < numChildren; ++childIdx)
+			{
+				numInnerChildren += bvh.nodes[children[childIdx]].count == 0 ? 1 : 0;
+			}
+			uint32_t childBaseIndex = (uint32_t)bvh8.nodes.size();
+			bvh8.nodes.resize(childBaseIndex + numInnerChildren);
+
+			// Quantization grid over the bounds of the binary node
+			TBVH8Node& node = bvh8.nodes[wideIndex];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				node.origin[axis] = binaryNode.min[axis];
+				node.exponent[axis] = quantization_exponent(binaryNode.max[axis] - binaryNode.min[axis]);
+			}
+			node.innerMask = 0;
+			node.childBaseIndex = childBaseIndex;
+			node.primitiveBaseIndex = (uint32_t)bvh8.primitiveIndices.size() / groupWidth;
+
+			uint32_t innerRank = 0;
+			for (uint32_t slot = 0; slot < BVH8_WIDTH; ++slot)
+			{
+				if (slot >= numChildren)
+				{
+					// Empty slots get an inverted box that no ray can enter
+					node.meta[slot] = 0;
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						node.quantizedMin[axis][slot] = 255;
+						node.quantizedMax[axis][slot] = 0;
+					}
+					continue;
+				}
+
+				const TBVHNode& child = bvh.nodes[children[slot]];
+				quantize_bounds(node, slot, child);
+				if (child.count == 0)
+				{
+					node.innerMask |= 1 << slot;
+					node.meta[slot] = 0;
+					pendingNodes.push_back(std::make_pair(children[slot], childBaseIndex + innerRank++));
+				}
+				else
+				{
+					uint32_t offset = (uint32_t)bvh8.primitiveIndices.size() / groupWidth - node.primitiveBaseIndex;
+					uint32_t numGroups = (child.count + groupWidth - 1) / groupWidth;
+					assert(numGroups < 8 && offset < 32);
+					node.meta[slot] = (uint8_t)(offset | (numGroups << 5));
+					bvh8.primitiveIndices.insert(bvh8.primitiveIndices.end(), bvh.primitiveIndices.begin() + child.leftFirst, bvh.primitiveIndices.begin() + child.leftFirst + child.count);
+					bvh8.primitiveIndices.resize(bvh8.primitiveIndices.size() + numGroups * groupWidth - child.count, BVH8_INVALID_PRIMITIVE);
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
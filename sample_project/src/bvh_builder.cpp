@@ -0,0 +1,669 @@
+// Internal includes
+#include "bvh.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <mutex>
+#include <emmintrin.h>
+
+namespace dxr_demo
+{
+	// Maximal number of bins per axis used to evaluate the split candidates
+	#define BVH_NUM_BINS 32
+
+	// Below this number of primitives, binning and partitioning a node is not worth distributing
+	#define BVH_PARALLEL_SPLIT_THRESHOLD 65536
+
+	// Size of the chunks a node is cut into when it is binned or partitioned in parallel
+	#define BVH_PARALLEL_CHUNK_SIZE 16384
+
+	// Subtrees smaller than this are always built by a single task
+	#define BVH_MIN_SUBTREE_SIZE 4096
+
+	// Copy of the bounds of a primitive, moved around by the partitions so that every pass reads memory linearly
+	struct TPrimitiveReference
+	{
+		float min[3];
+		uint32_t index;
+		float max[3];
+		uint32_t padding;
+	};
+
+	// Bounds of a bin, the last lane of each register is unused
+	struct TBin
+	{
+		float min[4];
+		float max[4];
+		uint32_t count;
+	};
+
+	// A node that still has to be built, with the bounds its parent already knows
+	struct TBuildTask
+	{
+		uint32_t nodeIndex;
+		uint32_t depth;
+		uint32_t first;
+		uint32_t count;
+		TAABB bounds;
+		TAABB centroidBounds;
+	};
+
+	// Parameters of the binning of a task, shared by the binning and the partition so that they agree
+	struct TBinMapping
+	{
+		uint32_t numBins;
+		float origin[4];
+		float scale[4];
+	};
+
+	// Accumulates the centroid bounds of the two sides of a partition
+	struct TPartitionBounds
+	{
+		__m128 leftMin;
+		__m128 leftMax;
+		__m128 rightMin;
+		__m128 rightMax;
+	};
+
+	struct TBuildContext
+	{
+		TBVH* bvh;
+		TTaskScheduler* taskScheduler;
+
+		// References to the primitives, and the scratch buffer the parallel partition scatters into
+		std::vector<TPrimitiveReference> references;
+		std::vector<TPrimitiveReference> partitionBuffer;
+
+		// Nodes are allocated by pairs out of bvh->nodes, which is sized for the worst case
+		std::atomic<uint32_t> nodeCount;
+
+		// Subtrees above this size are split one level at a time so that every thread gets work
+		uint32_t subtreeThreshold;
+
+		// Primitives are intersected by groups of leafWidth, leaves hold at most maxLeafSize of them
+		uint32_t leafWidth;
+		uint32_t maxLeafSize;
+
+		// Deepest level a leaf can be at
+		uint32_t maxDepth;
+	};
+
+	// Number of groups the intersection of a set of primitives costs
+	static inline float group_count(const TBuildContext& context, uint32_t count)
+	{
+		return (float)((count + context.leafWidth - 1) / context.leafWidth);
+	}
+
+	// Number of levels under a node that a balanced subtree over count primitives needs
+	static inline uint32_t balanced_depth(const TBuildContext& context, uint32_t count)
+	{
+		uint32_t numLeaves = (count + context.maxLeafSize - 1) / context.maxLeafSize;
+		uint32_t depth = 0;
+		while (((uint64_t)1 << depth) < numLeaves) ++depth;
+		return depth;
+	}
+
+	static inline void reset_bounds(TAABB& bounds)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			bounds.min[axis] = FLT_MAX;
+			bounds.max[axis] = -FLT_MAX;
+		}
+	}
+
+	static inline void grow_bounds(TAABB& bounds, const TAABB& other)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			bounds.min[axis] = std::min(bounds.min[axis], other.min[axis]);
+			bounds.max[axis] = std::max(bounds.max[axis], other.max[axis]);
+		}
+	}
+
+	static inline float half_area(const TAABB& bounds)
+	{
+		float dx = bounds.max[0] - bounds.min[0];
+		float dy = bounds.max[1] - bounds.min[1];
+		float dz = bounds.max[2] - bounds.min[2];
+		return (dx < 0.0f) ? 0.0f : dx * dy + dy * dz + dz * dx;
+	}
+
+	static inline void store_bounds(__m128 boundsMin, __m128 boundsMax, TAABB& bounds)
+	{
+		float minValues[4], maxValues[4];
+		_mm_storeu_ps(minValues, boundsMin);
+		_mm_storeu_ps(maxValues, boundsMax);
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			bounds.min[axis] = minValues[axis];
+			bounds.max[axis] = maxValues[axis];
+		}
+	}
+
+	// Centroids are kept doubled (min + max), which is enough to sort primitives and saves a multiplication
+	static inline __m128 reference_centroid(const TPrimitiveReference& reference)
+	{
+		return _mm_add_ps(_mm_loadu_ps(reference.min), _mm_loadu_ps(reference.max));
+	}
+
+	static inline void reset_partition_bounds(TPartitionBounds& bounds)
+	{
+		bounds.leftMin = bounds.rightMin = _mm_set1_ps(FLT_MAX);
+		bounds.leftMax = bounds.rightMax = _mm_set1_ps(-FLT_MAX);
+	}
+
+	template<typename TFunctor>
+	static void for_each_chunk(TBuildContext& context, uint32_t count, bool parallel, const TFunctor& functor)
+	{
+		uint32_t numChunks = (count + BVH_PARALLEL_CHUNK_SIZE - 1) / BVH_PARALLEL_CHUNK_SIZE;
+		auto process_chunk = [&](uint32_t chunkIdx, uint32_t)
+		{
+			uint32_t first = chunkIdx * BVH_PARALLEL_CHUNK_SIZE;
+			functor(chunkIdx, first, std::min(first + BVH_PARALLEL_CHUNK_SIZE, count));
+		};
+
+		if (parallel && context.taskScheduler)
+		{
+			context.taskScheduler->parallel_for(numChunks, process_chunk);
+		}
+		else
+		{
+			for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+			{
+				process_chunk(chunkIdx, 0);
+			}
+		}
+	}
+
+	static inline void write_node(TBVH& bvh, uint32_t nodeIndex, const TAABB& bounds, uint32_t leftFirst, uint32_t count)
+	{
+		TBVHNode& node = bvh.nodes[nodeIndex];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			node.min[axis] = bounds.min[axis];
+			node.max[axis] = bounds.max[axis];
+		}
+		node.leftFirst = leftFirst;
+		node.count = count;
+	}
+
+	static void compute_bin_mapping(const TBuildTask& task, TBinMapping& mapping)
+	{
+		// Small nodes don't need as many candidates as large ones
+		mapping.numBins = std::min((uint32_t)BVH_NUM_BINS, 4 + task.count / 2);
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			// An extent too small for its inverse to be finite (denormal centroids) puts everything in the first bin, like an empty one
+			float extent = task.centroidBounds.max[axis] - task.centroidBounds.min[axis];
+			float scale = (mapping.numBins * (1.0f - 1e-6f)) / extent;
+			mapping.origin[axis] = task.centroidBounds.min[axis];
+			mapping.scale[axis] = (extent > 0.0f && scale <= FLT_MAX) ? scale : 0.0f;
+		}
+		mapping.origin[3] = 0.0f;
+		mapping.scale[3] = 0.0f;
+	}
+
+	// Bin index of a centroid along the three axes
+	static inline __m128i bin_index(const TBinMapping& mapping, __m128 center)
+	{
+		__m128i binIndex = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(center, _mm_loadu_ps(mapping.origin)), _mm_loadu_ps(mapping.scale)));
+		__m128i maxBin = _mm_set1_epi32(mapping.numBins - 1);
+		__m128i tooLarge = _mm_cmpgt_epi32(binIndex, maxBin);
+		return _mm_or_si128(_mm_and_si128(tooLarge, maxBin), _mm_andnot_si128(tooLarge, binIndex));
+	}
+
+	static inline void reset_bins(TBin bins[3][BVH_NUM_BINS], uint32_t numBins)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			for (uint32_t binIdx = 0; binIdx < numBins; ++binIdx)
+			{
+				_mm_storeu_ps(bins[axis][binIdx].min, _mm_set1_ps(FLT_MAX));
+				_mm_storeu_ps(bins[axis][binIdx].max, _mm_set1_ps(-FLT_MAX));
+				bins[axis][binIdx].count = 0;
+			}
+		}
+	}
+
+	static void bin_references(const TPrimitiveReference* references, uint32_t count, const TBinMapping& mapping, TBin bins[3][BVH_NUM_BINS])
+	{
+		reset_bins(bins, mapping.numBins);
+		for (uint32_t refIdx = 0; refIdx < count; ++refIdx)
+		{
+			const TPrimitiveReference& reference = references[refIdx];
+			__m128 boundsMin = _mm_loadu_ps(reference.min);
+			__m128 boundsMax = _mm_loadu_ps(reference.max);
+
+			uint32_t binIndices[4];
+			_mm_storeu_si128((__m128i*)binIndices, bin_index(mapping, _mm_add_ps(boundsMin, boundsMax)));
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				TBin& bin = bins[axis][binIndices[axis]];
+				_mm_storeu_ps(bin.min, _mm_min_ps(_mm_loadu_ps(bin.min), boundsMin));
+				_mm_storeu_ps(bin.max, _mm_max_ps(_mm_loadu_ps(bin.max), boundsMax));
+				bin.count++;
+			}
+		}
+	}
+
+	static void bin_task(TBuildContext& context, const TBuildTask& task, const TBinMapping& mapping, TBin bins[3][BVH_NUM_BINS])
+	{
+		const TPrimitiveReference* references = context.references.data() + task.first;
+		if (task.count < BVH_PARALLEL_SPLIT_THRESHOLD || context.taskScheduler == nullptr)
+		{
+			bin_references(references, task.count, mapping, bins);
+			return;
+		}
+
+		// Each chunk fills its own set of bins, they are merged afterwards
+		uint32_t numChunks = (task.count + BVH_PARALLEL_CHUNK_SIZE - 1) / BVH_PARALLEL_CHUNK_SIZE;
+		std::vector<TBin> chunkBins((size_t)numChunks * 3 * BVH_NUM_BINS);
+		for_each_chunk(context, task.count, true, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+		{
+			bin_references(references + first, last - first, mapping, (TBin(*)[BVH_NUM_BINS])&chunkBins[(size_t)chunkIdx * 3 * BVH_NUM_BINS]);
+		});
+
+		reset_bins(bins, mapping.numBins);
+		for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const TBin* currentBins = &chunkBins[((size_t)chunkIdx * 3 + axis) * BVH_NUM_BINS];
+				for (uint32_t binIdx = 0; binIdx < mapping.numBins; ++binIdx)
+				{
+					TBin& bin = bins[axis][binIdx];
+					_mm_storeu_ps(bin.min, _mm_min_ps(_mm_loadu_ps(bin.min), _mm_loadu_ps(currentBins[binIdx].min)));
+					_mm_storeu_ps(bin.max, _mm_max_ps(_mm_loadu_ps(bin.max), _mm_loadu_ps(currentBins[binIdx].max)));
+					bin.count += currentBins[binIdx].count;
+				}
+			}
+		}
+	}
+
+	// Classify a reference and accumulate its centroid into the bounds of its side
+	static inline bool classify(const TPrimitiveReference& reference, const TBinMapping& mapping, uint32_t axis, uint32_t splitBin, TPartitionBounds& bounds)
+	{
+		__m128 center = reference_centroid(reference);
+		uint32_t binIndices[4];
+		_mm_storeu_si128((__m128i*)binIndices, bin_index(mapping, center));
+		if (binIndices[axis] < splitBin)
+		{
+			bounds.leftMin = _mm_min_ps(bounds.leftMin, center);
+			bounds.leftMax = _mm_max_ps(bounds.leftMax, center);
+			return true;
+		}
+		bounds.rightMin = _mm_min_ps(bounds.rightMin, center);
+		bounds.rightMax = _mm_max_ps(bounds.rightMax, center);
+		return false;
+	}
+
+	// Partition the references of a task around a bin boundary, returns the number of references on the left
+	static uint32_t partition_task(TBuildContext& context, const TBuildTask& task, const TBinMapping& mapping, uint32_t axis, uint32_t splitBin, TPartitionBounds& centroidBounds)
+	{
+		TPrimitiveReference* references = context.references.data() + task.first;
+		reset_partition_bounds(centroidBounds);
+
+		if (task.count < BVH_PARALLEL_SPLIT_THRESHOLD || context.taskScheduler == nullptr)
+		{
+			// Hoare partition
+			uint32_t left = 0;
+			uint32_t right = task.count;
+			while (true)
+			{
+				while (left < right && classify(references[left], mapping, axis, splitBin, centroidBounds)) ++left;
+				while (left < right && !classify(references[right - 1], mapping, axis, splitBin, centroidBounds)) --right;
+				if (left >= right) break;
+				std::swap(references[left], references[right - 1]);
+			}
+			return left;
+		}
+
+		// Count the left references of each chunk
+		uint32_t numChunks = (task.count + BVH_PARALLEL_CHUNK_SIZE - 1) / BVH_PARALLEL_CHUNK_SIZE;
+		std::vector<uint32_t> leftOffsets(numChunks + 1, 0);
+		std::vector<TPartitionBounds> chunkBounds(numChunks);
+		for_each_chunk(context, task.count, true, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+		{
+			TPartitionBounds bounds;
+			reset_partition_bounds(bounds);
+			uint32_t numLeft = 0;
+			for (uint32_t refIdx = first; refIdx < last; ++refIdx)
+			{
+				numLeft += classify(references[refIdx], mapping, axis, splitBin, bounds) ? 1 : 0;
+			}
+			leftOffsets[chunkIdx + 1] = numLeft;
+			chunkBounds[chunkIdx] = bounds;
+		});
+		for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+		{
+			leftOffsets[chunkIdx + 1] += leftOffsets[chunkIdx];
+			centroidBounds.leftMin = _mm_min_ps(centroidBounds.leftMin, chunkBounds[chunkIdx].leftMin);
+			centroidBounds.leftMax = _mm_max_ps(centroidBounds.leftMax, chunkBounds[chunkIdx].leftMax);
+			centroidBounds.rightMin = _mm_min_ps(centroidBounds.rightMin, chunkBounds[chunkIdx].rightMin);
+			centroidBounds.rightMax = _mm_max_ps(centroidBounds.rightMax, chunkBounds[chunkIdx].rightMax);
+		}
+		uint32_t totalLeft = leftOffsets[numChunks];
+
+		// Scatter every chunk to its final place in the scratch buffer, then copy back
+		TPrimitiveReference* scratch = context.partitionBuffer.data() + task.first;
+		for_each_chunk(context, task.count, true, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+		{
+			uint32_t leftCursor = leftOffsets[chunkIdx];
+			uint32_t rightCursor = totalLeft + first - leftOffsets[chunkIdx];
+			TPartitionBounds bounds;
+			reset_partition_bounds(bounds);
+			for (uint32_t refIdx = first; refIdx < last; ++refIdx)
+			{
+				scratch[classify(references[refIdx], mapping, axis, splitBin, bounds) ? leftCursor++ : rightCursor++] = references[refIdx];
+			}
+		});
+		for_each_chunk(context, task.count, true, [&](uint32_t, uint32_t first, uint32_t last)
+		{
+			std::copy(scratch + first, scratch + last, references + first);
+		});
+		return totalLeft;
+	}
+
+	// Split a task in two, or turn it into a leaf. Returns false if a leaf was created
+	static bool split_task(TBuildContext& context, const TBuildTask& task, TBuildTask& leftTask, TBuildTask& rightTask)
+	{
+		TBVH& bvh = *context.bvh;
+		float leafCost = group_count(context, task.count) * BVH_INTERSECTION_COST;
+
+		// Bin the references along the three axes
+		TBinMapping mapping;
+		compute_bin_mapping(task, mapping);
+		TBin bins[3][BVH_NUM_BINS];
+		bin_task(context, task, mapping, bins);
+
+		// Sweep the bins and evaluate the surface area heuristic of every boundary
+		float bestCost = FLT_MAX;
+		uint32_t bestAxis = 0;
+		uint32_t bestBin = 0;
+		TAABB bestLeftBounds, bestRightBounds;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			if (task.centroidBounds.max[axis] <= task.centroidBounds.min[axis]) continue;
+
+			float rightCosts[BVH_NUM_BINS];
+			TAABB rightBoundsArray[BVH_NUM_BINS];
+			__m128 rightMin = _mm_set1_ps(FLT_MAX);
+			__m128 rightMax = _mm_set1_ps(-FLT_MAX);
+			uint32_t rightCount = 0;
+			for (uint32_t binIdx = mapping.numBins - 1; binIdx > 0; --binIdx)
+			{
+				rightMin = _mm_min_ps(rightMin, _mm_loadu_ps(bins[axis][binIdx].min));
+				rightMax = _mm_max_ps(rightMax, _mm_loadu_ps(bins[axis][binIdx].max));
+				rightCount += bins[axis][binIdx].count;
+				store_bounds(rightMin, rightMax, rightBoundsArray[binIdx]);
+				rightCosts[binIdx] = half_area(rightBoundsArray[binIdx]) * group_count(context, rightCount);
+			}
+
+			__m128 leftMin = _mm_set1_ps(FLT_MAX);
+			__m128 leftMax = _mm_set1_ps(-FLT_MAX);
+			uint32_t leftCount = 0;
+			for (uint32_t binIdx = 1; binIdx < mapping.numBins; ++binIdx)
+			{
+				leftMin = _mm_min_ps(leftMin, _mm_loadu_ps(bins[axis][binIdx - 1].min));
+				leftMax = _mm_max_ps(leftMax, _mm_loadu_ps(bins[axis][binIdx - 1].max));
+				leftCount += bins[axis][binIdx - 1].count;
+				if (leftCount == 0 || leftCount == task.count) continue;
+
+				TAABB leftBounds;
+				store_bounds(leftMin, leftMax, leftBounds);
+				float cost = half_area(leftBounds) * group_count(context, leftCount) + rightCosts[binIdx];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = binIdx;
+					bestLeftBounds = leftBounds;
+					bestRightBounds = rightBoundsArray[binIdx];
+				}
+			}
+		}
+
+		// Degenerated node (all the centroids are at the same place), or a leaf is cheaper
+		// A node that has no level to spare under it becomes a leaf if it can, or is split in two halves so that its leaves still fit in the depth that is left
+		float splitCost = BVH_TRAVERSAL_COST + BVH_INTERSECTION_COST * bestCost / std::max(half_area(task.bounds), FLT_MIN);
+		bool forceSplit = task.count > context.maxLeafSize;
+		bool depthLimit = task.depth + balanced_depth(context, task.count) >= context.maxDepth;
+		if (bestCost == FLT_MAX || depthLimit || (!forceSplit && splitCost >= leafCost))
+		{
+			if (!forceSplit)
+			{
+				write_node(bvh, task.nodeIndex, task.bounds, task.first, task.count);
+				return false;
+			}
+
+			// Too many references for a leaf, cut the range at the median of the centroids along their largest extent
+			uint32_t half = task.count / 2;
+			leftTask.first = task.first;
+			leftTask.count = half;
+			rightTask.first = task.first + half;
+			rightTask.count = task.count - half;
+
+			TPrimitiveReference* references = context.references.data() + task.first;
+			if (bestCost != FLT_MAX)
+			{
+				uint32_t axis = 0;
+				for (uint32_t candidate = 1; candidate < 3; ++candidate)
+				{
+					float extent = task.centroidBounds.max[candidate] - task.centroidBounds.min[candidate];
+					if (extent > task.centroidBounds.max[axis] - task.centroidBounds.min[axis]) axis = candidate;
+				}
+				std::nth_element(references, references + half, references + task.count, [axis](const TPrimitiveReference& a, const TPrimitiveReference& b)
+				{
+					return a.min[axis] + a.max[axis] < b.min[axis] + b.max[axis];
+				});
+			}
+			for (uint32_t side = 0; side < 2; ++side)
+			{
+				TBuildTask& child = side == 0 ? leftTask : rightTask;
+				__m128 boundsMin = _mm_set1_ps(FLT_MAX);
+				__m128 boundsMax = _mm_set1_ps(-FLT_MAX);
+				__m128 centroidMin = _mm_set1_ps(FLT_MAX);
+				__m128 centroidMax = _mm_set1_ps(-FLT_MAX);
+				for (uint32_t refIdx = child.first - task.first; refIdx < child.first - task.first + child.count; ++refIdx)
+				{
+					boundsMin = _mm_min_ps(boundsMin, _mm_loadu_ps(references[refIdx].min));
+					boundsMax = _mm_max_ps(boundsMax, _mm_loadu_ps(references[refIdx].max));
+					centroidMin = _mm_min_ps(centroidMin, reference_centroid(references[refIdx]));
+					centroidMax = _mm_max_ps(centroidMax, reference_centroid(references[refIdx]));
+				}
+				store_bounds(boundsMin, boundsMax, child.bounds);
+				store_bounds(centroidMin, centroidMax, child.centroidBounds);
+			}
+		}
+		else
+		{
+			TPartitionBounds centroidBounds;
+			uint32_t numLeft = partition_task(context, task, mapping, bestAxis, bestBin, centroidBounds);
+
+			// The bounds of the children come from the bins, their centroid bounds from the partition
+			leftTask.first = task.first;
+			leftTask.count = numLeft;
+			leftTask.bounds = bestLeftBounds;
+			store_bounds(centroidBounds.leftMin, centroidBounds.leftMax, leftTask.centroidBounds);
+			rightTask.first = task.first + numLeft;
+			rightTask.count = task.count - numLeft;
+			rightTask.bounds = bestRightBounds;
+			store_bounds(centroidBounds.rightMin, centroidBounds.rightMax, rightTask.centroidBounds);
+		}
+
+		// Allocate the two children next to each other in the arena
+		uint32_t leftIndex = context.nodeCount.fetch_add(2);
+		leftTask.nodeIndex = leftIndex;
+		rightTask.nodeIndex = leftIndex + 1;
+		leftTask.depth = task.depth + 1;
+		rightTask.depth = task.depth + 1;
+		write_node(bvh, task.nodeIndex, task.bounds, leftIndex, 0);
+		return true;
+	}
+
+	static void build_subtree(TBuildContext& context, const TBuildTask& task)
+	{
+		TBuildTask leftTask, rightTask;
+		if (split_task(context, task, leftTask, rightTask))
+		{
+			build_subtree(context, leftTask);
+			build_subtree(context, rightTask);
+		}
+	}
+
+	void build_bvh(const TAABB* primitiveBounds, uint32_t numPrimitives, TBVH& bvh, TTaskScheduler* taskScheduler, uint32_t leafWidth, uint32_t maxDepth)
+	{
+		TBuildContext context;
+		context.bvh = &bvh;
+		context.taskScheduler = taskScheduler;
+		context.leafWidth = std::max(1u, leafWidth);
+		context.maxLeafSize = std::max((uint32_t)BVH_MAX_LEAF_SIZE, context.leafWidth);
+
+		// A depth that can not hold the primitives even with balanced splits only makes the whole tree balanced
+		context.maxDepth = std::max(maxDepth, balanced_depth(context, numPrimitives));
+		uint32_t numThreads = taskScheduler ? taskScheduler->num_threads() : 1;
+		context.subtreeThreshold = std::max((uint32_t)BVH_MIN_SUBTREE_SIZE, numPrimitives / (numThreads * 16));
+
+		// The arena is sized for the worst case, a binary tree with one primitive per leaf
+		bvh.nodes.resize(numPrimitives > 0 ? 2 * (size_t)numPrimitives - 1 : 1);
+		bvh.primitiveIndices.resize(numPrimitives);
+		context.nodeCount.store(1);
+		context.references.resize(numPrimitives);
+		if (taskScheduler && numPrimitives >= BVH_PARALLEL_SPLIT_THRESHOLD)
+		{
+			context.partitionBuffer.resize(numPrimitives);
+		}
+
+		// Initialize the references and the bounds of the root
+		uint32_t numChunks = (numPrimitives + BVH_PARALLEL_CHUNK_SIZE - 1) / BVH_PARALLEL_CHUNK_SIZE;
+		std::vector<TPartitionBounds> chunkBounds(numChunks);
+		for_each_chunk(context, numPrimitives, true, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+		{
+			TPartitionBounds& bounds = chunkBounds[chunkIdx];
+			reset_partition_bounds(bounds);
+			for (uint32_t primIdx = first; primIdx < last; ++primIdx)
+			{
+				TPrimitiveReference& reference = context.references[primIdx];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					reference.min[axis] = primitiveBounds[primIdx].min[axis];
+					reference.max[axis] = primitiveBounds[primIdx].max[axis];
+				}
+				reference.index = primIdx;
+				reference.padding = 0;
+
+				// Left side holds the bounds, right side the centroid bounds
+				bounds.leftMin = _mm_min_ps(bounds.leftMin, _mm_loadu_ps(reference.min));
+				bounds.leftMax = _mm_max_ps(bounds.leftMax, _mm_loadu_ps(reference.max));
+				bounds.rightMin = _mm_min_ps(bounds.rightMin, reference_centroid(reference));
+				bounds.rightMax = _mm_max_ps(bounds.rightMax, reference_centroid(reference));
+			}
+		});
+
+		TPartitionBounds rootBounds;
+		reset_partition_bounds(rootBounds);
+		for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+		{
+			rootBounds.leftMin = _mm_min_ps(rootBounds.leftMin, chunkBounds[chunkIdx].leftMin);
+			rootBounds.leftMax = _mm_max_ps(rootBounds.leftMax, chunkBounds[chunkIdx].leftMax);
+			rootBounds.rightMin = _mm_min_ps(rootBounds.rightMin, chunkBounds[chunkIdx].rightMin);
+			rootBounds.rightMax = _mm_max_ps(rootBounds.rightMax, chunkBounds[chunkIdx].rightMax);
+		}
+
+		TBuildTask rootTask;
+		rootTask.nodeIndex = 0;
+		rootTask.depth = 0;
+		rootTask.first = 0;
+		rootTask.count = numPrimitives;
+		store_bounds(rootBounds.leftMin, rootBounds.leftMax, rootTask.bounds);
+		store_bounds(rootBounds.rightMin, rootBounds.rightMax, rootTask.centroidBounds);
+
+		if (numPrimitives == 0)
+		{
+			write_node(bvh, 0, rootTask.bounds, 0, 0);
+			return;
+		}
+
+		// Split the top of the tree level by level until there are enough subtrees to keep every thread busy
+		std::vector<TBuildTask> frontier(1, rootTask);
+		std::vector<TBuildTask> nextFrontier;
+		std::mutex frontierMutex;
+		while (!frontier.empty())
+		{
+			nextFrontier.clear();
+			auto process_task = [&](uint32_t taskIdx, uint32_t)
+			{
+				const TBuildTask& task = frontier[taskIdx];
+				if (task.count <= context.subtreeThreshold)
+				{
+					build_subtree(context, task);
+					return;
+				}
+
+				TBuildTask leftTask, rightTask;
+				if (split_task(context, task, leftTask, rightTask))
+				{
+					std::lock_guard<std::mutex> lock(frontierMutex);
+					nextFrontier.push_back(leftTask);
+					nextFrontier.push_back(rightTask);
+				}
+			};
+
+			// While there are fewer tasks than threads, the parallelism comes from the binning and the partition
+			if (taskScheduler && frontier.size() >= numThreads)
+			{
+				taskScheduler->parallel_for((uint32_t)frontier.size(), process_task);
+			}
+			else
+			{
+				for (uint32_t taskIdx = 0; taskIdx < frontier.size(); ++taskIdx)
+				{
+					process_task(taskIdx, 0);
+				}
+			}
+			frontier.swap(nextFrontier);
+		}
+
+		// Drop the part of the arena that was not used and write down the final primitive order
+		bvh.nodes.resize(context.nodeCount.load());
+		for_each_chunk(context, numPrimitives, true, [&](uint32_t, uint32_t first, uint32_t last)
+		{
+			for (uint32_t primIdx = first; primIdx < last; ++primIdx)
+			{
+				bvh.primitiveIndices[primIdx] = context.references[primIdx].index;
+			}
+		});
+	}
+
+	float bvh_sah_cost(const TBVH& bvh, uint32_t leafWidth)
+	{
+		if (bvh.nodes.empty()) return 0.0f;
+
+		TAABB rootBounds;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			rootBounds.min[axis] = bvh.nodes[0].min[axis];
+			rootBounds.max[axis] = bvh.nodes[0].max[axis];
+		}
+		float invRootArea = 1.0f / std::max(half_area(rootBounds), FLT_MIN);
+		leafWidth = std::max(1u, leafWidth);
+
+		double cost = 0.0;
+		for (const TBVHNode& node : bvh.nodes)
+		{
+			TAABB bounds;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				bounds.min[axis] = node.min[axis];
+				bounds.max[axis] = node.max[axis];
+			}
+			float relativeArea = half_area(bounds) * invRootArea;
+			cost += relativeArea * (node.count == 0 ? BVH_TRAVERSAL_COST : (node.count + leafWidth - 1) / leafWidth * BVH_INTERSECTION_COST);
+		}
+		return (float)cost;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,305 @@
+// Internal includes
+#include "bvh_cache.h"
+
+// External includes
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace dxr_demo
+{
+	namespace cpu_raytracing
+	{
+		// First bytes of every cache file, "DXRB"
+		#define BVH_CACHE_MAGIC 0x42525844u
+
+		// Number of strided elements gathered before they are hashed
+		#define BVH_CACHE_HASH_BATCH 1024
+
+		namespace BVHCacheSection
+		{
+			enum Type
+			{
+				// Binary or wide nodes, depending on the node format
+				Nodes,
+				// Primitive indices of the binary leaves of the custom primitives
+				PrimitiveIndices,
+				// Primitives in the layout of the intersection kernels
+				Groups,
+				Count
+			};
+		}
+
+		struct TBVHCacheHeader
+		{
+			// Identifies the files of the cache, the layout they were written with and the geometry they were built for
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+
+			// Layout of the structure, the size of the nodes catches a compiler that lays them out differently
+			uint32_t geometryType;
+			uint32_t nodeFormat;
+			uint32_t nodeSize;
+			uint32_t groupWidth;
+			uint32_t groupSize;
+			uint32_t numGroups;
+			TAABB bounds;
+
+			// Offset from the first byte of the file and size in bytes of every section
+			uint64_t sectionOffsets[BVHCacheSection::Count];
+			uint64_t sectionSizes[BVHCacheSection::Count];
+		};
+
+		// 64 bit hash that consumes its input 8 bytes at a time, with the mixing steps of MurmurHash3
+		struct THasher
+		{
+			uint64_t state;
+			uint64_t length;
+		};
+
+		static inline uint64_t rotate_left(uint64_t value, uint32_t shift)
+		{
+			return (value << shift) | (value >> (64 - shift));
+		}
+
+		static inline void hash_word(THasher& hasher, uint64_t word)
+		{
+			word *= 0x87c37b91114253d5ull;
+			word = rotate_left(word, 31);
+			word *= 0x4cf5ad432745937full;
+			hasher.state = rotate_left(hasher.state ^ word, 27) * 5 + 0x52dce729;
+		}
+
+		static void hash_bytes(THasher& hasher, const void* data, size_t size)
+		{
+			const uint8_t* bytes = (const uint8_t*)data;
+			size_t numWords = size / 8;
+			for (size_t wordIdx = 0; wordIdx < numWords; ++wordIdx)
+			{
+				uint64_t word;
+				memcpy(&word, bytes + wordIdx * 8, 8);
+				hash_word(hasher, word);
+			}
+
+			// The last bytes are padded with zeros, the length tells the inputs apart
+			if (size % 8 != 0)
+			{
+				uint64_t word = 0;
+				memcpy(&word, bytes + numWords * 8, size % 8);
+				hash_word(hasher, word);
+			}
+			hasher.length += size;
+		}
+
+		// Hash the first elementSize bytes of count elements stride bytes apart
+		static void hash_strided(THasher& hasher, const void* data, uint32_t count, uint32_t stride, uint32_t elementSize)
+		{
+			if (stride == elementSize)
+			{
+				hash_bytes(hasher, data, (size_t)count * elementSize);
+				return;
+			}
+
+			// Gather batches of elements so that the hash still consumes whole words
+			uint8_t batch[BVH_CACHE_HASH_BATCH * 6 * sizeof(float)];
+			for (uint32_t first = 0; first < count; first += BVH_CACHE_HASH_BATCH)
+			{
+				uint32_t batchSize = std::min(count - first, (uint32_t)BVH_CACHE_HASH_BATCH);
+				for (uint32_t elementIdx = 0; elementIdx < batchSize; ++elementIdx)
+				{
+					memcpy(batch + (size_t)elementIdx * elementSize, (const uint8_t*)data + (size_t)(first + elementIdx) * stride, elementSize);
+				}
+				hash_bytes(hasher, batch, (size_t)batchSize * elementSize);
+			}
+		}
+
+		static uint64_t finalize_hash(const THasher& hasher)
+		{
+			uint64_t hash = hasher.state ^ hasher.length;
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ull;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		static inline uint64_t align_section(uint64_t offset)
+		{
+			return (offset + BVH_CACHE_SECTION_ALIGNMENT - 1) / BVH_CACHE_SECTION_ALIGNMENT * BVH_CACHE_SECTION_ALIGNMENT;
+		}
+
+		// The custom primitives always get a binary hierarchy, a requested wide one would be built the same way
+		static inline BVHNodeFormat::Type effective_node_format(const TGeometryDescriptor& geometry, BVHNodeFormat::Type nodeFormat)
+		{
+			return geometry.type == GeometryType::CustomPrimitives ? BVHNodeFormat::Binary : nodeFormat;
+		}
+
+		uint64_t bvh_cache_key(const TGeometryDescriptor& geometry, BVHNodeFormat::Type nodeFormat)
+		{
+			THasher hasher = { 0x9e3779b97f4a7c15ull, 0 };
+			uint32_t layout[4] = { BVH_CACHE_VERSION, (uint32_t)geometry.type, (uint32_t)effective_node_format(geometry, nodeFormat), triangle_intersection_api().width };
+			hash_bytes(hasher, layout, sizeof(layout));
+
+			if (geometry.type == GeometryType::Triangles)
+			{
+				uint32_t counts[2] = { geometry.vertexCount, geometry.indexCount };
+				hash_bytes(hasher, counts, sizeof(counts));
+				hash_strided(hasher, geometry.vertexBuffer, geometry.vertexCount, geometry.vertexStride, 3 * sizeof(float));
+				hash_bytes(hasher, geometry.indexBuffer, (size_t)geometry.indexCount * sizeof(uint32_t));
+			}
+			else
+			{
+				hash_bytes(hasher, &geometry.aabbCount, sizeof(geometry.aabbCount));
+				hash_strided(hasher, geometry.aabbBuffer, geometry.aabbCount, geometry.aabbStride, 6 * sizeof(float));
+			}
+			return finalize_hash(hasher);
+		}
+
+		bool save_bottom_level_acceleration_structure(const TBottomLevelAccelerationStructure& accelerationStructure, uint64_t key, const char* path)
+		{
+			// A structure loaded from a file has no storage of its own, and the storage of an updatable one changes every frame
+			if (accelerationStructure.mappedFile.data != nullptr || accelerationStructure.allowUpdate) return false;
+
+			bool wide = accelerationStructure.nodeFormat == BVHNodeFormat::Wide8;
+			const void* sections[BVHCacheSection::Count];
+			sections[BVHCacheSection::Nodes] = wide ? (const void*)accelerationStructure.bvh8.nodes.data() : (const void*)accelerationStructure.bvh.nodes.data();
+			sections[BVHCacheSection::PrimitiveIndices] = accelerationStructure.bvh.primitiveIndices.data();
+			sections[BVHCacheSection::Groups] = accelerationStructure.primitiveGroups.data();
+
+			TBVHCacheHeader header = {};
+			header.magic = BVH_CACHE_MAGIC;
+			header.version = BVH_CACHE_VERSION;
+			header.key = key;
+			header.geometryType = accelerationStructure.geometryType;
+			header.nodeFormat = accelerationStructure.nodeFormat;
+			header.nodeSize = wide ? sizeof(TBVH8Node) : sizeof(TBVHNode);
+			header.groupWidth = accelerationStructure.groupWidth;
+			header.groupSize = accelerationStructure.groupSize;
+			header.numGroups = accelerationStructure.numGroups;
+			header.bounds = accelerationStructure.bounds;
+			header.sectionSizes[BVHCacheSection::Nodes] = wide ? accelerationStructure.bvh8.nodes.size() * sizeof(TBVH8Node) : accelerationStructure.bvh.nodes.size() * sizeof(TBVHNode);
+			header.sectionSizes[BVHCacheSection::PrimitiveIndices] = accelerationStructure.bvh.primitiveIndices.size() * sizeof(uint32_t);
+			header.sectionSizes[BVHCacheSection::Groups] = accelerationStructure.primitiveGroups.size() * sizeof(float);
+
+			// Every section starts on an aligned offset, the mapping of the file is page aligned so the arrays are too
+			uint64_t offset = align_section(sizeof(TBVHCacheHeader));
+			for (uint32_t sectionIdx = 0; sectionIdx < BVHCacheSection::Count; ++sectionIdx)
+			{
+				header.sectionOffsets[sectionIdx] = offset;
+				offset = align_section(offset + header.sectionSizes[sectionIdx]);
+			}
+
+			std::string temporaryPath = std::string(path) + ".tmp";
+			std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+			if (!file) return false;
+
+			const char padding[BVH_CACHE_SECTION_ALIGNMENT] = {};
+			file.write((const char*)&header, sizeof(header));
+			uint64_t written = sizeof(header);
+			for (uint32_t sectionIdx = 0; sectionIdx < BVHCacheSection::Count; ++sectionIdx)
+			{
+				file.write(padding, (std::streamsize)(header.sectionOffsets[sectionIdx] - written));
+				file.write((const char*)sections[sectionIdx], (std::streamsize)header.sectionSizes[sectionIdx]);
+				written = header.sectionOffsets[sectionIdx] + header.sectionSizes[sectionIdx];
+			}
+			file.close();
+			if (!file)
+			{
+				remove(temporaryPath.c_str());
+				return false;
+			}
+
+			// Renaming over an existing file fails on Windows
+			remove(path);
+			return rename(temporaryPath.c_str(), path) == 0;
+		}
+
+		TBottomLevelAccelerationStructure* load_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, uint64_t key, const char* path)
+		{
+			TMappedFile file;
+			if (!map_file(path, file)) return nullptr;
+
+			// The header must match the geometry and the kernels of this processor, and the sections must lie in the file
+			const TBVHCacheHeader* header = (const TBVHCacheHeader*)file.data;
+			const TTriangleIntersectionAPI& intersectionAPI = triangle_intersection_api();
+			bool valid = file.size >= sizeof(TBVHCacheHeader) && header->magic == BVH_CACHE_MAGIC && header->version == BVH_CACHE_VERSION && header->key == key
+				&& header->geometryType == (uint32_t)geometry.type
+				&& header->nodeSize == (header->nodeFormat == BVHNodeFormat::Wide8 ? sizeof(TBVH8Node) : sizeof(TBVHNode))
+				&& header->groupWidth == (geometry.type == GeometryType::CustomPrimitives ? 1 : intersectionAPI.width);
+			for (uint32_t sectionIdx = 0; valid && sectionIdx < BVHCacheSection::Count; ++sectionIdx)
+			{
+				valid = header->sectionOffsets[sectionIdx] % BVH_CACHE_SECTION_ALIGNMENT == 0 && header->sectionOffsets[sectionIdx] <= file.size
+					&& header->sectionSizes[sectionIdx] <= file.size - header->sectionOffsets[sectionIdx];
+			}
+			valid = valid && header->sectionSizes[BVHCacheSection::Nodes] >= header->nodeSize
+				&& header->sectionSizes[BVHCacheSection::Groups] == (uint64_t)header->numGroups * header->groupSize * sizeof(float);
+			if (!valid)
+			{
+				unmap_file(file);
+				return nullptr;
+			}
+
+			TBottomLevelAccelerationStructure* accelerationStructure = new TBottomLevelAccelerationStructure();
+			accelerationStructure->nodeFormat = (BVHNodeFormat::Type)header->nodeFormat;
+			accelerationStructure->bounds = header->bounds;
+			accelerationStructure->opaque = geometry.opaque;
+			accelerationStructure->geometryType = geometry.type;
+			accelerationStructure->groupWidth = header->groupWidth;
+			accelerationStructure->groupSize = header->groupSize;
+			accelerationStructure->numGroups = header->numGroups;
+			accelerationStructure->allowUpdate = false;
+			switch (geometry.type)
+			{
+			case GeometryType::Triangles:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_triangles;
+				break;
+			case GeometryType::Spheres:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_spheres;
+				break;
+			case GeometryType::Boxes:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_boxes;
+				break;
+			case GeometryType::CustomPrimitives:
+				accelerationStructure->intersect_groups = nullptr;
+				break;
+			};
+
+			// The sections are used in place, the pages are read from the disk as the traversal touches them
+			const uint8_t* nodes = file.data + header->sectionOffsets[BVHCacheSection::Nodes];
+			bool wide = accelerationStructure->nodeFormat == BVHNodeFormat::Wide8;
+			accelerationStructure->nodes = wide ? nullptr : (const TBVHNode*)nodes;
+			accelerationStructure->wideNodes = wide ? (const TBVH8Node*)nodes : nullptr;
+			accelerationStructure->primitiveIndices = (const uint32_t*)(file.data + header->sectionOffsets[BVHCacheSection::PrimitiveIndices]);
+			accelerationStructure->groups = (const float*)(file.data + header->sectionOffsets[BVHCacheSection::Groups]);
+			accelerationStructure->mappedFile = file;
+			return accelerationStructure;
+		}
+
+		TBottomLevelAccelerationStructure* create_cached_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, BVHNodeFormat::Type nodeFormat, TTaskScheduler* taskScheduler, const char* cacheDirectory)
+		{
+			if (geometry.allowUpdate || cacheDirectory == nullptr || cacheDirectory[0] == '\0')
+			{
+				return create_bottom_level_acceleration_structure(geometry, nodeFormat, taskScheduler);
+			}
+
+			// One file per key, named after it
+			uint64_t key = bvh_cache_key(geometry, nodeFormat);
+			char fileName[32];
+			snprintf(fileName, sizeof(fileName), "/%016llx.bvh", (unsigned long long)key);
+			std::string path = std::string(cacheDirectory) + fileName;
+
+			TBottomLevelAccelerationStructure* accelerationStructure = load_bottom_level_acceleration_structure(geometry, key, path.c_str());
+			if (accelerationStructure == nullptr)
+			{
+				// A cache that cannot be written only costs the next run a rebuild
+				accelerationStructure = create_bottom_level_acceleration_structure(geometry, nodeFormat, taskScheduler);
+				save_bottom_level_acceleration_structure(*accelerationStructure, key, path.c_str());
+			}
+			return accelerationStructure;
+		}
+	}
+}
\ No newline at end of file
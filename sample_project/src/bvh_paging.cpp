@@ -0,0 +1,572 @@
+// Internal includes
+#include "bvh_cache.h"
+#include "bvh_paging.h"
+
+// External includes
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace dxr_demo
+{
+	namespace cpu_raytracing
+	{
+		// First bytes of every paged file, "DXRP"
+		#define BVH_PAGE_MAGIC 0x50525844u
+
+		struct TBVHPageFileHeader
+		{
+			// Identifies the paged files, the layout they were written with and the geometry they were built for
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+
+			// Layout of the structure, the size of the nodes catches a compiler that lays them out differently
+			uint32_t geometryType;
+			uint32_t nodeSize;
+			uint32_t groupWidth;
+			uint32_t groupSize;
+			uint32_t numGroups;
+			uint32_t numResidentNodes;
+			uint32_t numPages;
+			uint32_t padding;
+			TAABB bounds;
+
+			// Offsets from the first byte of the file of the resident nodes and of the page table
+			uint64_t residentOffset;
+			uint64_t pageTableOffset;
+		};
+
+		struct TBVHPageFileEntry
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint32_t numNodes;
+			uint32_t numGroups;
+		};
+
+		static inline uint64_t align_offset(uint64_t offset, uint64_t alignment)
+		{
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+
+		static inline uint64_t page_size(uint32_t numNodes, uint32_t numGroups, uint32_t groupSize)
+		{
+			return (uint64_t)numNodes * sizeof(TBVHNode) + (uint64_t)numGroups * groupSize * sizeof(float);
+		}
+
+		// Number of nodes and of groups of every subtree, the depth of the hierarchy is bounded by the traversal stack
+		static void count_subtree(const TBVHNode* nodes, uint32_t nodeIdx, std::vector<uint32_t>& subtreeNodes, std::vector<uint32_t>& subtreeGroups)
+		{
+			const TBVHNode& node = nodes[nodeIdx];
+			if (node.count != 0)
+			{
+				subtreeNodes[nodeIdx] = 1;
+				subtreeGroups[nodeIdx] = node.count;
+				return;
+			}
+
+			count_subtree(nodes, node.leftFirst, subtreeNodes, subtreeGroups);
+			count_subtree(nodes, node.leftFirst + 1, subtreeNodes, subtreeGroups);
+			subtreeNodes[nodeIdx] = 1 + subtreeNodes[node.leftFirst] + subtreeNodes[node.leftFirst + 1];
+			subtreeGroups[nodeIdx] = subtreeGroups[node.leftFirst] + subtreeGroups[node.leftFirst + 1];
+		}
+
+		// Copy the subtree of a page root with its nodes and groups numbered from the start of the page
+		static void write_page(const TBottomLevelAccelerationStructure& accelerationStructure, uint32_t rootIdx, const TBVHPageFileEntry& entry, std::vector<uint8_t>& page)
+		{
+			page.assign((size_t)entry.size, 0);
+			TBVHNode* pageNodes = (TBVHNode*)page.data();
+			float* pageGroups = (float*)(page.data() + (size_t)entry.numNodes * sizeof(TBVHNode));
+			uint32_t groupSize = accelerationStructure.groupSize;
+
+			// The children stay next to each other, the pairs are allocated in the order the subtree is walked
+			std::vector<std::pair<uint32_t, uint32_t>> stack;
+			stack.push_back(std::make_pair(rootIdx, 0u));
+			uint32_t numNodes = 1;
+			uint32_t numGroups = 0;
+			while (!stack.empty())
+			{
+				uint32_t sourceIdx = stack.back().first;
+				uint32_t targetIdx = stack.back().second;
+				stack.pop_back();
+
+				const TBVHNode& node = accelerationStructure.nodes[sourceIdx];
+				TBVHNode& copy = pageNodes[targetIdx];
+				copy = node;
+				if (node.count != 0)
+				{
+					copy.leftFirst = numGroups;
+					memcpy(pageGroups + (size_t)numGroups * groupSize, accelerationStructure.groups + (size_t)node.leftFirst * groupSize, (size_t)node.count * groupSize * sizeof(float));
+					numGroups += node.count;
+				}
+				else
+				{
+					copy.leftFirst = numNodes;
+					numNodes += 2;
+					stack.push_back(std::make_pair(node.leftFirst + 1, copy.leftFirst + 1));
+					stack.push_back(std::make_pair(node.leftFirst, copy.leftFirst));
+				}
+			}
+			assert(numNodes == entry.numNodes && numGroups == entry.numGroups);
+		}
+
+		bool save_paged_bottom_level_acceleration_structure(const TBottomLevelAccelerationStructure& accelerationStructure, uint64_t key, const char* path)
+		{
+			// Only a binary hierarchy over built-in primitives, with storage of its own that does not change, is paged
+			if (accelerationStructure.mappedFile.data != nullptr || accelerationStructure.pageTable != nullptr || accelerationStructure.allowUpdate
+				|| accelerationStructure.nodeFormat != BVHNodeFormat::Binary || accelerationStructure.geometryType == GeometryType::CustomPrimitives) return false;
+
+			const TBVHNode* nodes = accelerationStructure.nodes;
+			uint32_t numNodes = (uint32_t)accelerationStructure.bvh.nodes.size();
+			uint32_t groupSize = accelerationStructure.groupSize;
+			std::vector<uint32_t> subtreeNodes(numNodes);
+			std::vector<uint32_t> subtreeGroups(numNodes);
+			count_subtree(nodes, 0, subtreeNodes, subtreeGroups);
+
+			// The top of the hierarchy stays resident down to the first subtrees that fit in a page, a leaf that does not fit gets a page of its own
+			std::vector<TBVHNode> residentNodes(1);
+			std::vector<uint32_t> pageRoots;
+			std::vector<std::pair<uint32_t, uint32_t>> stack;
+			stack.push_back(std::make_pair(0u, 0u));
+			while (!stack.empty())
+			{
+				uint32_t sourceIdx = stack.back().first;
+				uint32_t targetIdx = stack.back().second;
+				stack.pop_back();
+
+				const TBVHNode& node = nodes[sourceIdx];
+				residentNodes[targetIdx] = node;
+				if (node.count != 0 || page_size(subtreeNodes[sourceIdx], subtreeGroups[sourceIdx], groupSize) <= BVH_PAGE_TARGET_SIZE)
+				{
+					residentNodes[targetIdx].leftFirst = (uint32_t)pageRoots.size();
+					residentNodes[targetIdx].count = BVH_PAGE_LEAF_COUNT;
+					pageRoots.push_back(sourceIdx);
+				}
+				else
+				{
+					uint32_t firstChild = (uint32_t)residentNodes.size();
+					residentNodes[targetIdx].leftFirst = firstChild;
+					residentNodes.resize(firstChild + 2);
+					stack.push_back(std::make_pair(node.leftFirst + 1, firstChild + 1));
+					stack.push_back(std::make_pair(node.leftFirst, firstChild));
+				}
+			}
+
+			TBVHPageFileHeader header = {};
+			header.magic = BVH_PAGE_MAGIC;
+			header.version = BVH_PAGE_VERSION;
+			header.key = key;
+			header.geometryType = accelerationStructure.geometryType;
+			header.nodeSize = sizeof(TBVHNode);
+			header.groupWidth = accelerationStructure.groupWidth;
+			header.groupSize = groupSize;
+			header.numGroups = accelerationStructure.numGroups;
+			header.numResidentNodes = (uint32_t)residentNodes.size();
+			header.numPages = (uint32_t)pageRoots.size();
+			header.bounds = accelerationStructure.bounds;
+			header.residentOffset = align_offset(sizeof(TBVHPageFileHeader), BVH_CACHE_SECTION_ALIGNMENT);
+			header.pageTableOffset = align_offset(header.residentOffset + residentNodes.size() * sizeof(TBVHNode), BVH_CACHE_SECTION_ALIGNMENT);
+
+			// Every page starts on an aligned offset, so that reading one touches as few blocks of the disk as possible
+			std::vector<TBVHPageFileEntry> entries(pageRoots.size());
+			uint64_t offset = align_offset(header.pageTableOffset + entries.size() * sizeof(TBVHPageFileEntry), BVH_PAGE_FILE_ALIGNMENT);
+			for (uint32_t pageIdx = 0; pageIdx < header.numPages; ++pageIdx)
+			{
+				TBVHPageFileEntry& entry = entries[pageIdx];
+				entry.numNodes = subtreeNodes[pageRoots[pageIdx]];
+				entry.numGroups = subtreeGroups[pageRoots[pageIdx]];
+				entry.size = page_size(entry.numNodes, entry.numGroups, groupSize);
+				entry.offset = offset;
+				offset = align_offset(offset + entry.size, BVH_PAGE_FILE_ALIGNMENT);
+			}
+
+			std::string temporaryPath = std::string(path) + ".tmp";
+			std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+			if (!file) return false;
+
+			static const char padding[BVH_PAGE_FILE_ALIGNMENT] = {};
+			file.write((const char*)&header, sizeof(header));
+			file.write(padding, (std::streamsize)(header.residentOffset - sizeof(header)));
+			file.write((const char*)residentNodes.data(), (std::streamsize)(residentNodes.size() * sizeof(TBVHNode)));
+			file.write(padding, (std::streamsize)(header.pageTableOffset - header.residentOffset - residentNodes.size() * sizeof(TBVHNode)));
+			file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(TBVHPageFileEntry)));
+			uint64_t written = header.pageTableOffset + entries.size() * sizeof(TBVHPageFileEntry);
+
+			// The pages are written one at a time, the copy of the whole structure is never held in memory
+			std::vector<uint8_t> page;
+			for (uint32_t pageIdx = 0; pageIdx < header.numPages && file; ++pageIdx)
+			{
+				write_page(accelerationStructure, pageRoots[pageIdx], entries[pageIdx], page);
+				file.write(padding, (std::streamsize)(entries[pageIdx].offset - written));
+				file.write((const char*)page.data(), (std::streamsize)page.size());
+				written = entries[pageIdx].offset + entries[pageIdx].size;
+			}
+			file.close();
+			if (!file)
+			{
+				remove(temporaryPath.c_str());
+				return false;
+			}
+
+			// Renaming over an existing file fails on Windows
+			remove(path);
+			return rename(temporaryPath.c_str(), path) == 0;
+		}
+
+		TBottomLevelAccelerationStructure* open_paged_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, uint64_t key, const char* path, TBVHPageCache& cache)
+		{
+			if (geometry.type == GeometryType::CustomPrimitives) return nullptr;
+
+			// The table keeps the file open, the loader thread reads the pages from it
+			TBVHPageTable* pageTable = new TBVHPageTable();
+			pageTable->path = path;
+			pageTable->cache = &cache;
+			std::ifstream& file = pageTable->file;
+			file.open(path, std::ios::binary);
+			file.seekg(0, std::ios::end);
+			uint64_t fileSize = file ? (uint64_t)file.tellg() : 0;
+			file.seekg(0, std::ios::beg);
+
+			// The header must match the geometry and the kernels of this processor, and the resident nodes and the page table must lie in the file
+			TBVHPageFileHeader header = {};
+			if (fileSize >= sizeof(TBVHPageFileHeader))
+			{
+				file.read((char*)&header, sizeof(header));
+			}
+			const TTriangleIntersectionAPI& intersectionAPI = triangle_intersection_api();
+			bool valid = file && fileSize >= sizeof(TBVHPageFileHeader) && header.magic == BVH_PAGE_MAGIC && header.version == BVH_PAGE_VERSION && header.key == key
+				&& header.geometryType == (uint32_t)geometry.type && header.nodeSize == sizeof(TBVHNode) && header.groupWidth == intersectionAPI.width
+				&& header.numResidentNodes > 0 && header.numPages > 0
+				&& header.residentOffset <= fileSize && (uint64_t)header.numResidentNodes * sizeof(TBVHNode) <= fileSize - header.residentOffset
+				&& header.pageTableOffset <= fileSize && (uint64_t)header.numPages * sizeof(TBVHPageFileEntry) <= fileSize - header.pageTableOffset;
+
+			std::vector<TBVHNode> residentNodes;
+			std::vector<TBVHPageFileEntry> entries;
+			if (valid)
+			{
+				residentNodes.resize(header.numResidentNodes);
+				entries.resize(header.numPages);
+				file.seekg((std::streamoff)header.residentOffset);
+				file.read((char*)residentNodes.data(), (std::streamsize)(residentNodes.size() * sizeof(TBVHNode)));
+				file.seekg((std::streamoff)header.pageTableOffset);
+				file.read((char*)entries.data(), (std::streamsize)(entries.size() * sizeof(TBVHPageFileEntry)));
+				valid = !file.fail();
+			}
+
+			// The resident nodes only reference each other and the pages, and every page lies in the file
+			for (uint32_t pageIdx = 0; valid && pageIdx < header.numPages; ++pageIdx)
+			{
+				const TBVHPageFileEntry& entry = entries[pageIdx];
+				valid = entry.numNodes > 0 && entry.size == page_size(entry.numNodes, entry.numGroups, header.groupSize) && entry.offset <= fileSize && entry.size <= fileSize - entry.offset;
+			}
+			for (uint32_t nodeIdx = 0; valid && nodeIdx < header.numResidentNodes; ++nodeIdx)
+			{
+				const TBVHNode& node = residentNodes[nodeIdx];
+				valid = node.count == BVH_PAGE_LEAF_COUNT ? node.leftFirst < header.numPages : node.count == 0 && node.leftFirst > nodeIdx && node.leftFirst + 1 < header.numResidentNodes;
+			}
+			if (!valid)
+			{
+				delete pageTable;
+				return nullptr;
+			}
+
+			std::vector<TBVHPage> pages(header.numPages);
+			pageTable->pages.swap(pages);
+			for (uint32_t pageIdx = 0; pageIdx < header.numPages; ++pageIdx)
+			{
+				TBVHPage& page = pageTable->pages[pageIdx];
+				page.offset = entries[pageIdx].offset;
+				page.size = entries[pageIdx].size;
+				page.numNodes = entries[pageIdx].numNodes;
+				page.numGroups = entries[pageIdx].numGroups;
+				page.state.store(0);
+				page.lastUse.store(0);
+			}
+			for (const TBVHNode& node : residentNodes)
+			{
+				if (node.count == BVH_PAGE_LEAF_COUNT)
+				{
+					pageTable->pages[node.leftFirst].leaf = node;
+				}
+			}
+
+			TBottomLevelAccelerationStructure* accelerationStructure = new TBottomLevelAccelerationStructure();
+			accelerationStructure->nodeFormat = BVHNodeFormat::Binary;
+			accelerationStructure->bounds = header.bounds;
+			accelerationStructure->opaque = geometry.opaque;
+			accelerationStructure->geometryType = geometry.type;
+			accelerationStructure->groupWidth = header.groupWidth;
+			accelerationStructure->groupSize = header.groupSize;
+			accelerationStructure->numGroups = header.numGroups;
+			accelerationStructure->allowUpdate = false;
+			switch (geometry.type)
+			{
+			case GeometryType::Triangles:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_triangles;
+				break;
+			case GeometryType::Spheres:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_spheres;
+				break;
+			case GeometryType::Boxes:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_boxes;
+				break;
+			case GeometryType::CustomPrimitives:
+				accelerationStructure->intersect_groups = nullptr;
+				break;
+			};
+
+			// Only the resident nodes are in memory, the groups are read with the pages
+			accelerationStructure->bvh.nodes.swap(residentNodes);
+			accelerationStructure->nodes = accelerationStructure->bvh.nodes.data();
+			accelerationStructure->wideNodes = nullptr;
+			accelerationStructure->primitiveIndices = nullptr;
+			accelerationStructure->groups = nullptr;
+			accelerationStructure->pageTable = pageTable;
+
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			cache.tables.push_back(pageTable);
+			return accelerationStructure;
+		}
+
+		TBottomLevelAccelerationStructure* create_paged_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, TTaskScheduler* taskScheduler, const char* directory, TBVHPageCache& cache)
+		{
+			if (geometry.allowUpdate || geometry.type == GeometryType::CustomPrimitives || directory == nullptr || directory[0] == '\0')
+			{
+				return create_cached_bottom_level_acceleration_structure(geometry, BVHNodeFormat::Binary, taskScheduler, directory);
+			}
+
+			// One file per key, named after it, the pages only exist for binary nodes
+			uint64_t key = bvh_cache_key(geometry, BVHNodeFormat::Binary);
+			char fileName[32];
+			snprintf(fileName, sizeof(fileName), "/%016llx.bvhp", (unsigned long long)key);
+			std::string path = std::string(directory) + fileName;
+
+			TBottomLevelAccelerationStructure* accelerationStructure = open_paged_bottom_level_acceleration_structure(geometry, key, path.c_str(), cache);
+			if (accelerationStructure != nullptr) return accelerationStructure;
+
+			// The file is written from a structure built in memory, which is released once its pages are on the disk
+			// A structure whose file cannot be written stays resident
+			accelerationStructure = create_bottom_level_acceleration_structure(geometry, BVHNodeFormat::Binary, taskScheduler);
+			if (!save_paged_bottom_level_acceleration_structure(*accelerationStructure, key, path.c_str())) return accelerationStructure;
+
+			TBottomLevelAccelerationStructure* pagedStructure = open_paged_bottom_level_acceleration_structure(geometry, key, path.c_str(), cache);
+			if (pagedStructure == nullptr) return accelerationStructure;
+			destroy_bottom_level_acceleration_structure(accelerationStructure);
+			return pagedStructure;
+		}
+
+		// Evict the least recently used pages that no traversal holds until size more bytes fit in the budget, called with the mutex of the cache held
+		// A page is only evicted if its state is exactly resident, a traversal pins it before it tests the residency
+		// The requested pages are pinned until their rays are traced, they only exceed the budget while the loads outrun the traversals
+		static void evict_bvh_pages(TBVHPageCache& cache, uint64_t size)
+		{
+			if (cache.residentBytes.load() + size <= cache.budget) return;
+
+			std::vector<std::pair<uint64_t, TBVHPage*>> candidates;
+			for (TBVHPageTable* pageTable : cache.tables)
+			{
+				for (TBVHPage& page : pageTable->pages)
+				{
+					if (page.state.load() == BVH_PAGE_RESIDENT)
+					{
+						candidates.push_back(std::make_pair(page.lastUse.load(), &page));
+					}
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const std::pair<uint64_t, TBVHPage*>& a, const std::pair<uint64_t, TBVHPage*>& b) { return a.first < b.first; });
+
+			for (const std::pair<uint64_t, TBVHPage*>& candidate : candidates)
+			{
+				if (cache.residentBytes.load() + size <= cache.budget) break;
+
+				TBVHPage& page = *candidate.second;
+				uint32_t expected = BVH_PAGE_RESIDENT;
+				if (page.state.compare_exchange_strong(expected, 0u))
+				{
+					cache.residentBytes.fetch_sub(page.size);
+					std::vector<uint8_t>().swap(page.data);
+				}
+			}
+		}
+
+		// Body of the loader thread, reads the requested pages one at a time and makes room for them in the budget
+		static void load_bvh_pages(TBVHPageCache* cache)
+		{
+			std::unique_lock<std::mutex> lock(cache->mutex);
+			while (true)
+			{
+				cache->requestCondition.wait(lock, [&]() { return cache->shutdown || !cache->requests.empty(); });
+				if (cache->shutdown) return;
+
+				// The table cannot be closed while one of its pages is read
+				TBVHPageTable* pageTable = cache->requests.front().first;
+				TBVHPage& page = pageTable->pages[cache->requests.front().second];
+				cache->requests.pop_front();
+				cache->loadingTable = pageTable;
+				lock.unlock();
+
+				std::vector<uint8_t> data((size_t)page.size);
+				std::ifstream& file = pageTable->file;
+				file.clear();
+				file.seekg((std::streamoff)page.offset);
+				file.read((char*)data.data(), (std::streamsize)page.size);
+				if (file.fail())
+				{
+					// A page that cannot be read becomes a subtree that no ray enters, the traversals waiting for it are not blocked
+					std::fill(data.begin(), data.end(), (uint8_t)0);
+					TBVHNode& root = *(TBVHNode*)data.data();
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						root.min[axis] = FLT_MAX;
+						root.max[axis] = -FLT_MAX;
+					}
+					root.count = 1;
+				}
+
+				lock.lock();
+				evict_bvh_pages(*cache, page.size);
+				page.data.swap(data);
+				cache->residentBytes.fetch_add(page.size);
+				cache->loadedBytes.fetch_add(page.size);
+				page.lastUse.store(cache->useClock.fetch_add(1) + 1);
+				page.state.fetch_xor(BVH_PAGE_RESIDENT | BVH_PAGE_REQUESTED);
+				cache->loadingTable = nullptr;
+				cache->loadedCondition.notify_all();
+			}
+		}
+
+		void init_bvh_page_cache(TBVHPageCache& cache, uint64_t budget)
+		{
+			cache.budget = budget;
+			cache.residentBytes.store(0);
+			cache.useClock.store(0);
+			cache.loadingTable = nullptr;
+			cache.shutdown = false;
+			cache.pageHits.store(0);
+			cache.pageMisses.store(0);
+			cache.deferredRays.store(0);
+			cache.stallNanoseconds.store(0);
+			cache.loadedBytes.store(0);
+			cache.loader = std::thread(load_bvh_pages, &cache);
+		}
+
+		void destroy_bvh_page_cache(TBVHPageCache& cache)
+		{
+			{
+				std::lock_guard<std::mutex> lock(cache.mutex);
+				assert(cache.tables.empty());
+				cache.shutdown = true;
+			}
+			cache.requestCondition.notify_all();
+			cache.loader.join();
+		}
+
+		void collect_bvh_page_statistics(TBVHPageCache& cache, TBVHPageStatistics& statistics)
+		{
+			statistics.pageHits = cache.pageHits.exchange(0);
+			statistics.pageMisses = cache.pageMisses.exchange(0);
+			statistics.deferredRays = cache.deferredRays.exchange(0);
+			statistics.stallTime = cache.stallNanoseconds.exchange(0) / 1000000.0;
+			statistics.loadedBytes = cache.loadedBytes.exchange(0);
+			statistics.residentBytes = cache.residentBytes.load();
+		}
+
+		void close_bvh_page_table(TBVHPageTable* pageTable)
+		{
+			TBVHPageCache& cache = *pageTable->cache;
+			{
+				std::unique_lock<std::mutex> lock(cache.mutex);
+				cache.loadedCondition.wait(lock, [&]() { return cache.loadingTable != pageTable; });
+				cache.tables.erase(std::remove(cache.tables.begin(), cache.tables.end(), pageTable), cache.tables.end());
+				cache.requests.erase(std::remove_if(cache.requests.begin(), cache.requests.end(), [&](const std::pair<TBVHPageTable*, uint32_t>& request) { return request.first == pageTable; }), cache.requests.end());
+				for (TBVHPage& page : pageTable->pages)
+				{
+					if (page.state.load() & BVH_PAGE_RESIDENT)
+					{
+						cache.residentBytes.fetch_sub(page.size);
+					}
+				}
+			}
+			delete pageTable;
+		}
+
+		// Pin a page and return true if it is resident, every read advances the clock so that the eviction follows the order of the reads
+		static inline bool pin_bvh_page(TBVHPageCache& cache, TBVHPage& page)
+		{
+			if ((page.state.fetch_add(1) & BVH_PAGE_RESIDENT) == 0)
+			{
+				page.state.fetch_sub(1);
+				return false;
+			}
+
+			page.lastUse.store(cache.useClock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Set the requested bit of a page that is neither resident nor requested, returns true if the caller has to queue the request
+		static inline bool mark_bvh_page_requested(TBVHPage& page)
+		{
+			uint32_t state = page.state.load();
+			while ((state & (BVH_PAGE_RESIDENT | BVH_PAGE_REQUESTED)) == 0)
+			{
+				if (page.state.compare_exchange_weak(state, state | BVH_PAGE_REQUESTED)) return true;
+			}
+			return false;
+		}
+
+		const uint8_t* acquire_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex)
+		{
+			TBVHPage& page = pageTable.pages[pageIndex];
+			TBVHPageCache& cache = *pageTable.cache;
+			if (pin_bvh_page(cache, page))
+			{
+				cache.pageHits.fetch_add(1, std::memory_order_relaxed);
+				return page.data.data();
+			}
+
+			cache.pageMisses.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		void request_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex)
+		{
+			TBVHPage& page = pageTable.pages[pageIndex];
+			TBVHPageCache& cache = *pageTable.cache;
+			page.state.fetch_add(1);
+			if (mark_bvh_page_requested(page))
+			{
+				std::lock_guard<std::mutex> lock(cache.mutex);
+				cache.requests.push_back(std::make_pair(&pageTable, pageIndex));
+				cache.requestCondition.notify_one();
+			}
+		}
+
+		const uint8_t* try_acquire_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex)
+		{
+			TBVHPage& page = pageTable.pages[pageIndex];
+			return pin_bvh_page(*pageTable.cache, page) ? page.data.data() : nullptr;
+		}
+
+		const uint8_t* wait_for_bvh_page(TBVHPageTable& pageTable, uint32_t pageIndex)
+		{
+			TBVHPage& page = pageTable.pages[pageIndex];
+			TBVHPageCache& cache = *pageTable.cache;
+			if ((page.state.load() & BVH_PAGE_RESIDENT) == 0)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				{
+					std::unique_lock<std::mutex> lock(cache.mutex);
+					cache.loadedCondition.wait(lock, [&]() { return (page.state.load() & BVH_PAGE_RESIDENT) != 0; });
+				}
+				cache.stallNanoseconds.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+			}
+
+			page.lastUse.store(cache.useClock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return page.data.data();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,442 @@
+// Internal includes
+#include "bvh_refit.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+
+namespace dxr_demo
+{
+	// Number of nodes of the chunks the refit is distributed by
+	#define BVH_REFIT_CHUNK_SIZE 4096
+
+	static inline float half_area(const TBVHNode& node)
+	{
+		float extent[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			extent[axis] = std::max(node.max[axis] - node.min[axis], 0.0f);
+		}
+		return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+	}
+
+	static inline float node_cost(const TBVHNode& node, uint32_t count)
+	{
+		return half_area(node) * (count == 0 ? BVH_TRAVERSAL_COST : count * BVH_INTERSECTION_COST);
+	}
+
+	// Number of items the primitives of a leaf are packed in
+	static inline uint32_t leaf_items(uint32_t numPrimitives, uint32_t itemWidth)
+	{
+		return (numPrimitives + itemWidth - 1) / itemWidth;
+	}
+
+	// Node of a pair that a rebuilt subtree does not use, nothing references it and its bounds are empty
+	static inline void clear_node(TBVHNode& node)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			node.min[axis] = 0.0f;
+			node.max[axis] = 0.0f;
+		}
+		node.leftFirst = 0;
+		node.count = 0;
+	}
+
+	void prepare_bvh_refit(const TBVH& bvh, const uint32_t* items, uint32_t numItems, uint32_t itemWidth, TBVHRefitState& state)
+	{
+		uint32_t numNodes = (uint32_t)bvh.nodes.size();
+		state.parents.assign(numNodes, 0);
+		state.visits.reset(new std::atomic<uint32_t>[numNodes]);
+		state.costs.resize(numNodes);
+		state.itemWidth = std::max(1u, itemWidth);
+		state.items.assign(items, items + (size_t)numItems * state.itemWidth);
+		state.subtrees.clear();
+		state.rebuildThreshold = BVH_REFIT_REBUILD_THRESHOLD;
+
+		// Children are allocated after their parent, going through the nodes backward reaches the children first
+		std::vector<uint32_t> leafCounts(numNodes);
+		for (uint32_t nodeIdx = numNodes; nodeIdx-- > 0;)
+		{
+			const TBVHNode& node = bvh.nodes[nodeIdx];
+			state.visits[nodeIdx].store(0, std::memory_order_relaxed);
+			if (node.count != 0 || numNodes == 1)
+			{
+				leafCounts[nodeIdx] = 1;
+				state.costs[nodeIdx] = node_cost(node, node.count);
+				continue;
+			}
+
+			uint32_t leftIdx = node.leftFirst;
+			state.parents[leftIdx] = nodeIdx;
+			state.parents[leftIdx + 1] = nodeIdx;
+			leafCounts[nodeIdx] = leafCounts[leftIdx] + leafCounts[leftIdx + 1];
+			state.costs[nodeIdx] = node_cost(node, 0) + state.costs[leftIdx] + state.costs[leftIdx + 1];
+		}
+		state.referenceCosts = state.costs;
+
+		// Going through the nodes forward reaches the parents first
+		std::vector<uint32_t> depths(numNodes, 0);
+		for (uint32_t nodeIdx = 1; nodeIdx < numNodes; ++nodeIdx)
+		{
+			depths[nodeIdx] = depths[state.parents[nodeIdx]] + 1;
+		}
+
+		// The largest subtrees under the size limit, they own the pairs of nodes and the items under their root
+		std::vector<uint32_t> stack;
+		for (uint32_t nodeIdx = 0; nodeIdx < numNodes; ++nodeIdx)
+		{
+			if (leafCounts[nodeIdx] > BVH_REFIT_SUBTREE_MAX_LEAVES) continue;
+			if (nodeIdx != 0 && leafCounts[state.parents[nodeIdx]] <= BVH_REFIT_SUBTREE_MAX_LEAVES) continue;
+
+			TBVHRefitSubtree subtree;
+			subtree.root = nodeIdx;
+			subtree.depth = depths[nodeIdx];
+			subtree.firstItem = UINT32_MAX;
+			subtree.numItems = 0;
+			uint32_t lastItem = 0;
+			stack.assign(1, nodeIdx);
+			while (!stack.empty())
+			{
+				const TBVHNode& node = bvh.nodes[stack.back()];
+				stack.pop_back();
+				if (node.count != 0 || numNodes == 1)
+				{
+					subtree.firstItem = std::min(subtree.firstItem, node.leftFirst);
+					subtree.numItems += node.count;
+					lastItem = std::max(lastItem, node.leftFirst + node.count);
+					continue;
+				}
+				subtree.pairs.push_back(node.leftFirst);
+				stack.push_back(node.leftFirst);
+				stack.push_back(node.leftFirst + 1);
+			}
+			assert(lastItem - subtree.firstItem == subtree.numItems);
+			std::sort(subtree.pairs.begin(), subtree.pairs.end());
+			state.subtrees.push_back(std::move(subtree));
+		}
+	}
+
+	// Build a new topology for a subtree from its primitives, it is kept if it has a lower cost than the refit one
+	// The leaves that cost the least to merge with their sibling are merged until the topology fits in the pairs of nodes and the items of the subtree
+	// Returns the number of nodes that were rewritten and the cost they removed
+	static uint32_t rebuild_subtree(TBVH& bvh, TBVHRefitState& state, TBVHSubtreeScratch& scratch, const TBVHRefitSubtree& subtree, float& gain)
+	{
+		// Gather the primitives of the items of the subtree
+		uint32_t itemWidth = state.itemWidth;
+		uint32_t* items = state.items.data();
+		scratch.primitives.clear();
+		scratch.bounds.clear();
+		for (uint32_t slotIdx = subtree.firstItem * itemWidth; slotIdx < (subtree.firstItem + subtree.numItems) * itemWidth; ++slotIdx)
+		{
+			if (items[slotIdx] == BVH_REFIT_INVALID_PRIMITIVE) continue;
+			scratch.primitives.push_back(items[slotIdx]);
+			scratch.bounds.push_back(state.primitiveBounds[items[slotIdx]]);
+		}
+
+		// The subtree is a single task of a larger update, it is built on the calling thread
+		build_bvh(scratch.bounds.data(), (uint32_t)scratch.bounds.size(), scratch.bvh, nullptr, itemWidth, BVH_MAX_DEPTH - subtree.depth);
+		TBVHNode* newNodes = scratch.bvh.nodes.data();
+		uint32_t numNewNodes = (uint32_t)scratch.bvh.nodes.size();
+		uint32_t numLeaves = 0;
+		uint32_t numNewItems = 0;
+		scratch.costs.resize(numNewNodes);
+		for (uint32_t nodeIdx = numNewNodes; nodeIdx-- > 0;)
+		{
+			const TBVHNode& node = newNodes[nodeIdx];
+			if (node.count != 0)
+			{
+				numLeaves++;
+				numNewItems += leaf_items(node.count, itemWidth);
+				scratch.costs[nodeIdx] = node_cost(node, leaf_items(node.count, itemWidth));
+				continue;
+			}
+			scratch.costs[nodeIdx] = node_cost(node, 0) + scratch.costs[node.leftFirst] + scratch.costs[node.leftFirst + 1];
+		}
+
+		// The primitives of two sibling leaves are next to each other, merging them turns their parent into a leaf
+		// The nodes under a merged one are left behind, they are leaves and never merged again
+		while (numLeaves - 1 > subtree.pairs.size() || numNewItems > subtree.numItems)
+		{
+			uint32_t bestIdx = UINT32_MAX;
+			float bestIncrease = FLT_MAX;
+			for (uint32_t nodeIdx = 0; nodeIdx < numNewNodes; ++nodeIdx)
+			{
+				const TBVHNode& node = newNodes[nodeIdx];
+				if (node.count != 0 || newNodes[node.leftFirst].count == 0 || newNodes[node.leftFirst + 1].count == 0) continue;
+				float increase = node_cost(node, leaf_items(newNodes[node.leftFirst].count + newNodes[node.leftFirst + 1].count, itemWidth)) - scratch.costs[nodeIdx];
+				if (increase < bestIncrease)
+				{
+					bestIncrease = increase;
+					bestIdx = nodeIdx;
+				}
+			}
+
+			assert(bestIdx != UINT32_MAX);
+			TBVHNode& node = newNodes[bestIdx];
+			uint32_t leftCount = newNodes[node.leftFirst].count;
+			uint32_t rightCount = newNodes[node.leftFirst + 1].count;
+			numLeaves--;
+			numNewItems -= leaf_items(leftCount, itemWidth) + leaf_items(rightCount, itemWidth) - leaf_items(leftCount + rightCount, itemWidth);
+			node.leftFirst = newNodes[node.leftFirst].leftFirst;
+			node.count = leftCount + rightCount;
+			scratch.costs[bestIdx] += bestIncrease;
+		}
+
+		// The merges made the costs of the ancestors of the merged nodes stale
+		for (uint32_t nodeIdx = numNewNodes; nodeIdx-- > 0;)
+		{
+			const TBVHNode& node = newNodes[nodeIdx];
+			if (node.count != 0) continue;
+			scratch.costs[nodeIdx] = node_cost(node, 0) + scratch.costs[node.leftFirst] + scratch.costs[node.leftFirst + 1];
+		}
+
+		// Whatever topology is kept becomes the reference the next updates compare against
+		float refitCost = state.costs[subtree.root];
+		float cost = scratch.costs[0];
+		gain = 0.0f;
+		if (cost >= refitCost)
+		{
+			state.referenceCosts[subtree.root] = refitCost;
+			return 0;
+		}
+		gain = refitCost - cost;
+		state.referenceCosts[subtree.root] = cost;
+
+		// The nodes are written depth first, every pair goes to the lowest pair of the subtree left, which keeps the children of every node after it
+		TBVHNode* nodes = bvh.nodes.data();
+		uint32_t pairIdx = 0;
+		uint32_t itemIdx = subtree.firstItem;
+		scratch.stack.assign(1, 0);
+		scratch.stack.push_back(subtree.root);
+		while (!scratch.stack.empty())
+		{
+			uint32_t nodeIdx = scratch.stack.back();
+			scratch.stack.pop_back();
+			uint32_t subtreeNodeIdx = scratch.stack.back();
+			scratch.stack.pop_back();
+			const TBVHNode& node = newNodes[subtreeNodeIdx];
+			nodes[nodeIdx] = node;
+			state.costs[nodeIdx] = scratch.costs[subtreeNodeIdx];
+			if (node.count != 0)
+			{
+				// The primitives of the leaf fill its items, the last one is padded
+				uint32_t numLeafItems = leaf_items(node.count, itemWidth);
+				uint32_t* slots = items + (size_t)itemIdx * itemWidth;
+				for (uint32_t slotIdx = 0; slotIdx < numLeafItems * itemWidth; ++slotIdx)
+				{
+					slots[slotIdx] = slotIdx < node.count ? scratch.primitives[scratch.bvh.primitiveIndices[node.leftFirst + slotIdx]] : BVH_REFIT_INVALID_PRIMITIVE;
+				}
+				nodes[nodeIdx].leftFirst = itemIdx;
+				nodes[nodeIdx].count = numLeafItems;
+				itemIdx += numLeafItems;
+				continue;
+			}
+
+			uint32_t leftIdx = subtree.pairs[pairIdx++];
+			nodes[nodeIdx].leftFirst = leftIdx;
+			state.parents[leftIdx] = nodeIdx;
+			state.parents[leftIdx + 1] = nodeIdx;
+			scratch.stack.push_back(node.leftFirst + 1);
+			scratch.stack.push_back(leftIdx + 1);
+			scratch.stack.push_back(node.leftFirst);
+			scratch.stack.push_back(leftIdx);
+		}
+
+		// The items and the pairs the new topology does not use stay with the subtree for its next rebuild
+		std::fill(items + (size_t)itemIdx * itemWidth, items + (size_t)(subtree.firstItem + subtree.numItems) * itemWidth, BVH_REFIT_INVALID_PRIMITIVE);
+		for (uint32_t unusedIdx = pairIdx; unusedIdx < (uint32_t)subtree.pairs.size(); ++unusedIdx)
+		{
+			clear_node(nodes[subtree.pairs[unusedIdx]]);
+			clear_node(nodes[subtree.pairs[unusedIdx] + 1]);
+		}
+		return 2 * pairIdx + 1;
+	}
+
+	void refit_bvh(TBVH& bvh, TBVHRefitState& state, TTaskScheduler* taskScheduler, TBVHRefitStatistics& statistics)
+	{
+		statistics = TBVHRefitStatistics();
+		uint32_t numNodes = (uint32_t)bvh.nodes.size();
+		if (numNodes <= 1)
+		{
+			statistics.sahCost = bvh_sah_cost(bvh);
+			return;
+		}
+
+		// Every leaf walks up as long as it is the second child to reach a node, which then sees the bounds of both children
+		TBVHNode* nodes = bvh.nodes.data();
+		uint32_t numChunks = (numNodes + BVH_REFIT_CHUNK_SIZE - 1) / BVH_REFIT_CHUNK_SIZE;
+		auto refit_chunk = [&](uint32_t chunkIdx, uint32_t)
+		{
+			uint32_t first = chunkIdx * BVH_REFIT_CHUNK_SIZE;
+			uint32_t last = std::min(first + BVH_REFIT_CHUNK_SIZE, numNodes);
+			for (uint32_t leafIdx = first; leafIdx < last; ++leafIdx)
+			{
+				if (nodes[leafIdx].count == 0) continue;
+				state.costs[leafIdx] = node_cost(nodes[leafIdx], nodes[leafIdx].count);
+
+				uint32_t childIdx = leafIdx;
+				while (childIdx != 0)
+				{
+					uint32_t parentIdx = state.parents[childIdx];
+					if ((state.visits[parentIdx].fetch_add(1, std::memory_order_acq_rel) & 1) == 0) break;
+
+					TBVHNode& parent = nodes[parentIdx];
+					const TBVHNode& left = nodes[parent.leftFirst];
+					const TBVHNode& right = nodes[parent.leftFirst + 1];
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						parent.min[axis] = std::min(left.min[axis], right.min[axis]);
+						parent.max[axis] = std::max(left.max[axis], right.max[axis]);
+					}
+					state.costs[parentIdx] = node_cost(parent, 0) + state.costs[parent.leftFirst] + state.costs[parent.leftFirst + 1];
+					childIdx = parentIdx;
+				}
+			}
+		};
+		if (taskScheduler && numChunks > 1)
+		{
+			taskScheduler->parallel_for(numChunks, refit_chunk);
+		}
+		else
+		{
+			for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+			{
+				refit_chunk(chunkIdx, 0);
+			}
+		}
+		statistics.refitNodes = (numNodes - 1) / 2;
+		float refitCost = state.costs[0];
+
+		// Compare every subtree with the cost of its topology when it was picked
+		state.degradedSubtrees.clear();
+		for (uint32_t subtreeIdx = 0; subtreeIdx < (uint32_t)state.subtrees.size(); ++subtreeIdx)
+		{
+			uint32_t rootIdx = state.subtrees[subtreeIdx].root;
+			if (state.costs[rootIdx] > state.referenceCosts[rootIdx] * state.rebuildThreshold)
+			{
+				state.degradedSubtrees.push_back(subtreeIdx);
+			}
+		}
+
+		// The degraded subtrees are disjoint, they are rebuilt by independent tasks
+		uint32_t numDegraded = (uint32_t)state.degradedSubtrees.size();
+		state.rebuiltNodes.resize(numDegraded);
+		state.rebuildGains.resize(numDegraded);
+		state.scratch.resize(taskScheduler ? taskScheduler->num_threads() : 1);
+		auto rebuild = [&](uint32_t degradedIdx, uint32_t threadIdx)
+		{
+			state.rebuiltNodes[degradedIdx] = rebuild_subtree(bvh, state, state.scratch[threadIdx], state.subtrees[state.degradedSubtrees[degradedIdx]], state.rebuildGains[degradedIdx]);
+		};
+		if (taskScheduler && numDegraded > 1)
+		{
+			taskScheduler->parallel_for(numDegraded, rebuild);
+		}
+		else
+		{
+			for (uint32_t degradedIdx = 0; degradedIdx < numDegraded; ++degradedIdx)
+			{
+				rebuild(degradedIdx, 0);
+			}
+		}
+		state.rebuiltItemRanges.clear();
+		for (uint32_t degradedIdx = 0; degradedIdx < numDegraded; ++degradedIdx)
+		{
+			if (state.rebuiltNodes[degradedIdx] == 0) continue;
+			const TBVHRefitSubtree& subtree = state.subtrees[state.degradedSubtrees[degradedIdx]];
+			state.rebuiltItemRanges.push_back(subtree.firstItem);
+			state.rebuiltItemRanges.push_back(subtree.numItems);
+		}
+
+		// A rebuild keeps the primitives of a subtree, the ones that moved to its sibling leave their parent degraded
+		// The right child of a parent is next to the left one, the subtrees rooted at a right child are found by their root
+		std::vector<uint32_t> rightSubtrees(numNodes, UINT32_MAX);
+		for (uint32_t subtreeIdx = 0; subtreeIdx < (uint32_t)state.subtrees.size(); ++subtreeIdx)
+		{
+			uint32_t rootIdx = state.subtrees[subtreeIdx].root;
+			if (rootIdx != 0 && nodes[state.parents[rootIdx]].leftFirst != rootIdx)
+			{
+				rightSubtrees[rootIdx] = subtreeIdx;
+			}
+		}
+		state.degradedParents.clear();
+		for (uint32_t leftSubtreeIdx = 0; leftSubtreeIdx < (uint32_t)state.subtrees.size(); ++leftSubtreeIdx)
+		{
+			const TBVHRefitSubtree& left = state.subtrees[leftSubtreeIdx];
+			if (left.root == 0 || rightSubtrees[left.root] != UINT32_MAX || rightSubtrees[left.root + 1] == UINT32_MAX) continue;
+			uint32_t rightSubtreeIdx = rightSubtrees[left.root + 1];
+			const TBVHRefitSubtree& right = state.subtrees[rightSubtreeIdx];
+			if (left.pairs.size() + right.pairs.size() + 2 > BVH_REFIT_MERGE_MAX_LEAVES) continue;
+
+			// The cost of the parent is recomputed over the ones of the rebuilt subtrees
+			uint32_t parentIdx = state.parents[left.root];
+			state.costs[parentIdx] = node_cost(nodes[parentIdx], 0) + state.costs[left.root] + state.costs[right.root];
+			if (state.costs[parentIdx] > state.referenceCosts[parentIdx] * state.rebuildThreshold)
+			{
+				state.degradedParents.push_back(leftSubtreeIdx);
+				state.degradedParents.push_back(rightSubtreeIdx);
+			}
+		}
+		uint32_t numMerges = (uint32_t)state.degradedParents.size() / 2;
+
+		// The parent is rebuilt with the primitives of both subtrees, that become a single one if it is worth it
+		state.rebuiltNodes.resize(numDegraded + numMerges);
+		state.rebuildGains.resize(numDegraded + numMerges);
+		auto merge = [&](uint32_t mergeIdx, uint32_t threadIdx)
+		{
+			TBVHRefitSubtree& left = state.subtrees[state.degradedParents[2 * mergeIdx]];
+			TBVHRefitSubtree& right = state.subtrees[state.degradedParents[2 * mergeIdx + 1]];
+			TBVHRefitSubtree merged;
+			merged.root = state.parents[left.root];
+			merged.depth = left.depth - 1;
+			merged.pairs.reserve(left.pairs.size() + right.pairs.size() + 1);
+			merged.pairs.push_back(left.root);
+			merged.pairs.insert(merged.pairs.end(), left.pairs.begin(), left.pairs.end());
+			merged.pairs.insert(merged.pairs.end(), right.pairs.begin(), right.pairs.end());
+			std::sort(merged.pairs.begin(), merged.pairs.end());
+			merged.firstItem = std::min(left.firstItem, right.firstItem);
+			merged.numItems = left.numItems + right.numItems;
+			assert(std::max(left.firstItem, right.firstItem) == merged.firstItem + (left.firstItem < right.firstItem ? left.numItems : right.numItems));
+
+			uint32_t rebuiltIdx = numDegraded + mergeIdx;
+			state.rebuiltNodes[rebuiltIdx] = rebuild_subtree(bvh, state, state.scratch[threadIdx], merged, state.rebuildGains[rebuiltIdx]);
+			if (state.rebuiltNodes[rebuiltIdx] > 0)
+			{
+				left = std::move(merged);
+				right.root = UINT32_MAX;
+			}
+		};
+		if (taskScheduler && numMerges > 1)
+		{
+			taskScheduler->parallel_for(numMerges, merge);
+		}
+		else
+		{
+			for (uint32_t mergeIdx = 0; mergeIdx < numMerges; ++mergeIdx)
+			{
+				merge(mergeIdx, 0);
+			}
+		}
+		for (uint32_t mergeIdx = 0; mergeIdx < numMerges; ++mergeIdx)
+		{
+			if (state.rebuiltNodes[numDegraded + mergeIdx] == 0) continue;
+			const TBVHRefitSubtree& subtree = state.subtrees[state.degradedParents[2 * mergeIdx]];
+			state.rebuiltItemRanges.push_back(subtree.firstItem);
+			state.rebuiltItemRanges.push_back(subtree.numItems);
+			statistics.mergedSubtrees++;
+		}
+		state.subtrees.erase(std::remove_if(state.subtrees.begin(), state.subtrees.end(), [](const TBVHRefitSubtree& subtree) { return subtree.root == UINT32_MAX; }), state.subtrees.end());
+
+		// The costs of the subtrees add up, the ancestors of a rebuilt one lose what it gained
+		float cost = refitCost;
+		for (uint32_t rebuiltIdx = 0; rebuiltIdx < numDegraded + numMerges; ++rebuiltIdx)
+		{
+			statistics.rebuiltNodes += state.rebuiltNodes[rebuiltIdx];
+			statistics.rebuiltSubtrees += rebuiltIdx < numDegraded && state.rebuiltNodes[rebuiltIdx] > 0 ? 1 : 0;
+			cost -= state.rebuildGains[rebuiltIdx];
+		}
+		statistics.sahCost = cost / std::max(half_area(nodes[0]), FLT_MIN);
+	}
+}
\ No newline at end of file
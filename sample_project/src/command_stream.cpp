@@ -0,0 +1,234 @@
+// Internal includes
+#include "command_stream.h"
+
+// External includes
+#include <assert.h>
+
+namespace dxr_demo
+{
+	void init_frame_arena(TFrameArena& arena, uint32_t blockSize)
+	{
+		arena.blocks.clear();
+		arena.blockSize = blockSize;
+		arena.currentBlock = 0;
+		arena.offset = 0;
+	}
+
+	void destroy_frame_arena(TFrameArena& arena)
+	{
+		for (uint8_t* block : arena.blocks)
+		{
+			delete [] block;
+		}
+		arena.blocks.clear();
+		arena.currentBlock = 0;
+		arena.offset = 0;
+	}
+
+	void reset_frame_arena(TFrameArena& arena)
+	{
+		arena.currentBlock = 0;
+		arena.offset = 0;
+	}
+
+	void* allocate_from_frame_arena(TFrameArena& arena, uint32_t size, uint32_t alignment)
+	{
+		assert(size + alignment <= arena.blockSize);
+
+		// Move to the next block when the allocation does not fit in the current one, new blocks are only allocated the first time a frame needs them
+		uint32_t offset = (arena.offset + alignment - 1) & ~(alignment - 1);
+		if (arena.currentBlock < arena.blocks.size() && offset + size > arena.blockSize)
+		{
+			arena.currentBlock++;
+			offset = 0;
+		}
+		if (arena.currentBlock == arena.blocks.size())
+		{
+			arena.blocks.push_back(new uint8_t[arena.blockSize]);
+			offset = 0;
+		}
+
+		// The blocks come from new, which aligns them for any type
+		arena.offset = offset + size;
+		return arena.blocks[arena.currentBlock] + offset;
+	}
+
+	void init_command_stream(TCommandStream& stream, uint32_t blockSize)
+	{
+		init_frame_arena(stream.arena, blockSize);
+		stream.first = nullptr;
+		stream.last = nullptr;
+		stream.numCommands = 0;
+	}
+
+	void destroy_command_stream(TCommandStream& stream)
+	{
+		destroy_frame_arena(stream.arena);
+		stream.first = nullptr;
+		stream.last = nullptr;
+		stream.numCommands = 0;
+	}
+
+	void reset_command_stream(TCommandStream& stream)
+	{
+		reset_frame_arena(stream.arena);
+		stream.first = nullptr;
+		stream.last = nullptr;
+		stream.numCommands = 0;
+	}
+
+	// Allocate a command at the end of the stream, its payload is filled by the caller. Every command starts with its header
+	template<typename TCommand>
+	TCommand* push_command(TCommandStream& stream, CommandType::Type type, uint32_t size = sizeof(TCommand))
+	{
+		TCommand* command = (TCommand*)allocate_from_frame_arena(stream.arena, size, alignof(TCommand));
+		TCommandHeader* header = (TCommandHeader*)command;
+		header->type = type;
+		header->next = nullptr;
+		if (stream.last)
+		{
+			stream.last->next = header;
+		}
+		else
+		{
+			stream.first = header;
+		}
+		stream.last = header;
+		stream.numCommands++;
+		return command;
+	}
+
+	void record_clear(TCommandStream& stream, Framebuffer frameBuffer, const float* color)
+	{
+		TClearCommand* command = push_command<TClearCommand>(stream, CommandType::Clear);
+		command->target.frameBuffer = frameBuffer;
+		for (uint32_t channelIdx = 0; channelIdx < 4; ++channelIdx)
+		{
+			command->color[channelIdx] = color[channelIdx];
+		}
+	}
+
+	void record_barrier(TCommandStream& stream, const TResourceTransition* transitions, uint32_t numTransitions)
+	{
+		// A batch that does not fit in a block of the arena is split over consecutive barriers, the backends issue them in order like a single one
+		uint32_t maxTransitions = (uint32_t)((stream.arena.blockSize - alignof(TBarrierCommand) - sizeof(TBarrierCommand)) / sizeof(TResourceTransition) + 1);
+		do
+		{
+			uint32_t count = numTransitions < maxTransitions ? numTransitions : maxTransitions;
+			uint32_t size = (uint32_t)(sizeof(TBarrierCommand) + (count > 1 ? count - 1 : 0) * sizeof(TResourceTransition));
+			TBarrierCommand* command = push_command<TBarrierCommand>(stream, CommandType::Barrier, size);
+			command->numTransitions = count;
+			for (uint32_t transitionIdx = 0; transitionIdx < count; ++transitionIdx)
+			{
+				command->transitions[transitionIdx] = transitions[transitionIdx];
+			}
+			transitions += count;
+			numTransitions -= count;
+		} while (numTransitions > 0);
+	}
+
+	void record_dispatch_rays(TCommandStream& stream, Framebuffer frameBuffer, TopLevelAccelerationStructure accelerationStructure, const TRayTracingPipeline& pipeline)
+	{
+		TDispatchRaysCommand* command = push_command<TDispatchRaysCommand>(stream, CommandType::DispatchRays);
+		command->target.frameBuffer = frameBuffer;
+		command->accelerationStructure = accelerationStructure;
+		command->pipeline = pipeline;
+	}
+
+	void record_trace_paths(TCommandStream& stream, Framebuffer frameBuffer, TopLevelAccelerationStructure accelerationStructure, const TPathTracingPipeline& pipeline)
+	{
+		TTracePathsCommand* command = push_command<TTracePathsCommand>(stream, CommandType::TracePaths);
+		command->target.frameBuffer = frameBuffer;
+		command->accelerationStructure = accelerationStructure;
+		command->pipeline = pipeline;
+	}
+
+	// What the merge knows about a frame buffer: its state if a barrier set it this frame, and the clear that nothing used yet
+	struct TTrackedTarget
+	{
+		Framebuffer frameBuffer;
+		bool stateKnown;
+		ResourceState::Type state;
+		TClearCommand* pendingClear;
+	};
+
+	// Target of the merge for a frame buffer, null once every slot is taken by others
+	static TTrackedTarget* tracked_target(TTrackedTarget* targets, uint32_t& numTargets, Framebuffer frameBuffer)
+	{
+		for (uint32_t targetIdx = 0; targetIdx < numTargets; ++targetIdx)
+		{
+			if (targets[targetIdx].frameBuffer == frameBuffer) return &targets[targetIdx];
+		}
+		if (numTargets == COMMAND_STREAM_MAX_TRACKED_TARGETS) return nullptr;
+		TTrackedTarget* target = &targets[numTargets++];
+		target->frameBuffer = frameBuffer;
+		target->stateKnown = false;
+		target->pendingClear = nullptr;
+		return target;
+	}
+
+	uint32_t merge_command_streams(TCommandStream* const* streams, uint32_t numStreams)
+	{
+		TTrackedTarget targets[COMMAND_STREAM_MAX_TRACKED_TARGETS];
+		uint32_t numTargets = 0;
+		uint32_t numSkipped = 0;
+		for (uint32_t streamIdx = 0; streamIdx < numStreams; ++streamIdx)
+		{
+			for (TCommandHeader* command = streams[streamIdx]->first; command != nullptr; command = command->next)
+			{
+				if (command->type == CommandType::Skipped) continue;
+
+				// A barrier does not use the content of the frame buffers, only their state. The transitions that have no effect are removed from the batch
+				if (command->type == CommandType::Barrier)
+				{
+					TBarrierCommand* barrier = (TBarrierCommand*)command;
+					uint32_t numTransitions = 0;
+					for (uint32_t transitionIdx = 0; transitionIdx < barrier->numTransitions; ++transitionIdx)
+					{
+						const TResourceTransition& transition = barrier->transitions[transitionIdx];
+						TTrackedTarget* target = tracked_target(targets, numTargets, transition.frameBuffer);
+						if (target && target->stateKnown && target->state == transition.after) continue;
+						if (target)
+						{
+							target->stateKnown = true;
+							target->state = transition.after;
+						}
+						barrier->transitions[numTransitions++] = transition;
+					}
+					numSkipped += barrier->numTransitions - numTransitions;
+					barrier->numTransitions = numTransitions;
+					command->type = numTransitions == 0 ? CommandType::Skipped : command->type;
+					continue;
+				}
+
+				// The other commands write a single frame buffer, they start with a target header
+				TTrackedTarget* target = tracked_target(targets, numTargets, ((const TTargetCommandHeader*)command)->frameBuffer);
+				if (target == nullptr) continue;
+				switch (command->type)
+				{
+					case CommandType::Clear:
+					{
+						// The previous clear is overwritten before anything read it
+						if (target->pendingClear)
+						{
+							target->pendingClear->target.header.type = CommandType::Skipped;
+							numSkipped++;
+						}
+						target->pendingClear = (TClearCommand*)command;
+					}
+					break;
+					case CommandType::DispatchRays:
+					case CommandType::TracePaths:
+					{
+						// The rays may leave pixels untouched, the clear that came before is kept
+						target->pendingClear = nullptr;
+					}
+					break;
+					default:
+					break;
+				};
+			}
+		}
+		return numSkipped;
+	}
+}
\ No newline at end of file
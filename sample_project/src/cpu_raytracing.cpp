@@ -0,0 +1,1615 @@
+// Internal includes
+#include "bvh_paging.h"
+#include "cpu_raytracing.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace dxr_demo
+{
+	namespace cpu_raytracing
+	{
+		// A binary descent pushes at most one node per level, the builders keep every leaf within BVH_MAX_DEPTH
+		#define TRAVERSAL_STACK_SIZE BVH_MAX_DEPTH
+
+		// A wide node pushes up to 7 entries for every level it descends
+		#define WIDE_TRAVERSAL_STACK_SIZE (TRAVERSAL_STACK_SIZE * (BVH8_WIDTH - 1))
+		static inline void sub(const float* a, const float* b, float* result)
+		{
+			result[0] = a[0] - b[0];
+			result[1] = a[1] - b[1];
+			result[2] = a[2] - b[2];
+		}
+
+		// Number of primitives processed by a task when the input is prepared in parallel
+		#define PRIMITIVE_CHUNK_SIZE 16384
+
+		static inline const float* vertex_position(const TGeometryDescriptor& geometry, uint32_t index)
+		{
+			return (const float*)((const char*)geometry.vertexBuffer + (size_t)geometry.indexBuffer[index] * geometry.vertexStride);
+		}
+
+		template<typename TFunctor>
+		static void for_each_chunk(TTaskScheduler* taskScheduler, uint32_t count, const TFunctor& functor)
+		{
+			uint32_t numChunks = (count + PRIMITIVE_CHUNK_SIZE - 1) / PRIMITIVE_CHUNK_SIZE;
+			auto process_chunk = [&](uint32_t chunkIdx, uint32_t)
+			{
+				uint32_t first = chunkIdx * PRIMITIVE_CHUNK_SIZE;
+				uint32_t last = std::min(first + PRIMITIVE_CHUNK_SIZE, count);
+				for (uint32_t idx = first; idx < last; ++idx)
+				{
+					functor(idx);
+				}
+			};
+
+			if (taskScheduler)
+			{
+				taskScheduler->parallel_for(numChunks, process_chunk);
+			}
+			else
+			{
+				for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+				{
+					process_chunk(chunkIdx, 0);
+				}
+			}
+		}
+
+		static inline const float* primitive_box(const TGeometryDescriptor& geometry, uint32_t index)
+		{
+			return (const float*)((const char*)geometry.aabbBuffer + (size_t)index * geometry.aabbStride);
+		}
+
+		// Values of the arrays of a group lane for a primitive, except its index
+		static void primitive_lane_values(const TGeometryDescriptor& geometry, uint32_t primitiveIndex, float* values)
+		{
+			switch (geometry.type)
+			{
+			case GeometryType::Triangles:
+			{
+				const float* p0 = vertex_position(geometry, 3 * primitiveIndex);
+				const float* p1 = vertex_position(geometry, 3 * primitiveIndex + 1);
+				const float* p2 = vertex_position(geometry, 3 * primitiveIndex + 2);
+				values[0] = p0[0];
+				values[1] = p0[1];
+				values[2] = p0[2];
+				sub(p1, p0, values + 3);
+				sub(p2, p0, values + 6);
+			}
+			break;
+			case GeometryType::Spheres:
+			{
+				const float* box = primitive_box(geometry, primitiveIndex);
+				float radius = 0.5f * std::min(std::min(box[3] - box[0], box[4] - box[1]), box[5] - box[2]);
+				values[0] = 0.5f * (box[0] + box[3]);
+				values[1] = 0.5f * (box[1] + box[4]);
+				values[2] = 0.5f * (box[2] + box[5]);
+				values[3] = radius * radius;
+			}
+			break;
+			case GeometryType::Boxes:
+			{
+				std::copy(primitive_box(geometry, primitiveIndex), primitive_box(geometry, primitiveIndex) + 6, values);
+			}
+			break;
+			case GeometryType::CustomPrimitives:
+			{
+				// The custom primitives are handed to the intersection function from their boxes, they are never stored in groups
+				assert(false);
+			}
+			break;
+			};
+		}
+
+		static void primitive_bounds(const TGeometryDescriptor& geometry, uint32_t primitiveIndex, TAABB& bounds)
+		{
+			if (geometry.type != GeometryType::Triangles)
+			{
+				const float* box = primitive_box(geometry, primitiveIndex);
+				std::copy(box, box + 3, bounds.min);
+				std::copy(box + 3, box + 6, bounds.max);
+				return;
+			}
+
+			const float* p0 = vertex_position(geometry, 3 * primitiveIndex);
+			const float* p1 = vertex_position(geometry, 3 * primitiveIndex + 1);
+			const float* p2 = vertex_position(geometry, 3 * primitiveIndex + 2);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				bounds.min[axis] = std::min(std::min(p0[axis], p1[axis]), p2[axis]);
+				bounds.max[axis] = std::max(std::max(p0[axis], p1[axis]), p2[axis]);
+			}
+		}
+
+		// The update of a hierarchy redistributes the lanes of the groups, their empty lanes are the empty slots of its items
+		static_assert(BVH_REFIT_INVALID_PRIMITIVE == TRIANGLE_INVALID_PRIMITIVE, "The empty lanes of the groups and the empty slots of the refit items must match");
+
+		// Write a primitive in a lane of a group, the empty lanes are zeroed so that they can never be hit
+		// A zeroed sphere would be hit by the rays through its center, its squared radius is negative instead
+		static void write_group_lane(const TGeometryDescriptor& geometry, float* group, uint32_t groupWidth, uint32_t numArrays, uint32_t lane, uint32_t primitiveIndex)
+		{
+			float values[TRIANGLE_GROUP_NUM_ARRAYS - 1] = {};
+			if (primitiveIndex != TRIANGLE_INVALID_PRIMITIVE)
+			{
+				primitive_lane_values(geometry, primitiveIndex, values);
+			}
+			else if (geometry.type == GeometryType::Spheres)
+			{
+				values[3] = -1.0f;
+			}
+
+			for (uint32_t arrayIdx = 0; arrayIdx < numArrays - 1; ++arrayIdx)
+			{
+				group[arrayIdx * groupWidth + lane] = values[arrayIdx];
+			}
+			((uint32_t*)group)[(numArrays - 1) * groupWidth + lane] = primitiveIndex;
+		}
+
+		// Point the arrays the traversal reads at the storage of the structure
+		static void bind_storage(TBottomLevelAccelerationStructure& accelerationStructure)
+		{
+			accelerationStructure.nodes = accelerationStructure.bvh.nodes.data();
+			accelerationStructure.wideNodes = accelerationStructure.bvh8.nodes.data();
+			accelerationStructure.primitiveIndices = accelerationStructure.bvh.primitiveIndices.data();
+			accelerationStructure.groups = accelerationStructure.primitiveGroups.data();
+		}
+
+		TBottomLevelAccelerationStructure* create_bottom_level_acceleration_structure(const TGeometryDescriptor& geometry, BVHNodeFormat::Type nodeFormat, TTaskScheduler* taskScheduler)
+		{
+			TBottomLevelAccelerationStructure* accelerationStructure = new TBottomLevelAccelerationStructure();
+			accelerationStructure->geometryType = geometry.type;
+			accelerationStructure->opaque = geometry.opaque;
+			bool triangles = geometry.type == GeometryType::Triangles;
+			uint32_t numPrimitives = triangles ? geometry.indexCount / 3 : geometry.aabbCount;
+
+			// The custom primitives are handed to the intersection function by binary leaves, and only the binary nodes can be refit
+			accelerationStructure->allowUpdate = geometry.allowUpdate;
+			if (geometry.type == GeometryType::CustomPrimitives || geometry.allowUpdate)
+			{
+				nodeFormat = BVHNodeFormat::Binary;
+			}
+			accelerationStructure->nodeFormat = nodeFormat;
+
+			// Compute the bounds of every primitive
+			std::vector<TAABB> primitiveBounds(numPrimitives);
+			for_each_chunk(taskScheduler, numPrimitives, [&](uint32_t primitiveIdx)
+			{
+				primitive_bounds(geometry, primitiveIdx, primitiveBounds[primitiveIdx]);
+			});
+
+			// Leaves are sized for the intersection kernel of the processor, the custom primitives are intersected one at a time
+			const TTriangleIntersectionAPI& intersectionAPI = triangle_intersection_api();
+			uint32_t groupWidth = intersectionAPI.width;
+			uint32_t numArrays = TRIANGLE_GROUP_NUM_ARRAYS;
+			switch (geometry.type)
+			{
+			case GeometryType::Triangles:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_triangles;
+				break;
+			case GeometryType::Spheres:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_spheres;
+				numArrays = SPHERE_GROUP_NUM_ARRAYS;
+				break;
+			case GeometryType::Boxes:
+				accelerationStructure->intersect_groups = intersectionAPI.intersect_boxes;
+				numArrays = BOX_GROUP_NUM_ARRAYS;
+				break;
+			case GeometryType::CustomPrimitives:
+				accelerationStructure->intersect_groups = nullptr;
+				groupWidth = 1;
+				numArrays = 0;
+				break;
+			};
+			accelerationStructure->groupWidth = groupWidth;
+			accelerationStructure->groupSize = numArrays * groupWidth;
+
+			// Build the hierarchy, the wide one is collapsed from the binary one
+			TBVH& bvh = accelerationStructure->bvh;
+			build_bvh(primitiveBounds.data(), numPrimitives, bvh, taskScheduler, groupWidth);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				accelerationStructure->bounds.min[axis] = bvh.nodes[0].min[axis];
+				accelerationStructure->bounds.max[axis] = bvh.nodes[0].max[axis];
+			}
+
+			if (geometry.type == GeometryType::CustomPrimitives)
+			{
+				accelerationStructure->numGroups = numPrimitives;
+				if (geometry.allowUpdate)
+				{
+					accelerationStructure->refitState.primitiveBounds.swap(primitiveBounds);
+					prepare_bvh_refit(bvh, bvh.primitiveIndices.data(), numPrimitives, 1, accelerationStructure->refitState);
+				}
+				bind_storage(*accelerationStructure);
+				return accelerationStructure;
+			}
+
+			// Order of the primitives in the groups, every leaf is padded to a whole number of groups
+			std::vector<uint32_t> groupedIndices;
+			if (nodeFormat == BVHNodeFormat::Wide8)
+			{
+				build_bvh8(bvh, accelerationStructure->bvh8, groupWidth);
+				groupedIndices.swap(accelerationStructure->bvh8.primitiveIndices);
+			}
+			else
+			{
+				// The binary leaves are rewritten to reference groups instead of primitives, in the order of their primitives
+				// The primitives of every subtree are contiguous, so are its groups, which lets the update rebuild a subtree in its own groups
+				std::vector<uint32_t> leaves;
+				for (uint32_t nodeIdx = 0; nodeIdx < (uint32_t)bvh.nodes.size(); ++nodeIdx)
+				{
+					if (bvh.nodes[nodeIdx].count != 0)
+					{
+						leaves.push_back(nodeIdx);
+					}
+				}
+				std::sort(leaves.begin(), leaves.end(), [&](uint32_t leftLeaf, uint32_t rightLeaf) { return bvh.nodes[leftLeaf].leftFirst < bvh.nodes[rightLeaf].leftFirst; });
+				for (uint32_t nodeIdx : leaves)
+				{
+					TBVHNode& node = bvh.nodes[nodeIdx];
+					uint32_t first = node.leftFirst;
+					uint32_t count = node.count;
+					node.leftFirst = (uint32_t)groupedIndices.size() / groupWidth;
+					node.count = (count + groupWidth - 1) / groupWidth;
+					groupedIndices.insert(groupedIndices.end(), bvh.primitiveIndices.begin() + first, bvh.primitiveIndices.begin() + first + count);
+					groupedIndices.resize((size_t)(node.leftFirst + node.count) * groupWidth, TRIANGLE_INVALID_PRIMITIVE);
+				}
+				bvh.primitiveIndices.clear();
+			}
+
+			// Precompute the primitives in structure of arrays
+			uint32_t numGroups = (uint32_t)groupedIndices.size() / groupWidth;
+			uint32_t groupSize = accelerationStructure->groupSize;
+			accelerationStructure->numGroups = numGroups;
+			accelerationStructure->primitiveGroups.resize((size_t)numGroups * groupSize);
+			for_each_chunk(taskScheduler, numGroups, [&](uint32_t groupIdx)
+			{
+				float* group = &accelerationStructure->primitiveGroups[(size_t)groupIdx * groupSize];
+				for (uint32_t lane = 0; lane < groupWidth; ++lane)
+				{
+					write_group_lane(geometry, group, groupWidth, numArrays, lane, groupedIndices[(size_t)groupIdx * groupWidth + lane]);
+				}
+			});
+
+			// The binary hierarchy was only needed to build the wide one
+			if (nodeFormat == BVHNodeFormat::Wide8)
+			{
+				accelerationStructure->bvh = TBVH();
+			}
+			else if (geometry.allowUpdate)
+			{
+				accelerationStructure->refitState.primitiveBounds.swap(primitiveBounds);
+				prepare_bvh_refit(bvh, groupedIndices.data(), numGroups, groupWidth, accelerationStructure->refitState);
+			}
+			bind_storage(*accelerationStructure);
+			return accelerationStructure;
+		}
+
+		void destroy_bottom_level_acceleration_structure(TBottomLevelAccelerationStructure* accelerationStructure)
+		{
+			if (accelerationStructure->pageTable != nullptr)
+			{
+				close_bvh_page_table(accelerationStructure->pageTable);
+			}
+			unmap_file(accelerationStructure->mappedFile);
+			delete accelerationStructure;
+		}
+
+		void update_bottom_level_acceleration_structure(TBottomLevelAccelerationStructure& accelerationStructure, const TGeometryDescriptor& geometry, TTaskScheduler* taskScheduler, TBVHRefitStatistics* statistics)
+		{
+			assert(accelerationStructure.allowUpdate && geometry.type == accelerationStructure.geometryType);
+			TBVHRefitStatistics refitStatistics = TBVHRefitStatistics();
+			if (accelerationStructure.numGroups > 0)
+			{
+				// Every leaf rewrites the lanes of its groups and recomputes its bounds, the custom primitives are referenced by the leaves directly
+				TBVH& bvh = accelerationStructure.bvh;
+				uint32_t groupWidth = accelerationStructure.groupWidth;
+				uint32_t groupSize = accelerationStructure.groupSize;
+				uint32_t numArrays = groupSize / groupWidth;
+				for_each_chunk(taskScheduler, (uint32_t)bvh.nodes.size(), [&](uint32_t nodeIdx)
+				{
+					TBVHNode& leaf = bvh.nodes[nodeIdx];
+					if (leaf.count == 0) return;
+
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						leaf.min[axis] = FLT_MAX;
+						leaf.max[axis] = -FLT_MAX;
+					}
+					auto grow_leaf = [&](uint32_t primitiveIndex)
+					{
+						TAABB& bounds = accelerationStructure.refitState.primitiveBounds[primitiveIndex];
+						primitive_bounds(geometry, primitiveIndex, bounds);
+						for (uint32_t axis = 0; axis < 3; ++axis)
+						{
+							leaf.min[axis] = std::min(leaf.min[axis], bounds.min[axis]);
+							leaf.max[axis] = std::max(leaf.max[axis], bounds.max[axis]);
+						}
+					};
+
+					if (geometry.type == GeometryType::CustomPrimitives)
+					{
+						for (uint32_t primIdx = leaf.leftFirst; primIdx < leaf.leftFirst + leaf.count; ++primIdx)
+						{
+							grow_leaf(bvh.primitiveIndices[primIdx]);
+						}
+						return;
+					}
+
+					for (uint32_t groupIdx = leaf.leftFirst; groupIdx < leaf.leftFirst + leaf.count; ++groupIdx)
+					{
+						float* group = &accelerationStructure.primitiveGroups[(size_t)groupIdx * groupSize];
+						for (uint32_t lane = 0; lane < groupWidth; ++lane)
+						{
+							uint32_t primitiveIndex = ((const uint32_t*)group)[(numArrays - 1) * groupWidth + lane];
+							if (primitiveIndex == TRIANGLE_INVALID_PRIMITIVE) continue;
+							write_group_lane(geometry, group, groupWidth, numArrays, lane, primitiveIndex);
+							grow_leaf(primitiveIndex);
+						}
+					}
+				});
+
+				refit_bvh(bvh, accelerationStructure.refitState, taskScheduler, refitStatistics);
+
+				// The rebuilt subtrees redistributed their primitives over their items, the groups or the primitive indices follow
+				const TBVHRefitState& refitState = accelerationStructure.refitState;
+				uint32_t numRanges = (uint32_t)refitState.rebuiltItemRanges.size() / 2;
+				auto rewrite_range = [&](uint32_t rangeIdx, uint32_t)
+				{
+					uint32_t firstItem = refitState.rebuiltItemRanges[2 * rangeIdx];
+					uint32_t lastItem = firstItem + refitState.rebuiltItemRanges[2 * rangeIdx + 1];
+					if (geometry.type == GeometryType::CustomPrimitives)
+					{
+						std::copy(refitState.items.begin() + firstItem, refitState.items.begin() + lastItem, bvh.primitiveIndices.begin() + firstItem);
+						return;
+					}
+
+					for (uint32_t groupIdx = firstItem; groupIdx < lastItem; ++groupIdx)
+					{
+						float* group = &accelerationStructure.primitiveGroups[(size_t)groupIdx * groupSize];
+						for (uint32_t lane = 0; lane < groupWidth; ++lane)
+						{
+							write_group_lane(geometry, group, groupWidth, numArrays, lane, refitState.items[(size_t)groupIdx * groupWidth + lane]);
+						}
+					}
+				};
+				if (taskScheduler && numRanges > 1)
+				{
+					taskScheduler->parallel_for(numRanges, rewrite_range);
+				}
+				else
+				{
+					for (uint32_t rangeIdx = 0; rangeIdx < numRanges; ++rangeIdx)
+					{
+						rewrite_range(rangeIdx, 0);
+					}
+				}
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					accelerationStructure.bounds.min[axis] = bvh.nodes[0].min[axis];
+					accelerationStructure.bounds.max[axis] = bvh.nodes[0].max[axis];
+				}
+			}
+
+			if (statistics)
+			{
+				*statistics = refitStatistics;
+			}
+		}
+
+		static inline void transform_point(const float* matrix, const float* point, float* result)
+		{
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				result[row] = matrix[4 * row] * point[0] + matrix[4 * row + 1] * point[1] + matrix[4 * row + 2] * point[2] + matrix[4 * row + 3];
+			}
+		}
+
+		static inline void transform_vector(const float* matrix, const float* vector, float* result)
+		{
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				result[row] = matrix[4 * row] * vector[0] + matrix[4 * row + 1] * vector[1] + matrix[4 * row + 2] * vector[2];
+			}
+		}
+
+		// Inverse of an affine 3x4 transform
+		static void invert_transform(const float* matrix, float* result)
+		{
+			const float* r0 = matrix;
+			const float* r1 = matrix + 4;
+			const float* r2 = matrix + 8;
+			float cofactors[3][3] = {
+				{ r1[1] * r2[2] - r1[2] * r2[1], r0[2] * r2[1] - r0[1] * r2[2], r0[1] * r1[2] - r0[2] * r1[1] },
+				{ r1[2] * r2[0] - r1[0] * r2[2], r0[0] * r2[2] - r0[2] * r2[0], r0[2] * r1[0] - r0[0] * r1[2] },
+				{ r1[0] * r2[1] - r1[1] * r2[0], r0[1] * r2[0] - r0[0] * r2[1], r0[0] * r1[1] - r0[1] * r1[0] } };
+			float determinant = r0[0] * cofactors[0][0] + r0[1] * cofactors[1][0] + r0[2] * cofactors[2][0];
+			float invDeterminant = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				for (uint32_t column = 0; column < 3; ++column)
+				{
+					result[4 * row + column] = cofactors[row][column] * invDeterminant;
+				}
+				result[4 * row + 3] = -(result[4 * row] * r0[3] + result[4 * row + 1] * r1[3] + result[4 * row + 2] * r2[3]);
+			}
+		}
+
+		// Refresh the inverse transform and the world space bounds of an instance
+		static void update_instance(TTopLevelAccelerationStructure& accelerationStructure, uint32_t instanceIndex)
+		{
+			TInstance& instance = accelerationStructure.instances[instanceIndex];
+			invert_transform(instance.objectToWorld, instance.worldToObject);
+
+			// Transform the bounds of the root of the bottom level structure, one axis of the result at a time
+			TAABB& bounds = accelerationStructure.instanceBounds[instanceIndex];
+			const TAABB& objectBounds = instance.bottomLevel->bounds;
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				const float* matrixRow = instance.objectToWorld + 4 * row;
+				bounds.min[row] = bounds.max[row] = matrixRow[3];
+				if (instance.bottomLevel->numGroups == 0) continue;
+
+				for (uint32_t column = 0; column < 3; ++column)
+				{
+					float a = matrixRow[column] * objectBounds.min[column];
+					float b = matrixRow[column] * objectBounds.max[column];
+					bounds.min[row] += std::min(a, b);
+					bounds.max[row] += std::max(a, b);
+				}
+			}
+		}
+
+		// Hierarchy over the world space bounds of the instances
+		static void build_top_level(TTopLevelAccelerationStructure& accelerationStructure, TTaskScheduler* taskScheduler)
+		{
+			const TAABB* instanceBounds = accelerationStructure.instanceBounds.data();
+			uint32_t numInstances = (uint32_t)accelerationStructure.instances.size();
+			if (accelerationStructure.buildMode == BVHBuildMode::BinnedSAH)
+			{
+				build_bvh(instanceBounds, numInstances, accelerationStructure.bvh, taskScheduler);
+			}
+			else
+			{
+				build_lbvh(accelerationStructure.lbvhBuilder, instanceBounds, numInstances, accelerationStructure.bvh, taskScheduler, accelerationStructure.buildMode == BVHBuildMode::HLBVH);
+			}
+			accelerationStructure.needsRebuild = false;
+		}
+
+		TTopLevelAccelerationStructure* create_top_level_acceleration_structure(const TInstanceDescriptor* instances, uint32_t numInstances, BVHBuildMode::Type buildMode, TTaskScheduler* taskScheduler)
+		{
+			TTopLevelAccelerationStructure* accelerationStructure = new TTopLevelAccelerationStructure();
+			accelerationStructure->instances.resize(numInstances);
+			accelerationStructure->instanceBounds.resize(numInstances);
+			for (uint32_t instanceIdx = 0; instanceIdx < numInstances; ++instanceIdx)
+			{
+				const TInstanceDescriptor& descriptor = instances[instanceIdx];
+				TInstance& instance = accelerationStructure->instances[instanceIdx];
+				std::copy(descriptor.transform, descriptor.transform + 12, instance.objectToWorld);
+				instance.bottomLevel = (const TBottomLevelAccelerationStructure*)descriptor.bottomLevel;
+				instance.instanceID = descriptor.instanceID;
+				instance.mask = descriptor.mask;
+				instance.hitGroupIndex = descriptor.hitGroupIndex;
+				update_instance(*accelerationStructure, instanceIdx);
+			}
+			accelerationStructure->shaderBindingTable = nullptr;
+			accelerationStructure->buildMode = buildMode;
+
+			build_top_level(*accelerationStructure, taskScheduler);
+			return accelerationStructure;
+		}
+
+		void bind_shader_binding_table(TTopLevelAccelerationStructure& accelerationStructure, const TShaderBindingTable* shaderBindingTable)
+		{
+			accelerationStructure.shaderBindingTable = shaderBindingTable;
+		}
+
+		// Hit group the custom primitives of an instance are intersected with, null if it has none or the instance is made of built-in primitives
+		static inline const THitGroupRecord* custom_hit_group(const TTopLevelAccelerationStructure& accelerationStructure, const TInstance& instance)
+		{
+			const TShaderBindingTable* shaderBindingTable = accelerationStructure.shaderBindingTable;
+			if (instance.bottomLevel->geometryType != GeometryType::CustomPrimitives || shaderBindingTable == nullptr) return nullptr;
+			if (instance.hitGroupIndex >= shaderBindingTable->numHitGroups) return nullptr;
+			const THitGroupRecord* hitGroup = shaderBindingTable->hitGroups + instance.hitGroupIndex;
+			return hitGroup->intersection != nullptr ? hitGroup : nullptr;
+		}
+
+		void destroy_top_level_acceleration_structure(TTopLevelAccelerationStructure* accelerationStructure)
+		{
+			delete accelerationStructure;
+		}
+
+		void update_instance_transforms(TTopLevelAccelerationStructure& accelerationStructure, uint32_t firstInstance, uint32_t numInstances, const float* transforms, TTaskScheduler* taskScheduler)
+		{
+			for_each_chunk(taskScheduler, numInstances, [&](uint32_t idx)
+			{
+				const float* transform = transforms + 12 * idx;
+				std::copy(transform, transform + 12, accelerationStructure.instances[firstInstance + idx].objectToWorld);
+				update_instance(accelerationStructure, firstInstance + idx);
+			});
+			accelerationStructure.needsRebuild |= numInstances > 0;
+		}
+
+		void refresh_instance_bounds(TTopLevelAccelerationStructure& accelerationStructure, const TBottomLevelAccelerationStructure* bottomLevel)
+		{
+			for (uint32_t instanceIdx = 0; instanceIdx < (uint32_t)accelerationStructure.instances.size(); ++instanceIdx)
+			{
+				if (accelerationStructure.instances[instanceIdx].bottomLevel != bottomLevel) continue;
+				update_instance(accelerationStructure, instanceIdx);
+				accelerationStructure.needsRebuild = true;
+			}
+		}
+
+		void rebuild_top_level_acceleration_structure(TTopLevelAccelerationStructure& accelerationStructure, TTaskScheduler* taskScheduler)
+		{
+			// The hierarchy only covers the instances, rebuilding it is cheaper than touching any triangle
+			if (accelerationStructure.needsRebuild)
+			{
+				build_top_level(accelerationStructure, taskScheduler);
+			}
+		}
+
+		// Slab test, returns the entry distance or FLT_MAX if the node is missed
+		static inline float intersect_node(const TBVHNode& node, const float* origin, const float* invDirection, float tMin, float tMax)
+		{
+			float tx0 = (node.min[0] - origin[0]) * invDirection[0];
+			float tx1 = (node.max[0] - origin[0]) * invDirection[0];
+			float ty0 = (node.min[1] - origin[1]) * invDirection[1];
+			float ty1 = (node.max[1] - origin[1]) * invDirection[1];
+			float tz0 = (node.min[2] - origin[2]) * invDirection[2];
+			float tz1 = (node.max[2] - origin[2]) * invDirection[2];
+			float tEnter = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), tMin));
+			float tExit = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), tMax));
+			return tEnter <= tExit ? tEnter : FLT_MAX;
+		}
+
+		// Closest first traversal of a hierarchy, the leaf function intersects a range of primitives and shortens tMax on a hit
+		// With RayFlags::AcceptFirstHit the traversal ends on the first leaf that reports a hit
+		template<uint32_t Flags, typename TLeafFunction>
+		static inline bool traverse_bvh(const TBVHNode* nodes, const float* origin, const float* direction, float tMin, float& tMax, const TLeafFunction& intersect_leaf)
+		{
+			float invDirection[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+			bool found = false;
+
+			uint32_t stack[TRAVERSAL_STACK_SIZE];
+			uint32_t stackSize = 0;
+			uint32_t nodeIndex = 0;
+			if (intersect_node(nodes[0], origin, invDirection, tMin, tMax) == FLT_MAX) return false;
+
+			while (true)
+			{
+				const TBVHNode& node = nodes[nodeIndex];
+				if (node.count != 0)
+				{
+					found |= intersect_leaf(node.leftFirst, node.count, tMax);
+					if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+				}
+				else
+				{
+					// Visit the closest child first and keep the other one for later
+					uint32_t nearIndex = node.leftFirst;
+					uint32_t farIndex = node.leftFirst + 1;
+					float tNear = intersect_node(nodes[nearIndex], origin, invDirection, tMin, tMax);
+					float tFar = intersect_node(nodes[farIndex], origin, invDirection, tMin, tMax);
+					if (tFar < tNear)
+					{
+						std::swap(nearIndex, farIndex);
+						std::swap(tNear, tFar);
+					}
+
+					if (tNear != FLT_MAX)
+					{
+						if (tFar != FLT_MAX)
+						{
+							assert(stackSize < TRAVERSAL_STACK_SIZE);
+							stack[stackSize++] = farIndex;
+						}
+						nodeIndex = nearIndex;
+						continue;
+					}
+				}
+
+				if (stackSize == 0) break;
+				nodeIndex = stack[--stackSize];
+			}
+
+			return found;
+		}
+
+		static inline void unpack_quantized(const uint8_t* values, __m128& low, __m128& high)
+		{
+			__m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)values), _mm_setzero_si128());
+			low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+			high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, _mm_setzero_si128()));
+		}
+
+		// Slab test against the eight children of a wide node, returns the mask of the children that are hit and their entry distances
+		static inline uint32_t intersect_children(const TBVH8Node& node, const float* origin, const float* invDirection, float tMin, float tMax, float* distances)
+		{
+		#if defined(__AVX2__)
+			__m256 tEnter = _mm256_set1_ps(tMin);
+			__m256 tExit = _mm256_set1_ps(tMax);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				// Entry and exit distances are affine in the quantized coordinates
+				__m256 scale = _mm256_set1_ps(bvh8_scale(node.exponent[axis]) * invDirection[axis]);
+				__m256 offset = _mm256_set1_ps((node.origin[axis] - origin[axis]) * invDirection[axis]);
+				bool positive = invDirection[axis] >= 0.0f;
+				__m256 qNear = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(positive ? node.quantizedMin[axis] : node.quantizedMax[axis]))));
+				__m256 qFar = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(positive ? node.quantizedMax[axis] : node.quantizedMin[axis]))));
+				tEnter = _mm256_max_ps(tEnter, _mm256_add_ps(_mm256_mul_ps(qNear, scale), offset));
+				tExit = _mm256_min_ps(tExit, _mm256_add_ps(_mm256_mul_ps(qFar, scale), offset));
+			}
+			_mm256_storeu_ps(distances, tEnter);
+			return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(tEnter, tExit, _CMP_LE_OQ));
+		#else
+			__m128 tEnter[2] = { _mm_set1_ps(tMin), _mm_set1_ps(tMin) };
+			__m128 tExit[2] = { _mm_set1_ps(tMax), _mm_set1_ps(tMax) };
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				// Entry and exit distances are affine in the quantized coordinates
+				__m128 scale = _mm_set1_ps(bvh8_scale(node.exponent[axis]) * invDirection[axis]);
+				__m128 offset = _mm_set1_ps((node.origin[axis] - origin[axis]) * invDirection[axis]);
+				bool positive = invDirection[axis] >= 0.0f;
+				__m128 qNear[2], qFar[2];
+				unpack_quantized(positive ? node.quantizedMin[axis] : node.quantizedMax[axis], qNear[0], qNear[1]);
+				unpack_quantized(positive ? node.quantizedMax[axis] : node.quantizedMin[axis], qFar[0], qFar[1]);
+				for (uint32_t half = 0; half < 2; ++half)
+				{
+					tEnter[half] = _mm_max_ps(tEnter[half], _mm_add_ps(_mm_mul_ps(qNear[half], scale), offset));
+					tExit[half] = _mm_min_ps(tExit[half], _mm_add_ps(_mm_mul_ps(qFar[half], scale), offset));
+				}
+			}
+			_mm_storeu_ps(distances, tEnter[0]);
+			_mm_storeu_ps(distances + 4, tEnter[1]);
+			return (uint32_t)(_mm_movemask_ps(_mm_cmple_ps(tEnter[0], tExit[0])) | (_mm_movemask_ps(_mm_cmple_ps(tEnter[1], tExit[1])) << 4));
+		#endif
+		}
+
+		// Entry of the wide traversal stack, either a node index or a leaf (flag, first primitive and count)
+		struct TWideStackEntry
+		{
+			uint32_t item;
+			float distance;
+		};
+
+		#define WIDE_STACK_LEAF_FLAG 0x80000000u
+
+		template<uint32_t Flags>
+		static inline bool traverse_bvh8(const TBottomLevelAccelerationStructure& accelerationStructure, const TRay& ray, float& tMax, THit& hit)
+		{
+			const TIntersectPrimitiveGroupsFunction intersect_groups = accelerationStructure.intersect_groups[Flags & INTERSECTION_KERNEL_VARIANT_MASK];
+			const TBVH8Node* nodes = accelerationStructure.wideNodes;
+			const float* primitiveGroups = accelerationStructure.groups;
+			uint32_t groupSize = accelerationStructure.groupSize;
+
+			// The quantized slab test multiplies the inverse direction by zero, it has to stay finite
+			float invDirection[3];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				float direction = ray.direction[axis];
+				if (fabsf(direction) < 1e-20f) direction = direction < 0.0f ? -1e-20f : 1e-20f;
+				invDirection[axis] = 1.0f / direction;
+			}
+
+			TWideStackEntry stack[WIDE_TRAVERSAL_STACK_SIZE];
+			uint32_t stackSize = 0;
+			stack[stackSize++] = { 0, ray.tMin };
+			bool found = false;
+
+			while (stackSize != 0)
+			{
+				TWideStackEntry entry = stack[--stackSize];
+				if (entry.distance > tMax) continue;
+
+				if (entry.item & WIDE_STACK_LEAF_FLAG)
+				{
+					uint32_t firstGroup = (entry.item & ~WIDE_STACK_LEAF_FLAG) >> 3;
+					found |= intersect_groups(primitiveGroups + (size_t)firstGroup * groupSize, entry.item & 7, ray, tMax, hit);
+					if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+					continue;
+				}
+
+				const TBVH8Node& node = nodes[entry.item];
+				float distances[BVH8_WIDTH];
+				uint32_t hitMask = intersect_children(node, ray.origin, invDirection, ray.tMin, tMax, distances);
+
+				// Sort the children that are hit from the farthest to the closest, so that the closest one is popped first
+				TWideStackEntry children[BVH8_WIDTH];
+				uint32_t numChildren = 0;
+				uint32_t innerRank = 0;
+				for (uint32_t slot = 0; slot < BVH8_WIDTH; ++slot)
+				{
+					bool inner = (node.innerMask >> slot) & 1;
+					if ((hitMask >> slot) & 1)
+					{
+						TWideStackEntry child;
+						child.distance = distances[slot];
+						if (inner)
+						{
+							child.item = node.childBaseIndex + innerRank;
+						}
+						else
+						{
+							uint8_t meta = node.meta[slot];
+							child.item = WIDE_STACK_LEAF_FLAG | ((node.primitiveBaseIndex + (meta & 31)) << 3) | (meta >> 5);
+						}
+
+						uint32_t position = numChildren++;
+						while (position > 0 && children[position - 1].distance < child.distance)
+						{
+							children[position] = children[position - 1];
+							position--;
+						}
+						children[position] = child;
+					}
+					innerRank += inner ? 1 : 0;
+				}
+
+				assert(stackSize + numChildren <= WIDE_TRAVERSAL_STACK_SIZE);
+				for (uint32_t childIdx = 0; childIdx < numChildren; ++childIdx)
+				{
+					stack[stackSize++] = children[childIdx];
+				}
+			}
+
+			return found;
+		}
+
+		// Closest intersection with the primitives of a bottom level structure made of custom primitives, every leaf is handed to the intersection function
+		template<uint32_t Flags>
+		static inline bool intersect_custom_primitives(const TBottomLevelAccelerationStructure& accelerationStructure, const TRay& ray, float& tMax, THit& hit, const THitGroupRecord* hitGroup)
+		{
+			if (hitGroup == nullptr) return false;
+
+			const uint32_t* primitiveIndices = accelerationStructure.primitiveIndices;
+			return traverse_bvh<Flags>(accelerationStructure.nodes, ray.origin, ray.direction, ray.tMin, tMax, [&](uint32_t first, uint32_t count, float& currentTMax)
+			{
+				TRay leafRay = ray;
+				leafRay.tMax = currentTMax;
+				return hitGroup->intersection(hitGroup->rootData, leafRay, primitiveIndices + first, count, currentTMax, hit);
+			});
+		}
+
+		// Closest intersection with the subtree of a page, which is resident and pinned by the caller
+		template<uint32_t Flags>
+		static inline bool traverse_page(const TBottomLevelAccelerationStructure& accelerationStructure, uint32_t pageIndex, const uint8_t* pageData, const TRay& ray, float& tMax, THit& hit)
+		{
+			const float* primitiveGroups = (const float*)(pageData + (size_t)accelerationStructure.pageTable->pages[pageIndex].numNodes * sizeof(TBVHNode));
+			uint32_t groupSize = accelerationStructure.groupSize;
+			TIntersectPrimitiveGroupsFunction intersect_groups = accelerationStructure.intersect_groups[Flags & INTERSECTION_KERNEL_VARIANT_MASK];
+			return traverse_bvh<Flags>((const TBVHNode*)pageData, ray.origin, ray.direction, ray.tMin, tMax, [&](uint32_t firstGroup, uint32_t numGroups, float& currentTMax)
+			{
+				return intersect_groups(primitiveGroups + (size_t)firstGroup * groupSize, numGroups, ray, currentTMax, hit);
+			});
+		}
+
+		// Closest intersection with a page of a paged structure
+		// The ray puts itself aside in the deferral if the page is not resident, it goes on with the rest of the structure and comes back to the page once its traversal is over
+		template<uint32_t Flags>
+		static inline bool intersect_page(const TBottomLevelAccelerationStructure& accelerationStructure, uint32_t pageIndex, const TRay& ray, float& tMax, THit& hit, TBVHPageDeferral& deferral)
+		{
+			TBVHPageTable& pageTable = *accelerationStructure.pageTable;
+			const uint8_t* pageData = acquire_bvh_page(pageTable, pageIndex);
+			if (pageData == nullptr)
+			{
+				float invDirection[3] = { 1.0f / ray.direction[0], 1.0f / ray.direction[1], 1.0f / ray.direction[2] };
+				float tEnter = intersect_node(pageTable.pages[pageIndex].leaf, ray.origin, invDirection, ray.tMin, tMax);
+				TDeferredPageRay deferredRay = { deferral.rayIndex, deferral.instanceIndex, pageIndex, tEnter };
+				deferral.rays.push_back(deferredRay);
+				pageTable.cache->deferredRays.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			bool found = traverse_page<Flags>(accelerationStructure, pageIndex, pageData, ray, tMax, hit);
+			release_bvh_page(pageTable, pageIndex);
+			return found;
+		}
+
+		// Closest intersection with the primitives of a bottom level structure, the ray is in its space
+		// The pages of a paged structure that are not resident are deferred
+		template<uint32_t Flags>
+		static inline bool intersect_bottom_level(const TBottomLevelAccelerationStructure& accelerationStructure, const TRay& ray, float& tMax, THit& hit, const THitGroupRecord* hitGroup, TBVHPageDeferral& deferral)
+		{
+			if (accelerationStructure.numGroups == 0) return false;
+
+			if (accelerationStructure.geometryType == GeometryType::CustomPrimitives)
+			{
+				return intersect_custom_primitives<Flags>(accelerationStructure, ray, tMax, hit, hitGroup);
+			}
+
+			if (accelerationStructure.nodeFormat == BVHNodeFormat::Wide8)
+			{
+				return traverse_bvh8<Flags>(accelerationStructure, ray, tMax, hit);
+			}
+
+			const float* primitiveGroups = accelerationStructure.groups;
+			uint32_t groupSize = accelerationStructure.groupSize;
+			TIntersectPrimitiveGroupsFunction intersect_groups = accelerationStructure.intersect_groups[Flags & INTERSECTION_KERNEL_VARIANT_MASK];
+			return traverse_bvh<Flags>(accelerationStructure.nodes, ray.origin, ray.direction, ray.tMin, tMax, [&](uint32_t firstGroup, uint32_t numGroups, float& currentTMax)
+			{
+				if (numGroups == BVH_PAGE_LEAF_COUNT) return intersect_page<Flags>(accelerationStructure, firstGroup, ray, currentTMax, hit, deferral);
+				return intersect_groups(primitiveGroups + (size_t)firstGroup * groupSize, numGroups, ray, currentTMax, hit);
+			});
+		}
+
+		// Traversal of the instances, instantiated for every combination of the flags that change it
+		// The deferral receives the rays that reached pages that are not resident, they are traced through them by resolve_deferred_rays
+		template<uint32_t Flags>
+		static bool intersect_ray(const TTopLevelAccelerationStructure& accelerationStructure, const TRay& ray, uint32_t instanceMask, THit& hit, TBVHPageDeferral& deferral)
+		{
+			if (accelerationStructure.instances.empty()) return false;
+
+			const TInstance* instances = accelerationStructure.instances.data();
+			const uint32_t* instanceIndices = accelerationStructure.bvh.primitiveIndices.data();
+			float tMax = ray.tMax;
+			return traverse_bvh<Flags>(accelerationStructure.bvh.nodes.data(), ray.origin, ray.direction, ray.tMin, tMax, [&](uint32_t first, uint32_t count, float& currentTMax)
+			{
+				bool found = false;
+				for (uint32_t idx = first; idx < first + count; ++idx)
+				{
+					uint32_t instanceIndex = instanceIndices[idx];
+					const TInstance& instance = instances[instanceIndex];
+					if ((instance.mask & instanceMask) == 0) continue;
+					if ((Flags & RayFlags::OpaqueOnly) && !instance.bottomLevel->opaque) continue;
+
+					// The direction is not normalized so that distances are the same in both spaces
+					TRay objectRay;
+					transform_point(instance.worldToObject, ray.origin, objectRay.origin);
+					transform_vector(instance.worldToObject, ray.direction, objectRay.direction);
+					objectRay.tMin = ray.tMin;
+					objectRay.tMax = currentTMax;
+					deferral.instanceIndex = instanceIndex;
+					if (intersect_bottom_level<Flags>(*instance.bottomLevel, objectRay, currentTMax, hit, custom_hit_group(accelerationStructure, instance), deferral))
+					{
+						hit.instanceIndex = instanceIndex;
+						hit.instanceID = instance.instanceID;
+						found = true;
+						if (Flags & RayFlags::AcceptFirstHit) break;
+					}
+				}
+				return found;
+			});
+		}
+
+		// The ray flags that change the traversal are the lowest bits, the others only matter to the caller
+		#define RAY_FLAGS_TRAVERSAL_MASK (RayFlags::AcceptFirstHit | RayFlags::CullBackFaces | RayFlags::OpaqueOnly)
+		#define RAY_FLAGS_NUM_TRAVERSAL_VARIANTS 8
+
+		typedef bool(*TIntersectRayFunction)(const TTopLevelAccelerationStructure& accelerationStructure, const TRay& ray, uint32_t instanceMask, THit& hit, TBVHPageDeferral& deferral);
+		static const TIntersectRayFunction intersectRayArray[RAY_FLAGS_NUM_TRAVERSAL_VARIANTS] =
+		{
+			intersect_ray<0>, intersect_ray<1>, intersect_ray<2>, intersect_ray<3>, intersect_ray<4>, intersect_ray<5>, intersect_ray<6>, intersect_ray<7>
+		};
+
+		// A deferred ray is only traced through its page if the hits found since it was put aside are not closer than the page
+		template<uint32_t Flags>
+		static inline bool deferred_ray_needs_page(const TDeferredPageRay& deferredRay, const THit* hits, const uint8_t* found)
+		{
+			if (!found[deferredRay.rayIndex]) return true;
+			return (Flags & RayFlags::AcceptFirstHit) == 0 && deferredRay.tEnter < hits[deferredRay.rayIndex].t;
+		}
+
+		// True if one of the deferred rays of a run still needs their page, the page is not read otherwise
+		template<uint32_t Flags>
+		static inline bool deferred_run_needs_page(const TDeferredPageRay* deferredRays, uint32_t count, const THit* hits, const uint8_t* found)
+		{
+			for (uint32_t idx = 0; idx < count; ++idx)
+			{
+				if (deferred_ray_needs_page<Flags>(deferredRays[idx], hits, found)) return true;
+			}
+			return false;
+		}
+
+		// Trace the deferred rays of a run that reached the same page, which is pinned, from the closest hit the traversal found for them
+		template<uint32_t Flags>
+		static void trace_deferred_run(const TTopLevelAccelerationStructure& accelerationStructure, const TDeferredPageRay* deferredRays, uint32_t count, const uint8_t* pageData, const TRay* rays, THit* hits, uint8_t* found)
+		{
+			for (uint32_t idx = 0; idx < count; ++idx)
+			{
+				const TDeferredPageRay& deferredRay = deferredRays[idx];
+				if (!deferred_ray_needs_page<Flags>(deferredRay, hits, found)) continue;
+
+				const TInstance& instance = accelerationStructure.instances[deferredRay.instanceIndex];
+				const TRay& ray = rays[deferredRay.rayIndex];
+				TRay objectRay;
+				transform_point(instance.worldToObject, ray.origin, objectRay.origin);
+				transform_vector(instance.worldToObject, ray.direction, objectRay.direction);
+				objectRay.tMin = ray.tMin;
+				objectRay.tMax = found[deferredRay.rayIndex] ? hits[deferredRay.rayIndex].t : ray.tMax;
+				float tMax = objectRay.tMax;
+				THit hit;
+				if (traverse_page<Flags>(*instance.bottomLevel, deferredRay.pageIndex, pageData, objectRay, tMax, hit))
+				{
+					hit.instanceIndex = deferredRay.instanceIndex;
+					hit.instanceID = instance.instanceID;
+					hits[deferredRay.rayIndex] = hit;
+					found[deferredRay.rayIndex] = 1;
+				}
+			}
+		}
+
+		// Trace the rays that were put aside through the pages they reached, once the traversal of the stream, packet or ray is over
+		// They are grouped by page so that every page is read once, however many rays reached it
+		template<uint32_t Flags>
+		static void resolve_deferred_rays(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, THit* hits, uint8_t* found, TBVHPageDeferral& deferral)
+		{
+			const TInstance* instances = accelerationStructure.instances.data();
+			std::sort(deferral.rays.begin(), deferral.rays.end(), [&](const TDeferredPageRay& a, const TDeferredPageRay& b)
+			{
+				const TBVHPageTable* tableA = instances[a.instanceIndex].bottomLevel->pageTable;
+				const TBVHPageTable* tableB = instances[b.instanceIndex].bottomLevel->pageTable;
+				if (tableA != tableB) return std::less<const TBVHPageTable*>()(tableA, tableB);
+				return a.pageIndex != b.pageIndex ? a.pageIndex < b.pageIndex : a.rayIndex < b.rayIndex;
+			});
+
+			// First ray of every run of rays that reached the same page, and the end of the last one
+			std::vector<uint32_t> runs;
+			for (uint32_t idx = 0; idx < (uint32_t)deferral.rays.size(); ++idx)
+			{
+				const TDeferredPageRay& deferredRay = deferral.rays[idx];
+				if (idx == 0 || deferredRay.pageIndex != deferral.rays[idx - 1].pageIndex
+					|| instances[deferredRay.instanceIndex].bottomLevel->pageTable != instances[deferral.rays[idx - 1].instanceIndex].bottomLevel->pageTable)
+				{
+					runs.push_back(idx);
+				}
+			}
+			uint32_t numRuns = (uint32_t)runs.size();
+			runs.push_back((uint32_t)deferral.rays.size());
+
+			// The pages that are resident are consumed first, most of them were left in the cache by the rays traced before
+			std::vector<uint32_t> pendingRuns;
+			std::vector<float> pendingDistances(numRuns, FLT_MAX);
+			for (uint32_t runIdx = 0; runIdx < numRuns; ++runIdx)
+			{
+				const TDeferredPageRay* deferredRays = deferral.rays.data() + runs[runIdx];
+				if (!deferred_run_needs_page<Flags>(deferredRays, runs[runIdx + 1] - runs[runIdx], hits, found)) continue;
+
+				TBVHPageTable& pageTable = *instances[deferredRays->instanceIndex].bottomLevel->pageTable;
+				const uint8_t* pageData = try_acquire_bvh_page(pageTable, deferredRays->pageIndex);
+				if (pageData == nullptr)
+				{
+					for (uint32_t idx = runs[runIdx]; idx < runs[runIdx + 1]; ++idx)
+					{
+						pendingDistances[runIdx] = std::min(pendingDistances[runIdx], deferral.rays[idx].tEnter);
+					}
+					pendingRuns.push_back(runIdx);
+					continue;
+				}
+				trace_deferred_run<Flags>(accelerationStructure, deferredRays, runs[runIdx + 1] - runs[runIdx], pageData, rays, hits, found);
+				release_bvh_page(pageTable, deferredRays->pageIndex);
+			}
+
+			// The others are read from the closest, so that the hits found in them spare the farther ones to the rays that reached only a few pages
+			std::sort(pendingRuns.begin(), pendingRuns.end(), [&](uint32_t a, uint32_t b) { return pendingDistances[a] < pendingDistances[b]; });
+
+			// They are requested in order and traced as the loader thread reads them, the requests pin them until then
+			// The pages requested ahead of the one waited for are limited to half the budget, the pinned pages can exceed it
+			uint32_t numPending = (uint32_t)pendingRuns.size();
+			std::vector<uint8_t> requested(numPending, 0);
+			uint64_t requestedBytes = 0;
+			uint32_t numRequested = 0;
+			for (uint32_t pendingIdx = 0; pendingIdx < numPending; ++pendingIdx)
+			{
+				for (; numRequested < numPending; ++numRequested)
+				{
+					uint32_t runIdx = pendingRuns[numRequested];
+					const TDeferredPageRay* deferredRays = deferral.rays.data() + runs[runIdx];
+					if (!deferred_run_needs_page<Flags>(deferredRays, runs[runIdx + 1] - runs[runIdx], hits, found)) continue;
+
+					TBVHPageTable& pageTable = *instances[deferredRays->instanceIndex].bottomLevel->pageTable;
+					uint64_t pageSize = pageTable.pages[deferredRays->pageIndex].size;
+					if (requestedBytes != 0 && requestedBytes + pageSize > pageTable.cache->budget / 2) break;
+					request_bvh_page(pageTable, deferredRays->pageIndex);
+					requested[numRequested] = 1;
+					requestedBytes += pageSize;
+				}
+				if (!requested[pendingIdx]) continue;
+
+				// The rays of a requested page may have found a closer hit since then, the page is then released without waiting for it
+				uint32_t runIdx = pendingRuns[pendingIdx];
+				const TDeferredPageRay* deferredRays = deferral.rays.data() + runs[runIdx];
+				uint32_t count = runs[runIdx + 1] - runs[runIdx];
+				TBVHPageTable& pageTable = *instances[deferredRays->instanceIndex].bottomLevel->pageTable;
+				if (deferred_run_needs_page<Flags>(deferredRays, count, hits, found))
+				{
+					const uint8_t* pageData = wait_for_bvh_page(pageTable, deferredRays->pageIndex);
+					trace_deferred_run<Flags>(accelerationStructure, deferredRays, count, pageData, rays, hits, found);
+				}
+				release_bvh_page(pageTable, deferredRays->pageIndex);
+				requestedBytes -= pageTable.pages[deferredRays->pageIndex].size;
+			}
+			deferral.rays.clear();
+		}
+
+		typedef void(*TResolveDeferredRaysFunction)(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, THit* hits, uint8_t* found, TBVHPageDeferral& deferral);
+		static const TResolveDeferredRaysFunction resolveDeferredRaysArray[RAY_FLAGS_NUM_TRAVERSAL_VARIANTS] =
+		{
+			resolve_deferred_rays<0>, resolve_deferred_rays<1>, resolve_deferred_rays<2>, resolve_deferred_rays<3>, resolve_deferred_rays<4>, resolve_deferred_rays<5>, resolve_deferred_rays<6>, resolve_deferred_rays<7>
+		};
+
+		bool intersect_closest(const TTopLevelAccelerationStructure& accelerationStructure, const TRay& ray, uint32_t instanceMask, THit& hit)
+		{
+			return intersect_ray(accelerationStructure, ray, RayFlags::None, instanceMask, hit);
+		}
+
+		bool intersect_ray(const TTopLevelAccelerationStructure& accelerationStructure, const TRay& ray, uint32_t rayFlags, uint32_t instanceMask, THit& hit)
+		{
+			// A single ray is a stream of one, the pages it put aside are traced once the resident ones gave it a closer hit
+			TBVHPageDeferral deferral;
+			deferral.rayIndex = 0;
+			uint8_t found = intersectRayArray[rayFlags & RAY_FLAGS_TRAVERSAL_MASK](accelerationStructure, ray, instanceMask, hit, deferral) ? 1 : 0;
+			if (!deferral.rays.empty())
+			{
+				resolveDeferredRaysArray[rayFlags & RAY_FLAGS_TRAVERSAL_MASK](accelerationStructure, &ray, &hit, &found, deferral);
+			}
+			return found != 0;
+		}
+
+		// Rays traced together, in structure of arrays so that the node tests process 4 of them per instruction
+		template<uint32_t N>
+		struct TRayPacket
+		{
+			float origin[3][N];
+			float direction[3][N];
+			float invDirection[3][N];
+			float tMin[N];
+			float tMax[N];
+
+			// Rays of the packet, and intervals covering them, the frustum test is only valid if all their directions have the same signs
+			uint32_t validMask;
+			bool coherent;
+			float originMin[3];
+			float originMax[3];
+			float invDirectionMin[3];
+			float invDirectionMax[3];
+			float tMinBound;
+			float tMaxBound;
+		};
+
+		// Largest tMax of the rays, the frustum test is conservative as long as it is not smaller than any of them
+		template<uint32_t N>
+		static inline void update_packet_distance_bound(TRayPacket<N>& packet)
+		{
+			packet.tMaxBound = 0.0f;
+			for (uint32_t mask = packet.validMask; mask != 0; mask &= mask - 1)
+			{
+				packet.tMaxBound = std::max(packet.tMaxBound, packet.tMax[first_bit_index(mask)]);
+			}
+		}
+
+		// Compute the inverse directions and the intervals of the rays of a packet once their origin and direction are set
+		template<uint32_t N>
+		static void prepare_packet(TRayPacket<N>& packet, uint32_t activeMask)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				packet.originMin[axis] = packet.invDirectionMin[axis] = FLT_MAX;
+				packet.originMax[axis] = packet.invDirectionMax[axis] = -FLT_MAX;
+			}
+			packet.tMinBound = FLT_MAX;
+
+			for (uint32_t mask = activeMask; mask != 0; mask &= mask - 1)
+			{
+				uint32_t lane = first_bit_index(mask);
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					// The interval products multiply the inverse direction by zero, it has to stay finite
+					float direction = packet.direction[axis][lane];
+					if (fabsf(direction) < 1e-20f) direction = direction < 0.0f ? -1e-20f : 1e-20f;
+					float invDirection = 1.0f / direction;
+					packet.invDirection[axis][lane] = invDirection;
+					packet.originMin[axis] = std::min(packet.originMin[axis], packet.origin[axis][lane]);
+					packet.originMax[axis] = std::max(packet.originMax[axis], packet.origin[axis][lane]);
+					packet.invDirectionMin[axis] = std::min(packet.invDirectionMin[axis], invDirection);
+					packet.invDirectionMax[axis] = std::max(packet.invDirectionMax[axis], invDirection);
+				}
+				packet.tMinBound = std::min(packet.tMinBound, packet.tMin[lane]);
+			}
+
+			packet.coherent = true;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				packet.coherent &= (packet.invDirectionMin[axis] >= 0.0f) == (packet.invDirectionMax[axis] >= 0.0f);
+			}
+			packet.validMask = activeMask;
+			update_packet_distance_bound(packet);
+		}
+
+		static inline float interval_product_min(float a0, float a1, float b0, float b1)
+		{
+			return std::min(std::min(a0 * b0, a0 * b1), std::min(a1 * b0, a1 * b1));
+		}
+
+		static inline float interval_product_max(float a0, float a1, float b0, float b1)
+		{
+			return std::max(std::max(a0 * b0, a0 * b1), std::max(a1 * b0, a1 * b1));
+		}
+
+		// Frustum test, bounds the entry and exit distances of all the rays of the packet with interval arithmetic
+		// Returns false if none of them can hit the box, true if some of them may
+		template<uint32_t N>
+		static inline bool packet_may_hit_box(const TRayPacket<N>& packet, const float* boxMin, const float* boxMax)
+		{
+			if (!packet.coherent) return true;
+
+			float tEnter = packet.tMinBound;
+			float tExit = packet.tMaxBound;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				bool positive = packet.invDirectionMin[axis] >= 0.0f;
+				float nearPlane = positive ? boxMin[axis] : boxMax[axis];
+				float farPlane = positive ? boxMax[axis] : boxMin[axis];
+				tEnter = std::max(tEnter, interval_product_min(nearPlane - packet.originMax[axis], nearPlane - packet.originMin[axis], packet.invDirectionMin[axis], packet.invDirectionMax[axis]));
+				tExit = std::min(tExit, interval_product_max(farPlane - packet.originMax[axis], farPlane - packet.originMin[axis], packet.invDirectionMin[axis], packet.invDirectionMax[axis]));
+			}
+			return tEnter <= tExit;
+		}
+
+		// Slab test of the active rays of a packet against a box, returns the mask of the rays that hit it and their entry distances
+		template<uint32_t N>
+		static inline uint32_t intersect_box_packet(const TRayPacket<N>& packet, const float* boxMin, const float* boxMax, uint32_t activeMask, float* distances)
+		{
+			uint32_t hitMask = 0;
+			for (uint32_t lane = 0; lane < N; lane += 4)
+			{
+				if (((activeMask >> lane) & 0xF) == 0) continue;
+
+				__m128 tEnter = _mm_loadu_ps(packet.tMin + lane);
+				__m128 tExit = _mm_loadu_ps(packet.tMax + lane);
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					__m128 origin = _mm_loadu_ps(packet.origin[axis] + lane);
+					__m128 invDirection = _mm_loadu_ps(packet.invDirection[axis] + lane);
+					__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boxMin[axis]), origin), invDirection);
+					__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boxMax[axis]), origin), invDirection);
+					tEnter = _mm_max_ps(tEnter, _mm_min_ps(t0, t1));
+					tExit = _mm_min_ps(tExit, _mm_max_ps(t0, t1));
+				}
+				_mm_storeu_ps(distances + lane, tEnter);
+				hitMask |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit)) << lane;
+			}
+			return hitMask & activeMask;
+		}
+
+		// Mask of the rays of a packet that hit a box, the frustum test skips the per ray test for the boxes the whole packet misses
+		template<uint32_t N>
+		static inline uint32_t cull_box_packet(const TRayPacket<N>& packet, const float* boxMin, const float* boxMax, uint32_t activeMask, float* distances)
+		{
+			if (!packet_may_hit_box(packet, boxMin, boxMax)) return 0;
+			return intersect_box_packet(packet, boxMin, boxMax, activeMask, distances);
+		}
+
+		// Entry of the packet traversal stacks, a node (or a wide leaf) and the rays that reached it
+		struct TPacketStackEntry
+		{
+			uint32_t item;
+			uint32_t activeMask;
+		};
+
+		// Packet version of traverse_bvh, the leaf function intersects a range of primitives with the active rays and returns the mask of those that hit
+		// With RayFlags::AcceptFirstHit the rays that found a hit are removed from the nodes that are popped afterwards
+		template<uint32_t N, uint32_t Flags, typename TLeafFunction>
+		static inline uint32_t traverse_bvh_packet(const TBVHNode* nodes, TRayPacket<N>& packet, uint32_t activeMask, const TLeafFunction& intersect_leaf)
+		{
+			float leftDistances[N], rightDistances[N];
+			activeMask = cull_box_packet(packet, nodes[0].min, nodes[0].max, activeMask, leftDistances);
+			if (activeMask == 0) return 0;
+
+			TPacketStackEntry stack[TRAVERSAL_STACK_SIZE];
+			uint32_t stackSize = 0;
+			uint32_t nodeIndex = 0;
+			uint32_t foundMask = 0;
+			while (true)
+			{
+				const TBVHNode& node = nodes[nodeIndex];
+				if (node.count != 0)
+				{
+					uint32_t leafMask = intersect_leaf(node.leftFirst, node.count, activeMask);
+					if (leafMask != 0)
+					{
+						foundMask |= leafMask;
+						update_packet_distance_bound(packet);
+					}
+				}
+				else
+				{
+					uint32_t leftIndex = node.leftFirst;
+					uint32_t rightIndex = node.leftFirst + 1;
+					uint32_t leftMask = cull_box_packet(packet, nodes[leftIndex].min, nodes[leftIndex].max, activeMask, leftDistances);
+					uint32_t rightMask = cull_box_packet(packet, nodes[rightIndex].min, nodes[rightIndex].max, activeMask, rightDistances);
+					if ((leftMask | rightMask) != 0)
+					{
+						// The order is chosen by the first ray that hits both children, or by the only child that is hit
+						uint32_t bothMask = leftMask & rightMask;
+						bool leftFirst = bothMask != 0 ? leftDistances[first_bit_index(bothMask)] <= rightDistances[first_bit_index(bothMask)] : leftMask != 0;
+						uint32_t nearIndex = leftFirst ? leftIndex : rightIndex;
+						uint32_t nearMask = leftFirst ? leftMask : rightMask;
+						uint32_t farMask = leftFirst ? rightMask : leftMask;
+						if (farMask != 0)
+						{
+							assert(stackSize < TRAVERSAL_STACK_SIZE);
+							stack[stackSize++] = { leftFirst ? rightIndex : leftIndex, farMask };
+						}
+						nodeIndex = nearIndex;
+						activeMask = nearMask;
+						continue;
+					}
+				}
+
+				do
+				{
+					if (stackSize == 0) return foundMask;
+					--stackSize;
+					nodeIndex = stack[stackSize].item;
+					activeMask = stack[stackSize].activeMask & ~((Flags & RayFlags::AcceptFirstHit) ? foundMask : 0u);
+				} while (activeMask == 0);
+			}
+		}
+
+		// Packet version of traverse_bvh8, the children bounds are dequantized once for the whole packet
+		template<uint32_t N, uint32_t Flags>
+		static inline uint32_t traverse_bvh8_packet(const TBottomLevelAccelerationStructure& accelerationStructure, TRayPacket<N>& packet, uint32_t activeMask, THit* hits)
+		{
+			const TIntersectPrimitiveGroupsFunction intersect_groups = accelerationStructure.intersect_groups[Flags & INTERSECTION_KERNEL_VARIANT_MASK];
+			const TBVH8Node* nodes = accelerationStructure.wideNodes;
+			const float* primitiveGroups = accelerationStructure.groups;
+			uint32_t groupSize = accelerationStructure.groupSize;
+
+			TPacketStackEntry stack[WIDE_TRAVERSAL_STACK_SIZE];
+			uint32_t stackSize = 0;
+			stack[stackSize++] = { 0, activeMask };
+			uint32_t foundMask = 0;
+
+			while (stackSize != 0)
+			{
+				TPacketStackEntry entry = stack[--stackSize];
+				entry.activeMask &= ~((Flags & RayFlags::AcceptFirstHit) ? foundMask : 0u);
+				if (entry.activeMask == 0) continue;
+
+				if (entry.item & WIDE_STACK_LEAF_FLAG)
+				{
+					const float* groups = primitiveGroups + (size_t)((entry.item & ~WIDE_STACK_LEAF_FLAG) >> 3) * groupSize;
+					uint32_t numGroups = entry.item & 7;
+					uint32_t leafMask = 0;
+					for (uint32_t mask = entry.activeMask; mask != 0; mask &= mask - 1)
+					{
+						uint32_t lane = first_bit_index(mask);
+						TRay ray = { { packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane] }, packet.tMin[lane],
+							{ packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane] }, packet.tMax[lane] };
+						leafMask |= intersect_groups(groups, numGroups, ray, packet.tMax[lane], hits[lane]) ? 1u << lane : 0u;
+					}
+					if (leafMask != 0)
+					{
+						foundMask |= leafMask;
+						update_packet_distance_bound(packet);
+					}
+					continue;
+				}
+
+				const TBVH8Node& node = nodes[entry.item];
+				TPacketStackEntry children[BVH8_WIDTH];
+				float childDistances[BVH8_WIDTH];
+				uint32_t numChildren = 0;
+				uint32_t innerRank = 0;
+				for (uint32_t slot = 0; slot < BVH8_WIDTH; ++slot)
+				{
+					bool inner = (node.innerMask >> slot) & 1;
+					innerRank += inner ? 1 : 0;
+					if (!inner && node.meta[slot] == 0) continue;
+
+					float boxMin[3], boxMax[3];
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						float scale = bvh8_scale(node.exponent[axis]);
+						boxMin[axis] = node.origin[axis] + node.quantizedMin[axis][slot] * scale;
+						boxMax[axis] = node.origin[axis] + node.quantizedMax[axis][slot] * scale;
+					}
+
+					float distances[N];
+					uint32_t childMask = cull_box_packet(packet, boxMin, boxMax, entry.activeMask, distances);
+					if (childMask == 0) continue;
+
+					TPacketStackEntry child;
+					child.activeMask = childMask;
+					if (inner)
+					{
+						child.item = node.childBaseIndex + innerRank - 1;
+					}
+					else
+					{
+						uint8_t meta = node.meta[slot];
+						child.item = WIDE_STACK_LEAF_FLAG | ((node.primitiveBaseIndex + (meta & 31)) << 3) | (meta >> 5);
+					}
+
+					// Sort from the farthest to the closest for the first ray that hits the child
+					float distance = distances[first_bit_index(childMask)];
+					uint32_t position = numChildren++;
+					while (position > 0 && childDistances[position - 1] < distance)
+					{
+						children[position] = children[position - 1];
+						childDistances[position] = childDistances[position - 1];
+						position--;
+					}
+					children[position] = child;
+					childDistances[position] = distance;
+				}
+
+				assert(stackSize + numChildren <= WIDE_TRAVERSAL_STACK_SIZE);
+				for (uint32_t childIdx = 0; childIdx < numChildren; ++childIdx)
+				{
+					stack[stackSize++] = children[childIdx];
+				}
+			}
+			return foundMask;
+		}
+
+		// Intersect the active rays of a packet one at a time with the groups of a leaf, returns the mask of those that hit
+		template<uint32_t N>
+		static inline uint32_t intersect_groups_packet(TIntersectPrimitiveGroupsFunction intersect_groups, const float* groups, uint32_t numGroups, TRayPacket<N>& packet, uint32_t leafMask, THit* hits)
+		{
+			uint32_t hitMask = 0;
+			for (; leafMask != 0; leafMask &= leafMask - 1)
+			{
+				uint32_t lane = first_bit_index(leafMask);
+				TRay ray = { { packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane] }, packet.tMin[lane],
+					{ packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane] }, packet.tMax[lane] };
+				hitMask |= intersect_groups(groups, numGroups, ray, packet.tMax[lane], hits[lane]) ? 1u << lane : 0u;
+			}
+			return hitMask;
+		}
+
+		// Packet version of intersect_page, the active rays put themselves aside with the index of their lane if the page is not resident
+		template<uint32_t N, uint32_t Flags>
+		static inline uint32_t intersect_page_packet(const TBottomLevelAccelerationStructure& accelerationStructure, uint32_t pageIndex, TRayPacket<N>& packet, uint32_t activeMask, THit* hits, TBVHPageDeferral& deferral)
+		{
+			TBVHPageTable& pageTable = *accelerationStructure.pageTable;
+			const uint8_t* pageData = acquire_bvh_page(pageTable, pageIndex);
+			if (pageData == nullptr)
+			{
+				uint32_t numDeferred = 0;
+				for (uint32_t mask = activeMask; mask != 0; mask &= mask - 1)
+				{
+					uint32_t lane = first_bit_index(mask);
+					float origin[3] = { packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane] };
+					float invDirection[3] = { packet.invDirection[0][lane], packet.invDirection[1][lane], packet.invDirection[2][lane] };
+					float tEnter = intersect_node(pageTable.pages[pageIndex].leaf, origin, invDirection, packet.tMin[lane], packet.tMax[lane]);
+					TDeferredPageRay deferredRay = { lane, deferral.instanceIndex, pageIndex, tEnter };
+					deferral.rays.push_back(deferredRay);
+					numDeferred++;
+				}
+				pageTable.cache->deferredRays.fetch_add(numDeferred, std::memory_order_relaxed);
+				return 0;
+			}
+
+			const float* primitiveGroups = (const float*)(pageData + (size_t)pageTable.pages[pageIndex].numNodes * sizeof(TBVHNode));
+			uint32_t groupSize = accelerationStructure.groupSize;
+			TIntersectPrimitiveGroupsFunction intersect_groups = accelerationStructure.intersect_groups[Flags & INTERSECTION_KERNEL_VARIANT_MASK];
+			uint32_t hitMask = traverse_bvh_packet<N, Flags>((const TBVHNode*)pageData, packet, activeMask, [&](uint32_t firstGroup, uint32_t numGroups, uint32_t leafMask)
+			{
+				return intersect_groups_packet(intersect_groups, primitiveGroups + (size_t)firstGroup * groupSize, numGroups, packet, leafMask, hits);
+			});
+			release_bvh_page(pageTable, pageIndex);
+			return hitMask;
+		}
+
+		// Packet version of intersect_bottom_level, the rays are in the space of the structure
+		// The intersection functions take one ray at a time, the custom primitives are traversed ray by ray
+		template<uint32_t N, uint32_t Flags>
+		static inline uint32_t intersect_bottom_level_packet(const TBottomLevelAccelerationStructure& accelerationStructure, TRayPacket<N>& packet, uint32_t activeMask, THit* hits, const THitGroupRecord* hitGroup, TBVHPageDeferral& deferral)
+		{
+			if (accelerationStructure.numGroups == 0) return 0;
+
+			if (accelerationStructure.geometryType == GeometryType::CustomPrimitives)
+			{
+				uint32_t hitMask = 0;
+				for (uint32_t mask = activeMask; mask != 0; mask &= mask - 1)
+				{
+					uint32_t lane = first_bit_index(mask);
+					TRay ray = { { packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane] }, packet.tMin[lane],
+						{ packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane] }, packet.tMax[lane] };
+					hitMask |= intersect_custom_primitives<Flags>(accelerationStructure, ray, packet.tMax[lane], hits[lane], hitGroup) ? 1u << lane : 0u;
+				}
+				return hitMask;
+			}
+
+			if (accelerationStructure.nodeFormat == BVHNodeFormat::Wide8)
+			{
+				return traverse_bvh8_packet<N, Flags>(accelerationStructure, packet, activeMask, hits);
+			}
+
+			const float* primitiveGroups = accelerationStructure.groups;
+			uint32_t groupSize = accelerationStructure.groupSize;
+			TIntersectPrimitiveGroupsFunction intersect_groups = accelerationStructure.intersect_groups[Flags & INTERSECTION_KERNEL_VARIANT_MASK];
+			return traverse_bvh_packet<N, Flags>(accelerationStructure.nodes, packet, activeMask, [&](uint32_t firstGroup, uint32_t numGroups, uint32_t leafMask)
+			{
+				if (numGroups == BVH_PAGE_LEAF_COUNT) return intersect_page_packet<N, Flags>(accelerationStructure, firstGroup, packet, leafMask, hits, deferral);
+				return intersect_groups_packet(intersect_groups, primitiveGroups + (size_t)firstGroup * groupSize, numGroups, packet, leafMask, hits);
+			});
+		}
+
+		template<uint32_t N, uint32_t Flags>
+		static uint32_t intersect_packet(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t instanceMask, THit* hits)
+		{
+			if (accelerationStructure.instances.empty()) return 0;
+
+			// Lanes past the rays are zeroed so that the 4 wide tests read defined values
+			TRayPacket<N> packet = {};
+			uint32_t activeMask = (uint32_t)((1ull << numRays) - 1);
+			for (uint32_t lane = 0; lane < numRays; ++lane)
+			{
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					packet.origin[axis][lane] = rays[lane].origin[axis];
+					packet.direction[axis][lane] = rays[lane].direction[axis];
+				}
+				packet.tMin[lane] = rays[lane].tMin;
+				packet.tMax[lane] = rays[lane].tMax;
+			}
+			prepare_packet(packet, activeMask);
+
+			const TInstance* instances = accelerationStructure.instances.data();
+			const uint32_t* instanceIndices = accelerationStructure.bvh.primitiveIndices.data();
+			TRayPacket<N> objectPacket = packet;
+			TBVHPageDeferral deferral;
+			uint32_t foundMask = traverse_bvh_packet<N, Flags>(accelerationStructure.bvh.nodes.data(), packet, activeMask, [&](uint32_t first, uint32_t count, uint32_t leafMask)
+			{
+				uint32_t hitMask = 0;
+				for (uint32_t idx = first; idx < first + count; ++idx)
+				{
+					uint32_t instanceIndex = instanceIndices[idx];
+					const TInstance& instance = instances[instanceIndex];
+					if ((instance.mask & instanceMask) == 0) continue;
+					if ((Flags & RayFlags::OpaqueOnly) && !instance.bottomLevel->opaque) continue;
+
+					// Same as the single ray path, the directions are not normalized
+					for (uint32_t mask = leafMask; mask != 0; mask &= mask - 1)
+					{
+						uint32_t lane = first_bit_index(mask);
+						float origin[3] = { packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane] };
+						float direction[3] = { packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane] };
+						float objectOrigin[3], objectDirection[3];
+						transform_point(instance.worldToObject, origin, objectOrigin);
+						transform_vector(instance.worldToObject, direction, objectDirection);
+						for (uint32_t axis = 0; axis < 3; ++axis)
+						{
+							objectPacket.origin[axis][lane] = objectOrigin[axis];
+							objectPacket.direction[axis][lane] = objectDirection[axis];
+						}
+						objectPacket.tMax[lane] = packet.tMax[lane];
+					}
+					prepare_packet(objectPacket, leafMask);
+
+					deferral.instanceIndex = instanceIndex;
+					uint32_t instanceHitMask = intersect_bottom_level_packet<N, Flags>(*instance.bottomLevel, objectPacket, leafMask, hits, custom_hit_group(accelerationStructure, instance), deferral);
+					for (uint32_t mask = instanceHitMask; mask != 0; mask &= mask - 1)
+					{
+						uint32_t lane = first_bit_index(mask);
+						packet.tMax[lane] = objectPacket.tMax[lane];
+						hits[lane].instanceIndex = instanceIndex;
+						hits[lane].instanceID = instance.instanceID;
+					}
+					hitMask |= instanceHitMask;
+
+					// The rays that accept their first hit do not visit the other instances
+					if (Flags & RayFlags::AcceptFirstHit)
+					{
+						leafMask &= ~instanceHitMask;
+						if (leafMask == 0) break;
+					}
+				}
+				return hitMask;
+			});
+
+			// The lanes that reached pages that are not resident are traced through them from the closest hit the packet found for them
+			if (!deferral.rays.empty())
+			{
+				uint8_t found[N];
+				for (uint32_t lane = 0; lane < numRays; ++lane)
+				{
+					found[lane] = (foundMask >> lane) & 1;
+				}
+				resolve_deferred_rays<Flags>(accelerationStructure, rays, hits, found, deferral);
+				foundMask = 0;
+				for (uint32_t lane = 0; lane < numRays; ++lane)
+				{
+					foundMask |= (uint32_t)found[lane] << lane;
+				}
+			}
+			return foundMask;
+		}
+
+		typedef uint32_t(*TIntersectPacketFunction)(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t instanceMask, THit* hits);
+		static const TIntersectPacketFunction intersectPacket8Array[RAY_FLAGS_NUM_TRAVERSAL_VARIANTS] =
+		{
+			intersect_packet<8, 0>, intersect_packet<8, 1>, intersect_packet<8, 2>, intersect_packet<8, 3>, intersect_packet<8, 4>, intersect_packet<8, 5>, intersect_packet<8, 6>, intersect_packet<8, 7>
+		};
+		static const TIntersectPacketFunction intersectPacket16Array[RAY_FLAGS_NUM_TRAVERSAL_VARIANTS] =
+		{
+			intersect_packet<16, 0>, intersect_packet<16, 1>, intersect_packet<16, 2>, intersect_packet<16, 3>, intersect_packet<16, 4>, intersect_packet<16, 5>, intersect_packet<16, 6>, intersect_packet<16, 7>
+		};
+
+		uint32_t intersect_closest_packet(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t instanceMask, THit* hits)
+		{
+			return intersect_packet(accelerationStructure, rays, numRays, RayFlags::None, instanceMask, hits);
+		}
+
+		uint32_t intersect_packet(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t rayFlags, uint32_t instanceMask, THit* hits)
+		{
+			assert(numRays <= RAY_PACKET_MAX_SIZE);
+			if (numRays == 0) return 0;
+
+			const TIntersectPacketFunction* intersectPacketArray = numRays <= 8 ? intersectPacket8Array : intersectPacket16Array;
+			return intersectPacketArray[rayFlags & RAY_FLAGS_TRAVERSAL_MASK](accelerationStructure, rays, numRays, instanceMask, hits);
+		}
+
+		void intersect_closest_stream(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t instanceMask, THit* hits, uint8_t* found)
+		{
+			intersect_stream(accelerationStructure, rays, numRays, RayFlags::None, instanceMask, hits, found);
+		}
+
+		void intersect_stream(const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t numRays, uint32_t rayFlags, uint32_t instanceMask, THit* hits, uint8_t* found)
+		{
+			if (accelerationStructure.instances.empty())
+			{
+				std::fill(found, found + numRays, (uint8_t)0);
+				return;
+			}
+
+			// The rays are traced one at a time in the order they come, packets of incoherent rays leave most of their lanes empty
+			// The rays that reach a page that is not resident go on with the other instances and come back to it once the stream is traced
+			TIntersectRayFunction intersect = intersectRayArray[rayFlags & RAY_FLAGS_TRAVERSAL_MASK];
+			TBVHPageDeferral deferral;
+			for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+			{
+				deferral.rayIndex = rayIdx;
+				found[rayIdx] = intersect(accelerationStructure, rays[rayIdx], instanceMask, hits[rayIdx], deferral) ? 1 : 0;
+			}
+			if (!deferral.rays.empty())
+			{
+				resolveDeferredRaysArray[rayFlags & RAY_FLAGS_TRAVERSAL_MASK](accelerationStructure, rays, hits, found, deferral);
+			}
+		}
+
+		void trace_ray(const TRayDispatchContext& context, const TRay& ray, uint32_t rayFlags, uint32_t instanceMask, void* payload)
+		{
+			const TTopLevelAccelerationStructure& accelerationStructure = *(const TTopLevelAccelerationStructure*)context.accelerationStructure;
+
+			THit hit;
+			if (intersect_ray(accelerationStructure, ray, rayFlags, instanceMask, hit))
+			{
+				if ((rayFlags & RayFlags::SkipClosestHit) == 0)
+				{
+					context.pipeline->closest_hit(context, ray, hit, payload);
+				}
+			}
+			else
+			{
+				context.pipeline->miss(context, ray, payload);
+			}
+		}
+
+		void dispatch_rays_region(const TRayDispatchContext& context, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, float* output, uint32_t outputStride)
+		{
+			TRayGenerationFunction rayGeneration = context.pipeline->ray_generation;
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				float* outputRow = output + (size_t)y * outputStride * 4;
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					rayGeneration(context, x0 + x, y0 + y, outputRow + x * 4);
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
 // Internal includes
 #include "d3d12_backend.h"
+#include "command_context_pool.h"
+#include "command_stream.h"
+#include "frame_ring.h"
 #include "renderer.h"
+#include "task_scheduler.h"
 
 // External includes
 #include <d3d12.h>
@@ -18,12 +22,15 @@ namespace dxr_demo
 		// D3D12 platform specific data
 		#define PLATFORM_DATA_HINSTANCE 0
 
-		// Frame buffer index
+		// Number of back buffers, which is also the number of frames the CPU can record ahead of the GPU (at most FRAME_RING_MAX_DEPTH)
 		#define NUM_SWAP_FRAME_BUFFERS 2
 
 		// The size of a descriptor heap page
 		#define DESCRIPTOR_HEAP_PAGE_SIZE 512
 
+		// Transitions of a barrier handed to the command list in a single call
+		#define D3D12_MAX_BATCHED_TRANSITIONS 16
+
 		// Forward declaration
 		struct D3D12RenderEnvironement;
 
@@ -38,23 +45,34 @@ namespace dxr_demo
 			uint32_t height;
 		};
 
+		// The stream that one thread records into, and the command list it is translated into at flush time with an allocator per back buffer
+		struct D3D12CommandContext
+		{
+			TCommandStream stream;
+			ID3D12CommandAllocator* commandAllocators[NUM_SWAP_FRAME_BUFFERS];
+			ID3D12GraphicsCommandList* commandList;
+
+			// Result of the last translation
+			HRESULT status;
+		};
+
 		// Structure that hold everything related to command submission and execution
 		struct D3D12CommandSystem
 		{
 			// The command queue is a object that allows us to submit command lists. (at least that is what i got from it at the moment)
 			ID3D12CommandQueue* commandQueue;
 
-			// The command allocator allows us to add new commands into the comand list, it cannot be shared between command lists
-			ID3D12CommandAllocator* commandAllocator;
-
-			// The command list is an object that allows to submit individual rendering requests (draw, compute, copy, dispatch)
-			ID3D12GraphicsCommandList* commandList;
+			// Contexts the threads record the frame into, and the contexts, streams and lists of the frame in submission order
+			TCommandContextPool<D3D12CommandContext> commandContexts;
+			std::vector<D3D12CommandContext*> submittedContexts;
+			std::vector<TCommandStream*> submittedStreams;
+			std::vector<ID3D12CommandList*> submittedLists;
 
 			// Fence to wait on the command list to be executed
 			ID3D12Fence* fence;
 
-			// Value that matches the fence
-			UINT64 fenceValue;
+			// Fence values of the frames in flight, the slots are the back buffers
+			TFrameRing frameRing;
 
 			// This manages to makes us hold on the fence to be passed
 			HANDLE fenceEvent;
@@ -108,9 +126,6 @@ namespace dxr_demo
 			// The rtv of the frame buffer
 			CD3DX12_CPU_DESCRIPTOR_HANDLE rtv;
 
-			// Fence value for the frame buffer
-			UINT64 fenceValue;
-
 			// The set of texture that are associated to this frame buffer
 			ID3D12Resource* resource;
 		};
@@ -152,9 +167,15 @@ namespace dxr_demo
 			// Swap chain system that hold everything relative to the swap mechanic
 			D3D12SwapChainSystem swapSystem;
 
+			// Time at which the render environment was created
+			std::chrono::steady_clock::time_point creationTime;
+
 			// Index of the current frame
 			uint64_t frameIndex;
 
+			// Scheduler of the renderer, the streams of the contexts are translated over its threads
+			TTaskScheduler* taskScheduler;
+
 			// Status check flag
 			HRESULT status_flag;
 		};
@@ -457,38 +478,57 @@ namespace dxr_demo
 					renderEnv.swapSystem.swap_buffer_array[bufferIdx].heapIndex = swapChainHeapIndex;
 					create_new_descriptor_heap_rtv_element(renderEnv, currentDescriptorHeap, renderEnv.swapSystem.swap_buffer_array[bufferIdx].resource, renderEnv.swapSystem.swap_buffer_array[bufferIdx].rtvIndex);
 					renderEnv.swapSystem.swap_buffer_array[bufferIdx].rtv = CD3DX12_CPU_DESCRIPTOR_HANDLE(currentDescriptorHeap.heapCpuStart, bufferIdx, currentDescriptorHeap.elementSize);
-					renderEnv.swapSystem.swap_buffer_array[bufferIdx].fenceValue = 0;
 				}
 
 				// AAAAND we are done.
 				return true;
 			}
 
-			bool create_command_allocator(D3D12RenderEnvironement& renderEnvironement)
+			void destroy_command_context(D3D12CommandContext* context)
 			{
-				// Create a command allocator for our command list
-				renderEnvironement.status_flag = renderEnvironement.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&renderEnvironement.commandSystem.commandAllocator));
-				return SUCCEEDED(renderEnvironement.status_flag);
+				destroy_command_stream(context->stream);
+				if (context->commandList)
+				{
+					context->commandList->Release();
+				}
+				for (uint32_t bufferIdx = 0; bufferIdx < NUM_SWAP_FRAME_BUFFERS; ++bufferIdx)
+				{
+					if (context->commandAllocators[bufferIdx])
+					{
+						context->commandAllocators[bufferIdx]->Release();
+					}
+				}
+				delete context;
 			}
 
-			bool create_command_list(D3D12RenderEnvironement& renderEnvironement)
+			D3D12CommandContext* create_command_context(D3D12RenderEnvironement& renderEnvironement)
 			{
-				// create the command list with the our allocator
-				renderEnvironement.status_flag = renderEnvironement.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, renderEnvironement.commandSystem.commandAllocator, NULL, IID_PPV_ARGS(&renderEnvironement.commandSystem.commandList));
-				if (FAILED(renderEnvironement.status_flag))
+				// Contexts are created from the recording threads, the failure is not reported through the status flag that the render thread owns
+				D3D12CommandContext* context = new D3D12CommandContext();
+				init_command_stream(context->stream);
+				for (uint32_t bufferIdx = 0; bufferIdx < NUM_SWAP_FRAME_BUFFERS; ++bufferIdx)
 				{
-					return false;
+					if (FAILED(renderEnvironement.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&context->commandAllocators[bufferIdx]))))
+					{
+						destroy_command_context(context);
+						return nullptr;
+					}
+				}
+				if (FAILED(renderEnvironement.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, context->commandAllocators[0], NULL, IID_PPV_ARGS(&context->commandList))))
+				{
+					destroy_command_context(context);
+					return nullptr;
 				}
 
-				// command lists are created in the recording state. our main loop will set it up for recording again so close it now
-				renderEnvironement.commandSystem.commandList->Close();
-				return true;
+				// Command lists are created in the recording state, it is reset when its stream is translated
+				context->commandList->Close();
+				return context;
 			}
 
 			bool create_fence(D3D12RenderEnvironement& renderEnvironement)
 			{    
 				renderEnvironement.status_flag = renderEnvironement.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&renderEnvironement.commandSystem.fence));
-				renderEnvironement.commandSystem.fenceValue = 0;
+				init_frame_ring(renderEnvironement.commandSystem.frameRing, NUM_SWAP_FRAME_BUFFERS);
 				return SUCCEEDED(renderEnvironement.status_flag);
 			}
 
@@ -498,6 +538,30 @@ namespace dxr_demo
 				return renderEnvironement.commandSystem.fenceEvent != nullptr;
 			}
 
+			bool wait_for_fence_value(D3D12RenderEnvironement& renderEnvironement, UINT64 fenceValue)
+			{
+				// Nothing to do if the GPU is already past this value
+				if (renderEnvironement.commandSystem.fence->GetCompletedValue() >= fenceValue)
+				{
+					return true;
+				}
+
+				renderEnvironement.status_flag = renderEnvironement.commandSystem.fence->SetEventOnCompletion(fenceValue, renderEnvironement.commandSystem.fenceEvent);
+				if (FAILED(renderEnvironement.status_flag))
+				{
+					return false;
+				}
+				::WaitForSingleObject(renderEnvironement.commandSystem.fenceEvent, INFINITE);
+				return true;
+			}
+
+			void drain_command_queue(D3D12RenderEnvironement& renderEnvironement)
+			{
+				// Wait for every submitted frame, after which none of the frame slots is in use
+				wait_for_fence_value(renderEnvironement, frame_ring_drain_value(renderEnvironement.commandSystem.frameRing));
+				reset_frame_ring(renderEnvironement.commandSystem.frameRing);
+			}
+
 			RenderEnvironment create_render_environment(const TGraphicSettings& graphic_settings)
 			{
 				D3D12RenderEnvironement* newRE = new D3D12RenderEnvironement();
@@ -511,17 +575,17 @@ namespace dxr_demo
 
 				// Initialize the command system
 				newRE->commandSystem.commandQueue = nullptr;
-				newRE->commandSystem.commandList = nullptr;
-				newRE->commandSystem.commandAllocator = nullptr;
 				newRE->commandSystem.fence = nullptr;
-				newRE->commandSystem.fenceValue = 0;
+				init_frame_ring(newRE->commandSystem.frameRing, NUM_SWAP_FRAME_BUFFERS);
 				newRE->commandSystem.fenceEvent = nullptr;
 
 				// Initialize the swap chain
 				newRE->swapSystem.swapChain = nullptr;
 
-				// Initialize the frame count
+				// Initialize the clock and the frame count
+				newRE->creationTime = std::chrono::steady_clock::now();
 				newRE->frameIndex = 0;
+				newRE->taskScheduler = graphic_settings.taskScheduler;
 
 				newRE->status_flag = S_OK;
 
@@ -570,20 +634,6 @@ namespace dxr_demo
 					return 0;
 				}
 
-				// Create the command allocator
-				if (!create_command_allocator(*newRE))
-				{
-					destroy_render_environment((RenderEnvironment)newRE);
-					return 0;
-				}
-
-				// Create the command list
-				if (!create_command_list(*newRE))
-				{
-					destroy_render_environment((RenderEnvironment)newRE);
-					return 0;
-				}
-
 				if (!create_fence(*newRE))
 				{
 					destroy_render_environment((RenderEnvironment)newRE);
@@ -602,6 +652,12 @@ namespace dxr_demo
 			{
 				D3D12RenderEnvironement* renderEnv = (D3D12RenderEnvironement*)render_environment;
 
+				// The GPU may still be using the resources of the frames in flight
+				if (renderEnv->commandSystem.fence && renderEnv->commandSystem.fenceEvent)
+				{
+					drain_command_queue(*renderEnv);
+				}
+
 				// Swap chain
 				for (uint32_t bufferIdx = 0; bufferIdx < NUM_SWAP_FRAME_BUFFERS; ++bufferIdx)
 				{
@@ -616,6 +672,10 @@ namespace dxr_demo
 				}
 
 				// Release the command system
+				for (D3D12CommandContext* context : renderEnv->commandSystem.commandContexts.contexts())
+				{
+					destroy_command_context(context);
+				}
 				if (renderEnv->commandSystem.fenceEvent)
 				{
 					CloseHandle(renderEnv->commandSystem.fenceEvent);
@@ -624,14 +684,6 @@ namespace dxr_demo
 				{
 					renderEnv->commandSystem.fence->Release();
 				}
-				if (renderEnv->commandSystem.commandList)
-				{
-					renderEnv->commandSystem.commandList->Release();
-				}
-				if (renderEnv->commandSystem.commandAllocator)
-				{
-					renderEnv->commandSystem.commandAllocator->Release();
-				}
 				if (renderEnv->commandSystem.commandQueue)
 				{
 					renderEnv->commandSystem.commandQueue->Release();
@@ -672,11 +724,13 @@ namespace dxr_demo
 					renderEnv->window.width = std::max(1u, width);
 					renderEnv->window.height = std::max(1u, height);
 
+					// The back buffers can only be released once the GPU is done with them
+					drain_command_queue(*renderEnv);
+
 					// Reset the buffers
 					for (uint32_t bufferIdx = 0; bufferIdx < NUM_SWAP_FRAME_BUFFERS; ++bufferIdx)
 					{
 						renderEnv->swapSystem.swap_buffer_array[bufferIdx].resource = nullptr;
-						renderEnv->swapSystem.swap_buffer_array[bufferIdx].fenceValue = 0;
 					}
 
 					// Get the previous descriptor of the swp chain
@@ -702,67 +756,168 @@ namespace dxr_demo
 
 			float get_time(RenderEnvironment render_environement)
 			{
-				return 0.0f;
+				D3D12RenderEnvironement* renderEnv = (D3D12RenderEnvironement*)render_environement;
+				std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - renderEnv->creationTime;
+				return elapsed.count();
 			}
 
 			bool initialize_frame(RenderEnvironment render_environement)
 			{
 				D3D12RenderEnvironement* renderEnv = (D3D12RenderEnvironement*)render_environement;
+				D3D12CommandSystem& commandSystem = renderEnv->commandSystem;
 
-				// Prepare the command list for the following frame
-				renderEnv->status_flag = renderEnv->commandSystem.commandAllocator->Reset();
-				renderEnv->status_flag |= renderEnv->commandSystem.commandList->Reset(renderEnv->commandSystem.commandAllocator, nullptr);
+				// Fetch which buffer is the current back buffer, it is also the slot of the frame
+				uint32_t backBuffer = renderEnv->swapSystem.swapChain->GetCurrentBackBufferIndex();
+				renderEnv->swapSystem.current_back_buffer = backBuffer;
 
-				// Fetch which buffer is the current back buffer
-				renderEnv->swapSystem.current_back_buffer = renderEnv->swapSystem.swapChain->GetCurrentBackBufferIndex();
+				// Only wait for the frame that last used this slot (N - NUM_SWAP_FRAME_BUFFERS), the more recent ones keep executing
+				uint64_t waitValue = acquire_frame_slot(commandSystem.frameRing, backBuffer, commandSystem.fence->GetCompletedValue());
+				if (waitValue != 0 && !wait_for_fence_value(*renderEnv, waitValue))
+				{
+					return false;
+				}
 
+				// The allocators of the slot are free, the contexts reset them when their streams are translated
 				// We moved to the next frame
 				renderEnv->frameIndex++;
-
-				return SUCCEEDED(renderEnv->status_flag);
+				return true;
 			}
 
-			bool flush_command_list(RenderEnvironment render_environement)
+			CommandContext acquire_command_context(RenderEnvironment render_environement, uint32_t submissionIndex)
 			{
-				// Cast the render environment
 				D3D12RenderEnvironement* renderEnv = (D3D12RenderEnvironement*)render_environement;
+				D3D12CommandContext* context = renderEnv->commandSystem.commandContexts.acquire(submissionIndex, [&]() { return create_command_context(*renderEnv); });
+				if (context == nullptr)
+				{
+					return 0;
+				}
 
-				// Change the state of the back buffer from render buffer to present for the present
-				CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(renderEnv->swapSystem.swap_buffer_array[renderEnv->swapSystem.current_back_buffer].resource, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-				renderEnv->commandSystem.commandList->ResourceBarrier(1, &barrier);
+				// Nothing reaches the API until the stream is translated at flush time
+				reset_command_stream(context->stream);
+				return (CommandContext)context;
+			}
 
-				// Everything that needed to be submitted is submitted, close the command list
-				renderEnv->status_flag = renderEnv->commandSystem.commandList->Close();
-				if (FAILED(renderEnv->status_flag))
+			D3D12_RESOURCE_STATES resource_state(ResourceState::Type state)
+			{
+				switch (state)
 				{
-					return false;
-				}
+					case ResourceState::Present:
+						return D3D12_RESOURCE_STATE_PRESENT;
+					case ResourceState::RenderTarget:
+						return D3D12_RESOURCE_STATE_RENDER_TARGET;
+					case ResourceState::UnorderedAccess:
+						return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+					case ResourceState::ShaderResource:
+						return D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+				};
+				return D3D12_RESOURCE_STATE_COMMON;
+			}
 
-				// create an array of command lists (only one command list here)
-				ID3D12CommandList* ppCommandLists[] = { renderEnv->commandSystem.commandList };
+			// Replay the stream of a context into its command list. The allocator of the slot is free, initialize_frame waited for the frame that last used it
+			HRESULT translate_command_context(D3D12RenderEnvironement& renderEnvironement, D3D12CommandContext& context)
+			{
+				ID3D12CommandAllocator* commandAllocator = context.commandAllocators[renderEnvironement.swapSystem.current_back_buffer];
+				HRESULT result = commandAllocator->Reset();
+				result = SUCCEEDED(result) ? context.commandList->Reset(commandAllocator, nullptr) : result;
+				if (FAILED(result))
+				{
+					return result;
+				}
 
-				// execute the array of command lists
-				renderEnv->commandSystem.commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+				for (const TCommandHeader* command = context.stream.first; command != nullptr; command = command->next)
+				{
+					switch (command->type)
+					{
+						case CommandType::Clear:
+						{
+							const TClearCommand& clear = *(const TClearCommand*)command;
+							context.commandList->ClearRenderTargetView(((D3D12FrameBuffer*)clear.target.frameBuffer)->rtv, clear.color, 0, nullptr);
+						}
+						break;
+						case CommandType::Barrier:
+						{
+							// The transitions of the batch go through as few calls as the local array allows
+							const TBarrierCommand& barrier = *(const TBarrierCommand*)command;
+							CD3DX12_RESOURCE_BARRIER transitions[D3D12_MAX_BATCHED_TRANSITIONS];
+							for (uint32_t firstTransition = 0; firstTransition < barrier.numTransitions; firstTransition += D3D12_MAX_BATCHED_TRANSITIONS)
+							{
+								uint32_t numTransitions = std::min(barrier.numTransitions - firstTransition, (uint32_t)D3D12_MAX_BATCHED_TRANSITIONS);
+								for (uint32_t transitionIdx = 0; transitionIdx < numTransitions; ++transitionIdx)
+								{
+									const TResourceTransition& transition = barrier.transitions[firstTransition + transitionIdx];
+									transitions[transitionIdx] = CD3DX12_RESOURCE_BARRIER::Transition(((D3D12FrameBuffer*)transition.frameBuffer)->resource, resource_state(transition.before), resource_state(transition.after));
+								}
+								context.commandList->ResourceBarrier(numTransitions, transitions);
+							}
+						}
+						break;
 
-				// Wait for the excecution to end
-				uint64_t fenceValueForSignal = ++renderEnv->commandSystem.fenceValue;
-				renderEnv->status_flag = renderEnv->commandSystem.commandQueue->Signal(renderEnv->commandSystem.fence, fenceValueForSignal);
-				return SUCCEEDED(renderEnv->status_flag);
+						// This backend records no ray tracing command, and the skipped ones have no effect
+						default:
+						break;
+					};
+				}
+				return context.commandList->Close();
 			}
 
-			void wait_for_fence_value(D3D12RenderEnvironement render_environement)
+			bool flush_command_list(RenderEnvironment render_environement)
 			{
-				uint64_t fenceCompletedValue = render_environement.commandSystem.fence->GetCompletedValue();
-				if (fenceCompletedValue < render_environement.commandSystem.fenceValue)
+				// Cast the render environment
+				D3D12RenderEnvironement* renderEnv = (D3D12RenderEnvironement*)render_environement;
+
+				// Gather the contexts in increasing submission index, and drop the commands that have no effect once their streams are put together
+				std::vector<D3D12CommandContext*>& submittedContexts = renderEnv->commandSystem.submittedContexts;
+				std::vector<TCommandStream*>& submittedStreams = renderEnv->commandSystem.submittedStreams;
+				submittedContexts.clear();
+				submittedStreams.clear();
+				for (const std::pair<uint32_t, D3D12CommandContext*>& context : renderEnv->commandSystem.commandContexts.sorted_contexts())
+				{
+					submittedContexts.push_back(context.second);
+					submittedStreams.push_back(&context.second->stream);
+				}
+				renderEnv->commandSystem.commandContexts.reset();
+				merge_command_streams(submittedStreams.data(), (uint32_t)submittedStreams.size());
+
+				// Every context has its own list and allocators, the threads of the scheduler translate them side by side
+				uint32_t numContexts = (uint32_t)submittedContexts.size();
+				if (renderEnv->taskScheduler)
 				{
-					render_environement.status_flag = render_environement.commandSystem.fence->SetEventOnCompletion(render_environement.commandSystem.fenceValue, render_environement.commandSystem.fenceEvent);
-					if (FAILED(render_environement.status_flag))
+					renderEnv->taskScheduler->parallel_for(numContexts, [&](uint32_t contextIdx, uint32_t)
 					{
-						return;
+						submittedContexts[contextIdx]->status = translate_command_context(*renderEnv, *submittedContexts[contextIdx]);
+					});
+				}
+				else
+				{
+					for (uint32_t contextIdx = 0; contextIdx < numContexts; ++contextIdx)
+					{
+						submittedContexts[contextIdx]->status = translate_command_context(*renderEnv, *submittedContexts[contextIdx]);
 					}
-					std::chrono::milliseconds duration = std::chrono::milliseconds::max();
-					::WaitForSingleObject(render_environement.commandSystem.fenceEvent, static_cast<DWORD>(duration.count()));
 				}
+
+				// The contexts are submitted in increasing submission index, they brought the back buffer back to the present state
+				std::vector<ID3D12CommandList*>& submittedLists = renderEnv->commandSystem.submittedLists;
+				submittedLists.clear();
+				for (D3D12CommandContext* context : submittedContexts)
+				{
+					renderEnv->status_flag = context->status;
+					if (FAILED(renderEnv->status_flag))
+					{
+						return false;
+					}
+					submittedLists.push_back(context->commandList);
+				}
+
+				// execute the array of command lists
+				if (!submittedLists.empty())
+				{
+					renderEnv->commandSystem.commandQueue->ExecuteCommandLists((UINT)submittedLists.size(), submittedLists.data());
+				}
+
+				// Signal the end of the frame, the slot and its back buffer are reused once the fence reaches this value
+				uint64_t fenceValueForSignal = submit_frame_slot(renderEnv->commandSystem.frameRing);
+				renderEnv->status_flag = renderEnv->commandSystem.commandQueue->Signal(renderEnv->commandSystem.fence, fenceValueForSignal);
+				return SUCCEEDED(renderEnv->status_flag);
 			}
 
 			bool present(RenderEnvironment render_environement)
@@ -778,8 +933,7 @@ namespace dxr_demo
 					running = false;
 				}
 
-				wait_for_fence_value(*renderEnv);
-
+				// The next frame only waits for its own slot in initialize_frame
 				return running;
 			}
 		}
@@ -805,22 +959,27 @@ namespace dxr_demo
 				return window->nativeWindow == currentWindow;
 			}
 
+			void swap(RenderWindow)
+			{
+				// The back buffers are presented through the swap chain when the frame is presented
+			}
 		}
 
 		namespace framebuffer
 		{
-			void clear(Framebuffer framebuffer, const float* clearColor)
+			void clear(CommandContext command_context, Framebuffer framebuffer, const float* clearColor)
 			{
-				D3D12FrameBuffer* currentFrameBuffer = (D3D12FrameBuffer*)framebuffer;
-				D3D12RenderEnvironement* renderEnv = currentFrameBuffer->renderEnvironement;
+				D3D12CommandContext* context = (D3D12CommandContext*)command_context;
 
-				// Notify the GPU that this render frame buffer needs to become a render target and no more a presentation frame buffer
-				CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition( currentFrameBuffer->resource, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-				// Wait for the state change
-				currentFrameBuffer->renderEnvironement->commandSystem.commandList->ResourceBarrier(1, &barrier);
+				// The frame buffer must be a render target, the descriptor handle of the render target is fetched when the stream is translated
+				record_clear(context->stream, framebuffer, clearColor);
+			}
 
-				// Grab the CPU descriptor handle of the render target
-				currentFrameBuffer->renderEnvironement->commandSystem.commandList->ClearRenderTargetView(currentFrameBuffer->rtv, clearColor, 0, nullptr);
+			void transition(CommandContext command_context, const TResourceTransition* transitions, uint32_t numTransitions)
+			{
+				// Issued as a single barrier when the stream is translated
+				D3D12CommandContext* context = (D3D12CommandContext*)command_context;
+				record_barrier(context->stream, transitions, numTransitions);
 			}
 		}
 	}
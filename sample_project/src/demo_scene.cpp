@@ -0,0 +1,662 @@
+// Internal includes
+#include "demo_scene.h"
+
+// External includes
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace dxr_demo
+{
+	// Data that travels with a ray between the pipeline functions
+	struct TDemoPayload
+	{
+		float color[3];
+		bool occluded;
+	};
+
+	// Constants of the hit group record of an instance, what the shading needs without going through the scene
+	struct TDemoHitGroupData
+	{
+		const TDemoMesh* mesh;
+		const float* transform;
+		const TDemoMaterial* material;
+	};
+
+	static inline void normalize(float* v)
+	{
+		float invLength = 1.0f / sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		v[0] *= invLength;
+		v[1] *= invLength;
+		v[2] *= invLength;
+	}
+
+	static inline void transform_point(const float* matrix, const float* point, float* result)
+	{
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			result[row] = matrix[4 * row] * point[0] + matrix[4 * row + 1] * point[1] + matrix[4 * row + 2] * point[2] + matrix[4 * row + 3];
+		}
+	}
+
+	// Number of small cubes spinning around the boxes
+	#define DEMO_NUM_RING_CUBES 48
+
+	// Number of surfaces the paths of the path tracer bounce on
+	#define DEMO_MAX_PATH_DEPTH 3
+
+	// Radiance the sun brings to a surface that faces it, relative to the albedo
+	#define DEMO_SUN_INTENSITY 0.85f
+
+	// Axis aligned box centered on the origin, its vertices and indices are appended to the storage of the scene
+	static void build_box_mesh(TDemoScene& scene, const float* halfSize)
+	{
+		TDemoMesh mesh = {};
+		mesh.vertexCount = 8;
+		mesh.indexCount = 36;
+		scene.meshes.push_back(mesh);
+
+		for (uint32_t cornerIdx = 0; cornerIdx < 8; ++cornerIdx)
+		{
+			scene.vertexStorage.push_back((cornerIdx & 1) ? halfSize[0] : -halfSize[0]);
+			scene.vertexStorage.push_back((cornerIdx & 2) ? halfSize[1] : -halfSize[1]);
+			scene.vertexStorage.push_back((cornerIdx & 4) ? halfSize[2] : -halfSize[2]);
+		}
+
+		// Two triangles per face
+		const uint32_t faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+		for (uint32_t faceIdx = 0; faceIdx < 6; ++faceIdx)
+		{
+			const uint32_t* face = faces[faceIdx];
+			const uint32_t triangles[6] = { face[0], face[1], face[2], face[0], face[2], face[3] };
+			scene.indexStorage.insert(scene.indexStorage.end(), triangles, triangles + 6);
+		}
+	}
+
+	static void add_material(TDemoScene& scene, const float* albedo)
+	{
+		TDemoMaterial material;
+		std::copy(albedo, albedo + 3, material.albedo);
+		material.textureIndex = SCENE_FILE_NO_TEXTURE;
+		scene.materials.push_back(material);
+	}
+
+	// Scale, rotation around the vertical axis and translation
+	static void write_transform(float* transform, const float* scale, float angle, const float* translation)
+	{
+		float cosAngle = cosf(angle);
+		float sinAngle = sinf(angle);
+		const float matrix[12] = {
+			cosAngle * scale[0], 0.0f, sinAngle * scale[2], translation[0],
+			0.0f, scale[1], 0.0f, translation[1],
+			-sinAngle * scale[0], 0.0f, cosAngle * scale[2], translation[2] };
+		std::copy(matrix, matrix + 12, transform);
+	}
+
+	static void add_instance(TDemoScene& scene, uint32_t meshIndex, uint32_t materialIndex, const float* scale, float angle, const float* translation)
+	{
+		TDemoInstance instance;
+		instance.meshIndex = meshIndex;
+		instance.materialIndex = materialIndex;
+		scene.instances.push_back(instance);
+
+		scene.transforms.resize(scene.transforms.size() + 12);
+		write_transform(&scene.transforms[scene.transforms.size() - 12], scale, angle, translation);
+	}
+
+	void build_demo_scene(TDemoScene& scene)
+	{
+		// Ground plane and a unit box that every other object is an instance of
+		const float groundHalfSize[3] = { 8.0f, 0.05f, 8.0f };
+		const float unitHalfSize[3] = { 1.0f, 1.0f, 1.0f };
+		build_box_mesh(scene, groundHalfSize);
+		build_box_mesh(scene, unitHalfSize);
+
+		// The meshes point in the storage once it stopped growing
+		size_t firstVertex = 0;
+		size_t firstIndex = 0;
+		for (TDemoMesh& mesh : scene.meshes)
+		{
+			mesh.vertices = &scene.vertexStorage[3 * firstVertex];
+			mesh.indices = &scene.indexStorage[firstIndex];
+			firstVertex += mesh.vertexCount;
+			firstIndex += mesh.indexCount;
+		}
+		scene.file = TSceneFile();
+
+		// Ground, boxes and ring cubes
+		const float groundAlbedo[3] = { 0.8f, 0.8f, 0.8f };
+		const float boxAlbedo[3] = { 0.9f, 0.4f, 0.2f };
+		const float cubeAlbedo[3] = { 0.2f, 0.5f, 0.9f };
+		add_material(scene, groundAlbedo);
+		add_material(scene, boxAlbedo);
+		add_material(scene, cubeAlbedo);
+
+		const float groundCenter[3] = { 0.0f, -0.05f, 0.0f };
+		const float identityScale[3] = { 1.0f, 1.0f, 1.0f };
+		add_instance(scene, 0, 0, identityScale, 0.0f, groundCenter);
+
+		// A few boxes on top of it
+		const float boxCenters[3][3] = { { 0.0f, 0.5f, 0.0f }, { 1.6f, 0.35f, 0.8f }, { -1.4f, 0.75f, 1.2f } };
+		const float boxHalfSizes[3][3] = { { 0.5f, 0.5f, 0.5f }, { 0.35f, 0.35f, 0.35f }, { 0.3f, 0.75f, 0.3f } };
+		for (uint32_t boxIdx = 0; boxIdx < 3; ++boxIdx)
+		{
+			add_instance(scene, 1, 1, boxHalfSizes[boxIdx], 0.0f, boxCenters[boxIdx]);
+		}
+
+		// The ring of cubes, placed by update_demo_scene
+		scene.firstAnimatedInstance = (uint32_t)scene.instances.size();
+		const float origin[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t cubeIdx = 0; cubeIdx < DEMO_NUM_RING_CUBES; ++cubeIdx)
+		{
+			add_instance(scene, 1, 2, identityScale, 0.0f, origin);
+		}
+		update_demo_scene(scene, 0.0f);
+
+		// Camera looking at the origin from the front
+		TCamera& camera = scene.camera;
+		camera.position[0] = 0.0f;
+		camera.position[1] = 2.0f;
+		camera.position[2] = -5.0f;
+		camera.forward[0] = -camera.position[0];
+		camera.forward[1] = 0.5f - camera.position[1];
+		camera.forward[2] = -camera.position[2];
+		normalize(camera.forward);
+		camera.right[0] = camera.forward[2];
+		camera.right[1] = 0.0f;
+		camera.right[2] = -camera.forward[0];
+		normalize(camera.right);
+		camera.up[0] = camera.forward[1] * camera.right[2] - camera.forward[2] * camera.right[1];
+		camera.up[1] = camera.forward[2] * camera.right[0] - camera.forward[0] * camera.right[2];
+		camera.up[2] = camera.forward[0] * camera.right[1] - camera.forward[1] * camera.right[0];
+		camera.tanHalfFov = tanf(0.5f * 60.0f * 3.14159265f / 180.0f);
+
+		// Light coming from the top left
+		scene.lightDirection[0] = -0.5f;
+		scene.lightDirection[1] = 1.0f;
+		scene.lightDirection[2] = -0.3f;
+		normalize(scene.lightDirection);
+	}
+
+	uint32_t num_demo_animated_instances(const TDemoScene& scene)
+	{
+		// A loaded scene may have fewer animated instances than the ring has cubes
+		return std::min((uint32_t)DEMO_NUM_RING_CUBES, (uint32_t)scene.instances.size() - scene.firstAnimatedInstance);
+	}
+
+	void update_demo_instance(TDemoScene& scene, uint32_t animatedIdx, float time)
+	{
+		// The ring turns slowly while every cube spins on itself
+		const float cubeScale[3] = { 0.12f, 0.12f, 0.12f };
+		float angle = 0.3f * time + 2.0f * 3.14159265f * animatedIdx / DEMO_NUM_RING_CUBES;
+		const float position[3] = { 3.0f * cosf(angle), 0.12f + 0.1f * (1.0f + sinf(3.0f * angle + 2.0f * time)), 3.0f * sinf(angle) };
+		write_transform(&scene.transforms[12 * (scene.firstAnimatedInstance + animatedIdx)], cubeScale, 2.0f * time + animatedIdx, position);
+	}
+
+	void update_demo_scene(TDemoScene& scene, float time)
+	{
+		uint32_t numCubes = num_demo_animated_instances(scene);
+		for (uint32_t cubeIdx = 0; cubeIdx < numCubes; ++cubeIdx)
+		{
+			update_demo_instance(scene, cubeIdx, time);
+		}
+	}
+
+	bool load_demo_scene(const char* path, TDemoScene& scene)
+	{
+		TSceneFile& file = scene.file;
+		if (!open_scene_file(path, file)) return false;
+
+		uint64_t numSettings, numMeshes, numVertices, numTriangles, numMaterials, numTextures, numTexels, numInstances;
+		const TSceneFileSettings* settings = (const TSceneFileSettings*)scene_file_section(file, SceneSection::Settings, sizeof(TSceneFileSettings), numSettings);
+		const TSceneFileMesh* meshes = (const TSceneFileMesh*)scene_file_section(file, SceneSection::Meshes, sizeof(TSceneFileMesh), numMeshes);
+		const float* vertices = (const float*)scene_file_section(file, SceneSection::Vertices, 3 * sizeof(float), numVertices);
+		const uint32_t* indices = (const uint32_t*)scene_file_section(file, SceneSection::Indices, 3 * sizeof(uint32_t), numTriangles);
+		const TSceneFileMaterial* materials = (const TSceneFileMaterial*)scene_file_section(file, SceneSection::Materials, sizeof(TSceneFileMaterial), numMaterials);
+		const TSceneFileTexture* textures = (const TSceneFileTexture*)scene_file_section(file, SceneSection::Textures, sizeof(TSceneFileTexture), numTextures);
+		const float* texels = (const float*)scene_file_section(file, SceneSection::Texels, sizeof(float), numTexels);
+		const TSceneFileInstance* instances = (const TSceneFileInstance*)scene_file_section(file, SceneSection::Instances, sizeof(TSceneFileInstance), numInstances);
+
+		// Every record must reference existing data, the index section counts triangles and the meshes count indices
+		bool valid = numSettings == 1 && settings->firstAnimatedInstance <= numInstances;
+		for (uint64_t meshIdx = 0; valid && meshIdx < numMeshes; ++meshIdx)
+		{
+			const TSceneFileMesh& mesh = meshes[meshIdx];
+			valid = mesh.indexCount % 3 == 0 && mesh.firstIndex % 3 == 0 && mesh.firstVertex + mesh.vertexCount <= numVertices && mesh.firstIndex + mesh.indexCount <= 3 * numTriangles;
+		}
+		for (uint64_t materialIdx = 0; valid && materialIdx < numMaterials; ++materialIdx)
+		{
+			valid = materials[materialIdx].textureIndex == SCENE_FILE_NO_TEXTURE || materials[materialIdx].textureIndex < numTextures;
+		}
+		for (uint64_t textureIdx = 0; valid && textureIdx < numTextures; ++textureIdx)
+		{
+			const TSceneFileTexture& texture = textures[textureIdx];
+			valid = texture.width > 0 && texture.height > 0 && texture.numChannels > 0 && texture.firstTexel + (uint64_t)texture.width * texture.height * texture.numChannels <= numTexels;
+		}
+		for (uint64_t instanceIdx = 0; valid && instanceIdx < numInstances; ++instanceIdx)
+		{
+			valid = instances[instanceIdx].meshIndex < numMeshes && instances[instanceIdx].materialIndex < numMaterials;
+		}
+		if (!valid)
+		{
+			close_scene_file(file);
+			return false;
+		}
+
+		// The meshes and the textures point in the mapping
+		scene.meshes.resize((size_t)numMeshes);
+		for (uint64_t meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
+		{
+			TDemoMesh& mesh = scene.meshes[meshIdx];
+			mesh.vertices = vertices + 3 * meshes[meshIdx].firstVertex;
+			mesh.indices = indices + meshes[meshIdx].firstIndex;
+			mesh.vertexCount = meshes[meshIdx].vertexCount;
+			mesh.indexCount = meshes[meshIdx].indexCount;
+		}
+		scene.textures.resize((size_t)numTextures);
+		for (uint64_t textureIdx = 0; textureIdx < numTextures; ++textureIdx)
+		{
+			TTextureView& texture = scene.textures[textureIdx];
+			texture.width = textures[textureIdx].width;
+			texture.height = textures[textureIdx].height;
+			texture.numChannels = textures[textureIdx].numChannels;
+			texture.data = texels + textures[textureIdx].firstTexel;
+		}
+
+		// The materials and the instances are small, the transforms are copied since the animation writes them
+		scene.materials.resize((size_t)numMaterials);
+		for (uint64_t materialIdx = 0; materialIdx < numMaterials; ++materialIdx)
+		{
+			std::copy(materials[materialIdx].albedo, materials[materialIdx].albedo + 3, scene.materials[materialIdx].albedo);
+			scene.materials[materialIdx].textureIndex = materials[materialIdx].textureIndex;
+		}
+		scene.instances.resize((size_t)numInstances);
+		scene.transforms.resize((size_t)numInstances * 12);
+		for (uint64_t instanceIdx = 0; instanceIdx < numInstances; ++instanceIdx)
+		{
+			scene.instances[instanceIdx].meshIndex = instances[instanceIdx].meshIndex;
+			scene.instances[instanceIdx].materialIndex = instances[instanceIdx].materialIndex;
+			std::copy(instances[instanceIdx].transform, instances[instanceIdx].transform + 12, &scene.transforms[12 * instanceIdx]);
+		}
+		scene.firstAnimatedInstance = settings->firstAnimatedInstance;
+
+		TCamera& camera = scene.camera;
+		std::copy(settings->cameraPosition, settings->cameraPosition + 3, camera.position);
+		std::copy(settings->cameraForward, settings->cameraForward + 3, camera.forward);
+		std::copy(settings->cameraRight, settings->cameraRight + 3, camera.right);
+		std::copy(settings->cameraUp, settings->cameraUp + 3, camera.up);
+		camera.tanHalfFov = settings->tanHalfFov;
+		std::copy(settings->lightDirection, settings->lightDirection + 3, scene.lightDirection);
+		return true;
+	}
+
+	bool save_demo_scene(const TDemoScene& scene, const char* path)
+	{
+		TSceneFileWriter writer;
+		if (!begin_scene_file(writer, path)) return false;
+
+		TSceneFileSettings settings = {};
+		const TCamera& camera = scene.camera;
+		std::copy(camera.position, camera.position + 3, settings.cameraPosition);
+		std::copy(camera.forward, camera.forward + 3, settings.cameraForward);
+		std::copy(camera.right, camera.right + 3, settings.cameraRight);
+		std::copy(camera.up, camera.up + 3, settings.cameraUp);
+		settings.tanHalfFov = camera.tanHalfFov;
+		std::copy(scene.lightDirection, scene.lightDirection + 3, settings.lightDirection);
+		settings.firstAnimatedInstance = scene.firstAnimatedInstance;
+		begin_scene_section(writer, SceneSection::Settings, sizeof(TSceneFileSettings));
+		write_scene_section(writer, &settings, 1);
+
+		// The meshes are packed one after the other in the vertex and index sections
+		begin_scene_section(writer, SceneSection::Meshes, sizeof(TSceneFileMesh));
+		TSceneFileMesh fileMesh = {};
+		for (const TDemoMesh& mesh : scene.meshes)
+		{
+			fileMesh.vertexCount = mesh.vertexCount;
+			fileMesh.indexCount = mesh.indexCount;
+			write_scene_section(writer, &fileMesh, 1);
+			fileMesh.firstVertex += mesh.vertexCount;
+			fileMesh.firstIndex += mesh.indexCount;
+		}
+		begin_scene_section(writer, SceneSection::Vertices, 3 * sizeof(float));
+		for (const TDemoMesh& mesh : scene.meshes)
+		{
+			write_scene_section(writer, mesh.vertices, mesh.vertexCount);
+		}
+		begin_scene_section(writer, SceneSection::Indices, 3 * sizeof(uint32_t));
+		for (const TDemoMesh& mesh : scene.meshes)
+		{
+			write_scene_section(writer, mesh.indices, mesh.indexCount / 3);
+		}
+
+		begin_scene_section(writer, SceneSection::Materials, sizeof(TSceneFileMaterial));
+		for (const TDemoMaterial& material : scene.materials)
+		{
+			TSceneFileMaterial fileMaterial;
+			std::copy(material.albedo, material.albedo + 3, fileMaterial.albedo);
+			fileMaterial.textureIndex = material.textureIndex;
+			write_scene_section(writer, &fileMaterial, 1);
+		}
+
+		begin_scene_section(writer, SceneSection::Textures, sizeof(TSceneFileTexture));
+		TSceneFileTexture fileTexture = {};
+		for (const TTextureView& texture : scene.textures)
+		{
+			fileTexture.width = texture.width;
+			fileTexture.height = texture.height;
+			fileTexture.numChannels = texture.numChannels;
+			write_scene_section(writer, &fileTexture, 1);
+			fileTexture.firstTexel += (uint64_t)texture.width * texture.height * texture.numChannels;
+		}
+		begin_scene_section(writer, SceneSection::Texels, sizeof(float));
+		for (const TTextureView& texture : scene.textures)
+		{
+			write_scene_section(writer, texture.data, (uint64_t)texture.width * texture.height * texture.numChannels);
+		}
+
+		begin_scene_section(writer, SceneSection::Instances, sizeof(TSceneFileInstance));
+		for (uint32_t instanceIdx = 0; instanceIdx < (uint32_t)scene.instances.size(); ++instanceIdx)
+		{
+			TSceneFileInstance fileInstance;
+			std::copy(&scene.transforms[12 * instanceIdx], &scene.transforms[12 * instanceIdx] + 12, fileInstance.transform);
+			fileInstance.meshIndex = scene.instances[instanceIdx].meshIndex;
+			fileInstance.materialIndex = scene.instances[instanceIdx].materialIndex;
+			write_scene_section(writer, &fileInstance, 1);
+		}
+		return end_scene_file(writer);
+	}
+
+	void release_demo_scene(TDemoScene& scene)
+	{
+		close_scene_file(scene.file);
+	}
+
+	TGeometryDescriptor demo_mesh_geometry(const TDemoMesh& mesh)
+	{
+		TGeometryDescriptor geometry;
+		geometry.type = GeometryType::Triangles;
+		geometry.vertexBuffer = mesh.vertices;
+		geometry.vertexCount = mesh.vertexCount;
+		geometry.vertexStride = 3 * sizeof(float);
+		geometry.indexBuffer = mesh.indices;
+		geometry.indexCount = mesh.indexCount;
+		geometry.opaque = true;
+		geometry.allowUpdate = false;
+		return geometry;
+	}
+
+	void demo_scene_instances(const TDemoScene& scene, const BottomLevelAccelerationStructure* bottomLevels, std::vector<TInstanceDescriptor>& instances)
+	{
+		instances.resize(scene.instances.size());
+		for (uint32_t instanceIdx = 0; instanceIdx < (uint32_t)scene.instances.size(); ++instanceIdx)
+		{
+			TInstanceDescriptor& instance = instances[instanceIdx];
+			std::copy(&scene.transforms[12 * instanceIdx], &scene.transforms[12 * instanceIdx] + 12, instance.transform);
+			instance.bottomLevel = bottomLevels[scene.instances[instanceIdx].meshIndex];
+			instance.instanceID = instanceIdx;
+			instance.mask = 0xFF;
+			instance.hitGroupIndex = instanceIdx;
+		}
+	}
+
+	// Pinhole camera ray through a point of the image, in pixels
+	static void camera_ray(const TCamera& camera, uint32_t width, uint32_t height, float x, float y, TRay& ray)
+	{
+		float aspectRatio = (float)width / (float)height;
+		float px = (2.0f * x / width - 1.0f) * camera.tanHalfFov * aspectRatio;
+		float py = (1.0f - 2.0f * y / height) * camera.tanHalfFov;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			ray.origin[axis] = camera.position[axis];
+			ray.direction[axis] = camera.forward[axis] + px * camera.right[axis] + py * camera.up[axis];
+		}
+		normalize(ray.direction);
+		ray.tMin = 0.0f;
+		ray.tMax = 1e30f;
+	}
+
+	static void demo_ray_generation(const TRayDispatchContext& context, uint32_t x, uint32_t y, float* outputColor)
+	{
+		const TDemoScene& scene = *(const TDemoScene*)context.pipeline->userData;
+		const TCamera& camera = scene.camera;
+
+		// Pinhole camera through the center of the pixel
+		TRay ray;
+		camera_ray(camera, context.width, context.height, x + 0.5f, y + 0.5f, ray);
+
+		TDemoPayload payload;
+		context.trace_ray(context, ray, RayFlags::None, 0xFF, &payload);
+
+		outputColor[0] = payload.color[0];
+		outputColor[1] = payload.color[1];
+		outputColor[2] = payload.color[2];
+		outputColor[3] = 1.0f;
+	}
+
+	// Geometric normal of a triangle of an instance in world space, facing the ray
+	static void hit_normal(const TDemoMesh& mesh, const float* transform, const TRay& ray, uint32_t primitiveIndex, float* normal)
+	{
+		float p0[3], p1[3], p2[3];
+		transform_point(transform, &mesh.vertices[3 * mesh.indices[3 * primitiveIndex]], p0);
+		transform_point(transform, &mesh.vertices[3 * mesh.indices[3 * primitiveIndex + 1]], p1);
+		transform_point(transform, &mesh.vertices[3 * mesh.indices[3 * primitiveIndex + 2]], p2);
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		normalize(normal);
+		if (normal[0] * ray.direction[0] + normal[1] * ray.direction[1] + normal[2] * ray.direction[2] > 0.0f)
+		{
+			normal[0] = -normal[0];
+			normal[1] = -normal[1];
+			normal[2] = -normal[2];
+		}
+	}
+
+	// Sky gradient, the direction must be normalized
+	static inline void sky_radiance(const float* direction, float* radiance)
+	{
+		float blend = 0.5f * (direction[1] + 1.0f);
+		radiance[0] = (1.0f - blend) + blend * 0.5f;
+		radiance[1] = (1.0f - blend) + blend * 0.7f;
+		radiance[2] = 1.0f;
+	}
+
+	// Albedo of a material at a world position
+	// The meshes have no texture coordinates, the textures are projected on the horizontal plane and repeat every unit
+	static inline void material_albedo(const TDemoScene& scene, const TDemoMaterial& material, const float* position, float* albedo)
+	{
+		std::copy(material.albedo, material.albedo + 3, albedo);
+		if (material.textureIndex == SCENE_FILE_NO_TEXTURE) return;
+
+		const TTextureView& texture = scene.textures[material.textureIndex];
+		float u = position[0] - floorf(position[0]);
+		float v = position[2] - floorf(position[2]);
+		uint32_t x = std::min((uint32_t)(u * texture.width), texture.width - 1);
+		uint32_t y = std::min((uint32_t)(v * texture.height), texture.height - 1);
+		const float* texel = texture.data + ((size_t)y * texture.width + x) * texture.numChannels;
+		for (uint32_t channel = 0; channel < 3; ++channel)
+		{
+			albedo[channel] *= texel[std::min(channel, texture.numChannels - 1)];
+		}
+	}
+
+	static void demo_closest_hit(const TRayDispatchContext& context, const TRay& ray, const THit& hit, void* payloadPtr)
+	{
+		TDemoPayload& payload = *(TDemoPayload*)payloadPtr;
+		const TDemoScene& scene = *(const TDemoScene*)context.pipeline->userData;
+		const TDemoInstance& instance = scene.instances[hit.instanceID];
+		float normal[3];
+		hit_normal(scene.meshes[instance.meshIndex], &scene.transforms[12 * hit.instanceID], ray, hit.primitiveIndex, normal);
+
+		// Shadow ray toward the light
+		TRay shadowRay;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			shadowRay.origin[axis] = ray.origin[axis] + hit.t * ray.direction[axis] + 1e-3f * normal[axis];
+			shadowRay.direction[axis] = scene.lightDirection[axis];
+		}
+		shadowRay.tMin = 0.0f;
+		shadowRay.tMax = 1e30f;
+
+		// Occlusion query, any hit will do and only the miss function runs
+		TDemoPayload shadowPayload;
+		shadowPayload.occluded = true;
+		context.trace_ray(context, shadowRay, RayFlags::AcceptFirstHit | RayFlags::SkipClosestHit, 0xFF, &shadowPayload);
+
+		// Lambert with a constant ambient term
+		float albedo[3];
+		material_albedo(scene, scene.materials[instance.materialIndex], shadowRay.origin, albedo);
+		float cosTheta = normal[0] * scene.lightDirection[0] + normal[1] * scene.lightDirection[1] + normal[2] * scene.lightDirection[2];
+		float lighting = 0.15f + (shadowPayload.occluded ? 0.0f : DEMO_SUN_INTENSITY * (cosTheta > 0.0f ? cosTheta : 0.0f));
+		payload.color[0] = lighting * albedo[0];
+		payload.color[1] = lighting * albedo[1];
+		payload.color[2] = lighting * albedo[2];
+	}
+
+	static void demo_miss(const TRayDispatchContext&, const TRay& ray, void* payloadPtr)
+	{
+		TDemoPayload& payload = *(TDemoPayload*)payloadPtr;
+		payload.occluded = false;
+		sky_radiance(ray.direction, payload.color);
+	}
+
+	TRayTracingPipeline demo_scene_pipeline(const TDemoScene& scene)
+	{
+		TRayTracingPipeline pipeline;
+		pipeline.ray_generation = demo_ray_generation;
+		pipeline.closest_hit = demo_closest_hit;
+		pipeline.miss = demo_miss;
+		pipeline.userData = &scene;
+		return pipeline;
+	}
+
+	static void demo_generate_camera_rays(const void* userData, uint32_t width, uint32_t height, const uint32_t* pixelIndices, uint32_t count, uint32_t* randomStates, TRay* rays)
+	{
+		const TDemoScene& scene = *(const TDemoScene*)userData;
+		for (uint32_t rayIdx = 0; rayIdx < count; ++rayIdx)
+		{
+			// The position in the pixel is jittered so that the samples of the pixel average into an antialiased result
+			uint32_t x = pixelIndices[rayIdx] % width;
+			uint32_t y = pixelIndices[rayIdx] / width;
+			float jitterX = next_random(randomStates[rayIdx]);
+			float jitterY = next_random(randomStates[rayIdx]);
+			camera_ray(scene.camera, width, height, x + jitterX, y + jitterY, rays[rayIdx]);
+		}
+	}
+
+	// Surface response of a batch of hits on an instance, the instance is described by the root data of its record
+	static void demo_closest_hit_batch(const void* userData, const void* rootData, const THitGroupBatch& batch, const TRay* rays, uint32_t* randomStates, TSurfaceSample* samples)
+	{
+		const TDemoScene& scene = *(const TDemoScene*)userData;
+		const TDemoHitGroupData& hitGroupData = *(const TDemoHitGroupData*)rootData;
+		for (uint32_t batchIdx = 0; batchIdx < batch.count; ++batchIdx)
+		{
+			uint32_t rayIdx = batch.rayIndices[batchIdx];
+			const TRay& ray = rays[rayIdx];
+			TSurfaceSample& sample = samples[rayIdx];
+			sample.emission[0] = sample.emission[1] = sample.emission[2] = 0.0f;
+			sample.directRadiance[0] = sample.directRadiance[1] = sample.directRadiance[2] = 0.0f;
+
+			float* normal = sample.normal;
+			hit_normal(*hitGroupData.mesh, hitGroupData.transform, ray, batch.primitiveIndices[batchIdx], normal);
+			float position[3];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				position[axis] = ray.origin[axis] + batch.t[batchIdx] * ray.direction[axis] + 1e-3f * normal[axis];
+			}
+			material_albedo(scene, *hitGroupData.material, position, sample.albedo);
+			const float* albedo = sample.albedo;
+
+			// Sun light, Lambert
+			float cosTheta = normal[0] * scene.lightDirection[0] + normal[1] * scene.lightDirection[1] + normal[2] * scene.lightDirection[2];
+			if (cosTheta > 0.0f)
+			{
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					sample.shadowRay.origin[axis] = position[axis];
+					sample.shadowRay.direction[axis] = scene.lightDirection[axis];
+					sample.directRadiance[axis] = DEMO_SUN_INTENSITY * cosTheta * albedo[axis];
+				}
+				sample.shadowRay.tMin = 0.0f;
+				sample.shadowRay.tMax = 1e30f;
+			}
+
+			// Cosine distributed bounce, the cosine and the pdf cancel out and leave the albedo as weight
+			float tangent[3];
+			if (fabsf(normal[0]) > 0.5f)
+			{
+				tangent[0] = -normal[2];
+				tangent[1] = 0.0f;
+				tangent[2] = normal[0];
+			}
+			else
+			{
+				tangent[0] = 0.0f;
+				tangent[1] = normal[2];
+				tangent[2] = -normal[1];
+			}
+			normalize(tangent);
+			float bitangent[3] = { normal[1] * tangent[2] - normal[2] * tangent[1], normal[2] * tangent[0] - normal[0] * tangent[2], normal[0] * tangent[1] - normal[1] * tangent[0] };
+
+			float radius = sqrtf(next_random(randomStates[rayIdx]));
+			float angle = 2.0f * 3.14159265f * next_random(randomStates[rayIdx]);
+			float localX = radius * cosf(angle);
+			float localY = radius * sinf(angle);
+			float localZ = sqrtf(std::max(0.0f, 1.0f - radius * radius));
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				sample.bounceRay.origin[axis] = position[axis];
+				sample.bounceRay.direction[axis] = localX * tangent[axis] + localY * bitangent[axis] + localZ * normal[axis];
+				sample.bounceWeight[axis] = albedo[axis];
+			}
+			sample.bounceRay.tMin = 0.0f;
+			sample.bounceRay.tMax = 1e30f;
+		}
+	}
+
+	// Sky seen by a batch of rays that left the scene
+	static void demo_miss_batch(const void*, const void*, const uint32_t* rayIndices, uint32_t count, const TRay* rays, TSurfaceSample* samples)
+	{
+		for (uint32_t batchIdx = 0; batchIdx < count; ++batchIdx)
+		{
+			TSurfaceSample& sample = samples[rayIndices[batchIdx]];
+			sky_radiance(rays[rayIndices[batchIdx]].direction, sample.emission);
+			sample.directRadiance[0] = sample.directRadiance[1] = sample.directRadiance[2] = 0.0f;
+			sample.bounceWeight[0] = sample.bounceWeight[1] = sample.bounceWeight[2] = 0.0f;
+			sample.albedo[0] = sample.albedo[1] = sample.albedo[2] = 1.0f;
+			sample.normal[0] = sample.normal[1] = sample.normal[2] = 0.0f;
+		}
+	}
+
+	TPathTracingPipeline demo_scene_path_tracing_pipeline(const TDemoScene& scene, std::vector<THitGroupRecord>& hitGroups)
+	{
+		// One record per instance, they share the functions and differ by their root data
+		static_assert(sizeof(TDemoHitGroupData) <= SHADER_RECORD_ROOT_DATA_SIZE, "The hit group data doesn't fit in a record");
+		hitGroups.resize(scene.instances.size());
+		for (uint32_t instanceIdx = 0; instanceIdx < (uint32_t)scene.instances.size(); ++instanceIdx)
+		{
+			THitGroupRecord& record = hitGroups[instanceIdx];
+			record.closest_hit = demo_closest_hit_batch;
+			record.any_hit = nullptr;
+			record.intersection = nullptr;
+
+			const TDemoInstance& instance = scene.instances[instanceIdx];
+			TDemoHitGroupData hitGroupData;
+			hitGroupData.mesh = &scene.meshes[instance.meshIndex];
+			hitGroupData.transform = &scene.transforms[12 * instanceIdx];
+			hitGroupData.material = &scene.materials[instance.materialIndex];
+			memcpy(record.rootData, &hitGroupData, sizeof(TDemoHitGroupData));
+		}
+
+		TPathTracingPipeline pipeline;
+		pipeline.generate_camera_rays = demo_generate_camera_rays;
+		pipeline.shaderBindingTable.hitGroups = hitGroups.data();
+		pipeline.shaderBindingTable.numHitGroups = (uint32_t)hitGroups.size();
+		pipeline.shaderBindingTable.miss.miss = demo_miss_batch;
+		pipeline.maxDepth = DEMO_MAX_PATH_DEPTH;
+		pipeline.userData = &scene;
+		return pipeline;
+	}
+}
\ No newline at end of file
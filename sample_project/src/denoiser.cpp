@@ -0,0 +1,366 @@
+// Internal includes
+#include "denoiser.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <emmintrin.h>
+
+namespace dxr_demo
+{
+	// Smallest albedo the radiance is divided by, darker surfaces are demodulated as if they had this albedo
+	#define DENOISER_ALBEDO_EPSILON 1e-3f
+
+	// Keeps the edge stopping functions finite on pixels with no variance or no depth
+	#define DENOISER_EPSILON 1e-4f
+
+	// Flush to zero and denormals are zero bits of the SSE control register
+	#define DENOISER_FLUSH_DENORMALS 0x8040u
+
+	// Number of rows a task of the passes processes, the rows of the demodulation are too short on their own to be worth a steal
+	#define DENOISER_ROW_GRAIN_SIZE 4
+
+	// B3 spline kernel of the a-trous filter, indexed by the distance of the tap in steps
+	static const float kernelWeights[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+	// Everything an iteration reads and writes, the images are planar with numPixels floats per plane
+	struct TFilterPass
+	{
+		uint32_t width;
+		uint32_t height;
+		size_t numPixels;
+
+		// Distance in pixels between two taps
+		uint32_t step;
+
+		// Input and output of the iteration
+		const float* irradiance;
+		const float* variance;
+		float* outIrradiance;
+		float* outVariance;
+
+		// Guides
+		const float* normals;
+		const float* depth;
+
+		// Only set on the last iteration, the filtered irradiance is multiplied by the albedo and written interleaved
+		const float* albedo;
+		float* output;
+
+		// Edge stopping settings
+		float colorPhi;
+		float depthPhi;
+		uint32_t normalSharpness;
+	};
+
+	TDenoiserSettings default_denoiser_settings()
+	{
+		TDenoiserSettings settings;
+		settings.numIterations = 5;
+		settings.colorPhi = 4.0f;
+		settings.normalSharpness = 7;
+		settings.depthPhi = 0.05f;
+		return settings;
+	}
+
+	static inline float luminance(float red, float green, float blue)
+	{
+		return 0.2126f * red + 0.7152f * green + 0.0722f * blue;
+	}
+
+	// exp(x) for x <= 0, x * log2(e) is rounded to the nearest integer that goes in the exponent bits, 2^remainder is a polynomial
+	// The weights only need a few digits, a degree 4 polynomial over [-0.5, 0.5] keeps the dependency chain short
+	static inline __m128 fast_exp(__m128 x)
+	{
+		__m128 t = _mm_mul_ps(_mm_max_ps(x, _mm_set1_ps(-87.0f)), _mm_set1_ps(1.44269504f));
+		__m128i integer = _mm_cvtps_epi32(t);
+		__m128 fraction = _mm_sub_ps(t, _mm_cvtepi32_ps(integer));
+		__m128 power = _mm_add_ps(_mm_mul_ps(fraction, _mm_set1_ps(0.00961812911f)), _mm_set1_ps(0.0555041087f));
+		power = _mm_add_ps(_mm_mul_ps(fraction, power), _mm_set1_ps(0.240226507f));
+		power = _mm_add_ps(_mm_mul_ps(fraction, power), _mm_set1_ps(0.693147181f));
+		power = _mm_add_ps(_mm_mul_ps(fraction, power), _mm_set1_ps(1.0f));
+		return _mm_mul_ps(power, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(integer, _mm_set1_epi32(127)), 23)));
+	}
+
+	// Filter a single pixel, used on the borders of the rows where the taps of four consecutive pixels do not all fall inside the image
+	static void filter_pixel(const TFilterPass& pass, uint32_t x, uint32_t y, float* color, float& variance)
+	{
+		const size_t numPixels = pass.numPixels;
+		const size_t center = (size_t)y * pass.width + x;
+		const float* irradiance = pass.irradiance;
+		const float* normals = pass.normals;
+		float centerLuminance = luminance(irradiance[center], irradiance[numPixels + center], irradiance[2 * numPixels + center]);
+		float centerDepth = pass.depth[center];
+		float colorScale = 1.0f / (pass.colorPhi * sqrtf(pass.variance[center]) + DENOISER_EPSILON);
+		float depthScale = 1.0f / (pass.depthPhi * pass.step * centerDepth + DENOISER_EPSILON);
+
+		float weightSum = 0.0f, varianceSum = 0.0f;
+		float sum[3] = { 0.0f, 0.0f, 0.0f };
+		for (int32_t dy = -2; dy <= 2; ++dy)
+		{
+			int32_t tapY = (int32_t)y + dy * (int32_t)pass.step;
+			if (tapY < 0 || tapY >= (int32_t)pass.height) continue;
+			for (int32_t dx = -2; dx <= 2; ++dx)
+			{
+				int32_t tapX = (int32_t)x + dx * (int32_t)pass.step;
+				if (tapX < 0 || tapX >= (int32_t)pass.width) continue;
+
+				size_t tap = (size_t)tapY * pass.width + tapX;
+				float weight = kernelWeights[abs(dx)] * kernelWeights[abs(dy)];
+				if (dx != 0 || dy != 0)
+				{
+					float cosine = std::max(0.0f, normals[center] * normals[tap] + normals[numPixels + center] * normals[numPixels + tap] + normals[2 * numPixels + center] * normals[2 * numPixels + tap]);
+					for (uint32_t squareIdx = 0; squareIdx < pass.normalSharpness; ++squareIdx)
+					{
+						cosine *= cosine;
+					}
+					float tapLuminance = luminance(irradiance[tap], irradiance[numPixels + tap], irradiance[2 * numPixels + tap]);
+					float distance = fabsf(centerLuminance - tapLuminance) * colorScale + fabsf(centerDepth - pass.depth[tap]) * depthScale;
+					weight *= cosine * _mm_cvtss_f32(fast_exp(_mm_set_ss(-distance)));
+				}
+
+				weightSum += weight;
+				varianceSum += weight * weight * pass.variance[tap];
+				sum[0] += weight * irradiance[tap];
+				sum[1] += weight * irradiance[numPixels + tap];
+				sum[2] += weight * irradiance[2 * numPixels + tap];
+			}
+		}
+
+		// The center tap always has a non zero weight
+		float invWeightSum = 1.0f / weightSum;
+		color[0] = sum[0] * invWeightSum;
+		color[1] = sum[1] * invWeightSum;
+		color[2] = sum[2] * invWeightSum;
+		variance = varianceSum * invWeightSum * invWeightSum;
+	}
+
+	// Same as filter_pixel for the four pixels that start at x, the caller guarantees that all their taps are inside the row
+	static void filter_quad(const TFilterPass& pass, uint32_t x, uint32_t y, __m128* color, __m128& variance)
+	{
+		const size_t numPixels = pass.numPixels;
+		const size_t center = (size_t)y * pass.width + x;
+		const float* irradiance = pass.irradiance;
+		const float* normals = pass.normals;
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 epsilon = _mm_set1_ps(DENOISER_EPSILON);
+		const __m128 redWeight = _mm_set1_ps(0.2126f), greenWeight = _mm_set1_ps(0.7152f), blueWeight = _mm_set1_ps(0.0722f);
+
+		__m128 centerNormal[3] = { _mm_loadu_ps(normals + center), _mm_loadu_ps(normals + numPixels + center), _mm_loadu_ps(normals + 2 * numPixels + center) };
+		__m128 centerLuminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(redWeight, _mm_loadu_ps(irradiance + center)), _mm_mul_ps(greenWeight, _mm_loadu_ps(irradiance + numPixels + center))),
+			_mm_mul_ps(blueWeight, _mm_loadu_ps(irradiance + 2 * numPixels + center)));
+		__m128 centerDepth = _mm_loadu_ps(pass.depth + center);
+		__m128 colorScale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pass.colorPhi), _mm_sqrt_ps(_mm_loadu_ps(pass.variance + center))), epsilon));
+		__m128 depthScale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pass.depthPhi * pass.step), centerDepth), epsilon));
+
+		__m128 weightSum = zero, varianceSum = zero;
+		__m128 sum[3] = { zero, zero, zero };
+		for (int32_t dy = -2; dy <= 2; ++dy)
+		{
+			int32_t tapY = (int32_t)y + dy * (int32_t)pass.step;
+			if (tapY < 0 || tapY >= (int32_t)pass.height) continue;
+			for (int32_t dx = -2; dx <= 2; ++dx)
+			{
+				size_t tap = (size_t)tapY * pass.width + (size_t)((int32_t)x + dx * (int32_t)pass.step);
+				__m128 tapColor[3] = { _mm_loadu_ps(irradiance + tap), _mm_loadu_ps(irradiance + numPixels + tap), _mm_loadu_ps(irradiance + 2 * numPixels + tap) };
+				__m128 weight = _mm_set1_ps(kernelWeights[abs(dx)] * kernelWeights[abs(dy)]);
+				if (dx != 0 || dy != 0)
+				{
+					__m128 cosine = _mm_mul_ps(centerNormal[0], _mm_loadu_ps(normals + tap));
+					cosine = _mm_add_ps(cosine, _mm_mul_ps(centerNormal[1], _mm_loadu_ps(normals + numPixels + tap)));
+					cosine = _mm_max_ps(_mm_add_ps(cosine, _mm_mul_ps(centerNormal[2], _mm_loadu_ps(normals + 2 * numPixels + tap))), zero);
+					for (uint32_t squareIdx = 0; squareIdx < pass.normalSharpness; ++squareIdx)
+					{
+						cosine = _mm_mul_ps(cosine, cosine);
+					}
+					__m128 tapLuminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(redWeight, tapColor[0]), _mm_mul_ps(greenWeight, tapColor[1])), _mm_mul_ps(blueWeight, tapColor[2]));
+					__m128 distance = _mm_mul_ps(_mm_andnot_ps(signMask, _mm_sub_ps(centerLuminance, tapLuminance)), colorScale);
+					distance = _mm_add_ps(distance, _mm_mul_ps(_mm_andnot_ps(signMask, _mm_sub_ps(centerDepth, _mm_loadu_ps(pass.depth + tap))), depthScale));
+					weight = _mm_mul_ps(weight, _mm_mul_ps(cosine, fast_exp(_mm_sub_ps(zero, distance))));
+				}
+
+				weightSum = _mm_add_ps(weightSum, weight);
+				varianceSum = _mm_add_ps(varianceSum, _mm_mul_ps(_mm_mul_ps(weight, weight), _mm_loadu_ps(pass.variance + tap)));
+				sum[0] = _mm_add_ps(sum[0], _mm_mul_ps(weight, tapColor[0]));
+				sum[1] = _mm_add_ps(sum[1], _mm_mul_ps(weight, tapColor[1]));
+				sum[2] = _mm_add_ps(sum[2], _mm_mul_ps(weight, tapColor[2]));
+			}
+		}
+
+		__m128 invWeightSum = _mm_div_ps(_mm_set1_ps(1.0f), weightSum);
+		color[0] = _mm_mul_ps(sum[0], invWeightSum);
+		color[1] = _mm_mul_ps(sum[1], invWeightSum);
+		color[2] = _mm_mul_ps(sum[2], invWeightSum);
+		variance = _mm_mul_ps(varianceSum, _mm_mul_ps(invWeightSum, invWeightSum));
+	}
+
+	// Write the result of a pixel, either in the planes of the next iteration or modulated into the output
+	static inline void store_pixel(const TFilterPass& pass, size_t pixelIdx, const float* color, float variance)
+	{
+		if (pass.output)
+		{
+			for (uint32_t channel = 0; channel < 3; ++channel)
+			{
+				pass.output[3 * pixelIdx + channel] = color[channel] * std::max(pass.albedo[3 * pixelIdx + channel], DENOISER_ALBEDO_EPSILON);
+			}
+			return;
+		}
+		pass.outIrradiance[pixelIdx] = color[0];
+		pass.outIrradiance[pass.numPixels + pixelIdx] = color[1];
+		pass.outIrradiance[2 * pass.numPixels + pixelIdx] = color[2];
+		pass.outVariance[pixelIdx] = variance;
+	}
+
+	// One iteration over a row, the pixels far enough from the borders are filtered four at a time
+	static void filter_row(const TFilterPass& pass, uint32_t y)
+	{
+		// The weights of the taps across edges underflow, denormals are flushed to zero while the row is filtered as they are very slow to compute with
+		const uint32_t controlStatus = _mm_getcsr();
+		_mm_setcsr(controlStatus | DENOISER_FLUSH_DENORMALS);
+
+		const uint32_t border = 2 * pass.step;
+		const uint32_t quadEnd = pass.width > 2 * border ? pass.width - border : 0;
+		uint32_t x = 0;
+		for (; x < std::min(border, pass.width); ++x)
+		{
+			float color[3], variance;
+			filter_pixel(pass, x, y, color, variance);
+			store_pixel(pass, (size_t)y * pass.width + x, color, variance);
+		}
+
+		for (; x + 4 <= quadEnd; x += 4)
+		{
+			__m128 color[3], variance;
+			filter_quad(pass, x, y, color, variance);
+			size_t pixelIdx = (size_t)y * pass.width + x;
+			if (pass.output)
+			{
+				float colorArray[3][4], varianceArray[4];
+				_mm_storeu_ps(colorArray[0], color[0]);
+				_mm_storeu_ps(colorArray[1], color[1]);
+				_mm_storeu_ps(colorArray[2], color[2]);
+				_mm_storeu_ps(varianceArray, variance);
+				for (uint32_t lane = 0; lane < 4; ++lane)
+				{
+					float laneColor[3] = { colorArray[0][lane], colorArray[1][lane], colorArray[2][lane] };
+					store_pixel(pass, pixelIdx + lane, laneColor, varianceArray[lane]);
+				}
+				continue;
+			}
+			_mm_storeu_ps(pass.outIrradiance + pixelIdx, color[0]);
+			_mm_storeu_ps(pass.outIrradiance + pass.numPixels + pixelIdx, color[1]);
+			_mm_storeu_ps(pass.outIrradiance + 2 * pass.numPixels + pixelIdx, color[2]);
+			_mm_storeu_ps(pass.outVariance + pixelIdx, variance);
+		}
+
+		for (; x < pass.width; ++x)
+		{
+			float color[3], variance;
+			filter_pixel(pass, x, y, color, variance);
+			store_pixel(pass, (size_t)y * pass.width + x, color, variance);
+		}
+		_mm_setcsr(controlStatus);
+	}
+
+	// Size the scratch for a frame, this only allocates when the dimensions change
+	static void prepare_denoiser(TDenoiser& denoiser, uint32_t width, uint32_t height)
+	{
+		if (denoiser.width == width && denoiser.height == height && !denoiser.depth.empty()) return;
+		denoiser.width = width;
+		denoiser.height = height;
+
+		size_t numPixels = (size_t)width * height;
+		for (uint32_t bufferIdx = 0; bufferIdx < 2; ++bufferIdx)
+		{
+			denoiser.irradiance[bufferIdx].resize(3 * numPixels);
+			denoiser.variance[bufferIdx].resize(numPixels);
+		}
+		denoiser.normals.resize(3 * numPixels);
+		denoiser.depth.resize(numPixels);
+	}
+
+	void denoise(TDenoiser& denoiser, const TTextureDescriptor& radiance, const TTextureDescriptor& albedo, const TTextureDescriptor& normal, const TTextureDescriptor& depth,
+		const TDenoiserSettings& settings, TTaskScheduler& taskScheduler, TTextureDescriptor& output)
+	{
+		const uint32_t width = radiance.width;
+		const uint32_t height = radiance.height;
+		const size_t numPixels = (size_t)width * height;
+		prepare_denoiser(denoiser, width, height);
+		output.width = width;
+		output.height = height;
+		output.data.resize(3 * numPixels);
+		if (settings.numIterations == 0)
+		{
+			std::copy(radiance.data.begin(), radiance.data.begin() + 3 * numPixels, output.data.begin());
+			return;
+		}
+
+		// Demodulate the albedo and move the guides to planes, the luminance is kept for the variance estimation
+		float* luminanceBuffer = denoiser.variance[1].data();
+		taskScheduler.parallel_for(height, [&](uint32_t y, uint32_t)
+		{
+			for (size_t pixelIdx = (size_t)y * width; pixelIdx < (size_t)(y + 1) * width; ++pixelIdx)
+			{
+				for (uint32_t channel = 0; channel < 3; ++channel)
+				{
+					denoiser.irradiance[0][channel * numPixels + pixelIdx] = radiance.data[3 * pixelIdx + channel] / std::max(albedo.data[3 * pixelIdx + channel], DENOISER_ALBEDO_EPSILON);
+					denoiser.normals[channel * numPixels + pixelIdx] = normal.data[3 * pixelIdx + channel];
+				}
+				denoiser.depth[pixelIdx] = depth.data[pixelIdx];
+				luminanceBuffer[pixelIdx] = luminance(denoiser.irradiance[0][pixelIdx], denoiser.irradiance[0][numPixels + pixelIdx], denoiser.irradiance[0][2 * numPixels + pixelIdx]);
+			}
+		}, DENOISER_ROW_GRAIN_SIZE);
+
+		// There is no history to estimate the variance over time, it is estimated over the 3x3 neighborhood instead
+		taskScheduler.parallel_for(height, [&](uint32_t y, uint32_t)
+		{
+			uint32_t firstY = y > 0 ? y - 1 : 0, lastY = std::min(y + 1, height - 1);
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				uint32_t firstX = x > 0 ? x - 1 : 0, lastX = std::min(x + 1, width - 1);
+				float sum = 0.0f, squareSum = 0.0f;
+				for (uint32_t tapY = firstY; tapY <= lastY; ++tapY)
+				{
+					for (uint32_t tapX = firstX; tapX <= lastX; ++tapX)
+					{
+						float value = luminanceBuffer[(size_t)tapY * width + tapX];
+						sum += value;
+						squareSum += value * value;
+					}
+				}
+				float invCount = 1.0f / ((lastY - firstY + 1) * (lastX - firstX + 1));
+				float mean = sum * invCount;
+				denoiser.variance[0][(size_t)y * width + x] = std::max(0.0f, squareSum * invCount - mean * mean);
+			}
+		}, DENOISER_ROW_GRAIN_SIZE);
+
+		// The iterations ping-pong between the two buffers, the last one writes the output
+		TFilterPass pass;
+		pass.width = width;
+		pass.height = height;
+		pass.numPixels = numPixels;
+		pass.normals = denoiser.normals.data();
+		pass.depth = denoiser.depth.data();
+		pass.colorPhi = settings.colorPhi;
+		pass.depthPhi = settings.depthPhi;
+		pass.normalSharpness = settings.normalSharpness;
+		for (uint32_t iteration = 0; iteration < settings.numIterations; ++iteration)
+		{
+			bool lastIteration = iteration + 1 == settings.numIterations;
+			pass.step = 1u << iteration;
+			pass.irradiance = denoiser.irradiance[iteration % 2].data();
+			pass.variance = denoiser.variance[iteration % 2].data();
+			pass.outIrradiance = denoiser.irradiance[(iteration + 1) % 2].data();
+			pass.outVariance = denoiser.variance[(iteration + 1) % 2].data();
+			pass.albedo = lastIteration ? albedo.data.data() : nullptr;
+			pass.output = lastIteration ? output.data.data() : nullptr;
+			taskScheduler.parallel_for(height, [&](uint32_t y, uint32_t)
+			{
+				filter_row(pass, y);
+			}, DENOISER_ROW_GRAIN_SIZE);
+		}
+	}
+}
\ No newline at end of file
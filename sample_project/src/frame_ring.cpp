@@ -0,0 +1,44 @@
+// Internal includes
+#include "frame_ring.h"
+
+namespace dxr_demo
+{
+	void init_frame_ring(TFrameRing& ring, uint32_t depth, uint64_t initialValue)
+	{
+		ring.depth = depth < 1 ? 1 : (depth > FRAME_RING_MAX_DEPTH ? FRAME_RING_MAX_DEPTH : depth);
+		ring.currentSlot = ring.depth - 1;
+		ring.signaledValue = initialValue;
+		reset_frame_ring(ring);
+	}
+
+	uint32_t next_frame_slot(const TFrameRing& ring)
+	{
+		return (ring.currentSlot + 1) % ring.depth;
+	}
+
+	uint64_t acquire_frame_slot(TFrameRing& ring, uint32_t slot, uint64_t completedValue)
+	{
+		ring.currentSlot = slot % ring.depth;
+		uint64_t fenceValue = ring.slotFenceValues[ring.currentSlot];
+		return fenceValue > completedValue ? fenceValue : 0;
+	}
+
+	uint64_t submit_frame_slot(TFrameRing& ring)
+	{
+		ring.slotFenceValues[ring.currentSlot] = ++ring.signaledValue;
+		return ring.signaledValue;
+	}
+
+	uint64_t frame_ring_drain_value(const TFrameRing& ring)
+	{
+		return ring.signaledValue;
+	}
+
+	void reset_frame_ring(TFrameRing& ring)
+	{
+		for (uint32_t slotIdx = 0; slotIdx < FRAME_RING_MAX_DEPTH; ++slotIdx)
+		{
+			ring.slotFenceValues[slotIdx] = 0;
+		}
+	}
+}
\ No newline at end of file
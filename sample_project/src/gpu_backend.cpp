@@ -1,19 +1,22 @@
 // Internal includes
 #include "gpu_backend.h"
 #include "d3d12_backend.h"
+#include "null_backend.h"
+#include "software_backend.h"
 
 // External includes
-#include <d3d12.h>
+#include <assert.h>
 
 namespace dxr_demo
 {
 	// Variable that holds the gpu backend
-	GPUBackendAPI gpuBackendAPI = { nullptr };
+	GPUBackendAPI gpuBackendAPI = {};
 
 	void initialize_gpu_backend(RenderingBackEnd::Type backend_type)
 	{
 		switch (backend_type)
 		{
+	#if defined(_WIN32)
 		case RenderingBackEnd::D3D12:
 		{
 			// Render system API
@@ -23,9 +26,11 @@ namespace dxr_demo
 			gpuBackendAPI.render_system_api.destroy_render_environment = d3d12::render_system::destroy_render_environment;
 			gpuBackendAPI.render_system_api.render_window = d3d12::render_system::render_window;
 			gpuBackendAPI.render_system_api.default_frame_buffer = d3d12::render_system::default_frame_buffer;
+			gpuBackendAPI.render_system_api.get_time = d3d12::render_system::get_time;
 			gpuBackendAPI.render_system_api.frame_index = d3d12::render_system::frame_index;
 			
 			gpuBackendAPI.render_system_api.initialize_frame = d3d12::render_system::initialize_frame;
+			gpuBackendAPI.render_system_api.acquire_command_context = d3d12::render_system::acquire_command_context;
 			gpuBackendAPI.render_system_api.flush_command_list = d3d12::render_system::flush_command_list;
 			gpuBackendAPI.render_system_api.present = d3d12::render_system::present;
 
@@ -33,9 +38,88 @@ namespace dxr_demo
 			gpuBackendAPI.window_api.hide = d3d12::window::hide;
 			gpuBackendAPI.window_api.is_active = d3d12::window::is_active;
 			gpuBackendAPI.window_api.show = d3d12::window::show;
+			gpuBackendAPI.window_api.swap = d3d12::window::swap;
 
 			// Frame buffer API
 			gpuBackendAPI.frame_buffer_api.clear = d3d12::framebuffer::clear;
+			gpuBackendAPI.frame_buffer_api.transition = d3d12::framebuffer::transition;
+		}
+		break;
+	#endif
+		case RenderingBackEnd::Null:
+		{
+			// Render system API
+			gpuBackendAPI.render_system_api.init_render_system = null::render_system::init_render_system;
+			gpuBackendAPI.render_system_api.shutdown_render_system = null::render_system::shutdown_render_system;
+			gpuBackendAPI.render_system_api.create_render_environment = null::render_system::create_render_environment;
+			gpuBackendAPI.render_system_api.destroy_render_environment = null::render_system::destroy_render_environment;
+			gpuBackendAPI.render_system_api.render_window = null::render_system::render_window;
+			gpuBackendAPI.render_system_api.default_frame_buffer = null::render_system::default_frame_buffer;
+			gpuBackendAPI.render_system_api.get_time = null::render_system::get_time;
+			gpuBackendAPI.render_system_api.frame_index = null::render_system::frame_index;
+
+			gpuBackendAPI.render_system_api.initialize_frame = null::render_system::initialize_frame;
+			gpuBackendAPI.render_system_api.acquire_command_context = null::render_system::acquire_command_context;
+			gpuBackendAPI.render_system_api.flush_command_list = null::render_system::flush_command_list;
+			gpuBackendAPI.render_system_api.present = null::render_system::present;
+
+			// Window API
+			gpuBackendAPI.window_api.hide = null::window::hide;
+			gpuBackendAPI.window_api.is_active = null::window::is_active;
+			gpuBackendAPI.window_api.show = null::window::show;
+			gpuBackendAPI.window_api.swap = null::window::swap;
+
+			// Frame buffer API
+			gpuBackendAPI.frame_buffer_api.clear = null::framebuffer::clear;
+			gpuBackendAPI.frame_buffer_api.transition = null::framebuffer::transition;
+
+			// No acceleration structure nor ray tracing API, the renderer then skips the scene and only the frame overhead is left
+		}
+		break;
+		case RenderingBackEnd::Software:
+		{
+			// Render system API
+			gpuBackendAPI.render_system_api.init_render_system = software::render_system::init_render_system;
+			gpuBackendAPI.render_system_api.shutdown_render_system = software::render_system::shutdown_render_system;
+			gpuBackendAPI.render_system_api.create_render_environment = software::render_system::create_render_environment;
+			gpuBackendAPI.render_system_api.destroy_render_environment = software::render_system::destroy_render_environment;
+			gpuBackendAPI.render_system_api.render_window = software::render_system::render_window;
+			gpuBackendAPI.render_system_api.default_frame_buffer = software::render_system::default_frame_buffer;
+			gpuBackendAPI.render_system_api.get_time = software::render_system::get_time;
+			gpuBackendAPI.render_system_api.frame_index = software::render_system::frame_index;
+
+			gpuBackendAPI.render_system_api.initialize_frame = software::render_system::initialize_frame;
+			gpuBackendAPI.render_system_api.acquire_command_context = software::render_system::acquire_command_context;
+			gpuBackendAPI.render_system_api.flush_command_list = software::render_system::flush_command_list;
+			gpuBackendAPI.render_system_api.present = software::render_system::present;
+
+			// Window API
+			gpuBackendAPI.window_api.hide = software::window::hide;
+			gpuBackendAPI.window_api.is_active = software::window::is_active;
+			gpuBackendAPI.window_api.show = software::window::show;
+			gpuBackendAPI.window_api.swap = software::window::swap;
+
+			// Frame buffer API
+			gpuBackendAPI.frame_buffer_api.clear = software::framebuffer::clear;
+			gpuBackendAPI.frame_buffer_api.transition = software::framebuffer::transition;
+
+			// Acceleration structure API
+			gpuBackendAPI.acceleration_structure_api.create_bottom_level_acceleration_structure = software::acceleration_structure::create_bottom_level_acceleration_structure;
+			gpuBackendAPI.acceleration_structure_api.destroy_bottom_level_acceleration_structure = software::acceleration_structure::destroy_bottom_level_acceleration_structure;
+			gpuBackendAPI.acceleration_structure_api.update_bottom_level_acceleration_structure = software::acceleration_structure::update_bottom_level_acceleration_structure;
+			gpuBackendAPI.acceleration_structure_api.create_top_level_acceleration_structure = software::acceleration_structure::create_top_level_acceleration_structure;
+			gpuBackendAPI.acceleration_structure_api.destroy_top_level_acceleration_structure = software::acceleration_structure::destroy_top_level_acceleration_structure;
+			gpuBackendAPI.acceleration_structure_api.update_instance_transforms = software::acceleration_structure::update_instance_transforms;
+
+			// Ray tracing API
+			gpuBackendAPI.ray_tracing_api.dispatch_rays = software::raytracing::dispatch_rays;
+			gpuBackendAPI.ray_tracing_api.trace_paths = software::raytracing::trace_paths;
+		}
+		break;
+		default:
+		{
+			// The backend is not available on this platform, the API stays empty
+			assert(false);
 		}
 		break;
 		};
@@ -0,0 +1,485 @@
+// Internal includes
+#include "lbvh.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <float.h>
+
+namespace dxr_demo
+{
+	// Bits of the Morton codes per axis, the codes fit in the high half of the sort keys
+	#define LBVH_MORTON_BITS_PER_AXIS 10
+	#define LBVH_MORTON_BITS (3 * LBVH_MORTON_BITS_PER_AXIS)
+
+	// The codes are sorted by least significant digit first passes over digits of 10 bits
+	#define LBVH_RADIX_BITS 10
+	#define LBVH_RADIX_SIZE (1 << LBVH_RADIX_BITS)
+	#define LBVH_RADIX_NUM_PASSES (LBVH_MORTON_BITS / LBVH_RADIX_BITS)
+
+	// Number of primitives of the chunks the linear passes are distributed by
+	#define LBVH_CHUNK_SIZE 4096
+
+	// The clusters are the cells of a 16^3 grid, identified by the top bits of the codes
+	#define LBVH_CLUSTER_BITS 12
+
+	// The splits along the curve clear a bit of the codes or halve a range of identical codes, their leaves are never deeper than this
+	static_assert(LBVH_MORTON_BITS + 32 <= BVH_MAX_DEPTH, "The curve splits must fit in the traversal stacks");
+
+	// Number of bins per axis of the surface area heuristic over the clusters, and number of clusters below which the curve splits them again
+	#define LBVH_NUM_BINS 16
+	#define LBVH_SAH_MIN_CLUSTERS 32
+
+	template<typename TFunctor>
+	static void for_each_chunk(TTaskScheduler* taskScheduler, uint32_t count, const TFunctor& functor)
+	{
+		uint32_t numChunks = (count + LBVH_CHUNK_SIZE - 1) / LBVH_CHUNK_SIZE;
+		auto process_chunk = [&](uint32_t chunkIdx, uint32_t)
+		{
+			uint32_t first = chunkIdx * LBVH_CHUNK_SIZE;
+			functor(chunkIdx, first, std::min(first + LBVH_CHUNK_SIZE, count));
+		};
+
+		if (taskScheduler && numChunks > 1)
+		{
+			taskScheduler->parallel_for(numChunks, process_chunk);
+		}
+		else
+		{
+			for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+			{
+				process_chunk(chunkIdx, 0);
+			}
+		}
+	}
+
+	static inline void reset_bounds(TAABB& bounds)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			bounds.min[axis] = FLT_MAX;
+			bounds.max[axis] = -FLT_MAX;
+		}
+	}
+
+	static inline float half_area(const TAABB& bounds)
+	{
+		float extent[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			extent[axis] = std::max(bounds.max[axis] - bounds.min[axis], 0.0f);
+		}
+		return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+	}
+
+	// Spread the 10 low bits of a value so that there are two zero bits between each of them
+	static inline uint32_t expand_bits(uint32_t value)
+	{
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	// Number of bits needed to tell count values apart
+	static inline uint32_t count_bits(uint32_t count)
+	{
+		uint32_t bits = 0;
+		while (((uint64_t)1 << bits) < count) ++bits;
+		return bits;
+	}
+
+	static inline uint32_t key_code(uint64_t key)
+	{
+		return (uint32_t)(key >> 32);
+	}
+
+	// Number of codes of a sorted range that go to the left child, the ones whose highest bit that differs across the range is clear
+	// A range of identical codes is cut in its middle
+	template<typename TCodeFunction>
+	static inline uint32_t split_count(uint32_t first, uint32_t count, const TCodeFunction& code)
+	{
+		uint32_t firstCode = code(first);
+		uint32_t difference = firstCode ^ code(first + count - 1);
+		if (difference == 0) return count / 2;
+
+		// Isolate the highest bit of the difference
+		difference |= difference >> 1;
+		difference |= difference >> 2;
+		difference |= difference >> 4;
+		difference |= difference >> 8;
+		difference |= difference >> 16;
+		uint32_t splitBit = (difference >> 1) + 1;
+
+		// Binary search of the first code that has the bit set
+		uint32_t low = 1;
+		uint32_t high = count - 1;
+		while (low < high)
+		{
+			uint32_t middle = (low + high) / 2;
+			if (code(first + middle) & splitBit) high = middle;
+			else low = middle + 1;
+		}
+		return low;
+	}
+
+	static inline void write_union(const TBVHNode& left, const TBVHNode& right, uint32_t leftIndex, TBVHNode& node)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			node.min[axis] = std::min(left.min[axis], right.min[axis]);
+			node.max[axis] = std::max(left.max[axis], right.max[axis]);
+		}
+		node.leftFirst = leftIndex;
+		node.count = 0;
+	}
+
+	// Subtree of a sorted range, a range of n primitives takes 2n - 1 nodes: its root and 2n - 2 descendants stored contiguously from the given index
+	// The left subtree is stored right after the pair of children, the right one after it, so that no allocation has to be synchronized
+	static void emit_subtree(const TAABB* primitiveBounds, const uint64_t* keys, TBVHNode* nodes, TBVHNode& node, uint32_t first, uint32_t count, uint32_t descendants)
+	{
+		if (count == 1)
+		{
+			const TAABB& bounds = primitiveBounds[(uint32_t)keys[first]];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				node.min[axis] = bounds.min[axis];
+				node.max[axis] = bounds.max[axis];
+			}
+			node.leftFirst = first;
+			node.count = 1;
+			return;
+		}
+
+		uint32_t leftCount = split_count(first, count, [&](uint32_t idx) { return key_code(keys[idx]); });
+		emit_subtree(primitiveBounds, keys, nodes, nodes[descendants], first, leftCount, descendants + 2);
+		emit_subtree(primitiveBounds, keys, nodes, nodes[descendants + 1], first + leftCount, count - leftCount, descendants + 2 * leftCount);
+		write_union(nodes[descendants], nodes[descendants + 1], descendants, node);
+	}
+
+	// Binned surface area heuristic over the centroids of a range of clusters, every cluster weighs its number of primitives
+	// Returns the number of clusters moved to the left side, 0 if no split separates them
+	static uint32_t partition_clusters(TLBVHBuilder& builder, uint32_t first, uint32_t count)
+	{
+		uint32_t* clusterOrder = builder.clusterOrder.data() + first;
+		const TBVHNode* roots = builder.clusterRoots.data();
+
+		TAABB centroidBounds;
+		reset_bounds(centroidBounds);
+		for (uint32_t idx = 0; idx < count; ++idx)
+		{
+			const TBVHNode& root = roots[clusterOrder[idx]];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				float centroid = root.min[axis] + root.max[axis];
+				centroidBounds.min[axis] = std::min(centroidBounds.min[axis], centroid);
+				centroidBounds.max[axis] = std::max(centroidBounds.max[axis], centroid);
+			}
+		}
+
+		float bestCost = FLT_MAX;
+		uint32_t bestAxis = 0;
+		uint32_t bestBin = 0;
+		float scale[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			// An extent too small for its inverse to be finite (denormal centroids) is not split either
+			float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			scale[axis] = extent > 0.0f ? LBVH_NUM_BINS * 0.9999f / extent : 0.0f;
+			if (scale[axis] == 0.0f || scale[axis] > FLT_MAX) continue;
+
+			TAABB binBounds[LBVH_NUM_BINS];
+			uint32_t binWeights[LBVH_NUM_BINS] = {};
+			for (uint32_t binIdx = 0; binIdx < LBVH_NUM_BINS; ++binIdx)
+			{
+				reset_bounds(binBounds[binIdx]);
+			}
+			for (uint32_t idx = 0; idx < count; ++idx)
+			{
+				uint32_t clusterIdx = clusterOrder[idx];
+				const TBVHNode& root = roots[clusterIdx];
+				uint32_t binIdx = (uint32_t)((root.min[axis] + root.max[axis] - centroidBounds.min[axis]) * scale[axis]);
+				for (uint32_t boundsAxis = 0; boundsAxis < 3; ++boundsAxis)
+				{
+					binBounds[binIdx].min[boundsAxis] = std::min(binBounds[binIdx].min[boundsAxis], root.min[boundsAxis]);
+					binBounds[binIdx].max[boundsAxis] = std::max(binBounds[binIdx].max[boundsAxis], root.max[boundsAxis]);
+				}
+				binWeights[binIdx] += builder.clusterStarts[clusterIdx + 1] - builder.clusterStarts[clusterIdx];
+			}
+
+			// Sweep from the right to get the cost of the right side of every split, then from the left
+			float rightCosts[LBVH_NUM_BINS];
+			TAABB sideBounds;
+			reset_bounds(sideBounds);
+			uint32_t sideWeight = 0;
+			for (uint32_t binIdx = LBVH_NUM_BINS - 1; binIdx > 0; --binIdx)
+			{
+				for (uint32_t boundsAxis = 0; boundsAxis < 3; ++boundsAxis)
+				{
+					sideBounds.min[boundsAxis] = std::min(sideBounds.min[boundsAxis], binBounds[binIdx].min[boundsAxis]);
+					sideBounds.max[boundsAxis] = std::max(sideBounds.max[boundsAxis], binBounds[binIdx].max[boundsAxis]);
+				}
+				sideWeight += binWeights[binIdx];
+				rightCosts[binIdx] = sideWeight > 0 ? half_area(sideBounds) * sideWeight : FLT_MAX;
+			}
+
+			reset_bounds(sideBounds);
+			sideWeight = 0;
+			for (uint32_t binIdx = 1; binIdx < LBVH_NUM_BINS; ++binIdx)
+			{
+				for (uint32_t boundsAxis = 0; boundsAxis < 3; ++boundsAxis)
+				{
+					sideBounds.min[boundsAxis] = std::min(sideBounds.min[boundsAxis], binBounds[binIdx - 1].min[boundsAxis]);
+					sideBounds.max[boundsAxis] = std::max(sideBounds.max[boundsAxis], binBounds[binIdx - 1].max[boundsAxis]);
+				}
+				sideWeight += binWeights[binIdx - 1];
+				if (sideWeight == 0 || rightCosts[binIdx] == FLT_MAX) continue;
+
+				float cost = half_area(sideBounds) * sideWeight + rightCosts[binIdx];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = binIdx;
+				}
+			}
+		}
+		if (bestCost == FLT_MAX) return 0;
+
+		uint32_t* middle = std::partition(clusterOrder, clusterOrder + count, [&](uint32_t clusterIdx)
+		{
+			const TBVHNode& root = roots[clusterIdx];
+			return (uint32_t)((root.min[bestAxis] + root.max[bestAxis] - centroidBounds.min[bestAxis]) * scale[bestAxis]) < bestBin;
+		});
+		return (uint32_t)(middle - clusterOrder);
+	}
+
+	// Levels above the clusters, the pairs of children are allocated in order from the node after the root
+	// Their leaves are the roots of the clusters, the top of the tree takes 2c - 1 nodes for c clusters
+	// The heuristic only splits the ranges of many clusters, the smaller ones are sorted back along the curve and split at the bits of their codes
+	// The heuristic can peel the clusters one by one, it stops after sahLevels levels so that the curve splits below it still fit in BVH_MAX_DEPTH
+	static void emit_top_levels(TLBVHBuilder& builder, TBVHNode* nodes, uint32_t nodeIndex, uint32_t first, uint32_t count, bool sahLevel, uint32_t sahLevels, uint32_t& nodeCount)
+	{
+		if (count == 1)
+		{
+			nodes[nodeIndex] = builder.clusterRoots[builder.clusterOrder[first]];
+			return;
+		}
+
+		uint32_t leftCount = 0;
+		if (sahLevel && sahLevels > 0 && count > LBVH_SAH_MIN_CLUSTERS)
+		{
+			leftCount = partition_clusters(builder, first, count);
+		}
+		if (leftCount == 0)
+		{
+			// The clusters are in the order of their codes once sorted by index
+			if (sahLevel)
+			{
+				std::sort(builder.clusterOrder.begin() + first, builder.clusterOrder.begin() + first + count);
+				sahLevel = false;
+			}
+			const uint64_t* keys = builder.keys[LBVH_RADIX_NUM_PASSES % 2].data();
+			leftCount = split_count(first, count, [&](uint32_t idx) { return key_code(keys[builder.clusterStarts[builder.clusterOrder[idx]]]); });
+		}
+
+		uint32_t leftIndex = nodeCount;
+		uint32_t childSahLevels = sahLevel ? sahLevels - 1 : 0;
+		nodeCount += 2;
+		emit_top_levels(builder, nodes, leftIndex, first, leftCount, sahLevel, childSahLevels, nodeCount);
+		emit_top_levels(builder, nodes, leftIndex + 1, first + leftCount, count - leftCount, sahLevel, childSahLevels, nodeCount);
+		write_union(nodes[leftIndex], nodes[leftIndex + 1], leftIndex, nodes[nodeIndex]);
+	}
+
+	void build_lbvh(TLBVHBuilder& builder, const TAABB* primitiveBounds, uint32_t numPrimitives, TBVH& bvh, TTaskScheduler* taskScheduler, bool sahTopLevels)
+	{
+		bvh.nodes.resize(numPrimitives > 0 ? 2 * (size_t)numPrimitives - 1 : 1);
+		bvh.primitiveIndices.resize(numPrimitives);
+		if (numPrimitives == 0)
+		{
+			TBVHNode& root = bvh.nodes[0];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				root.min[axis] = FLT_MAX;
+				root.max[axis] = -FLT_MAX;
+			}
+			root.leftFirst = 0;
+			root.count = 0;
+			return;
+		}
+
+		// Bounds of the centroids (doubled, the sum of the corners), that the grid of the codes covers
+		uint32_t numChunks = (numPrimitives + LBVH_CHUNK_SIZE - 1) / LBVH_CHUNK_SIZE;
+		builder.chunkBounds.resize(numChunks);
+		for_each_chunk(taskScheduler, numPrimitives, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+		{
+			TAABB& bounds = builder.chunkBounds[chunkIdx];
+			reset_bounds(bounds);
+			for (uint32_t primIdx = first; primIdx < last; ++primIdx)
+			{
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					float centroid = primitiveBounds[primIdx].min[axis] + primitiveBounds[primIdx].max[axis];
+					bounds.min[axis] = std::min(bounds.min[axis], centroid);
+					bounds.max[axis] = std::max(bounds.max[axis], centroid);
+				}
+			}
+		});
+
+		TAABB centroidBounds = builder.chunkBounds[0];
+		for (uint32_t chunkIdx = 1; chunkIdx < numChunks; ++chunkIdx)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				centroidBounds.min[axis] = std::min(centroidBounds.min[axis], builder.chunkBounds[chunkIdx].min[axis]);
+				centroidBounds.max[axis] = std::max(centroidBounds.max[axis], builder.chunkBounds[chunkIdx].max[axis]);
+			}
+		}
+
+		// Quantize the centroids on the grid and interleave the bits of their coordinates, an extent whose inverse is not finite is a single cell
+		const uint32_t gridSize = 1u << LBVH_MORTON_BITS_PER_AXIS;
+		float scale[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			scale[axis] = extent > 0.0f ? gridSize / extent : 0.0f;
+			if (scale[axis] > FLT_MAX) scale[axis] = 0.0f;
+		}
+		builder.keys[0].resize(numPrimitives);
+		builder.keys[1].resize(numPrimitives);
+		for_each_chunk(taskScheduler, numPrimitives, [&](uint32_t, uint32_t first, uint32_t last)
+		{
+			for (uint32_t primIdx = first; primIdx < last; ++primIdx)
+			{
+				uint32_t code = 0;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					float centroid = primitiveBounds[primIdx].min[axis] + primitiveBounds[primIdx].max[axis];
+					uint32_t cell = std::min((uint32_t)((centroid - centroidBounds.min[axis]) * scale[axis]), gridSize - 1);
+					code |= expand_bits(cell) << (2 - axis);
+				}
+				builder.keys[0][primIdx] = ((uint64_t)code << 32) | primIdx;
+			}
+		});
+
+		// Radix sort of the keys on their codes, every pass counts the digits of every chunk, turns the counts into offsets and scatters the chunks in order
+		builder.histograms.resize((size_t)numChunks * LBVH_RADIX_SIZE);
+		for (uint32_t passIdx = 0; passIdx < LBVH_RADIX_NUM_PASSES; ++passIdx)
+		{
+			const uint64_t* source = builder.keys[passIdx % 2].data();
+			uint64_t* destination = builder.keys[(passIdx + 1) % 2].data();
+			const uint32_t shift = 32 + passIdx * LBVH_RADIX_BITS;
+			for_each_chunk(taskScheduler, numPrimitives, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+			{
+				uint32_t* histogram = builder.histograms.data() + (size_t)chunkIdx * LBVH_RADIX_SIZE;
+				std::fill(histogram, histogram + LBVH_RADIX_SIZE, 0u);
+				for (uint32_t keyIdx = first; keyIdx < last; ++keyIdx)
+				{
+					histogram[(source[keyIdx] >> shift) & (LBVH_RADIX_SIZE - 1)]++;
+				}
+			});
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < LBVH_RADIX_SIZE; ++digit)
+			{
+				for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+				{
+					uint32_t& count = builder.histograms[(size_t)chunkIdx * LBVH_RADIX_SIZE + digit];
+					uint32_t chunkCount = count;
+					count = offset;
+					offset += chunkCount;
+				}
+			}
+
+			for_each_chunk(taskScheduler, numPrimitives, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+			{
+				uint32_t* offsets = builder.histograms.data() + (size_t)chunkIdx * LBVH_RADIX_SIZE;
+				for (uint32_t keyIdx = first; keyIdx < last; ++keyIdx)
+				{
+					destination[offsets[(source[keyIdx] >> shift) & (LBVH_RADIX_SIZE - 1)]++] = source[keyIdx];
+				}
+			});
+		}
+		const uint64_t* keys = builder.keys[LBVH_RADIX_NUM_PASSES % 2].data();
+
+		// Cut the sorted primitives where the cluster bits of the codes change, every chunk counts its clusters and then writes them at its offset
+		const uint32_t clusterShift = 32 + LBVH_MORTON_BITS - LBVH_CLUSTER_BITS;
+		builder.chunkClusters.resize(numChunks);
+		for_each_chunk(taskScheduler, numPrimitives, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+		{
+			uint32_t numClusters = 0;
+			for (uint32_t keyIdx = first; keyIdx < last; ++keyIdx)
+			{
+				numClusters += (keyIdx == 0 || (keys[keyIdx] >> clusterShift) != (keys[keyIdx - 1] >> clusterShift)) ? 1 : 0;
+			}
+			builder.chunkClusters[chunkIdx] = numClusters;
+		});
+
+		uint32_t numClusters = 0;
+		for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+		{
+			uint32_t chunkClusters = builder.chunkClusters[chunkIdx];
+			builder.chunkClusters[chunkIdx] = numClusters;
+			numClusters += chunkClusters;
+		}
+		builder.clusterStarts.resize(numClusters + 1);
+		builder.clusterStarts[numClusters] = numPrimitives;
+		for_each_chunk(taskScheduler, numPrimitives, [&](uint32_t chunkIdx, uint32_t first, uint32_t last)
+		{
+			uint32_t clusterIdx = builder.chunkClusters[chunkIdx];
+			for (uint32_t keyIdx = first; keyIdx < last; ++keyIdx)
+			{
+				if (keyIdx == 0 || (keys[keyIdx] >> clusterShift) != (keys[keyIdx - 1] >> clusterShift))
+				{
+					builder.clusterStarts[clusterIdx++] = keyIdx;
+				}
+			}
+		});
+
+		// The top of the tree takes the first 2c - 1 nodes, the descendants of every cluster follow in the order of the clusters
+		builder.clusterRoots.resize(numClusters);
+		builder.clusterDescendants.resize(numClusters);
+		builder.clusterOrder.resize(numClusters);
+		uint32_t descendants = 2 * numClusters - 1;
+		uint32_t maxClusterSize = 0;
+		for (uint32_t clusterIdx = 0; clusterIdx < numClusters; ++clusterIdx)
+		{
+			uint32_t clusterSize = builder.clusterStarts[clusterIdx + 1] - builder.clusterStarts[clusterIdx];
+			builder.clusterDescendants[clusterIdx] = descendants;
+			builder.clusterOrder[clusterIdx] = clusterIdx;
+			descendants += 2 * clusterSize - 2;
+			maxClusterSize = std::max(maxClusterSize, clusterSize);
+		}
+
+		// Every cluster is an independent task, its root is kept aside until the top of the tree places it
+		TBVHNode* nodes = bvh.nodes.data();
+		auto emit_cluster = [&](uint32_t clusterIdx, uint32_t)
+		{
+			uint32_t first = builder.clusterStarts[clusterIdx];
+			uint32_t count = builder.clusterStarts[clusterIdx + 1] - first;
+			emit_subtree(primitiveBounds, keys, nodes, builder.clusterRoots[clusterIdx], first, count, builder.clusterDescendants[clusterIdx]);
+			for (uint32_t keyIdx = first; keyIdx < first + count; ++keyIdx)
+			{
+				bvh.primitiveIndices[keyIdx] = (uint32_t)keys[keyIdx];
+			}
+		};
+		if (taskScheduler && numChunks > 1)
+		{
+			taskScheduler->parallel_for(numClusters, emit_cluster);
+		}
+		else
+		{
+			for (uint32_t clusterIdx = 0; clusterIdx < numClusters; ++clusterIdx)
+			{
+				emit_cluster(clusterIdx, 0);
+			}
+		}
+
+		// A cluster subtree is at most as deep as the bits below the cluster bits plus the halvings of its largest cluster, and the curve splits above it at most as deep as the cluster bits
+		uint32_t clusterDepth = LBVH_MORTON_BITS - LBVH_CLUSTER_BITS + count_bits(maxClusterSize);
+		uint32_t sahLevels = BVH_MAX_DEPTH - LBVH_CLUSTER_BITS - clusterDepth;
+		uint32_t nodeCount = 1;
+		emit_top_levels(builder, nodes, 0, 0, numClusters, sahTopLevels, sahLevels, nodeCount);
+	}
+}
\ No newline at end of file
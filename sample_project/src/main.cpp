@@ -3,8 +3,16 @@
 #include "gpu_backend.h"
 
 // External includes
+#if defined(_WIN32)
 #include "windows.h"
+#else
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
 
+#if defined(_WIN32)
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 {
 	// Create the graphics settings
@@ -12,6 +20,14 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 	graphicsSettings.width = 1280;
 	graphicsSettings.height = 720;
 	graphicsSettings.fullscreen = false;
+	graphicsSettings.backend = dxr_demo::RenderingBackEnd::D3D12;
+	graphicsSettings.bvhNodeFormat = dxr_demo::BVHNodeFormat::Wide8;
+	graphicsSettings.topLevelBuildMode = dxr_demo::BVHBuildMode::HLBVH;
+	graphicsSettings.bvhCacheDirectory = "";
+	graphicsSettings.bvhPageBudget = 0;
+	graphicsSettings.progressiveTimeBudget = 0.0f;
+	graphicsSettings.denoise = false;
+	graphicsSettings.scenePath = "";
 	graphicsSettings.window_name = "DXR Demo";
 	graphicsSettings.platformData[0] = (uint64_t)hInstance;
 	graphicsSettings.platformData[1] = 666;
@@ -23,4 +39,56 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 	renderer.destroy();
 
 	return 0;
-}
\ No newline at end of file
+}
+#else
+int main(int argc, char** argv)
+{
+	// Number of frames that should be rendered before exiting, the backend that renders them, the layout of the acceleration structures,
+	// the time budget of a progressive frame in milliseconds, the denoising of the path traced image, the builder of the top level structure
+	// the directory the bottom level structures are cached in, the scene file to render and the megabytes of bottom level pages kept in memory
+	uint64_t numFrames = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+	bool softwareBackend = argc > 2 && strcmp(argv[2], "software") == 0;
+	bool binaryNodes = argc > 3 && strcmp(argv[3], "binary") == 0;
+	float progressiveTimeBudget = argc > 4 ? strtof(argv[4], nullptr) : 0.0f;
+	bool denoise = argc > 5 && strcmp(argv[5], "denoise") == 0;
+	const char* topLevelBuild = argc > 6 ? argv[6] : "hlbvh";
+	const char* bvhCacheDirectory = argc > 7 ? argv[7] : "";
+	const char* scenePath = argc > 8 ? argv[8] : "";
+	uint64_t bvhPageBudget = argc > 9 ? strtoull(argv[9], nullptr, 10) : 0;
+
+	// Create the graphics settings, there is no window on this platform
+	dxr_demo::TGraphicSettings graphicsSettings;
+	graphicsSettings.width = 1280;
+	graphicsSettings.height = 720;
+	graphicsSettings.fullscreen = false;
+	graphicsSettings.backend = softwareBackend ? dxr_demo::RenderingBackEnd::Software : dxr_demo::RenderingBackEnd::Null;
+	graphicsSettings.bvhNodeFormat = binaryNodes ? dxr_demo::BVHNodeFormat::Binary : dxr_demo::BVHNodeFormat::Wide8;
+	graphicsSettings.topLevelBuildMode = strcmp(topLevelBuild, "sah") == 0 ? dxr_demo::BVHBuildMode::BinnedSAH : (strcmp(topLevelBuild, "lbvh") == 0 ? dxr_demo::BVHBuildMode::LBVH : dxr_demo::BVHBuildMode::HLBVH);
+	graphicsSettings.bvhCacheDirectory = bvhCacheDirectory;
+	graphicsSettings.bvhPageBudget = bvhPageBudget * 1024 * 1024;
+	graphicsSettings.progressiveTimeBudget = progressiveTimeBudget;
+	graphicsSettings.denoise = denoise;
+	graphicsSettings.scenePath = scenePath;
+	graphicsSettings.window_name = "DXR Demo";
+
+	// Create the renderer
+	dxr_demo::TRenderer renderer;
+	renderer.init(graphicsSettings);
+
+	// Drive the frame loop for the requested number of frames
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint64_t frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+	{
+		renderer.update();
+		renderer.render();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	// Report the CPU side cost of a frame
+	printf("%llu frames in %.3f s: %.0f frames/s, %.1f ns/frame\n", (unsigned long long)numFrames, elapsed.count(),
+		numFrames / elapsed.count(), elapsed.count() * 1e9 / (double)(numFrames ? numFrames : 1));
+
+	renderer.destroy();
+	return 0;
+}
+#endif
\ No newline at end of file
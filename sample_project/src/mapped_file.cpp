@@ -0,0 +1,82 @@
+// Internal includes
+#include "mapped_file.h"
+
+// External includes
+#if defined(_WIN32)
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dxr_demo
+{
+	bool map_file(const char* path, TMappedFile& file)
+	{
+		file.data = nullptr;
+		file.size = 0;
+		file.fileHandle = nullptr;
+		file.mappingHandle = nullptr;
+
+	#if defined(_WIN32)
+		HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		HANDLE mappingHandle = nullptr;
+		const void* data = nullptr;
+		if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart > 0)
+		{
+			mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			data = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		}
+		if (data == nullptr)
+		{
+			if (mappingHandle) CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			return false;
+		}
+
+		file.data = (const uint8_t*)data;
+		file.size = (uint64_t)fileSize.QuadPart;
+		file.fileHandle = fileHandle;
+		file.mappingHandle = mappingHandle;
+	#else
+		int descriptor = open(path, O_RDONLY);
+		if (descriptor < 0) return false;
+
+		// The mapping keeps the file alive, the descriptor is not needed past this point
+		struct stat status;
+		void* data = MAP_FAILED;
+		if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+		{
+			data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		}
+		close(descriptor);
+		if (data == MAP_FAILED) return false;
+
+		file.data = (const uint8_t*)data;
+		file.size = (uint64_t)status.st_size;
+	#endif
+		return true;
+	}
+
+	void unmap_file(TMappedFile& file)
+	{
+		if (file.data == nullptr) return;
+
+	#if defined(_WIN32)
+		UnmapViewOfFile(file.data);
+		CloseHandle((HANDLE)file.mappingHandle);
+		CloseHandle((HANDLE)file.fileHandle);
+	#else
+		munmap((void*)file.data, (size_t)file.size);
+	#endif
+		file.data = nullptr;
+		file.size = 0;
+		file.fileHandle = nullptr;
+		file.mappingHandle = nullptr;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+// Internal includes
+#include "null_backend.h"
+#include "command_context_pool.h"
+#include "command_stream.h"
+
+// External includes
+#include <chrono>
+#include <vector>
+
+namespace dxr_demo
+{
+	namespace null
+	{
+		// Forward declaration
+		struct NullRenderEnvironement;
+
+		// Structure that stands for the window, nothing is ever displayed
+		struct NullWindow
+		{
+			// Dimension of the virtual window
+			uint32_t width;
+			uint32_t height;
+
+			// Flag that tracks the show/hide requests
+			bool visible;
+		};
+
+		struct NullFrameBuffer
+		{
+			// We keep a pointer to the render environement
+			NullRenderEnvironement* renderEnvironement;
+
+			// Last color that was requested for this frame buffer
+			float clearColor[4];
+		};
+
+		struct NullRenderEnvironement
+		{
+			// Structure that hold the data of the virtual window
+			NullWindow window;
+
+			// The only frame buffer of this backend
+			NullFrameBuffer frameBuffer;
+
+			// Streams that the frames record into, and the ones of the frame in submission order once it is flushed
+			TCommandContextPool<TCommandStream> commandContexts;
+			std::vector<TCommandStream*> submittedStreams;
+
+			// Time at which the render environment was created
+			std::chrono::steady_clock::time_point creationTime;
+
+			// Index of the current frame
+			uint64_t frameIndex;
+		};
+
+		namespace render_system
+		{
+			bool init_render_system()
+			{
+				return true;
+			}
+
+			void shutdown_render_system()
+			{
+			}
+
+			RenderEnvironment create_render_environment(const TGraphicSettings& graphic_settings)
+			{
+				NullRenderEnvironement* newRE = new NullRenderEnvironement();
+
+				// Keep track of the dimensions
+				newRE->window.width = graphic_settings.width;
+				newRE->window.height = graphic_settings.height;
+				newRE->window.visible = false;
+
+				// Initialize the frame buffer
+				newRE->frameBuffer.renderEnvironement = newRE;
+				for (uint32_t channelIdx = 0; channelIdx < 4; ++channelIdx)
+				{
+					newRE->frameBuffer.clearColor[channelIdx] = 0.0f;
+				}
+
+				// Initialize the timing data
+				newRE->creationTime = std::chrono::steady_clock::now();
+				newRE->frameIndex = 0;
+
+				return (RenderEnvironment)newRE;
+			}
+
+			void destroy_render_environment(RenderEnvironment render_environment)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environment;
+				for (TCommandStream* stream : renderEnv->commandContexts.contexts())
+				{
+					destroy_command_stream(*stream);
+					delete stream;
+				}
+				delete renderEnv;
+			}
+
+			RenderWindow render_window(RenderEnvironment render_environement)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environement;
+				return (RenderWindow)(&renderEnv->window);
+			}
+
+			Framebuffer default_frame_buffer(RenderEnvironment render_environement)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environement;
+				return (Framebuffer)(&renderEnv->frameBuffer);
+			}
+
+			uint64_t frame_index(RenderEnvironment render_environement)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environement;
+				return renderEnv->frameIndex;
+			}
+
+			float get_time(RenderEnvironment render_environement)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environement;
+				std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - renderEnv->creationTime;
+				return elapsed.count();
+			}
+
+			bool initialize_frame(RenderEnvironment render_environement)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environement;
+
+				// We moved to the next frame
+				renderEnv->frameIndex++;
+				return true;
+			}
+
+			CommandContext acquire_command_context(RenderEnvironment render_environement, uint32_t submissionIndex)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environement;
+				TCommandStream* stream = renderEnv->commandContexts.acquire(submissionIndex, []()
+				{
+					TCommandStream* newStream = new TCommandStream();
+					init_command_stream(*newStream);
+					return newStream;
+				});
+				reset_command_stream(*stream);
+				return (CommandContext)stream;
+			}
+
+			bool flush_command_list(RenderEnvironment render_environement)
+			{
+				NullRenderEnvironement* renderEnv = (NullRenderEnvironement*)render_environement;
+
+				std::vector<TCommandStream*>& streams = renderEnv->submittedStreams;
+				streams.clear();
+				for (const std::pair<uint32_t, TCommandStream*>& context : renderEnv->commandContexts.sorted_contexts())
+				{
+					streams.push_back(context.second);
+				}
+				renderEnv->commandContexts.reset();
+				merge_command_streams(streams.data(), (uint32_t)streams.size());
+
+				// Only the clears have an effect, the last one submitted wins
+				for (const TCommandStream* stream : streams)
+				{
+					for (const TCommandHeader* command = stream->first; command != nullptr; command = command->next)
+					{
+						if (command->type != CommandType::Clear) continue;
+						const TClearCommand& clear = *(const TClearCommand*)command;
+						for (uint32_t channelIdx = 0; channelIdx < 4; ++channelIdx)
+						{
+							((NullFrameBuffer*)clear.target.frameBuffer)->clearColor[channelIdx] = clear.color[channelIdx];
+						}
+					}
+				}
+				return true;
+			}
+
+			bool present(RenderEnvironment)
+			{
+				// No swap chain, the frame is done as soon as it was recorded
+				return true;
+			}
+		}
+
+		namespace window
+		{
+			void show(RenderWindow renderWindow)
+			{
+				NullWindow* window = (NullWindow*)renderWindow;
+				window->visible = true;
+			}
+
+			void hide(RenderWindow renderWindow)
+			{
+				NullWindow* window = (NullWindow*)renderWindow;
+				window->visible = false;
+			}
+
+			bool is_active(RenderWindow renderWindow)
+			{
+				NullWindow* window = (NullWindow*)renderWindow;
+				return window->visible;
+			}
+
+			void swap(RenderWindow)
+			{
+			}
+		}
+
+		namespace framebuffer
+		{
+			void clear(CommandContext command_context, Framebuffer framebuffer, const float* clearColor)
+			{
+				// Only the color is kept when the stream is flushed, there is no memory behind this frame buffer
+				record_clear(*(TCommandStream*)command_context, framebuffer, clearColor);
+			}
+
+			void transition(CommandContext, const TResourceTransition*, uint32_t)
+			{
+				// The frame buffer has no state to change
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+// Internal includes
+#include "render_graph.h"
+
+// External includes
+#include <assert.h>
+
+namespace dxr_demo
+{
+	void reset_render_graph(TRenderGraph& graph)
+	{
+		graph.resources.clear();
+		graph.passes.clear();
+		graph.accesses.clear();
+	}
+
+	uint32_t import_render_graph_resource(TRenderGraph& graph, Framebuffer frameBuffer, ResourceState::Type initialState, ResourceState::Type finalState)
+	{
+		TRenderGraphResource resource;
+		resource.frameBuffer = frameBuffer;
+		resource.imported = true;
+		resource.initialState = initialState;
+		resource.finalState = finalState;
+		resource.output = false;
+		graph.resources.push_back(resource);
+		return (uint32_t)graph.resources.size() - 1;
+	}
+
+	uint32_t create_render_graph_resource(TRenderGraph& graph, Framebuffer frameBuffer)
+	{
+		TRenderGraphResource resource;
+		resource.frameBuffer = frameBuffer;
+		resource.imported = false;
+		resource.initialState = ResourceState::Present;
+		resource.finalState = ResourceState::Present;
+		resource.output = false;
+		graph.resources.push_back(resource);
+		return (uint32_t)graph.resources.size() - 1;
+	}
+
+	void mark_render_graph_output(TRenderGraph& graph, uint32_t resource)
+	{
+		graph.resources[resource].output = true;
+	}
+
+	uint32_t add_render_pass(TRenderGraph& graph, const char* name, TRenderPassFunction function, void* userData, bool sideEffects)
+	{
+		TRenderGraphPass pass;
+		pass.name = name;
+		pass.function = function;
+		pass.userData = userData;
+		pass.sideEffects = sideEffects;
+		pass.firstAccess = (uint32_t)graph.accesses.size();
+		pass.numAccesses = 0;
+		graph.passes.push_back(pass);
+		return (uint32_t)graph.passes.size() - 1;
+	}
+
+	void add_render_pass_access(TRenderGraph& graph, uint32_t pass, uint32_t resource, RenderGraphAccess::Type type, ResourceState::Type state)
+	{
+		// The accesses of a pass are contiguous
+		assert(pass == graph.passes.size() - 1);
+		assert(resource < graph.resources.size());
+		TRenderGraphAccess access;
+		access.resource = resource;
+		access.type = type;
+		access.state = state;
+		graph.accesses.push_back(access);
+		graph.passes[pass].numAccesses++;
+	}
+
+	// Add a transition to the batch of the latest slot that comes after the last use of the resource, or open a batch at the current slot
+	// The slots of the transitions never decrease, so the earlier batches are final and the transitions of a batch stay contiguous
+	static void place_transition(TCompiledRenderGraph& compiled, uint32_t slot, uint32_t earliestSlot, const TResourceTransition& transition)
+	{
+		if (compiled.batches.empty() || compiled.batches.back().slot < earliestSlot)
+		{
+			TRenderGraphBarrierBatch batch;
+			batch.slot = slot;
+			batch.firstTransition = (uint32_t)compiled.transitions.size();
+			batch.numTransitions = 0;
+			compiled.batches.push_back(batch);
+		}
+		compiled.transitions.push_back(transition);
+		compiled.batches.back().numTransitions++;
+	}
+
+	bool compile_render_graph(const TRenderGraph& graph, TCompiledRenderGraph& compiled)
+	{
+		const uint32_t numPasses = (uint32_t)graph.passes.size();
+		const uint32_t numResources = (uint32_t)graph.resources.size();
+		compiled.passes.clear();
+		compiled.batches.clear();
+		compiled.transitions.clear();
+		compiled.numCulledPasses = 0;
+
+		// Find the pass that wrote what every read sees, the passes are declared in execution order
+		compiled.producers.assign(graph.accesses.size(), RENDER_GRAPH_INVALID_INDEX);
+		compiled.lastWriters.assign(numResources, RENDER_GRAPH_INVALID_INDEX);
+		for (uint32_t passIdx = 0; passIdx < numPasses; ++passIdx)
+		{
+			const TRenderGraphPass& pass = graph.passes[passIdx];
+			for (uint32_t accessIdx = pass.firstAccess; accessIdx < pass.firstAccess + pass.numAccesses; ++accessIdx)
+			{
+				const TRenderGraphAccess& access = graph.accesses[accessIdx];
+
+				// A pass sees a resource in a single state
+				for (uint32_t otherIdx = pass.firstAccess; otherIdx < accessIdx; ++otherIdx)
+				{
+					if (graph.accesses[otherIdx].resource == access.resource && graph.accesses[otherIdx].state != access.state) return false;
+				}
+
+				if (access.type != RenderGraphAccess::Write)
+				{
+					uint32_t producer = compiled.lastWriters[access.resource];
+					if (producer == RENDER_GRAPH_INVALID_INDEX && !graph.resources[access.resource].imported) return false;
+					compiled.producers[accessIdx] = producer;
+				}
+			}
+
+			// The writes are only visible to the passes that come after
+			for (uint32_t accessIdx = pass.firstAccess; accessIdx < pass.firstAccess + pass.numAccesses; ++accessIdx)
+			{
+				if (graph.accesses[accessIdx].type != RenderGraphAccess::Read)
+				{
+					compiled.lastWriters[graph.accesses[accessIdx].resource] = passIdx;
+				}
+			}
+		}
+
+		// Keep the last writers of the outputs and the passes with side effects, then everything they read from. The producers come before their readers,
+		// so a single sweep from the last pass reaches all of them
+		compiled.alive.assign(numPasses, 0);
+		for (uint32_t resourceIdx = 0; resourceIdx < numResources; ++resourceIdx)
+		{
+			if (graph.resources[resourceIdx].output && compiled.lastWriters[resourceIdx] != RENDER_GRAPH_INVALID_INDEX)
+			{
+				compiled.alive[compiled.lastWriters[resourceIdx]] = 1;
+			}
+		}
+		for (uint32_t passIdx = numPasses; passIdx-- > 0; )
+		{
+			const TRenderGraphPass& pass = graph.passes[passIdx];
+			if (!compiled.alive[passIdx] && !pass.sideEffects) continue;
+			compiled.alive[passIdx] = 1;
+			for (uint32_t accessIdx = pass.firstAccess; accessIdx < pass.firstAccess + pass.numAccesses; ++accessIdx)
+			{
+				if (compiled.producers[accessIdx] != RENDER_GRAPH_INVALID_INDEX)
+				{
+					compiled.alive[compiled.producers[accessIdx]] = 1;
+				}
+			}
+		}
+		for (uint32_t passIdx = 0; passIdx < numPasses; ++passIdx)
+		{
+			if (compiled.alive[passIdx])
+			{
+				compiled.passes.push_back(passIdx);
+			}
+		}
+		compiled.numCulledPasses = numPasses - (uint32_t)compiled.passes.size();
+
+		// Go over the kept passes with the state of every resource, a transition can be issued anywhere after the last use of the resource
+		// Placing it in the latest batch that is late enough, and opening a batch as late as possible otherwise, gives the fewest batches
+		compiled.lastUses.assign(numResources, 0);
+		compiled.states.resize(numResources);
+		compiled.statesKnown.resize(numResources);
+		for (uint32_t resourceIdx = 0; resourceIdx < numResources; ++resourceIdx)
+		{
+			compiled.states[resourceIdx] = graph.resources[resourceIdx].initialState;
+			compiled.statesKnown[resourceIdx] = graph.resources[resourceIdx].imported ? 1 : 0;
+		}
+		const uint32_t numExecuted = (uint32_t)compiled.passes.size();
+		for (uint32_t slot = 0; slot < numExecuted; ++slot)
+		{
+			const TRenderGraphPass& pass = graph.passes[compiled.passes[slot]];
+			for (uint32_t accessIdx = pass.firstAccess; accessIdx < pass.firstAccess + pass.numAccesses; ++accessIdx)
+			{
+				const TRenderGraphAccess& access = graph.accesses[accessIdx];
+				if (compiled.statesKnown[access.resource] && compiled.states[access.resource] != access.state)
+				{
+					TResourceTransition transition = { graph.resources[access.resource].frameBuffer, compiled.states[access.resource], access.state };
+					place_transition(compiled, slot, compiled.lastUses[access.resource], transition);
+				}
+				compiled.states[access.resource] = access.state;
+				compiled.statesKnown[access.resource] = 1;
+
+				// The slot after the pass is the earliest one the next transition of the resource can go in
+				compiled.lastUses[access.resource] = slot + 1;
+			}
+		}
+
+		// The imported resources leave the frame in their final state
+		for (uint32_t resourceIdx = 0; resourceIdx < numResources; ++resourceIdx)
+		{
+			const TRenderGraphResource& resource = graph.resources[resourceIdx];
+			if (resource.imported && compiled.states[resourceIdx] != resource.finalState)
+			{
+				TResourceTransition transition = { resource.frameBuffer, compiled.states[resourceIdx], resource.finalState };
+				place_transition(compiled, numExecuted, compiled.lastUses[resourceIdx], transition);
+			}
+		}
+		return true;
+	}
+
+	void execute_render_graph(const TRenderGraph& graph, const TCompiledRenderGraph& compiled, const GPUBackendAPI& gpuBackendAPI, CommandContext commandContext)
+	{
+		uint32_t batchIdx = 0;
+		const uint32_t numExecuted = (uint32_t)compiled.passes.size();
+		for (uint32_t slot = 0; slot <= numExecuted; ++slot)
+		{
+			if (batchIdx < compiled.batches.size() && compiled.batches[batchIdx].slot == slot)
+			{
+				const TRenderGraphBarrierBatch& batch = compiled.batches[batchIdx++];
+				gpuBackendAPI.frame_buffer_api.transition(commandContext, &compiled.transitions[batch.firstTransition], batch.numTransitions);
+			}
+			if (slot < numExecuted)
+			{
+				const TRenderGraphPass& pass = graph.passes[compiled.passes[slot]];
+				pass.function(commandContext, pass.userData);
+			}
+		}
+	}
+}
\ No newline at end of file
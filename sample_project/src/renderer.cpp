@@ -3,15 +3,26 @@
 
 // Extenral includes
 #include <assert.h>
+#include <string.h>
 
 namespace dxr_demo
 {
 	#define D3D_NUM_KEYS 254
 
+	// Number of animated instances a task of the scene update transforms, a single transform costs less than the steal that would move it to another thread
+	#define ANIMATION_GRAIN_SIZE 16
+
+#if defined(_WIN32)
 	TRenderer::TRenderer(HINSTANCE hInstance, int nCmdShow)
+#else
+	TRenderer::TRenderer()
+#endif
 	: _renderEnvironement(0)
 	, _renderWindow(0)
 	, _gpuBackendAPI(nullptr)
+	, _scene()
+	, _sceneTopLevel(0)
+	, _animateScene(true)
 	, _isRunning(false)
 	{
 
@@ -26,8 +37,12 @@ namespace dxr_demo
 	{
 		graphicsSettings.platformData[1] = (uint64_t)this;
 
+		// Spawn the workers of the scheduler before the backend, which can use it
+		_taskScheduler.init();
+		graphicsSettings.taskScheduler = &_taskScheduler;
+
 		// Initialize and fetch the API
-		initialize_gpu_backend(RenderingBackEnd::D3D12);
+		initialize_gpu_backend(graphicsSettings.backend);
 		_gpuBackendAPI = &gpu_api();
 
 		// Create the render environement
@@ -36,6 +51,35 @@ namespace dxr_demo
 		// Fetch the render window
 		_renderWindow = _gpuBackendAPI->render_system_api.render_window(_renderEnvironement);
 
+		// If the backend supports ray tracing, prepare the scene
+		const GPUAccelerationStructureAPI& accelerationStructureAPI = _gpuBackendAPI->acceleration_structure_api;
+		if (accelerationStructureAPI.create_bottom_level_acceleration_structure)
+		{
+			if (graphicsSettings.scenePath.empty() || !load_demo_scene(graphicsSettings.scenePath.c_str(), _scene))
+			{
+				build_demo_scene(_scene);
+			}
+
+			// One bottom level structure per mesh, shared by all the instances of the mesh
+			for (const TDemoMesh& mesh : _scene.meshes)
+			{
+				_sceneBottomLevels.push_back(accelerationStructureAPI.create_bottom_level_acceleration_structure(_renderEnvironement, demo_mesh_geometry(mesh)));
+			}
+
+			std::vector<TInstanceDescriptor> instances;
+			demo_scene_instances(_scene, _sceneBottomLevels.data(), instances);
+			_sceneTopLevel = accelerationStructureAPI.create_top_level_acceleration_structure(_renderEnvironement, instances.data(), (uint32_t)instances.size());
+			_rayTracingPipeline = demo_scene_pipeline(_scene);
+			_pathTracingPipeline = demo_scene_path_tracing_pipeline(_scene, _hitGroupRecords);
+
+			// With a time budget the image converges over the frames, so the scene stays still
+			_pathTracingPipeline.timeBudget = graphicsSettings.progressiveTimeBudget;
+			_pathTracingPipeline.accumulationId = 0;
+			_pathTracingPipeline.denoise = graphicsSettings.denoise;
+			_animateScene = graphicsSettings.progressiveTimeBudget <= 0.0f;
+			_accumulatedCamera = _scene.camera;
+		}
+
 		// Allocate the input buffer
 		_inputData.resize(D3D_NUM_KEYS);
 	}
@@ -48,6 +92,7 @@ namespace dxr_demo
 		// Display the window
 		_gpuBackendAPI->window_api.show(_renderWindow);
 		
+	#if defined(_WIN32)
 		// Main rendering loop
 		MSG msg;
 		ZeroMemory(&msg, sizeof(MSG));
@@ -67,11 +112,29 @@ namespace dxr_demo
 				render();
 			}
 		}
+	#else
+		// No message pump, the loop only ends when the backend stops
+		while (_isRunning)
+		{
+			update();
+			render();
+		}
+	#endif
 	}
 
 	void TRenderer::destroy()
 	{
+		if (_sceneTopLevel)
+		{
+			_gpuBackendAPI->acceleration_structure_api.destroy_top_level_acceleration_structure(_renderEnvironement, _sceneTopLevel);
+		}
+		for (BottomLevelAccelerationStructure bottomLevel : _sceneBottomLevels)
+		{
+			_gpuBackendAPI->acceleration_structure_api.destroy_bottom_level_acceleration_structure(_renderEnvironement, bottomLevel);
+		}
+		release_demo_scene(_scene);
 		_gpuBackendAPI->render_system_api.destroy_render_environment(_renderEnvironement);
+		_taskScheduler.destroy();
 	}
 
 	void TRenderer::key_down(int keyID)
@@ -91,27 +154,98 @@ namespace dxr_demo
 		return _renderEnvironement;
 	}
 
+	TTaskScheduler& TRenderer::task_scheduler()
+	{
+		return _taskScheduler;
+	}
+
 	void TRenderer::update()
 	{
+		// Animate the scene, only the transforms of the instances that move are sent to the backend
+		if (_sceneTopLevel && _animateScene)
+		{
+			// The animated instances are spread over the threads of the scheduler, the backend splits the transform update the same way
+			float time = _gpuBackendAPI->render_system_api.get_time(_renderEnvironement);
+			_taskScheduler.parallel_for(num_demo_animated_instances(_scene), [&](uint32_t animatedIdx, uint32_t)
+			{
+				update_demo_instance(_scene, animatedIdx, time);
+			}, ANIMATION_GRAIN_SIZE);
+			uint32_t numAnimatedInstances = (uint32_t)_scene.instances.size() - _scene.firstAnimatedInstance;
+			_gpuBackendAPI->acceleration_structure_api.update_instance_transforms(_renderEnvironement, _sceneTopLevel, _scene.firstAnimatedInstance, numAnimatedInstances, &_scene.transforms[12 * _scene.firstAnimatedInstance]);
+			_pathTracingPipeline.accumulationId++;
+		}
+
+		// The accumulated samples no longer match the image once the camera moved
+		if (memcmp(&_accumulatedCamera, &_scene.camera, sizeof(TCamera)) != 0)
+		{
+			_accumulatedCamera = _scene.camera;
+			_pathTracingPipeline.accumulationId++;
+		}
 	}
 
 	void TRenderer::render()
 	{
 		_isRunning &= _gpuBackendAPI->render_system_api.initialize_frame(_renderEnvironement);
 
-		uint64_t currentFrameIndex = _gpuBackendAPI->render_system_api.frame_index(_renderEnvironement);
-		if (currentFrameIndex % 2 == 0)
+		// The back buffer comes in and leaves the frame in the present state, its content is the result of the frame
+		reset_render_graph(_renderGraph);
+		uint32_t backBuffer = import_render_graph_resource(_renderGraph, _gpuBackendAPI->render_system_api.default_frame_buffer(_renderEnvironement), ResourceState::Present, ResourceState::Present);
+		mark_render_graph_output(_renderGraph, backBuffer);
+
+		uint32_t clearPass = add_render_pass(_renderGraph, "clear", &TRenderer::clear_pass, this);
+		add_render_pass_access(_renderGraph, clearPass, backBuffer, RenderGraphAccess::Write, ResourceState::RenderTarget);
+
+		// The path tracer writes every pixel and culls the clear, the rays of the per pixel pipeline may leave some of them untouched
+		if (_sceneTopLevel)
 		{
-			FLOAT clearColor0[] = { 1.0f, 0.0f, 0.0f, 1.0f };
-			_gpuBackendAPI->frame_buffer_api.clear(_gpuBackendAPI->render_system_api.default_frame_buffer(_renderEnvironement), clearColor0);
+			uint32_t tracePass = add_render_pass(_renderGraph, "trace", &TRenderer::trace_pass, this);
+			RenderGraphAccess::Type traceAccess = _gpuBackendAPI->ray_tracing_api.trace_paths ? RenderGraphAccess::Write : RenderGraphAccess::ReadWrite;
+			add_render_pass_access(_renderGraph, tracePass, backBuffer, traceAccess, ResourceState::UnorderedAccess);
+		}
+
+		// The whole frame is recorded into a single context
+		CommandContext commandContext = _gpuBackendAPI->render_system_api.acquire_command_context(_renderEnvironement, 0);
+		if (compile_render_graph(_renderGraph, _compiledRenderGraph))
+		{
+			execute_render_graph(_renderGraph, _compiledRenderGraph, *_gpuBackendAPI, commandContext);
 		}
 		else
 		{
-			FLOAT clearColor1[] = { 0.0f, 1.0f, 0.0f, 1.0f };
-			_gpuBackendAPI->frame_buffer_api.clear(_gpuBackendAPI->render_system_api.default_frame_buffer(_renderEnvironement), clearColor1);
+			_isRunning = false;
 		}
 
 		_isRunning &= _gpuBackendAPI->render_system_api.flush_command_list(_renderEnvironement);
 		_isRunning &= _gpuBackendAPI->render_system_api.present(_renderEnvironement);
 	}
+
+	void TRenderer::clear_pass(CommandContext commandContext, void* userData)
+	{
+		TRenderer* renderer = (TRenderer*)userData;
+		uint64_t currentFrameIndex = renderer->_gpuBackendAPI->render_system_api.frame_index(renderer->_renderEnvironement);
+		if (currentFrameIndex % 2 == 0)
+		{
+			float clearColor0[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+			renderer->_gpuBackendAPI->frame_buffer_api.clear(commandContext, renderer->_gpuBackendAPI->render_system_api.default_frame_buffer(renderer->_renderEnvironement), clearColor0);
+		}
+		else
+		{
+			float clearColor1[] = { 0.0f, 1.0f, 0.0f, 1.0f };
+			renderer->_gpuBackendAPI->frame_buffer_api.clear(commandContext, renderer->_gpuBackendAPI->render_system_api.default_frame_buffer(renderer->_renderEnvironement), clearColor1);
+		}
+	}
+
+	void TRenderer::trace_pass(CommandContext commandContext, void* userData)
+	{
+		// The backends that have a path tracer render the scene with it, the others run the per pixel pipeline
+		TRenderer* renderer = (TRenderer*)userData;
+		Framebuffer frameBuffer = renderer->_gpuBackendAPI->render_system_api.default_frame_buffer(renderer->_renderEnvironement);
+		if (renderer->_gpuBackendAPI->ray_tracing_api.trace_paths)
+		{
+			renderer->_gpuBackendAPI->ray_tracing_api.trace_paths(commandContext, frameBuffer, renderer->_sceneTopLevel, renderer->_pathTracingPipeline);
+		}
+		else
+		{
+			renderer->_gpuBackendAPI->ray_tracing_api.dispatch_rays(commandContext, frameBuffer, renderer->_sceneTopLevel, renderer->_rayTracingPipeline);
+		}
+	}
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+// Internal includes
+#include "scene_file.h"
+
+// External includes
+#include <stdio.h>
+#include <string.h>
+
+namespace dxr_demo
+{
+	// First bytes of every scene file, "DXRS"
+	#define SCENE_FILE_MAGIC 0x53525844u
+
+	static inline uint64_t align_section(uint64_t offset)
+	{
+		return (offset + SCENE_FILE_SECTION_ALIGNMENT - 1) / SCENE_FILE_SECTION_ALIGNMENT * SCENE_FILE_SECTION_ALIGNMENT;
+	}
+
+	bool open_scene_file(const char* path, TSceneFile& file)
+	{
+		file.header = nullptr;
+		if (!map_file(path, file.mappedFile)) return false;
+
+		// Every section must be aligned and lie in the file, nothing else is read before the sections are used
+		const TMappedFile& mappedFile = file.mappedFile;
+		const TSceneFileHeader* header = (const TSceneFileHeader*)mappedFile.data;
+		bool valid = mappedFile.size >= sizeof(TSceneFileHeader) && header->magic == SCENE_FILE_MAGIC && header->version == SCENE_FILE_VERSION && header->numSections == SceneSection::Count;
+		for (uint32_t sectionIdx = 0; valid && sectionIdx < SceneSection::Count; ++sectionIdx)
+		{
+			const TSceneFileSection& section = header->sections[sectionIdx];
+			valid = section.offset % SCENE_FILE_SECTION_ALIGNMENT == 0 && section.offset <= mappedFile.size
+				&& (section.elementSize == 0 || section.count <= (mappedFile.size - section.offset) / section.elementSize);
+		}
+		if (!valid)
+		{
+			unmap_file(file.mappedFile);
+			return false;
+		}
+
+		file.header = header;
+		return true;
+	}
+
+	void close_scene_file(TSceneFile& file)
+	{
+		unmap_file(file.mappedFile);
+		file.header = nullptr;
+	}
+
+	const void* scene_file_section(const TSceneFile& file, SceneSection::Type section, uint32_t elementSize, uint64_t& count)
+	{
+		const TSceneFileSection& entry = file.header->sections[section];
+		if (entry.count == 0 || entry.elementSize != elementSize)
+		{
+			count = 0;
+			return nullptr;
+		}
+		count = entry.count;
+		return file.mappedFile.data + entry.offset;
+	}
+
+	bool begin_scene_file(TSceneFileWriter& writer, const char* path)
+	{
+		writer.path = path;
+		writer.stream.open((writer.path + ".tmp").c_str(), std::ios::binary | std::ios::trunc);
+		if (!writer.stream) return false;
+
+		// The header is written again once the table of contents is known
+		memset(&writer.header, 0, sizeof(TSceneFileHeader));
+		writer.header.magic = SCENE_FILE_MAGIC;
+		writer.header.version = SCENE_FILE_VERSION;
+		writer.header.numSections = SceneSection::Count;
+		writer.currentSection = SceneSection::Count;
+		writer.stream.write((const char*)&writer.header, sizeof(TSceneFileHeader));
+		writer.offset = sizeof(TSceneFileHeader);
+		return true;
+	}
+
+	void begin_scene_section(TSceneFileWriter& writer, SceneSection::Type section, uint32_t elementSize)
+	{
+		const char padding[SCENE_FILE_SECTION_ALIGNMENT] = {};
+		uint64_t sectionOffset = align_section(writer.offset);
+		writer.stream.write(padding, (std::streamsize)(sectionOffset - writer.offset));
+		writer.offset = sectionOffset;
+
+		TSceneFileSection& entry = writer.header.sections[section];
+		entry.offset = sectionOffset;
+		entry.count = 0;
+		entry.elementSize = elementSize;
+		writer.currentSection = section;
+	}
+
+	void write_scene_section(TSceneFileWriter& writer, const void* elements, uint64_t count)
+	{
+		TSceneFileSection& entry = writer.header.sections[writer.currentSection];
+		uint64_t size = count * entry.elementSize;
+		writer.stream.write((const char*)elements, (std::streamsize)size);
+		writer.offset += size;
+		entry.count += count;
+	}
+
+	bool end_scene_file(TSceneFileWriter& writer)
+	{
+		writer.stream.seekp(0);
+		writer.stream.write((const char*)&writer.header, sizeof(TSceneFileHeader));
+		writer.stream.close();
+
+		std::string temporaryPath = writer.path + ".tmp";
+		if (!writer.stream)
+		{
+			remove(temporaryPath.c_str());
+			return false;
+		}
+
+		// Renaming over an existing file fails on Windows
+		remove(writer.path.c_str());
+		return rename(temporaryPath.c_str(), writer.path.c_str()) == 0;
+	}
+}
\ No newline at end of file
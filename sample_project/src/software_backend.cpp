@@ -0,0 +1,613 @@
+// Internal includes
+#include "software_backend.h"
+#include "bvh_cache.h"
+#include "bvh_paging.h"
+#include "command_context_pool.h"
+#include "command_stream.h"
+#include "cpu_raytracing.h"
+#include "denoiser.h"
+#include "task_scheduler.h"
+#include "triangle_intersection.h"
+#include "wavefront_integrator.h"
+
+// External includes
+#include <assert.h>
+#include <chrono>
+#include <algorithm>
+#include <emmintrin.h>
+#include <string>
+
+namespace dxr_demo
+{
+	namespace software
+	{
+		// Frame buffer index
+		#define NUM_SWAP_FRAME_BUFFERS 2
+
+		// Tiles are 64x64 RGBA32F pixels (64KB), so that a tile job stays within L2
+		#define SOFTWARE_TILE_SIZE 64
+		#define SOFTWARE_TILE_NUM_PIXELS (SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE)
+
+		// Number of floats per pixel
+		#define SOFTWARE_PIXEL_NUM_CHANNELS 4
+
+		// Forward declaration
+		struct SoftwareRenderEnvironement;
+
+		// Structure that stands for the window, the result is kept in memory
+		struct SoftwareWindow
+		{
+			// Dimension of the virtual window
+			uint32_t width;
+			uint32_t height;
+
+			// Flag that tracks the show/hide requests
+			bool visible;
+		};
+
+		struct SoftwareFrameBuffer
+		{
+			// We keep a pointer to the render environement
+			SoftwareRenderEnvironement* renderEnvironement;
+
+			// Number of tiles in each dimension
+			uint32_t numTilesX;
+			uint32_t numTilesY;
+
+			// Pixels of the frame buffer, stored tile after tile (each tile being in scanline order)
+			TTextureDescriptor pixels;
+		};
+
+		struct SoftwareRenderEnvironement
+		{
+			// Structure that hold the data of the virtual window
+			SoftwareWindow window;
+
+			// Scheduler that executes the builds, the path tracer, the denoiser and the tile jobs. It is the one of the renderer,
+			// the backend only spawns its own threads when it is used without one
+			TTaskScheduler* taskScheduler;
+			TTaskScheduler ownedTaskScheduler;
+
+			// Node layout of the bottom level acceleration structures, directory they are cached in and builder of the top level ones
+			BVHNodeFormat::Type bvhNodeFormat;
+			std::string bvhCacheDirectory;
+			BVHBuildMode::Type topLevelBuildMode;
+
+			// Subtrees of the bottom level structures that stay in memory when they are paged, and what the traversal of the last frame did with them
+			uint64_t bvhPageBudget;
+			cpu_raytracing::TBVHPageCache bvhPageCache;
+			cpu_raytracing::TBVHPageStatistics bvhPageStatistics;
+
+			// Top level structures alive, and the ones whose instances moved, they are rebuilt before the commands of the next frame are recorded
+			std::vector<cpu_raytracing::TTopLevelAccelerationStructure*> topLevels;
+			std::vector<cpu_raytracing::TTopLevelAccelerationStructure*> pendingTopLevels;
+
+			// Streams that the threads record into, and their commands in submission order once the frame is flushed
+			TCommandContextPool<TCommandStream> commandContexts;
+			std::vector<TCommandStream*> submittedStreams;
+			std::vector<const TCommandHeader*> commandList;
+
+			// Queues of the path tracer and the samples it accumulated, kept from one frame to the next
+			cpu_raytracing::TWavefrontIntegrator pathIntegrator;
+			cpu_raytracing::TProgressiveAccumulator pathAccumulator;
+
+			// Scratch of the denoiser and the filtered image of the path tracer
+			TDenoiser denoiser;
+			TTextureDescriptor denoisedRadiance;
+
+			// The buffers that are rendered into, and the index of the current one
+			SoftwareFrameBuffer swap_buffer_array[NUM_SWAP_FRAME_BUFFERS];
+			uint32_t current_back_buffer;
+
+			// Result of the last present
+			std::vector<uint32_t> presentedImage;
+
+			// Time at which the render environment was created
+			std::chrono::steady_clock::time_point creationTime;
+
+			// Index of the current frame
+			uint64_t frameIndex;
+		};
+
+		namespace render_system
+		{
+			bool init_render_system()
+			{
+				return true;
+			}
+
+			void shutdown_render_system()
+			{
+			}
+
+			void create_frame_buffer(SoftwareRenderEnvironement& renderEnv, SoftwareFrameBuffer& frameBuffer)
+			{
+				frameBuffer.renderEnvironement = &renderEnv;
+				frameBuffer.numTilesX = (renderEnv.window.width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+				frameBuffer.numTilesY = (renderEnv.window.height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+
+				// Tiles on the border are allocated fully, so a tile job never has to clip its writes
+				frameBuffer.pixels.width = renderEnv.window.width;
+				frameBuffer.pixels.height = renderEnv.window.height;
+				frameBuffer.pixels.data.resize((size_t)frameBuffer.numTilesX * frameBuffer.numTilesY * SOFTWARE_TILE_NUM_PIXELS * SOFTWARE_PIXEL_NUM_CHANNELS);
+			}
+
+			RenderEnvironment create_render_environment(const TGraphicSettings& graphic_settings)
+			{
+				SoftwareRenderEnvironement* newRE = new SoftwareRenderEnvironement();
+
+				// Keep track of the dimensions
+				newRE->window.width = std::max(1u, graphic_settings.width);
+				newRE->window.height = std::max(1u, graphic_settings.height);
+				newRE->window.visible = false;
+				newRE->bvhNodeFormat = graphic_settings.bvhNodeFormat;
+				newRE->bvhCacheDirectory = graphic_settings.bvhCacheDirectory;
+				newRE->topLevelBuildMode = graphic_settings.topLevelBuildMode;
+				newRE->taskScheduler = graphic_settings.taskScheduler;
+
+				// The pages are read from the cache directory, the structures stay resident without one
+				newRE->bvhPageBudget = graphic_settings.bvhCacheDirectory.empty() ? 0 : graphic_settings.bvhPageBudget;
+				if (newRE->bvhPageBudget != 0)
+				{
+					cpu_raytracing::init_bvh_page_cache(newRE->bvhPageCache, newRE->bvhPageBudget);
+				}
+
+				// Share the threads of the renderer, or spawn one per hardware thread
+				if (newRE->taskScheduler == nullptr)
+				{
+					newRE->ownedTaskScheduler.init();
+					newRE->taskScheduler = &newRE->ownedTaskScheduler;
+				}
+
+				// Pick the intersection kernels of the processor
+				initialize_triangle_intersection();
+
+				// Create the swap buffers
+				for (uint32_t bufferIdx = 0; bufferIdx < NUM_SWAP_FRAME_BUFFERS; ++bufferIdx)
+				{
+					create_frame_buffer(*newRE, newRE->swap_buffer_array[bufferIdx]);
+				}
+				newRE->current_back_buffer = 0;
+				newRE->presentedImage.resize((size_t)newRE->window.width * newRE->window.height);
+
+				// Initialize the timing data
+				newRE->creationTime = std::chrono::steady_clock::now();
+				newRE->frameIndex = 0;
+
+				return (RenderEnvironment)newRE;
+			}
+
+			void destroy_render_environment(RenderEnvironment render_environment)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environment;
+				renderEnv->ownedTaskScheduler.destroy();
+				if (renderEnv->bvhPageBudget != 0)
+				{
+					cpu_raytracing::destroy_bvh_page_cache(renderEnv->bvhPageCache);
+				}
+				for (TCommandStream* stream : renderEnv->commandContexts.contexts())
+				{
+					destroy_command_stream(*stream);
+					delete stream;
+				}
+				delete renderEnv;
+			}
+
+			RenderWindow render_window(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				return (RenderWindow)(&renderEnv->window);
+			}
+
+			Framebuffer default_frame_buffer(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				return (Framebuffer)(&renderEnv->swap_buffer_array[renderEnv->current_back_buffer]);
+			}
+
+			uint64_t frame_index(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				return renderEnv->frameIndex;
+			}
+
+			float get_time(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - renderEnv->creationTime;
+				return elapsed.count();
+			}
+
+			bool initialize_frame(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+
+				// The contexts of the previous frame were all submitted
+				renderEnv->commandContexts.reset();
+
+				// Bring the top level structures up to date with the transforms of their instances before any ray is traced
+				for (cpu_raytracing::TTopLevelAccelerationStructure* accelerationStructure : renderEnv->pendingTopLevels)
+				{
+					cpu_raytracing::rebuild_top_level_acceleration_structure(*accelerationStructure, renderEnv->taskScheduler);
+				}
+				renderEnv->pendingTopLevels.clear();
+
+				// We moved to the next frame
+				renderEnv->frameIndex++;
+				return true;
+			}
+
+			CommandContext acquire_command_context(RenderEnvironment render_environement, uint32_t submissionIndex)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				TCommandStream* stream = renderEnv->commandContexts.acquire(submissionIndex, []()
+				{
+					TCommandStream* newStream = new TCommandStream();
+					init_command_stream(*newStream);
+					return newStream;
+				});
+				reset_command_stream(*stream);
+				return (CommandContext)stream;
+			}
+
+			void execute_tile(SoftwareRenderEnvironement& renderEnv, SoftwareFrameBuffer& frameBuffer, uint32_t tileIdx, uint32_t firstCommand, uint32_t lastCommand)
+			{
+				float* tileData = frameBuffer.pixels.data.data() + (size_t)tileIdx * SOFTWARE_TILE_NUM_PIXELS * SOFTWARE_PIXEL_NUM_CHANNELS;
+				uint32_t tileX = (tileIdx % frameBuffer.numTilesX) * SOFTWARE_TILE_SIZE;
+				uint32_t tileY = (tileIdx / frameBuffer.numTilesX) * SOFTWARE_TILE_SIZE;
+
+				// Replay every command of the range that targets this frame buffer, the tile stays hot in cache for the whole range
+				for (uint32_t commandIdx = firstCommand; commandIdx < lastCommand; ++commandIdx)
+				{
+					const TCommandHeader* command = renderEnv.commandList[commandIdx];
+					switch (command->type)
+					{
+						case CommandType::Clear:
+						{
+							const TClearCommand& clear = *(const TClearCommand*)command;
+							if (clear.target.frameBuffer != (Framebuffer)&frameBuffer) continue;
+							for (uint32_t pixelIdx = 0; pixelIdx < SOFTWARE_TILE_NUM_PIXELS; ++pixelIdx)
+							{
+								float* pixel = tileData + pixelIdx * SOFTWARE_PIXEL_NUM_CHANNELS;
+								pixel[0] = clear.color[0];
+								pixel[1] = clear.color[1];
+								pixel[2] = clear.color[2];
+								pixel[3] = clear.color[3];
+							}
+						}
+						break;
+						case CommandType::DispatchRays:
+						{
+							const TDispatchRaysCommand& dispatch = *(const TDispatchRaysCommand*)command;
+							if (dispatch.target.frameBuffer != (Framebuffer)&frameBuffer) continue;
+							TRayDispatchContext context;
+							context.pipeline = &dispatch.pipeline;
+							context.width = frameBuffer.pixels.width;
+							context.height = frameBuffer.pixels.height;
+							context.accelerationStructure = (const cpu_raytracing::TTopLevelAccelerationStructure*)dispatch.accelerationStructure;
+							context.trace_ray = cpu_raytracing::trace_ray;
+
+							// Only the pixels of the tile that are inside the frame buffer are generated
+							uint32_t tileWidth = std::min((uint32_t)SOFTWARE_TILE_SIZE, context.width - tileX);
+							uint32_t tileHeight = std::min((uint32_t)SOFTWARE_TILE_SIZE, context.height - tileY);
+							cpu_raytracing::dispatch_rays_region(context, tileX, tileY, tileWidth, tileHeight, tileData, SOFTWARE_TILE_SIZE);
+						}
+						break;
+						default:
+						break;
+					};
+				}
+			}
+
+			// The cost of the tiles varies with the scene they cover, the scheduler balances them by stealing
+			template<typename TFunctor>
+			void parallel_for_tiles(SoftwareRenderEnvironement& renderEnv, uint32_t numTiles, const TFunctor& functor)
+			{
+				renderEnv.taskScheduler->parallel_for(numTiles, functor);
+			}
+
+			// Execute a range of commands that work tile by tile, one job per tile of each swap buffer
+			void execute_tile_commands(SoftwareRenderEnvironement& renderEnv, uint32_t firstCommand, uint32_t lastCommand)
+			{
+				for (uint32_t bufferIdx = 0; bufferIdx < NUM_SWAP_FRAME_BUFFERS; ++bufferIdx)
+				{
+					SoftwareFrameBuffer& frameBuffer = renderEnv.swap_buffer_array[bufferIdx];
+					bool used = false;
+					for (uint32_t commandIdx = firstCommand; commandIdx < lastCommand; ++commandIdx)
+					{
+						// The barriers are not in the command list, every command left starts with a target header
+						used |= ((const TTargetCommandHeader*)renderEnv.commandList[commandIdx])->frameBuffer == (Framebuffer)&frameBuffer;
+					}
+					if (!used) continue;
+
+					parallel_for_tiles(renderEnv, frameBuffer.numTilesX * frameBuffer.numTilesY, [&](uint32_t tileIdx, uint32_t)
+					{
+						execute_tile(renderEnv, frameBuffer, tileIdx, firstCommand, lastCommand);
+					});
+				}
+			}
+
+			// The path tracer works on the whole frame, the average of its accumulated samples is then written into the tiles
+			void execute_trace_paths(SoftwareRenderEnvironement& renderEnv, const TTracePathsCommand& command)
+			{
+				SoftwareFrameBuffer& frameBuffer = *(SoftwareFrameBuffer*)command.target.frameBuffer;
+				const uint32_t width = frameBuffer.pixels.width;
+				const uint32_t height = frameBuffer.pixels.height;
+				cpu_raytracing::TProgressiveAccumulator& accumulator = renderEnv.pathAccumulator;
+
+				// The custom primitives are intersected by the functions of the pipeline for the duration of the command, the structures belong to the backend
+				cpu_raytracing::TTopLevelAccelerationStructure& accelerationStructure = *(cpu_raytracing::TTopLevelAccelerationStructure*)command.accelerationStructure;
+				cpu_raytracing::bind_shader_binding_table(accelerationStructure, &command.pipeline.shaderBindingTable);
+				cpu_raytracing::render_progressive(accumulator, renderEnv.pathIntegrator, accelerationStructure, command.pipeline, width, height, *renderEnv.taskScheduler);
+				cpu_raytracing::bind_shader_binding_table(accelerationStructure, nullptr);
+
+				// The average is filtered before it is written if the pipeline asks for it
+				const float* radiance = accumulator.accumulation.data.data();
+				if (command.pipeline.denoise)
+				{
+					denoise(renderEnv.denoiser, accumulator.accumulation, accumulator.albedo, accumulator.normal, accumulator.depth, default_denoiser_settings(), *renderEnv.taskScheduler, renderEnv.denoisedRadiance);
+					radiance = renderEnv.denoisedRadiance.data.data();
+				}
+				parallel_for_tiles(renderEnv, frameBuffer.numTilesX * frameBuffer.numTilesY, [&](uint32_t tileIdx, uint32_t)
+				{
+					float* tileData = frameBuffer.pixels.data.data() + (size_t)tileIdx * SOFTWARE_TILE_NUM_PIXELS * SOFTWARE_PIXEL_NUM_CHANNELS;
+					uint32_t tileX = (tileIdx % frameBuffer.numTilesX) * SOFTWARE_TILE_SIZE;
+					uint32_t tileY = (tileIdx / frameBuffer.numTilesX) * SOFTWARE_TILE_SIZE;
+					uint32_t tileWidth = std::min((uint32_t)SOFTWARE_TILE_SIZE, width - tileX);
+					uint32_t tileHeight = std::min((uint32_t)SOFTWARE_TILE_SIZE, height - tileY);
+					for (uint32_t y = 0; y < tileHeight; ++y)
+					{
+						for (uint32_t x = 0; x < tileWidth; ++x)
+						{
+							const float* source = radiance + 3 * ((size_t)(tileY + y) * width + tileX + x);
+							float* pixel = tileData + (y * SOFTWARE_TILE_SIZE + x) * SOFTWARE_PIXEL_NUM_CHANNELS;
+							pixel[0] = source[0];
+							pixel[1] = source[1];
+							pixel[2] = source[2];
+							pixel[3] = 1.0f;
+						}
+					}
+				});
+			}
+
+			bool flush_command_list(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+
+				// Gather the streams in submission order, the order the threads recorded them in does not matter, and drop the commands that have no effect
+				std::vector<TCommandStream*>& streams = renderEnv->submittedStreams;
+				streams.clear();
+				for (const std::pair<uint32_t, TCommandStream*>& context : renderEnv->commandContexts.sorted_contexts())
+				{
+					streams.push_back(context.second);
+				}
+				renderEnv->commandContexts.reset();
+				merge_command_streams(streams.data(), (uint32_t)streams.size());
+
+				// The commands stay in the arenas of the streams until they are acquired again, only their addresses are gathered. The tiles need no transitions
+				renderEnv->commandList.clear();
+				for (const TCommandStream* stream : streams)
+				{
+					for (const TCommandHeader* command = stream->first; command != nullptr; command = command->next)
+					{
+						if (command->type != CommandType::Skipped && command->type != CommandType::Barrier)
+						{
+							renderEnv->commandList.push_back(command);
+						}
+					}
+				}
+
+				// Execute the recorded commands in order, the runs of tile commands are replayed tile by tile between the frame wide ones
+				uint32_t numCommands = (uint32_t)renderEnv->commandList.size();
+				uint32_t firstCommand = 0;
+				while (firstCommand < numCommands)
+				{
+					if (renderEnv->commandList[firstCommand]->type == CommandType::TracePaths)
+					{
+						execute_trace_paths(*renderEnv, *(const TTracePathsCommand*)renderEnv->commandList[firstCommand]);
+						firstCommand++;
+						continue;
+					}
+
+					uint32_t lastCommand = firstCommand + 1;
+					while (lastCommand < numCommands && renderEnv->commandList[lastCommand]->type != CommandType::TracePaths)
+					{
+						lastCommand++;
+					}
+					execute_tile_commands(*renderEnv, firstCommand, lastCommand);
+					firstCommand = lastCommand;
+				}
+				renderEnv->commandList.clear();
+
+				// Every ray of the frame was traced by the commands
+				if (renderEnv->bvhPageBudget != 0)
+				{
+					cpu_raytracing::collect_bvh_page_statistics(renderEnv->bvhPageCache, renderEnv->bvhPageStatistics);
+				}
+				return true;
+			}
+
+			inline uint32_t to_rgba8(const float* pixel)
+			{
+				// Saturate the four channels at once and pack them into a single 32 bit value
+				__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pixel), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				__m128i channels = _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.0f)));
+				channels = _mm_packs_epi32(channels, channels);
+				return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(channels, channels));
+			}
+
+			bool present(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				SoftwareFrameBuffer& backBuffer = renderEnv->swap_buffer_array[renderEnv->current_back_buffer];
+				const uint32_t width = renderEnv->window.width;
+				const uint32_t height = renderEnv->window.height;
+				const float* backBufferData = backBuffer.pixels.data.data();
+				uint32_t* presentedData = renderEnv->presentedImage.data();
+
+				// Resolve the tiles of the back buffer into the RGBA8 scanline image
+				parallel_for_tiles(*renderEnv, backBuffer.numTilesX * backBuffer.numTilesY, [&](uint32_t tileIdx, uint32_t)
+				{
+					const float* tileData = backBufferData + (size_t)tileIdx * SOFTWARE_TILE_NUM_PIXELS * SOFTWARE_PIXEL_NUM_CHANNELS;
+					uint32_t tileX = (tileIdx % backBuffer.numTilesX) * SOFTWARE_TILE_SIZE;
+					uint32_t tileY = (tileIdx / backBuffer.numTilesX) * SOFTWARE_TILE_SIZE;
+					uint32_t tileWidth = std::min((uint32_t)SOFTWARE_TILE_SIZE, width - tileX);
+					uint32_t tileHeight = std::min((uint32_t)SOFTWARE_TILE_SIZE, height - tileY);
+
+					for (uint32_t y = 0; y < tileHeight; ++y)
+					{
+						const float* srcRow = tileData + y * SOFTWARE_TILE_SIZE * SOFTWARE_PIXEL_NUM_CHANNELS;
+						uint32_t* dstRow = presentedData + (size_t)(tileY + y) * width + tileX;
+						for (uint32_t x = 0; x < tileWidth; ++x)
+						{
+							dstRow[x] = to_rgba8(srcRow + x * SOFTWARE_PIXEL_NUM_CHANNELS);
+						}
+					}
+				});
+
+				// The next frame renders into the other buffer
+				renderEnv->current_back_buffer = (renderEnv->current_back_buffer + 1) % NUM_SWAP_FRAME_BUFFERS;
+				return true;
+			}
+
+			const uint32_t* presented_image(RenderEnvironment render_environement)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				return renderEnv->presentedImage.data();
+			}
+
+			bool bvh_page_statistics(RenderEnvironment render_environement, cpu_raytracing::TBVHPageStatistics& statistics)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environement;
+				if (renderEnv->bvhPageBudget == 0) return false;
+				statistics = renderEnv->bvhPageStatistics;
+				return true;
+			}
+		}
+
+		namespace window
+		{
+			void show(RenderWindow renderWindow)
+			{
+				SoftwareWindow* window = (SoftwareWindow*)renderWindow;
+				window->visible = true;
+			}
+
+			void hide(RenderWindow renderWindow)
+			{
+				SoftwareWindow* window = (SoftwareWindow*)renderWindow;
+				window->visible = false;
+			}
+
+			bool is_active(RenderWindow renderWindow)
+			{
+				SoftwareWindow* window = (SoftwareWindow*)renderWindow;
+				return window->visible;
+			}
+
+			void swap(RenderWindow)
+			{
+			}
+		}
+
+		namespace framebuffer
+		{
+			void clear(CommandContext command_context, Framebuffer framebuffer, const float* clearColor)
+			{
+				// Record the clear, it is executed tile by tile when the command list is flushed
+				record_clear(*(TCommandStream*)command_context, framebuffer, clearColor);
+			}
+
+			void transition(CommandContext, const TResourceTransition*, uint32_t)
+			{
+				// The tiles are read and written by the same threads in the order of the commands, nothing needs to be recorded
+			}
+		}
+
+		namespace acceleration_structure
+		{
+			BottomLevelAccelerationStructure create_bottom_level_acceleration_structure(RenderEnvironment render_environment, const TGeometryDescriptor& geometry)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environment;
+				if (renderEnv->bvhPageBudget != 0)
+				{
+					return (BottomLevelAccelerationStructure)cpu_raytracing::create_paged_bottom_level_acceleration_structure(geometry, renderEnv->taskScheduler, renderEnv->bvhCacheDirectory.c_str(), renderEnv->bvhPageCache);
+				}
+				return (BottomLevelAccelerationStructure)cpu_raytracing::create_cached_bottom_level_acceleration_structure(geometry, renderEnv->bvhNodeFormat, renderEnv->taskScheduler, renderEnv->bvhCacheDirectory.c_str());
+			}
+
+			void destroy_bottom_level_acceleration_structure(RenderEnvironment, BottomLevelAccelerationStructure acceleration_structure)
+			{
+				cpu_raytracing::destroy_bottom_level_acceleration_structure((cpu_raytracing::TBottomLevelAccelerationStructure*)acceleration_structure);
+			}
+
+			void update_bottom_level_acceleration_structure(RenderEnvironment render_environment, BottomLevelAccelerationStructure acceleration_structure, const TGeometryDescriptor& geometry)
+			{
+				// Same as the instance transforms, the primitives must not move in the middle of a frame
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environment;
+				assert(renderEnv->commandContexts.num_acquired() == 0);
+				cpu_raytracing::TBottomLevelAccelerationStructure* bottomLevel = (cpu_raytracing::TBottomLevelAccelerationStructure*)acceleration_structure;
+				cpu_raytracing::update_bottom_level_acceleration_structure(*bottomLevel, geometry, renderEnv->taskScheduler);
+
+				// The bounds of the instances changed with the bounds of the structure, their hierarchies are rebuilt with the ones whose instances moved
+				for (cpu_raytracing::TTopLevelAccelerationStructure* topLevel : renderEnv->topLevels)
+				{
+					bool needsRebuild = topLevel->needsRebuild;
+					cpu_raytracing::refresh_instance_bounds(*topLevel, bottomLevel);
+					if (!needsRebuild && topLevel->needsRebuild)
+					{
+						renderEnv->pendingTopLevels.push_back(topLevel);
+					}
+				}
+			}
+
+			TopLevelAccelerationStructure create_top_level_acceleration_structure(RenderEnvironment render_environment, const TInstanceDescriptor* instances, uint32_t numInstances)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environment;
+				cpu_raytracing::TTopLevelAccelerationStructure* accelerationStructure = cpu_raytracing::create_top_level_acceleration_structure(instances, numInstances, renderEnv->topLevelBuildMode, renderEnv->taskScheduler);
+				renderEnv->topLevels.push_back(accelerationStructure);
+				return (TopLevelAccelerationStructure)accelerationStructure;
+			}
+
+			void destroy_top_level_acceleration_structure(RenderEnvironment render_environment, TopLevelAccelerationStructure acceleration_structure)
+			{
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environment;
+				std::vector<cpu_raytracing::TTopLevelAccelerationStructure*>& topLevels = renderEnv->topLevels;
+				std::vector<cpu_raytracing::TTopLevelAccelerationStructure*>& pendingTopLevels = renderEnv->pendingTopLevels;
+				topLevels.erase(std::remove(topLevels.begin(), topLevels.end(), (cpu_raytracing::TTopLevelAccelerationStructure*)acceleration_structure), topLevels.end());
+				pendingTopLevels.erase(std::remove(pendingTopLevels.begin(), pendingTopLevels.end(), (cpu_raytracing::TTopLevelAccelerationStructure*)acceleration_structure), pendingTopLevels.end());
+				cpu_raytracing::destroy_top_level_acceleration_structure((cpu_raytracing::TTopLevelAccelerationStructure*)acceleration_structure);
+			}
+
+			void update_instance_transforms(RenderEnvironment render_environment, TopLevelAccelerationStructure acceleration_structure, uint32_t firstInstance, uint32_t numInstances, const float* transforms)
+			{
+				// Dispatches are executed when the command list is flushed, the update must not happen in the middle of a frame
+				SoftwareRenderEnvironement* renderEnv = (SoftwareRenderEnvironement*)render_environment;
+				assert(renderEnv->commandContexts.num_acquired() == 0);
+
+				// The hierarchy is rebuilt once per frame by initialize_frame, whatever the number of updates
+				cpu_raytracing::TTopLevelAccelerationStructure& accelerationStructure = *(cpu_raytracing::TTopLevelAccelerationStructure*)acceleration_structure;
+				if (!accelerationStructure.needsRebuild)
+				{
+					renderEnv->pendingTopLevels.push_back(&accelerationStructure);
+				}
+				cpu_raytracing::update_instance_transforms(accelerationStructure, firstInstance, numInstances, transforms, renderEnv->taskScheduler);
+			}
+		}
+
+		namespace raytracing
+		{
+			void dispatch_rays(CommandContext command_context, Framebuffer framebuffer, TopLevelAccelerationStructure acceleration_structure, const TRayTracingPipeline& pipeline)
+			{
+				// Record the dispatch, the rays of a tile are traced when the tile is processed at flush time
+				record_dispatch_rays(*(TCommandStream*)command_context, framebuffer, acceleration_structure, pipeline);
+			}
+
+			void trace_paths(CommandContext command_context, Framebuffer framebuffer, TopLevelAccelerationStructure acceleration_structure, const TPathTracingPipeline& pipeline)
+			{
+				// Record the path tracing, it runs over the whole frame at flush time
+				record_trace_paths(*(TCommandStream*)command_context, framebuffer, acceleration_structure, pipeline);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,359 @@
+// Internal includes
+#include "task_scheduler.h"
+
+// External includes
+#include <assert.h>
+
+namespace dxr_demo
+{
+	// Rounds of failed steals before an idle worker goes to sleep
+	#define TASK_SCHEDULER_SPIN_ROUNDS 64
+
+	// Scheduler and index of the worker threads, the threads that do not run a worker loop have no scheduler
+	static thread_local const TTaskScheduler* currentScheduler = nullptr;
+	static thread_local uint32_t currentThreadIndex = 0;
+
+	// State of the random choice of the first victim of a steal
+	static thread_local uint32_t stealSeed = 0x9E3779B9u;
+
+	TTaskCounter::TTaskCounter()
+	: pending(0)
+	, releasing(0)
+	{
+	}
+
+	TTaskDeque::TTaskDeque()
+	: _top(0)
+	, _bottom(0)
+	{
+	}
+
+	void TTaskDeque::write_slot(int64_t index, const TTask& task)
+	{
+		TTaskSlot& slot = _slots[index & (TASK_DEQUE_CAPACITY - 1)];
+		slot.function.store(task.function, std::memory_order_relaxed);
+		slot.userData.store(task.userData, std::memory_order_relaxed);
+		slot.begin.store(task.begin, std::memory_order_relaxed);
+		slot.end.store(task.end, std::memory_order_relaxed);
+		slot.counter.store(task.counter, std::memory_order_relaxed);
+		slot.grainSize.store(task.grainSize, std::memory_order_relaxed);
+	}
+
+	void TTaskDeque::read_slot(int64_t index, TTask& task) const
+	{
+		const TTaskSlot& slot = _slots[index & (TASK_DEQUE_CAPACITY - 1)];
+		task.function = slot.function.load(std::memory_order_relaxed);
+		task.userData = slot.userData.load(std::memory_order_relaxed);
+		task.begin = slot.begin.load(std::memory_order_relaxed);
+		task.end = slot.end.load(std::memory_order_relaxed);
+		task.counter = slot.counter.load(std::memory_order_relaxed);
+		task.grainSize = slot.grainSize.load(std::memory_order_relaxed);
+	}
+
+	bool TTaskDeque::push(const TTask& task)
+	{
+		int64_t bottom = _bottom.load(std::memory_order_relaxed);
+		int64_t top = _top.load(std::memory_order_acquire);
+		if (bottom - top >= TASK_DEQUE_CAPACITY) return false;
+
+		// The slot is published to the thieves by the release of the new bottom
+		write_slot(bottom, task);
+		std::atomic_thread_fence(std::memory_order_release);
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool TTaskDeque::pop(TTask& task)
+	{
+		// Reserve the bottom slot before looking at the top, a thief that read the old bottom races for the same slot
+		int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+		_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = _top.load(std::memory_order_relaxed);
+		if (top > bottom)
+		{
+			_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		read_slot(bottom, task);
+		if (top == bottom)
+		{
+			// Last task, the owner and the thieves compete for it on the top
+			bool won = _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	bool TTaskDeque::steal(TTask& task)
+	{
+		int64_t top = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = _bottom.load(std::memory_order_acquire);
+		if (top >= bottom) return false;
+
+		// The copy is only valid if no other thread moved the top in the meantime
+		read_slot(top, task);
+		return _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	TTaskScheduler::TTaskScheduler()
+	: _queuedTasks(0)
+	, _sleepingWorkers(0)
+	, _shutdown(false)
+	{
+	}
+
+	TTaskScheduler::~TTaskScheduler()
+	{
+		destroy();
+	}
+
+	void TTaskScheduler::init(uint32_t numThreads)
+	{
+		if (numThreads == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			numThreads = hardwareThreads > 1 ? hardwareThreads : 1;
+		}
+		uint32_t numWorkers = numThreads - 1;
+
+		_shutdown = false;
+		_ownerThread = std::this_thread::get_id();
+		for (uint32_t dequeIdx = 0; dequeIdx < numWorkers + 1; ++dequeIdx)
+		{
+			_deques.push_back(new TTaskDeque());
+		}
+		_workers.reserve(numWorkers);
+		for (uint32_t workerIdx = 0; workerIdx < numWorkers; ++workerIdx)
+		{
+			_workers.push_back(std::thread(&TTaskScheduler::worker_loop, this, workerIdx + 1));
+		}
+	}
+
+	void TTaskScheduler::destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_shutdown = true;
+		}
+		_wakeCondition.notify_all();
+
+		for (uint32_t workerIdx = 0; workerIdx < _workers.size(); ++workerIdx)
+		{
+			_workers[workerIdx].join();
+		}
+		_workers.clear();
+
+		for (TTaskDeque* deque : _deques)
+		{
+			delete deque;
+		}
+		_deques.clear();
+	}
+
+	uint32_t TTaskScheduler::num_threads() const
+	{
+		return (uint32_t)_workers.size() + 1;
+	}
+
+	uint32_t TTaskScheduler::thread_index() const
+	{
+		if (currentScheduler == this) return currentThreadIndex;
+		return std::this_thread::get_id() == _ownerThread ? 0 : TASK_SCHEDULER_NO_THREAD;
+	}
+
+	void TTaskScheduler::push_task(uint32_t threadIndex, const TTask& task)
+	{
+		// Counted before the push so that a thief never sees the count go below zero
+		_queuedTasks.fetch_add(1);
+		if (!_deques[threadIndex]->push(task))
+		{
+			_queuedTasks.fetch_sub(1);
+			execute_task(threadIndex, task);
+			return;
+		}
+
+		// A worker that went to sleep after this task was counted has seen the count, the others are woken up here
+		if (_sleepingWorkers.load() != 0)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_wakeCondition.notify_one();
+		}
+	}
+
+	bool TTaskScheduler::find_task(uint32_t threadIndex, TTask& task)
+	{
+		// Newest task of our own deque first, it is the most likely to be in cache
+		if (_deques[threadIndex]->pop(task))
+		{
+			_queuedTasks.fetch_sub(1);
+			return true;
+		}
+
+		// Then the oldest task of the others, starting from a random one so that the thieves spread over the victims
+		uint32_t numDeques = (uint32_t)_deques.size();
+		stealSeed ^= stealSeed << 13;
+		stealSeed ^= stealSeed >> 17;
+		stealSeed ^= stealSeed << 5;
+		for (uint32_t victimIdx = 0; victimIdx < numDeques; ++victimIdx)
+		{
+			uint32_t victim = (stealSeed + victimIdx) % numDeques;
+			if (victim != threadIndex && _deques[victim]->steal(task))
+			{
+				_queuedTasks.fetch_sub(1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void TTaskScheduler::execute_task(uint32_t threadIndex, TTask task)
+	{
+		// Give away the upper half of the range until it fits in a grain
+		uint32_t grainSize = task.grainSize > 1 ? task.grainSize : 1;
+		while (task.end - task.begin > grainSize)
+		{
+			TTask upperHalf = task;
+			upperHalf.begin = task.begin + (task.end - task.begin) / 2;
+			if (task.counter)
+			{
+				task.counter->pending.fetch_add(1);
+			}
+			push_task(threadIndex, upperHalf);
+			task.end = upperHalf.begin;
+		}
+
+		for (uint32_t taskIdx = task.begin; taskIdx < task.end; ++taskIdx)
+		{
+			task.function(task.userData, taskIdx, threadIndex);
+		}
+		if (task.counter)
+		{
+			complete_task(threadIndex, *task.counter);
+		}
+	}
+
+	void TTaskScheduler::complete_task(uint32_t threadIndex, TTaskCounter& counter)
+	{
+		// The counter may be destroyed as soon as it reads zero, the waiters also wait for the threads that still read it
+		counter.releasing.fetch_add(1);
+		if (counter.pending.fetch_sub(1) != 1)
+		{
+			counter.releasing.fetch_sub(1);
+			return;
+		}
+
+		// Last task of the group, release the tasks that depend on it
+		std::vector<TTask> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter.mutex);
+			continuations.swap(counter.continuations);
+		}
+		counter.releasing.fetch_sub(1);
+		for (const TTask& continuation : continuations)
+		{
+			push_task(threadIndex, continuation);
+		}
+	}
+
+	void TTaskScheduler::submit(const TTask& task, TTaskCounter* dependency)
+	{
+		uint32_t threadIndex = thread_index();
+		assert(threadIndex != TASK_SCHEDULER_NO_THREAD);
+		if (task.counter)
+		{
+			task.counter->pending.fetch_add(1);
+		}
+
+		// Hold the task until the dependency is done, the thread that finishes its last task pushes it
+		if (dependency)
+		{
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (dependency->pending.load() != 0)
+			{
+				dependency->continuations.push_back(task);
+				return;
+			}
+		}
+		push_task(threadIndex, task);
+	}
+
+	void TTaskScheduler::wait(TTaskCounter& counter)
+	{
+		uint32_t threadIndex = thread_index();
+		assert(threadIndex != TASK_SCHEDULER_NO_THREAD);
+
+		// Help with any task while the group is not done
+		while (counter.pending.load() != 0 || counter.releasing.load() != 0)
+		{
+			TTask task;
+			if (find_task(threadIndex, task))
+			{
+				execute_task(threadIndex, task);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void TTaskScheduler::parallel_for(uint32_t numTasks, TTaskFunction function, void* userData, uint32_t grainSize)
+	{
+		uint32_t threadIndex = thread_index();
+		assert(threadIndex != TASK_SCHEDULER_NO_THREAD);
+
+		// Nothing to distribute: run everything on this thread
+		if (_workers.empty() || numTasks <= 1 || numTasks <= grainSize)
+		{
+			for (uint32_t taskIdx = 0; taskIdx < numTasks; ++taskIdx)
+			{
+				function(userData, taskIdx, threadIndex);
+			}
+			return;
+		}
+
+		// The calling thread starts splitting the range right away, the idle threads steal the halves it gives away
+		TTaskCounter counter;
+		counter.pending.store(1);
+		TTask task = { function, userData, 0, numTasks, &counter, grainSize };
+		execute_task(threadIndex, task);
+		wait(counter);
+	}
+
+	void TTaskScheduler::worker_loop(uint32_t threadIndex)
+	{
+		currentScheduler = this;
+		currentThreadIndex = threadIndex;
+		stealSeed ^= threadIndex * 0x85EBCA6Bu;
+
+		uint32_t idleRounds = 0;
+		while (true)
+		{
+			TTask task;
+			if (find_task(threadIndex, task))
+			{
+				execute_task(threadIndex, task);
+				idleRounds = 0;
+				continue;
+			}
+
+			// Spin a little before going to sleep, the tasks of a frame tend to come in bursts
+			if (++idleRounds < TASK_SCHEDULER_SPIN_ROUNDS)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			idleRounds = 0;
+
+			std::unique_lock<std::mutex> lock(_mutex);
+			_sleepingWorkers.fetch_add(1);
+			_wakeCondition.wait(lock, [&] { return _shutdown || _queuedTasks.load() != 0; });
+			_sleepingWorkers.fetch_sub(1);
+			if (_shutdown) return;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+// Internal includes
+#include "thread_pool.h"
+
+namespace dxr_demo
+{
+	// Flag raised on the threads that are currently executing tasks, nested parallel_for calls run inline
+	static thread_local bool insideTask = false;
+
+	TThreadPool::TThreadPool()
+	: _generation(0)
+	, _activeWorkers(0)
+	, _shutdown(false)
+	, _function(nullptr)
+	, _userData(nullptr)
+	, _numTasks(0)
+	, _nextTask(0)
+	{
+	}
+
+	TThreadPool::~TThreadPool()
+	{
+		destroy();
+	}
+
+	void TThreadPool::init(uint32_t numWorkers)
+	{
+		if (numWorkers == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			numWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+		}
+
+		_shutdown = false;
+		_workers.reserve(numWorkers);
+		for (uint32_t workerIdx = 0; workerIdx < numWorkers; ++workerIdx)
+		{
+			_workers.push_back(std::thread(&TThreadPool::worker_loop, this, workerIdx + 1));
+		}
+	}
+
+	void TThreadPool::destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_shutdown = true;
+		}
+		_wakeCondition.notify_all();
+
+		for (uint32_t workerIdx = 0; workerIdx < _workers.size(); ++workerIdx)
+		{
+			_workers[workerIdx].join();
+		}
+		_workers.clear();
+	}
+
+	uint32_t TThreadPool::num_threads() const
+	{
+		return (uint32_t)_workers.size() + 1;
+	}
+
+	void TThreadPool::run_tasks(uint32_t threadIndex)
+	{
+		insideTask = true;
+		for (uint32_t taskIdx = _nextTask.fetch_add(1); taskIdx < _numTasks; taskIdx = _nextTask.fetch_add(1))
+		{
+			_function(_userData, taskIdx, threadIndex);
+		}
+		insideTask = false;
+	}
+
+	void TThreadPool::worker_loop(uint32_t threadIndex)
+	{
+		uint64_t lastGeneration = 0;
+		while (true)
+		{
+			// Wait for a new job
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wakeCondition.wait(lock, [&] { return _shutdown || _generation != lastGeneration; });
+				if (_shutdown) return;
+				lastGeneration = _generation;
+			}
+
+			run_tasks(threadIndex);
+
+			// Notify the submitting thread if we are the last one out
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--_activeWorkers == 0)
+			{
+				_doneCondition.notify_one();
+			}
+		}
+	}
+
+	void TThreadPool::parallel_for(uint32_t numTasks, TTaskFunction function, void* userData)
+	{
+		// Nothing to distribute, or we are already inside a task: run everything on this thread
+		if (_workers.empty() || numTasks <= 1 || insideTask)
+		{
+			for (uint32_t taskIdx = 0; taskIdx < numTasks; ++taskIdx)
+			{
+				function(userData, taskIdx, 0);
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> submitLock(_submitMutex);
+
+		// Publish the job and wake the workers
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_function = function;
+			_userData = userData;
+			_numTasks = numTasks;
+			_nextTask.store(0);
+			_activeWorkers = (uint32_t)_workers.size();
+			_generation++;
+		}
+		_wakeCondition.notify_all();
+
+		// The calling thread takes its share of the work
+		run_tasks(0);
+
+		// Wait for the workers to drain the job
+		std::unique_lock<std::mutex> lock(_mutex);
+		_doneCondition.wait(lock, [&] { return _activeWorkers == 0; });
+	}
+}
\ No newline at end of file
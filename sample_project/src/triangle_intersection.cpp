@@ -0,0 +1,271 @@
+// Internal includes
+#include "triangle_intersection.h"
+
+// External includes
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace dxr_demo
+{
+	// Variable that holds the selected kernels
+	TTriangleIntersectionAPI triangleIntersectionAPI = { SIMDInstructionSet::SSE, 0, nullptr, nullptr, nullptr };
+
+	static void cpuid(uint32_t leaf, uint32_t subLeaf, uint32_t* registers)
+	{
+	#if defined(_MSC_VER)
+		__cpuidex((int*)registers, (int)leaf, (int)subLeaf);
+	#else
+		__cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+	#endif
+	}
+
+	// Register states the operating system saves on context switches
+	static uint64_t xgetbv()
+	{
+	#if defined(_MSC_VER)
+		return _xgetbv(0);
+	#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32) | eax;
+	#endif
+	}
+
+	SIMDInstructionSet::Type detect_instruction_set()
+	{
+		uint32_t registers[4];
+		cpuid(0, 0, registers);
+		uint32_t maxLeaf = registers[0];
+
+		// AVX needs the processor support and the operating system to save the YMM registers
+		cpuid(1, 0, registers);
+		bool osxsave = (registers[2] >> 27) & 1;
+		bool avx = (registers[2] >> 28) & 1;
+		bool fma = (registers[2] >> 12) & 1;
+		if (!osxsave || !avx || maxLeaf < 7) return SIMDInstructionSet::SSE;
+
+		uint64_t enabledStates = xgetbv();
+		if ((enabledStates & 0x6) != 0x6) return SIMDInstructionSet::SSE;
+
+		cpuid(7, 0, registers);
+		bool avx2 = (registers[1] >> 5) & 1;
+		bool avx512f = (registers[1] >> 16) & 1;
+
+		// AVX-512 also needs the opmask and ZMM states
+		if (avx512f && (enabledStates & 0xE6) == 0xE6) return SIMDInstructionSet::AVX512;
+		if (avx2 && fma) return SIMDInstructionSet::AVX2;
+		return SIMDInstructionSet::SSE;
+	}
+
+	bool initialize_triangle_intersection(SIMDInstructionSet::Type instructionSet)
+	{
+		if (instructionSet > detect_instruction_set()) return false;
+
+		triangleIntersectionAPI.instructionSet = instructionSet;
+		switch (instructionSet)
+		{
+		case SIMDInstructionSet::SSE:
+		{
+			triangleIntersectionAPI.width = 4;
+			triangleIntersectionAPI.intersect_triangles = sse::intersect_triangles;
+			triangleIntersectionAPI.intersect_spheres = sse::intersect_spheres;
+			triangleIntersectionAPI.intersect_boxes = sse::intersect_boxes;
+		}
+		break;
+		case SIMDInstructionSet::AVX2:
+		{
+			triangleIntersectionAPI.width = 8;
+			triangleIntersectionAPI.intersect_triangles = avx2::intersect_triangles;
+			triangleIntersectionAPI.intersect_spheres = avx2::intersect_spheres;
+			triangleIntersectionAPI.intersect_boxes = avx2::intersect_boxes;
+		}
+		break;
+		case SIMDInstructionSet::AVX512:
+		{
+			triangleIntersectionAPI.width = 16;
+			triangleIntersectionAPI.intersect_triangles = avx512::intersect_triangles;
+			triangleIntersectionAPI.intersect_spheres = avx512::intersect_spheres;
+			triangleIntersectionAPI.intersect_boxes = avx512::intersect_boxes;
+		}
+		break;
+		};
+		return true;
+	}
+
+	void initialize_triangle_intersection()
+	{
+		if (triangleIntersectionAPI.intersect_triangles == nullptr)
+		{
+			initialize_triangle_intersection(detect_instruction_set());
+		}
+	}
+
+	const TTriangleIntersectionAPI& triangle_intersection_api()
+	{
+		return triangleIntersectionAPI;
+	}
+
+	namespace sse
+	{
+		// Moller-Trumbore against 4 triangles at once
+		template<uint32_t Flags>
+		static bool intersect(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m128 originX = _mm_set1_ps(ray.origin[0]);
+			const __m128 originY = _mm_set1_ps(ray.origin[1]);
+			const __m128 originZ = _mm_set1_ps(ray.origin[2]);
+			const __m128 directionX = _mm_set1_ps(ray.direction[0]);
+			const __m128 directionY = _mm_set1_ps(ray.direction[1]);
+			const __m128 directionZ = _mm_set1_ps(ray.direction[2]);
+			const __m128 tMin = _mm_set1_ps(ray.tMin);
+			const __m128 epsilon = _mm_set1_ps(1e-12f);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * TRIANGLE_GROUP_NUM_ARRAYS * 4;
+				__m128 edge1X = _mm_loadu_ps(group + 12), edge1Y = _mm_loadu_ps(group + 16), edge1Z = _mm_loadu_ps(group + 20);
+				__m128 edge2X = _mm_loadu_ps(group + 24), edge2Y = _mm_loadu_ps(group + 28), edge2Z = _mm_loadu_ps(group + 32);
+
+				__m128 pvecX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+				__m128 pvecY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+				__m128 pvecZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+				__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pvecX), _mm_mul_ps(edge1Y, pvecY)), _mm_mul_ps(edge1Z, pvecZ));
+				__m128 invDet = _mm_div_ps(one, det);
+
+				__m128 tvecX = _mm_sub_ps(originX, _mm_loadu_ps(group));
+				__m128 tvecY = _mm_sub_ps(originY, _mm_loadu_ps(group + 4));
+				__m128 tvecZ = _mm_sub_ps(originZ, _mm_loadu_ps(group + 8));
+				__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tvecX, pvecX), _mm_mul_ps(tvecY, pvecY)), _mm_mul_ps(tvecZ, pvecZ)), invDet);
+
+				__m128 qvecX = _mm_sub_ps(_mm_mul_ps(tvecY, edge1Z), _mm_mul_ps(tvecZ, edge1Y));
+				__m128 qvecY = _mm_sub_ps(_mm_mul_ps(tvecZ, edge1X), _mm_mul_ps(tvecX, edge1Z));
+				__m128 qvecZ = _mm_sub_ps(_mm_mul_ps(tvecX, edge1Y), _mm_mul_ps(tvecY, edge1X));
+				__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qvecX), _mm_mul_ps(directionY, qvecY)), _mm_mul_ps(directionZ, qvecZ)), invDet);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qvecX), _mm_mul_ps(edge2Y, qvecY)), _mm_mul_ps(edge2Z, qvecZ)), invDet);
+
+				__m128 valid = (Flags & RayFlags::CullBackFaces) ? _mm_cmpge_ps(det, epsilon) : _mm_cmpge_ps(_mm_andnot_ps(signMask, det), epsilon);
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+				valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, tMin), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+				uint32_t mask = (uint32_t)_mm_movemask_ps(valid);
+				if (mask == 0) continue;
+
+				// Keep the closest of the lanes that are hit, or the first one when any hit will do
+				float tArray[4], uArray[4], vArray[4];
+				_mm_storeu_ps(tArray, t);
+				_mm_storeu_ps(uArray, u);
+				_mm_storeu_ps(vArray, v);
+				found |= select_lane_hit<Flags>(mask, tArray, uArray, vArray, (const uint32_t*)(group + 36), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		// Spheres 4 at a time, the distance to the center is measured at the closest approach of the ray for precision
+		// The directions are not normalized, distances along the ray are scaled by the inverse of their squared length
+		template<uint32_t Flags>
+		static bool intersect_sphere_groups(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m128 originX = _mm_set1_ps(ray.origin[0]);
+			const __m128 originY = _mm_set1_ps(ray.origin[1]);
+			const __m128 originZ = _mm_set1_ps(ray.origin[2]);
+			const __m128 directionX = _mm_set1_ps(ray.direction[0]);
+			const __m128 directionY = _mm_set1_ps(ray.direction[1]);
+			const __m128 directionZ = _mm_set1_ps(ray.direction[2]);
+			const __m128 invLengthSquared = _mm_set1_ps(1.0f / (ray.direction[0] * ray.direction[0] + ray.direction[1] * ray.direction[1] + ray.direction[2] * ray.direction[2]));
+			const __m128 tMin = _mm_set1_ps(ray.tMin);
+			const __m128 zero = _mm_setzero_ps();
+			const float zeroArray[4] = {};
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * SPHERE_GROUP_NUM_ARRAYS * 4;
+				__m128 toCenterX = _mm_sub_ps(_mm_loadu_ps(group), originX);
+				__m128 toCenterY = _mm_sub_ps(_mm_loadu_ps(group + 4), originY);
+				__m128 toCenterZ = _mm_sub_ps(_mm_loadu_ps(group + 8), originZ);
+				__m128 tCenter = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, directionX), _mm_mul_ps(toCenterY, directionY)), _mm_mul_ps(toCenterZ, directionZ)), invLengthSquared);
+
+				// Offset from the center to the closest point of the ray, and half the chord length
+				__m128 offsetX = _mm_sub_ps(_mm_mul_ps(directionX, tCenter), toCenterX);
+				__m128 offsetY = _mm_sub_ps(_mm_mul_ps(directionY, tCenter), toCenterY);
+				__m128 offsetZ = _mm_sub_ps(_mm_mul_ps(directionZ, tCenter), toCenterZ);
+				__m128 chordSquared = _mm_sub_ps(_mm_loadu_ps(group + 12), _mm_add_ps(_mm_add_ps(_mm_mul_ps(offsetX, offsetX), _mm_mul_ps(offsetY, offsetY)), _mm_mul_ps(offsetZ, offsetZ)));
+				__m128 halfChord = _mm_sqrt_ps(_mm_mul_ps(_mm_max_ps(chordSquared, zero), invLengthSquared));
+
+				// The rays that start inside the sphere hit its far side
+				__m128 tNear = _mm_sub_ps(tCenter, halfChord);
+				__m128 nearValid = _mm_cmpge_ps(tNear, tMin);
+				__m128 t = _mm_or_ps(_mm_and_ps(nearValid, tNear), _mm_andnot_ps(nearValid, _mm_add_ps(tCenter, halfChord)));
+
+				__m128 valid = _mm_cmpge_ps(chordSquared, zero);
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, tMin), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+				uint32_t mask = (uint32_t)_mm_movemask_ps(valid);
+				if (mask == 0) continue;
+
+				float tArray[4];
+				_mm_storeu_ps(tArray, t);
+				found |= select_lane_hit<Flags>(mask, tArray, zeroArray, zeroArray, (const uint32_t*)(group + 16), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		// Slab test against 4 boxes at once, the rays that start inside a box hit its exit point
+		template<uint32_t Flags>
+		static bool intersect_box_groups(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m128 originX = _mm_set1_ps(ray.origin[0]);
+			const __m128 originY = _mm_set1_ps(ray.origin[1]);
+			const __m128 originZ = _mm_set1_ps(ray.origin[2]);
+			const __m128 invDirectionX = _mm_set1_ps(1.0f / ray.direction[0]);
+			const __m128 invDirectionY = _mm_set1_ps(1.0f / ray.direction[1]);
+			const __m128 invDirectionZ = _mm_set1_ps(1.0f / ray.direction[2]);
+			const __m128 tMin = _mm_set1_ps(ray.tMin);
+			const __m128i invalidPrimitive = _mm_set1_epi32((int)TRIANGLE_INVALID_PRIMITIVE);
+			const float zeroArray[4] = {};
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * BOX_GROUP_NUM_ARRAYS * 4;
+				__m128 t0X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group), originX), invDirectionX);
+				__m128 t0Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group + 4), originY), invDirectionY);
+				__m128 t0Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group + 8), originZ), invDirectionZ);
+				__m128 t1X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group + 12), originX), invDirectionX);
+				__m128 t1Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group + 16), originY), invDirectionY);
+				__m128 t1Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group + 20), originZ), invDirectionZ);
+				__m128 tEnter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0X, t1X), _mm_min_ps(t0Y, t1Y)), _mm_min_ps(t0Z, t1Z));
+				__m128 tExit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0X, t1X), _mm_max_ps(t0Y, t1Y)), _mm_max_ps(t0Z, t1Z));
+
+				__m128 enterValid = _mm_cmpge_ps(tEnter, tMin);
+				__m128 t = _mm_or_ps(_mm_and_ps(enterValid, tEnter), _mm_andnot_ps(enterValid, tExit));
+
+				__m128i primitiveIndices = _mm_loadu_si128((const __m128i*)(group + 24));
+				__m128 valid = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(primitiveIndices, invalidPrimitive)), _mm_cmple_ps(tEnter, tExit));
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, tMin), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+				uint32_t mask = (uint32_t)_mm_movemask_ps(valid);
+				if (mask == 0) continue;
+
+				float tArray[4];
+				_mm_storeu_ps(tArray, t);
+				found |= select_lane_hit<Flags>(mask, tArray, zeroArray, zeroArray, (const uint32_t*)(group + 24), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		const TIntersectPrimitiveGroupsFunction intersect_triangles[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect<0>, intersect<1>, intersect<2>, intersect<3> };
+		// Face culling does not apply to the procedural primitives, its variants are the ones without it
+		const TIntersectPrimitiveGroupsFunction intersect_spheres[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect_sphere_groups<0>, intersect_sphere_groups<1>, intersect_sphere_groups<0>, intersect_sphere_groups<1> };
+		const TIntersectPrimitiveGroupsFunction intersect_boxes[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect_box_groups<0>, intersect_box_groups<1>, intersect_box_groups<0>, intersect_box_groups<1> };
+	}
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+// Internal includes
+#include "triangle_intersection.h"
+
+// External includes
+#include <immintrin.h>
+
+namespace dxr_demo
+{
+	namespace avx2
+	{
+		// Moller-Trumbore against 8 triangles at once, this file is built with AVX2 and FMA enabled
+		template<uint32_t Flags>
+		static bool intersect(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m256 originX = _mm256_set1_ps(ray.origin[0]);
+			const __m256 originY = _mm256_set1_ps(ray.origin[1]);
+			const __m256 originZ = _mm256_set1_ps(ray.origin[2]);
+			const __m256 directionX = _mm256_set1_ps(ray.direction[0]);
+			const __m256 directionY = _mm256_set1_ps(ray.direction[1]);
+			const __m256 directionZ = _mm256_set1_ps(ray.direction[2]);
+			const __m256 tMin = _mm256_set1_ps(ray.tMin);
+			const __m256 epsilon = _mm256_set1_ps(1e-12f);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * TRIANGLE_GROUP_NUM_ARRAYS * 8;
+				__m256 edge1X = _mm256_loadu_ps(group + 24), edge1Y = _mm256_loadu_ps(group + 32), edge1Z = _mm256_loadu_ps(group + 40);
+				__m256 edge2X = _mm256_loadu_ps(group + 48), edge2Y = _mm256_loadu_ps(group + 56), edge2Z = _mm256_loadu_ps(group + 64);
+
+				__m256 pvecX = _mm256_fmsub_ps(directionY, edge2Z, _mm256_mul_ps(directionZ, edge2Y));
+				__m256 pvecY = _mm256_fmsub_ps(directionZ, edge2X, _mm256_mul_ps(directionX, edge2Z));
+				__m256 pvecZ = _mm256_fmsub_ps(directionX, edge2Y, _mm256_mul_ps(directionY, edge2X));
+				__m256 det = _mm256_fmadd_ps(edge1X, pvecX, _mm256_fmadd_ps(edge1Y, pvecY, _mm256_mul_ps(edge1Z, pvecZ)));
+				__m256 invDet = _mm256_div_ps(one, det);
+
+				__m256 tvecX = _mm256_sub_ps(originX, _mm256_loadu_ps(group));
+				__m256 tvecY = _mm256_sub_ps(originY, _mm256_loadu_ps(group + 8));
+				__m256 tvecZ = _mm256_sub_ps(originZ, _mm256_loadu_ps(group + 16));
+				__m256 u = _mm256_mul_ps(_mm256_fmadd_ps(tvecX, pvecX, _mm256_fmadd_ps(tvecY, pvecY, _mm256_mul_ps(tvecZ, pvecZ))), invDet);
+
+				__m256 qvecX = _mm256_fmsub_ps(tvecY, edge1Z, _mm256_mul_ps(tvecZ, edge1Y));
+				__m256 qvecY = _mm256_fmsub_ps(tvecZ, edge1X, _mm256_mul_ps(tvecX, edge1Z));
+				__m256 qvecZ = _mm256_fmsub_ps(tvecX, edge1Y, _mm256_mul_ps(tvecY, edge1X));
+				__m256 v = _mm256_mul_ps(_mm256_fmadd_ps(directionX, qvecX, _mm256_fmadd_ps(directionY, qvecY, _mm256_mul_ps(directionZ, qvecZ))), invDet);
+				__m256 t = _mm256_mul_ps(_mm256_fmadd_ps(edge2X, qvecX, _mm256_fmadd_ps(edge2Y, qvecY, _mm256_mul_ps(edge2Z, qvecZ))), invDet);
+
+				__m256 valid = (Flags & RayFlags::CullBackFaces) ? _mm256_cmp_ps(det, epsilon, _CMP_GE_OQ) : _mm256_cmp_ps(_mm256_andnot_ps(signMask, det), epsilon, _CMP_GE_OQ);
+				valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, zero, _CMP_GE_OQ)));
+				valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+				valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, tMin, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+				uint32_t mask = (uint32_t)_mm256_movemask_ps(valid);
+				if (mask == 0) continue;
+
+				// Keep the closest of the lanes that are hit, or the first one when any hit will do
+				float tArray[8], uArray[8], vArray[8];
+				_mm256_storeu_ps(tArray, t);
+				_mm256_storeu_ps(uArray, u);
+				_mm256_storeu_ps(vArray, v);
+				found |= select_lane_hit<Flags>(mask, tArray, uArray, vArray, (const uint32_t*)(group + 72), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		// Spheres 8 at a time, the distance to the center is measured at the closest approach of the ray for precision
+		// The directions are not normalized, distances along the ray are scaled by the inverse of their squared length
+		template<uint32_t Flags>
+		static bool intersect_sphere_groups(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m256 originX = _mm256_set1_ps(ray.origin[0]);
+			const __m256 originY = _mm256_set1_ps(ray.origin[1]);
+			const __m256 originZ = _mm256_set1_ps(ray.origin[2]);
+			const __m256 directionX = _mm256_set1_ps(ray.direction[0]);
+			const __m256 directionY = _mm256_set1_ps(ray.direction[1]);
+			const __m256 directionZ = _mm256_set1_ps(ray.direction[2]);
+			const __m256 invLengthSquared = _mm256_set1_ps(1.0f / (ray.direction[0] * ray.direction[0] + ray.direction[1] * ray.direction[1] + ray.direction[2] * ray.direction[2]));
+			const __m256 tMin = _mm256_set1_ps(ray.tMin);
+			const __m256 zero = _mm256_setzero_ps();
+			const float zeroArray[8] = {};
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * SPHERE_GROUP_NUM_ARRAYS * 8;
+				__m256 toCenterX = _mm256_sub_ps(_mm256_loadu_ps(group), originX);
+				__m256 toCenterY = _mm256_sub_ps(_mm256_loadu_ps(group + 8), originY);
+				__m256 toCenterZ = _mm256_sub_ps(_mm256_loadu_ps(group + 16), originZ);
+				__m256 tCenter = _mm256_mul_ps(_mm256_fmadd_ps(toCenterX, directionX, _mm256_fmadd_ps(toCenterY, directionY, _mm256_mul_ps(toCenterZ, directionZ))), invLengthSquared);
+
+				// Offset from the center to the closest point of the ray, and half the chord length
+				__m256 offsetX = _mm256_fmsub_ps(directionX, tCenter, toCenterX);
+				__m256 offsetY = _mm256_fmsub_ps(directionY, tCenter, toCenterY);
+				__m256 offsetZ = _mm256_fmsub_ps(directionZ, tCenter, toCenterZ);
+				__m256 chordSquared = _mm256_sub_ps(_mm256_loadu_ps(group + 24), _mm256_fmadd_ps(offsetX, offsetX, _mm256_fmadd_ps(offsetY, offsetY, _mm256_mul_ps(offsetZ, offsetZ))));
+				__m256 halfChord = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_max_ps(chordSquared, zero), invLengthSquared));
+
+				// The rays that start inside the sphere hit its far side
+				__m256 tNear = _mm256_sub_ps(tCenter, halfChord);
+				__m256 t = _mm256_blendv_ps(_mm256_add_ps(tCenter, halfChord), tNear, _mm256_cmp_ps(tNear, tMin, _CMP_GE_OQ));
+
+				__m256 valid = _mm256_cmp_ps(chordSquared, zero, _CMP_GE_OQ);
+				valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, tMin, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+				uint32_t mask = (uint32_t)_mm256_movemask_ps(valid);
+				if (mask == 0) continue;
+
+				float tArray[8];
+				_mm256_storeu_ps(tArray, t);
+				found |= select_lane_hit<Flags>(mask, tArray, zeroArray, zeroArray, (const uint32_t*)(group + 32), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		// Slab test against 8 boxes at once, the rays that start inside a box hit its exit point
+		template<uint32_t Flags>
+		static bool intersect_box_groups(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m256 originX = _mm256_set1_ps(ray.origin[0]);
+			const __m256 originY = _mm256_set1_ps(ray.origin[1]);
+			const __m256 originZ = _mm256_set1_ps(ray.origin[2]);
+			const __m256 invDirectionX = _mm256_set1_ps(1.0f / ray.direction[0]);
+			const __m256 invDirectionY = _mm256_set1_ps(1.0f / ray.direction[1]);
+			const __m256 invDirectionZ = _mm256_set1_ps(1.0f / ray.direction[2]);
+			const __m256 tMin = _mm256_set1_ps(ray.tMin);
+			const __m256i invalidPrimitive = _mm256_set1_epi32((int)TRIANGLE_INVALID_PRIMITIVE);
+			const float zeroArray[8] = {};
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * BOX_GROUP_NUM_ARRAYS * 8;
+				__m256 t0X = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(group), originX), invDirectionX);
+				__m256 t0Y = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(group + 8), originY), invDirectionY);
+				__m256 t0Z = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(group + 16), originZ), invDirectionZ);
+				__m256 t1X = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(group + 24), originX), invDirectionX);
+				__m256 t1Y = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(group + 32), originY), invDirectionY);
+				__m256 t1Z = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(group + 40), originZ), invDirectionZ);
+				__m256 tEnter = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0X, t1X), _mm256_min_ps(t0Y, t1Y)), _mm256_min_ps(t0Z, t1Z));
+				__m256 tExit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0X, t1X), _mm256_max_ps(t0Y, t1Y)), _mm256_max_ps(t0Z, t1Z));
+				__m256 t = _mm256_blendv_ps(tExit, tEnter, _mm256_cmp_ps(tEnter, tMin, _CMP_GE_OQ));
+
+				__m256i primitiveIndices = _mm256_loadu_si256((const __m256i*)(group + 48));
+				__m256 valid = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(primitiveIndices, invalidPrimitive)), _mm256_cmp_ps(tEnter, tExit, _CMP_LE_OQ));
+				valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, tMin, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+				uint32_t mask = (uint32_t)_mm256_movemask_ps(valid);
+				if (mask == 0) continue;
+
+				float tArray[8];
+				_mm256_storeu_ps(tArray, t);
+				found |= select_lane_hit<Flags>(mask, tArray, zeroArray, zeroArray, (const uint32_t*)(group + 48), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		const TIntersectPrimitiveGroupsFunction intersect_triangles[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect<0>, intersect<1>, intersect<2>, intersect<3> };
+		// Face culling does not apply to the procedural primitives, its variants are the ones without it
+		const TIntersectPrimitiveGroupsFunction intersect_spheres[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect_sphere_groups<0>, intersect_sphere_groups<1>, intersect_sphere_groups<0>, intersect_sphere_groups<1> };
+		const TIntersectPrimitiveGroupsFunction intersect_boxes[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect_box_groups<0>, intersect_box_groups<1>, intersect_box_groups<0>, intersect_box_groups<1> };
+	}
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+// Internal includes
+#include "triangle_intersection.h"
+
+// External includes
+#include <immintrin.h>
+
+namespace dxr_demo
+{
+	namespace avx512
+	{
+		// Moller-Trumbore against 16 triangles at once, this file is built with AVX-512F enabled
+		template<uint32_t Flags>
+		static bool intersect(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m512 originX = _mm512_set1_ps(ray.origin[0]);
+			const __m512 originY = _mm512_set1_ps(ray.origin[1]);
+			const __m512 originZ = _mm512_set1_ps(ray.origin[2]);
+			const __m512 directionX = _mm512_set1_ps(ray.direction[0]);
+			const __m512 directionY = _mm512_set1_ps(ray.direction[1]);
+			const __m512 directionZ = _mm512_set1_ps(ray.direction[2]);
+			const __m512 tMin = _mm512_set1_ps(ray.tMin);
+			const __m512 epsilon = _mm512_set1_ps(1e-12f);
+			const __m512 zero = _mm512_setzero_ps();
+			const __m512 one = _mm512_set1_ps(1.0f);
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * TRIANGLE_GROUP_NUM_ARRAYS * 16;
+				__m512 edge1X = _mm512_loadu_ps(group + 48), edge1Y = _mm512_loadu_ps(group + 64), edge1Z = _mm512_loadu_ps(group + 80);
+				__m512 edge2X = _mm512_loadu_ps(group + 96), edge2Y = _mm512_loadu_ps(group + 112), edge2Z = _mm512_loadu_ps(group + 128);
+
+				__m512 pvecX = _mm512_fmsub_ps(directionY, edge2Z, _mm512_mul_ps(directionZ, edge2Y));
+				__m512 pvecY = _mm512_fmsub_ps(directionZ, edge2X, _mm512_mul_ps(directionX, edge2Z));
+				__m512 pvecZ = _mm512_fmsub_ps(directionX, edge2Y, _mm512_mul_ps(directionY, edge2X));
+				__m512 det = _mm512_fmadd_ps(edge1X, pvecX, _mm512_fmadd_ps(edge1Y, pvecY, _mm512_mul_ps(edge1Z, pvecZ)));
+				__m512 invDet = _mm512_div_ps(one, det);
+
+				__m512 tvecX = _mm512_sub_ps(originX, _mm512_loadu_ps(group));
+				__m512 tvecY = _mm512_sub_ps(originY, _mm512_loadu_ps(group + 16));
+				__m512 tvecZ = _mm512_sub_ps(originZ, _mm512_loadu_ps(group + 32));
+				__m512 u = _mm512_mul_ps(_mm512_fmadd_ps(tvecX, pvecX, _mm512_fmadd_ps(tvecY, pvecY, _mm512_mul_ps(tvecZ, pvecZ))), invDet);
+
+				__m512 qvecX = _mm512_fmsub_ps(tvecY, edge1Z, _mm512_mul_ps(tvecZ, edge1Y));
+				__m512 qvecY = _mm512_fmsub_ps(tvecZ, edge1X, _mm512_mul_ps(tvecX, edge1Z));
+				__m512 qvecZ = _mm512_fmsub_ps(tvecX, edge1Y, _mm512_mul_ps(tvecY, edge1X));
+				__m512 v = _mm512_mul_ps(_mm512_fmadd_ps(directionX, qvecX, _mm512_fmadd_ps(directionY, qvecY, _mm512_mul_ps(directionZ, qvecZ))), invDet);
+				__m512 t = _mm512_mul_ps(_mm512_fmadd_ps(edge2X, qvecX, _mm512_fmadd_ps(edge2Y, qvecY, _mm512_mul_ps(edge2Z, qvecZ))), invDet);
+
+				__m512 absDet = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(det), _mm512_set1_epi32(0x7FFFFFFF)));
+				__mmask16 valid = _mm512_cmp_ps_mask((Flags & RayFlags::CullBackFaces) ? det : absDet, epsilon, _CMP_GE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, u, zero, _CMP_GE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, v, zero, _CMP_GE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, _mm512_add_ps(u, v), one, _CMP_LE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, t, tMin, _CMP_GE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, t, _mm512_set1_ps(tMax), _CMP_LT_OQ);
+				uint32_t mask = (uint32_t)valid;
+				if (mask == 0) continue;
+
+				// Keep the closest of the lanes that are hit, or the first one when any hit will do
+				float tArray[16], uArray[16], vArray[16];
+				_mm512_storeu_ps(tArray, t);
+				_mm512_storeu_ps(uArray, u);
+				_mm512_storeu_ps(vArray, v);
+				found |= select_lane_hit<Flags>(mask, tArray, uArray, vArray, (const uint32_t*)(group + 144), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		// Spheres 16 at a time, the distance to the center is measured at the closest approach of the ray for precision
+		// The directions are not normalized, distances along the ray are scaled by the inverse of their squared length
+		template<uint32_t Flags>
+		static bool intersect_sphere_groups(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m512 originX = _mm512_set1_ps(ray.origin[0]);
+			const __m512 originY = _mm512_set1_ps(ray.origin[1]);
+			const __m512 originZ = _mm512_set1_ps(ray.origin[2]);
+			const __m512 directionX = _mm512_set1_ps(ray.direction[0]);
+			const __m512 directionY = _mm512_set1_ps(ray.direction[1]);
+			const __m512 directionZ = _mm512_set1_ps(ray.direction[2]);
+			const __m512 invLengthSquared = _mm512_set1_ps(1.0f / (ray.direction[0] * ray.direction[0] + ray.direction[1] * ray.direction[1] + ray.direction[2] * ray.direction[2]));
+			const __m512 tMin = _mm512_set1_ps(ray.tMin);
+			const __m512 zero = _mm512_setzero_ps();
+			const float zeroArray[16] = {};
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * SPHERE_GROUP_NUM_ARRAYS * 16;
+				__m512 toCenterX = _mm512_sub_ps(_mm512_loadu_ps(group), originX);
+				__m512 toCenterY = _mm512_sub_ps(_mm512_loadu_ps(group + 16), originY);
+				__m512 toCenterZ = _mm512_sub_ps(_mm512_loadu_ps(group + 32), originZ);
+				__m512 tCenter = _mm512_mul_ps(_mm512_fmadd_ps(toCenterX, directionX, _mm512_fmadd_ps(toCenterY, directionY, _mm512_mul_ps(toCenterZ, directionZ))), invLengthSquared);
+
+				// Offset from the center to the closest point of the ray, and half the chord length
+				__m512 offsetX = _mm512_fmsub_ps(directionX, tCenter, toCenterX);
+				__m512 offsetY = _mm512_fmsub_ps(directionY, tCenter, toCenterY);
+				__m512 offsetZ = _mm512_fmsub_ps(directionZ, tCenter, toCenterZ);
+				__m512 chordSquared = _mm512_sub_ps(_mm512_loadu_ps(group + 48), _mm512_fmadd_ps(offsetX, offsetX, _mm512_fmadd_ps(offsetY, offsetY, _mm512_mul_ps(offsetZ, offsetZ))));
+				__m512 halfChord = _mm512_sqrt_ps(_mm512_mul_ps(_mm512_max_ps(chordSquared, zero), invLengthSquared));
+
+				// The rays that start inside the sphere hit its far side
+				__m512 tNear = _mm512_sub_ps(tCenter, halfChord);
+				__m512 t = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(tNear, tMin, _CMP_GE_OQ), _mm512_add_ps(tCenter, halfChord), tNear);
+
+				__mmask16 valid = _mm512_cmp_ps_mask(chordSquared, zero, _CMP_GE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, t, tMin, _CMP_GE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, t, _mm512_set1_ps(tMax), _CMP_LT_OQ);
+				uint32_t mask = (uint32_t)valid;
+				if (mask == 0) continue;
+
+				float tArray[16];
+				_mm512_storeu_ps(tArray, t);
+				found |= select_lane_hit<Flags>(mask, tArray, zeroArray, zeroArray, (const uint32_t*)(group + 64), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		// Slab test against 16 boxes at once, the rays that start inside a box hit its exit point
+		template<uint32_t Flags>
+		static bool intersect_box_groups(const float* groups, uint32_t numGroups, const TRay& ray, float& tMax, THit& hit)
+		{
+			const __m512 originX = _mm512_set1_ps(ray.origin[0]);
+			const __m512 originY = _mm512_set1_ps(ray.origin[1]);
+			const __m512 originZ = _mm512_set1_ps(ray.origin[2]);
+			const __m512 invDirectionX = _mm512_set1_ps(1.0f / ray.direction[0]);
+			const __m512 invDirectionY = _mm512_set1_ps(1.0f / ray.direction[1]);
+			const __m512 invDirectionZ = _mm512_set1_ps(1.0f / ray.direction[2]);
+			const __m512 tMin = _mm512_set1_ps(ray.tMin);
+			const __m512i invalidPrimitive = _mm512_set1_epi32((int)TRIANGLE_INVALID_PRIMITIVE);
+			const float zeroArray[16] = {};
+
+			bool found = false;
+			for (uint32_t groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+			{
+				const float* group = groups + groupIdx * BOX_GROUP_NUM_ARRAYS * 16;
+				__m512 t0X = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(group), originX), invDirectionX);
+				__m512 t0Y = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(group + 16), originY), invDirectionY);
+				__m512 t0Z = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(group + 32), originZ), invDirectionZ);
+				__m512 t1X = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(group + 48), originX), invDirectionX);
+				__m512 t1Y = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(group + 64), originY), invDirectionY);
+				__m512 t1Z = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(group + 80), originZ), invDirectionZ);
+				__m512 tEnter = _mm512_max_ps(_mm512_max_ps(_mm512_min_ps(t0X, t1X), _mm512_min_ps(t0Y, t1Y)), _mm512_min_ps(t0Z, t1Z));
+				__m512 tExit = _mm512_min_ps(_mm512_min_ps(_mm512_max_ps(t0X, t1X), _mm512_max_ps(t0Y, t1Y)), _mm512_max_ps(t0Z, t1Z));
+				__m512 t = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(tEnter, tMin, _CMP_GE_OQ), tExit, tEnter);
+
+				__m512i primitiveIndices = _mm512_loadu_si512((const void*)(group + 96));
+				__mmask16 valid = _mm512_cmpneq_epi32_mask(primitiveIndices, invalidPrimitive);
+				valid = _mm512_mask_cmp_ps_mask(valid, tEnter, tExit, _CMP_LE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, t, tMin, _CMP_GE_OQ);
+				valid = _mm512_mask_cmp_ps_mask(valid, t, _mm512_set1_ps(tMax), _CMP_LT_OQ);
+				uint32_t mask = (uint32_t)valid;
+				if (mask == 0) continue;
+
+				float tArray[16];
+				_mm512_storeu_ps(tArray, t);
+				found |= select_lane_hit<Flags>(mask, tArray, zeroArray, zeroArray, (const uint32_t*)(group + 96), tMax, hit);
+				if ((Flags & RayFlags::AcceptFirstHit) && found) return true;
+			}
+			return found;
+		}
+
+		const TIntersectPrimitiveGroupsFunction intersect_triangles[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect<0>, intersect<1>, intersect<2>, intersect<3> };
+		// Face culling does not apply to the procedural primitives, its variants are the ones without it
+		const TIntersectPrimitiveGroupsFunction intersect_spheres[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect_sphere_groups<0>, intersect_sphere_groups<1>, intersect_sphere_groups<0>, intersect_sphere_groups<1> };
+		const TIntersectPrimitiveGroupsFunction intersect_boxes[INTERSECTION_KERNEL_NUM_VARIANTS] = { intersect_box_groups<0>, intersect_box_groups<1>, intersect_box_groups<0>, intersect_box_groups<1> };
+	}
+}
\ No newline at end of file
@@ -0,0 +1,460 @@
+// Internal includes
+#include "wavefront_integrator.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <math.h>
+
+namespace dxr_demo
+{
+	namespace cpu_raytracing
+	{
+		// Number of paths processed by a task of every stage, large enough for the sorts by hit group to batch the calls of the shader binding table
+		#define WAVEFRONT_CHUNK_SIZE 4096
+
+		// Side of the pixel tiles the camera rays are generated over, a tile is one packet
+		#define WAVEFRONT_TILE_SIZE 4
+
+		// Number of rows a task of the accumulation blends, a single row is too short to be worth a steal
+		#define WAVEFRONT_ROW_GRAIN_SIZE 8
+
+		// Hit group of the rays that left the scene, it sorts after every record of the shader binding table
+		#define WAVEFRONT_MISS_GROUP 0xFFFFFFFFu
+
+		static void resize_queue(TPathQueue& queue, uint32_t capacity)
+		{
+			queue.numPaths = 0;
+			queue.pixelIndices.resize(capacity);
+			queue.randomStates.resize(capacity);
+			queue.throughputs.resize(3 * (size_t)capacity);
+			queue.rays.resize(capacity);
+		}
+
+		// Size the buffers for a frame, this only allocates when the dimensions change
+		static void prepare_integrator(TWavefrontIntegrator& integrator, uint32_t width, uint32_t height)
+		{
+			if (integrator.width == width && integrator.height == height && !integrator.pixelOrder.empty()) return;
+			integrator.width = width;
+			integrator.height = height;
+
+			uint32_t numPixels = width * height;
+			integrator.pixelOrder.clear();
+			integrator.pixelOrder.reserve(numPixels);
+			for (uint32_t tileY = 0; tileY < height; tileY += WAVEFRONT_TILE_SIZE)
+			{
+				for (uint32_t tileX = 0; tileX < width; tileX += WAVEFRONT_TILE_SIZE)
+				{
+					for (uint32_t y = tileY; y < std::min(tileY + WAVEFRONT_TILE_SIZE, height); ++y)
+					{
+						for (uint32_t x = tileX; x < std::min(tileX + WAVEFRONT_TILE_SIZE, width); ++x)
+						{
+							integrator.pixelOrder.push_back(y * width + x);
+						}
+					}
+				}
+			}
+
+			resize_queue(integrator.queues[0], numPixels);
+			resize_queue(integrator.queues[1], numPixels);
+			integrator.hits.resize(numPixels);
+			integrator.found.resize(numPixels);
+			integrator.samples.resize(numPixels);
+			integrator.shadowRays.resize(numPixels);
+			integrator.shadowPaths.resize(numPixels);
+			integrator.sortKeys.resize(numPixels);
+			integrator.chunkOffsets.resize((numPixels + WAVEFRONT_CHUNK_SIZE - 1) / WAVEFRONT_CHUNK_SIZE + 1);
+			integrator.radiance.resize(3 * (size_t)numPixels);
+			integrator.albedo.resize(3 * (size_t)numPixels);
+			integrator.normals.resize(3 * (size_t)numPixels);
+			integrator.depth.resize(numPixels);
+			integrator.batchRayIndices.resize(numPixels);
+			integrator.batchT.resize(numPixels);
+			integrator.batchU.resize(numPixels);
+			integrator.batchV.resize(numPixels);
+			integrator.batchPrimitiveIndices.resize(numPixels);
+			integrator.batchInstanceIDs.resize(numPixels);
+			integrator.batchAccepted.resize(numPixels);
+		}
+
+		// Decorrelated, non zero seed of the random sequence of a pixel for a given sample
+		static inline uint32_t random_seed(uint32_t pixelIndex, uint32_t sampleIndex)
+		{
+			uint32_t seed = pixelIndex * 0x9E3779B9u ^ (sampleIndex + 1) * 0x85EBCA6Bu;
+			seed = (seed ^ 61u) ^ (seed >> 16);
+			seed *= 9u;
+			seed ^= seed >> 4;
+			seed *= 0x27D4EB2Du;
+			seed ^= seed >> 15;
+			return seed != 0 ? seed : 1;
+		}
+
+		// Intersection of a range of rays, the tiles of the first bounce are traced as packets and the later bounces as streams
+		static void trace_range(TWavefrontIntegrator& integrator, const TTopLevelAccelerationStructure& accelerationStructure, const TRay* rays, uint32_t first, uint32_t count, uint32_t rayFlags, bool coherent)
+		{
+			THit* hits = integrator.hits.data() + first;
+			uint8_t* found = integrator.found.data() + first;
+			if (!coherent)
+			{
+				intersect_stream(accelerationStructure, rays, count, rayFlags, 0xFF, hits, found);
+				return;
+			}
+
+			for (uint32_t packetStart = 0; packetStart < count; packetStart += RAY_PACKET_MAX_SIZE)
+			{
+				uint32_t numRays = std::min((uint32_t)RAY_PACKET_MAX_SIZE, count - packetStart);
+				uint32_t hitMask = intersect_packet(accelerationStructure, rays + packetStart, numRays, rayFlags, 0xFF, hits + packetStart);
+				for (uint32_t lane = 0; lane < numRays; ++lane)
+				{
+					found[packetStart + lane] = (hitMask >> lane) & 1;
+				}
+			}
+		}
+
+		// End of the run of sorted keys that share the hit group (high 32 bits) of the key at runStart
+		static inline uint32_t hit_group_run_end(const uint64_t* keys, uint32_t runStart, uint32_t numKeys)
+		{
+			uint32_t runEnd = runStart + 1;
+			while (runEnd < numKeys && (keys[runEnd] >> 32) == (keys[runStart] >> 32)) runEnd++;
+			return runEnd;
+		}
+
+		// Gather the hits of a run of sorted keys of a chunk into the batch arrays, the ray indices (low 32 bits of the keys) are relative to the chunk
+		static THitGroupBatch gather_batch(TWavefrontIntegrator& integrator, uint32_t first, const uint64_t* keys, uint32_t runStart, uint32_t runEnd)
+		{
+			uint32_t batchStart = first + runStart;
+			THitGroupBatch batch;
+			batch.count = runEnd - runStart;
+			batch.rayIndices = &integrator.batchRayIndices[batchStart];
+			batch.t = &integrator.batchT[batchStart];
+			batch.u = &integrator.batchU[batchStart];
+			batch.v = &integrator.batchV[batchStart];
+			batch.primitiveIndices = &integrator.batchPrimitiveIndices[batchStart];
+			batch.instanceIDs = &integrator.batchInstanceIDs[batchStart];
+			for (uint32_t batchIdx = 0; batchIdx < batch.count; ++batchIdx)
+			{
+				uint32_t rayIdx = (uint32_t)keys[runStart + batchIdx];
+				const THit& hit = integrator.hits[first + rayIdx];
+				integrator.batchRayIndices[batchStart + batchIdx] = rayIdx;
+				integrator.batchT[batchStart + batchIdx] = hit.t;
+				integrator.batchU[batchStart + batchIdx] = hit.u;
+				integrator.batchV[batchStart + batchIdx] = hit.v;
+				integrator.batchPrimitiveIndices[batchStart + batchIdx] = hit.primitiveIndex;
+				integrator.batchInstanceIDs[batchStart + batchIdx] = hit.instanceID;
+			}
+			return batch;
+		}
+
+		// Run the any hit functions on the hits of a traced range that land on geometries that are not opaque, one call per hit group
+		// The rays of the ignored hits are traced again beyond them until their hit is accepted or they leave the scene
+		static void resolve_any_hits(TWavefrontIntegrator& integrator, const TTopLevelAccelerationStructure& accelerationStructure, const TPathTracingPipeline& pipeline,
+			const TRay* rays, uint32_t first, uint32_t count, uint32_t rayFlags)
+		{
+			const TShaderBindingTable& shaderBindingTable = pipeline.shaderBindingTable;
+			THit* hits = &integrator.hits[first];
+			uint8_t* found = &integrator.found[first];
+			uint64_t* keys = &integrator.sortKeys[first];
+
+			// Hit group whose any hit function must see the hit of a ray, WAVEFRONT_MISS_GROUP if there is none
+			auto any_hit_group = [&](uint32_t rayIdx)
+			{
+				if (!found[rayIdx]) return WAVEFRONT_MISS_GROUP;
+				const TInstance& instance = accelerationStructure.instances[hits[rayIdx].instanceIndex];
+				if (instance.bottomLevel->opaque) return WAVEFRONT_MISS_GROUP;
+				assert(instance.hitGroupIndex < shaderBindingTable.numHitGroups);
+				return shaderBindingTable.hitGroups[instance.hitGroupIndex].any_hit != nullptr ? instance.hitGroupIndex : WAVEFRONT_MISS_GROUP;
+			};
+
+			uint32_t numPending = 0;
+			for (uint32_t rayIdx = 0; rayIdx < count; ++rayIdx)
+			{
+				uint32_t hitGroup = any_hit_group(rayIdx);
+				if (hitGroup != WAVEFRONT_MISS_GROUP) keys[numPending++] = ((uint64_t)hitGroup << 32) | rayIdx;
+			}
+
+			while (numPending != 0)
+			{
+				std::sort(keys, keys + numPending);
+
+				// The keys of the rays that hit another candidate are packed at the front, behind the runs that were already gathered
+				uint32_t numRejected = 0;
+				for (uint32_t runStart = 0; runStart < numPending;)
+				{
+					uint32_t runEnd = hit_group_run_end(keys, runStart, numPending);
+					const THitGroupRecord& record = shaderBindingTable.hitGroups[keys[runStart] >> 32];
+					THitGroupBatch batch = gather_batch(integrator, first, keys, runStart, runEnd);
+					uint8_t* accepted = &integrator.batchAccepted[first + runStart];
+					std::fill(accepted, accepted + batch.count, (uint8_t)1);
+					record.any_hit(pipeline.userData, record.rootData, batch, rays, accepted);
+
+					for (uint32_t batchIdx = 0; batchIdx < batch.count; ++batchIdx)
+					{
+						if (accepted[batchIdx]) continue;
+						uint32_t rayIdx = batch.rayIndices[batchIdx];
+						TRay ray = rays[rayIdx];
+						ray.tMin = nextafterf(hits[rayIdx].t, INFINITY);
+						found[rayIdx] = intersect_ray(accelerationStructure, ray, rayFlags, 0xFF, hits[rayIdx]) ? 1 : 0;
+
+						uint32_t hitGroup = any_hit_group(rayIdx);
+						if (hitGroup != WAVEFRONT_MISS_GROUP) keys[numRejected++] = ((uint64_t)hitGroup << 32) | rayIdx;
+					}
+					runStart = runEnd;
+				}
+				numPending = numRejected;
+			}
+		}
+
+		// Shade a range of extended paths, they are sorted by hit group so that every record of the shader binding table is called once with all its hits
+		static void shade_range(TWavefrontIntegrator& integrator, const TTopLevelAccelerationStructure& accelerationStructure, const TPathTracingPipeline& pipeline,
+			TPathQueue& queue, uint32_t first, uint32_t count)
+		{
+			const TShaderBindingTable& shaderBindingTable = pipeline.shaderBindingTable;
+			uint64_t* keys = &integrator.sortKeys[first];
+			for (uint32_t rayIdx = 0; rayIdx < count; ++rayIdx)
+			{
+				uint32_t hitGroup = WAVEFRONT_MISS_GROUP;
+				if (integrator.found[first + rayIdx])
+				{
+					hitGroup = accelerationStructure.instances[integrator.hits[first + rayIdx].instanceIndex].hitGroupIndex;
+					assert(hitGroup < shaderBindingTable.numHitGroups);
+				}
+				keys[rayIdx] = ((uint64_t)hitGroup << 32) | rayIdx;
+			}
+			std::sort(keys, keys + count);
+
+			const TRay* rays = &queue.rays[first];
+			uint32_t* randomStates = &queue.randomStates[first];
+			TSurfaceSample* samples = &integrator.samples[first];
+			for (uint32_t runStart = 0; runStart < count;)
+			{
+				uint32_t runEnd = hit_group_run_end(keys, runStart, count);
+				uint32_t hitGroup = (uint32_t)(keys[runStart] >> 32);
+				if (hitGroup == WAVEFRONT_MISS_GROUP)
+				{
+					uint32_t* rayIndices = &integrator.batchRayIndices[first + runStart];
+					for (uint32_t batchIdx = 0; batchIdx < runEnd - runStart; ++batchIdx)
+					{
+						rayIndices[batchIdx] = (uint32_t)keys[runStart + batchIdx];
+					}
+					shaderBindingTable.miss.miss(pipeline.userData, shaderBindingTable.miss.rootData, rayIndices, runEnd - runStart, rays, samples);
+				}
+				else
+				{
+					const THitGroupRecord& record = shaderBindingTable.hitGroups[hitGroup];
+					THitGroupBatch batch = gather_batch(integrator, first, keys, runStart, runEnd);
+					record.closest_hit(pipeline.userData, record.rootData, batch, rays, randomStates, samples);
+				}
+				runStart = runEnd;
+			}
+		}
+
+		void render_wavefront(TWavefrontIntegrator& integrator, const TTopLevelAccelerationStructure& accelerationStructure, const TPathTracingPipeline& pipeline,
+			uint32_t width, uint32_t height, uint32_t sampleIndex, TTaskScheduler& taskScheduler)
+		{
+			prepare_integrator(integrator, width, height);
+			float* radiance = integrator.radiance.data();
+
+			// Run a stage over the paths of the current queue, one task per chunk
+			auto run_stage = [&](uint32_t numPaths, const auto& process_chunk)
+			{
+				uint32_t numChunks = (numPaths + WAVEFRONT_CHUNK_SIZE - 1) / WAVEFRONT_CHUNK_SIZE;
+				taskScheduler.parallel_for(numChunks, [&](uint32_t chunkIdx, uint32_t)
+				{
+					uint32_t first = chunkIdx * WAVEFRONT_CHUNK_SIZE;
+					process_chunk(chunkIdx, first, std::min(numPaths - first, (uint32_t)WAVEFRONT_CHUNK_SIZE));
+				});
+			};
+
+			// Generate: one camera path per pixel
+			uint32_t currentQueue = 0;
+			TPathQueue& cameraQueue = integrator.queues[currentQueue];
+			cameraQueue.numPaths = width * height;
+			run_stage(cameraQueue.numPaths, [&](uint32_t, uint32_t first, uint32_t count)
+			{
+				for (uint32_t pathIdx = first; pathIdx < first + count; ++pathIdx)
+				{
+					uint32_t pixelIndex = integrator.pixelOrder[pathIdx];
+					cameraQueue.pixelIndices[pathIdx] = pixelIndex;
+					cameraQueue.randomStates[pathIdx] = random_seed(pixelIndex, sampleIndex);
+					std::fill(&cameraQueue.throughputs[3 * (size_t)pathIdx], &cameraQueue.throughputs[3 * (size_t)pathIdx] + 3, 1.0f);
+					std::fill(radiance + 3 * (size_t)pixelIndex, radiance + 3 * (size_t)pixelIndex + 3, 0.0f);
+				}
+				pipeline.generate_camera_rays(pipeline.userData, width, height, &cameraQueue.pixelIndices[first], count, &cameraQueue.randomStates[first], &cameraQueue.rays[first]);
+			});
+
+			for (uint32_t depth = 0; depth < pipeline.maxDepth; ++depth)
+			{
+				TPathQueue& queue = integrator.queues[currentQueue];
+				TPathQueue& nextQueue = integrator.queues[1 - currentQueue];
+				if (queue.numPaths == 0) break;
+
+				// Extend: closest hit of every path, the hits on geometries that are not opaque go through their any hit function
+				run_stage(queue.numPaths, [&](uint32_t, uint32_t first, uint32_t count)
+				{
+					trace_range(integrator, accelerationStructure, &queue.rays[first], first, count, RayFlags::None, depth == 0);
+					resolve_any_hits(integrator, accelerationStructure, pipeline, &queue.rays[first], first, count, RayFlags::None);
+				});
+
+				// Shade: surface response, the emitted radiance is accumulated right away
+				run_stage(queue.numPaths, [&](uint32_t, uint32_t first, uint32_t count)
+				{
+					shade_range(integrator, accelerationStructure, pipeline, queue, first, count);
+					for (uint32_t pathIdx = first; pathIdx < first + count; ++pathIdx)
+					{
+						const TSurfaceSample& sample = integrator.samples[pathIdx];
+						const float* throughput = &queue.throughputs[3 * (size_t)pathIdx];
+						float* pixel = radiance + 3 * (size_t)queue.pixelIndices[pathIdx];
+						pixel[0] += throughput[0] * sample.emission[0];
+						pixel[1] += throughput[1] * sample.emission[1];
+						pixel[2] += throughput[2] * sample.emission[2];
+					}
+
+					// The first surface of the camera paths is kept for the denoiser
+					if (depth != 0) return;
+					for (uint32_t pathIdx = first; pathIdx < first + count; ++pathIdx)
+					{
+						const TSurfaceSample& sample = integrator.samples[pathIdx];
+						uint32_t pixelIndex = queue.pixelIndices[pathIdx];
+						std::copy(sample.albedo, sample.albedo + 3, &integrator.albedo[3 * (size_t)pixelIndex]);
+						std::copy(sample.normal, sample.normal + 3, &integrator.normals[3 * (size_t)pixelIndex]);
+						integrator.depth[pixelIndex] = integrator.found[pathIdx] ? integrator.hits[pathIdx].t : 0.0f;
+					}
+				});
+
+				// Connect shadow: the light samples that bring something are packed at the start of the chunk and traced
+				run_stage(queue.numPaths, [&](uint32_t, uint32_t first, uint32_t count)
+				{
+					uint32_t numShadowRays = 0;
+					for (uint32_t pathIdx = first; pathIdx < first + count; ++pathIdx)
+					{
+						const float* directRadiance = integrator.samples[pathIdx].directRadiance;
+						if (directRadiance[0] <= 0.0f && directRadiance[1] <= 0.0f && directRadiance[2] <= 0.0f) continue;
+						integrator.shadowPaths[first + numShadowRays] = pathIdx;
+						integrator.shadowRays[first + numShadowRays] = integrator.samples[pathIdx].shadowRay;
+						numShadowRays++;
+					}
+					trace_range(integrator, accelerationStructure, &integrator.shadowRays[first], first, numShadowRays, RayFlags::AcceptFirstHit, depth == 0);
+					resolve_any_hits(integrator, accelerationStructure, pipeline, &integrator.shadowRays[first], first, numShadowRays, RayFlags::AcceptFirstHit);
+
+					for (uint32_t shadowIdx = first; shadowIdx < first + numShadowRays; ++shadowIdx)
+					{
+						if (integrator.found[shadowIdx]) continue;
+						uint32_t pathIdx = integrator.shadowPaths[shadowIdx];
+						const float* directRadiance = integrator.samples[pathIdx].directRadiance;
+						const float* throughput = &queue.throughputs[3 * (size_t)pathIdx];
+						float* pixel = radiance + 3 * (size_t)queue.pixelIndices[pathIdx];
+						pixel[0] += throughput[0] * directRadiance[0];
+						pixel[1] += throughput[1] * directRadiance[1];
+						pixel[2] += throughput[2] * directRadiance[2];
+					}
+				});
+
+				// Compact: the paths that continue are packed in the next queue, in the same relative order
+				bool lastBounce = depth + 1 == pipeline.maxDepth;
+				auto survives = [&](uint32_t pathIdx)
+				{
+					const float* weight = integrator.samples[pathIdx].bounceWeight;
+					return !lastBounce && (weight[0] > 0.0f || weight[1] > 0.0f || weight[2] > 0.0f);
+				};
+
+				uint32_t* chunkOffsets = integrator.chunkOffsets.data();
+				run_stage(queue.numPaths, [&](uint32_t chunkIdx, uint32_t first, uint32_t count)
+				{
+					uint32_t numSurvivors = 0;
+					for (uint32_t pathIdx = first; pathIdx < first + count; ++pathIdx)
+					{
+						numSurvivors += survives(pathIdx) ? 1 : 0;
+					}
+					chunkOffsets[chunkIdx] = numSurvivors;
+				});
+
+				uint32_t numChunks = (queue.numPaths + WAVEFRONT_CHUNK_SIZE - 1) / WAVEFRONT_CHUNK_SIZE;
+				uint32_t offset = 0;
+				for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+				{
+					uint32_t numSurvivors = chunkOffsets[chunkIdx];
+					chunkOffsets[chunkIdx] = offset;
+					offset += numSurvivors;
+				}
+				nextQueue.numPaths = offset;
+
+				run_stage(queue.numPaths, [&](uint32_t chunkIdx, uint32_t first, uint32_t count)
+				{
+					uint32_t outputIdx = chunkOffsets[chunkIdx];
+					for (uint32_t pathIdx = first; pathIdx < first + count; ++pathIdx)
+					{
+						if (!survives(pathIdx)) continue;
+
+						const TSurfaceSample& sample = integrator.samples[pathIdx];
+						nextQueue.pixelIndices[outputIdx] = queue.pixelIndices[pathIdx];
+						nextQueue.randomStates[outputIdx] = queue.randomStates[pathIdx];
+						for (uint32_t channel = 0; channel < 3; ++channel)
+						{
+							nextQueue.throughputs[3 * (size_t)outputIdx + channel] = queue.throughputs[3 * (size_t)pathIdx + channel] * sample.bounceWeight[channel];
+						}
+						nextQueue.rays[outputIdx] = sample.bounceRay;
+						outputIdx++;
+					}
+				});
+				currentQueue = 1 - currentQueue;
+			}
+		}
+
+		uint32_t render_progressive(TProgressiveAccumulator& accumulator, TWavefrontIntegrator& integrator, const TTopLevelAccelerationStructure& accelerationStructure,
+			const TPathTracingPipeline& pipeline, uint32_t width, uint32_t height, TTaskScheduler& taskScheduler)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			// Start over when the image changed
+			TTextureDescriptor* textures[4] = { &accumulator.accumulation, &accumulator.albedo, &accumulator.normal, &accumulator.depth };
+			const uint32_t numChannels[4] = { 3, 3, 3, 1 };
+			if (accumulator.accumulationId != pipeline.accumulationId || accumulator.accumulation.width != width || accumulator.accumulation.height != height || accumulator.numSamples == 0)
+			{
+				for (uint32_t textureIdx = 0; textureIdx < 4; ++textureIdx)
+				{
+					textures[textureIdx]->width = width;
+					textures[textureIdx]->height = height;
+					textures[textureIdx]->data.assign(numChannels[textureIdx] * (size_t)width * height, 0.0f);
+				}
+				accumulator.numSamples = 0;
+				accumulator.accumulationId = pipeline.accumulationId;
+			}
+
+			// Keep adding samples while the next one is expected to end within the budget, a sample is assumed to cost as much as the previous one
+			uint32_t numSamples = 0;
+			double budget = pipeline.timeBudget * 1e-3;
+			double elapsed = 0.0;
+			double sampleTime = 0.0;
+			do
+			{
+				render_wavefront(integrator, accelerationStructure, pipeline, width, height, accumulator.sampleIndex++, taskScheduler);
+
+				// Rows are blended in parallel into the running averages, the integrator buffers and the textures share the same layout
+				const float* sources[4] = { integrator.radiance.data(), integrator.albedo.data(), integrator.normals.data(), integrator.depth.data() };
+				accumulator.numSamples++;
+				numSamples++;
+				const float sampleWeight = 1.0f / accumulator.numSamples;
+				taskScheduler.parallel_for(height, [&](uint32_t y, uint32_t)
+				{
+					for (uint32_t textureIdx = 0; textureIdx < 4; ++textureIdx)
+					{
+						const float* source = sources[textureIdx];
+						float* average = textures[textureIdx]->data.data();
+						size_t first = numChannels[textureIdx] * (size_t)y * width;
+						for (size_t channelIdx = first; channelIdx < first + numChannels[textureIdx] * (size_t)width; ++channelIdx)
+						{
+							average[channelIdx] += (source[channelIdx] - average[channelIdx]) * sampleWeight;
+						}
+					}
+				}, WAVEFRONT_ROW_GRAIN_SIZE);
+
+				std::chrono::duration<double> totalTime = std::chrono::steady_clock::now() - start;
+				sampleTime = totalTime.count() - elapsed;
+				elapsed = totalTime.count();
+			} while (elapsed + sampleTime < budget);
+			return numSamples;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+// Internal includes
+#include "imported_scene.h"
+
+namespace dxr_demo
+{
+	namespace converter
+	{
+		// Import a glTF 2.0 file, either a .gltf with external buffers or a binary .glb. Returns false if it cannot be read or is not supported
+		// The buffers are mapped and the positions are welded straight out of them, every triangle primitive becomes a mesh and every node that references it an instance
+		// Only the positions, the indices and the base color factors are imported, the embedded data URIs, the sparse accessors and the images are not supported
+		bool import_gltf(const char* path, TTaskScheduler& taskScheduler, TImportedScene& scene);
+	}
+}
\ No newline at end of file
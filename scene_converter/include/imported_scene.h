@@ -0,0 +1,61 @@
+#pragma once
+
+// Internal includes
+#include "scene_file.h"
+
+// External includes
+#include <stdint.h>
+#include <vector>
+
+namespace dxr_demo
+{
+	// Forward declaration
+	class TTaskScheduler;
+
+	namespace converter
+	{
+		struct TImportedMesh
+		{
+			// Three floats per unique vertex and three indices per triangle, in the order the vertex cache optimization picked
+			std::vector<float> vertices;
+			std::vector<uint32_t> indices;
+		};
+
+		struct TMeshStatistics
+		{
+			// Vertices left once the duplicates were merged, and triangles
+			uint64_t uniqueVertices;
+			uint64_t numTriangles;
+
+			// Misses of the vertex cache in the source order of the triangles and in the optimized order
+			uint64_t sourceCacheMisses;
+			uint64_t optimizedCacheMisses;
+		};
+
+		struct TImportStatistics
+		{
+			// Bytes read from the source files and vertices they declare
+			uint64_t inputBytes;
+			uint64_t sourceVertices;
+
+			// Sum of the statistics of the meshes
+			TMeshStatistics meshes;
+
+			// Seconds spent parsing the sources, the reads included, and optimizing the meshes
+			double parseTime;
+			double optimizeTime;
+		};
+
+		// Scene in the runtime layout, filled by the importers
+		struct TImportedScene
+		{
+			std::vector<TImportedMesh> meshes;
+			std::vector<TSceneFileMaterial> materials;
+			std::vector<TSceneFileInstance> instances;
+			TImportStatistics statistics;
+		};
+
+		// Write a scene file, with a camera that frames the bounds of the instances. Returns false if the file cannot be written
+		bool write_imported_scene(const TImportedScene& scene, const char* path);
+	}
+}
\ No newline at end of file
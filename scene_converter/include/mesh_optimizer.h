@@ -0,0 +1,37 @@
+#pragma once
+
+// Internal includes
+#include "imported_scene.h"
+
+// External includes
+#include <stdint.h>
+
+namespace dxr_demo
+{
+	namespace converter
+	{
+		// Number of vertices of the post transform cache the triangle order is optimized for
+		#define MESH_OPTIMIZER_CACHE_SIZE 16
+
+		// Merge the vertices that have the same position, through a hash map of the positions
+		// positions holds numPositions float triplets stride bytes apart and indices three entries per triangle. Returns false if an index is out of range
+		bool weld_vertices(const uint8_t* positions, uint32_t stride, uint64_t numPositions, const uint32_t* indices, uint64_t numIndices, TImportedMesh& mesh);
+
+		// Reorder the triangles for the vertex cache with the Tipsify algorithm, then the vertices in the order the triangles first use them
+		void optimize_mesh(TImportedMesh& mesh);
+
+		// Misses of a first in first out vertex cache of cacheSize vertices over a triangle list
+		uint64_t count_cache_misses(const uint32_t* indices, uint64_t numIndices, uint32_t numVertices, uint32_t cacheSize);
+
+		// Weld and optimize a mesh and record what it went through, returns false if an index is out of range
+		bool build_mesh(const uint8_t* positions, uint32_t stride, uint64_t numPositions, const uint32_t* indices, uint64_t numIndices, TImportedMesh& mesh, TMeshStatistics& statistics);
+
+		inline void accumulate_statistics(TMeshStatistics& total, const TMeshStatistics& statistics)
+		{
+			total.uniqueVertices += statistics.uniqueVertices;
+			total.numTriangles += statistics.numTriangles;
+			total.sourceCacheMisses += statistics.sourceCacheMisses;
+			total.optimizedCacheMisses += statistics.optimizedCacheMisses;
+		}
+	}
+}
\ No newline at end of file
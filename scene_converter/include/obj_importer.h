@@ -0,0 +1,18 @@
+#pragma once
+
+// Internal includes
+#include "imported_scene.h"
+
+namespace dxr_demo
+{
+	namespace converter
+	{
+		// Bytes of text read at once and parsed by a single task, the importer holds one chunk per thread
+		#define OBJ_IMPORTER_CHUNK_SIZE (16 * 1024 * 1024)
+
+		// Import a Wavefront OBJ file and the diffuse colors of its MTL libraries, returns false if it cannot be read or references missing vertices
+		// The text is streamed: batches of one chunk per thread are read and parsed in parallel, only the parsed positions and triangles stay in memory
+		// Every object, group and material change starts a mesh, the polygons are split in fans and only the positions are kept
+		bool import_obj(const char* path, TTaskScheduler& taskScheduler, TImportedScene& scene);
+	}
+}
\ No newline at end of file
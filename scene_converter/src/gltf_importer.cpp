@@ -0,0 +1,692 @@
+// Internal includes
+#include "gltf_importer.h"
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+namespace dxr_demo
+{
+	namespace converter
+	{
+		// Missing value of the document, and deepest nesting accepted by the parser
+		#define GLTF_INVALID_INDEX 0xFFFFFFFFu
+		#define GLTF_MAX_JSON_DEPTH 256
+
+		// Binary container, a JSON chunk followed by an optional BIN chunk
+		#define GLB_MAGIC 0x46546C67u
+		#define GLB_CHUNK_JSON 0x4E4F534Au
+		#define GLB_CHUNK_BIN 0x004E4942u
+
+		// Accessor component types and primitive mode that are imported
+		#define GLTF_UNSIGNED_BYTE 5121
+		#define GLTF_UNSIGNED_SHORT 5123
+		#define GLTF_UNSIGNED_INT 5125
+		#define GLTF_FLOAT 5126
+		#define GLTF_TRIANGLES 4
+
+		namespace JsonType
+		{
+			enum Type
+			{
+				Null,
+				Boolean,
+				Number,
+				String,
+				Array,
+				Object
+			};
+		}
+
+		// Values of a document are stored in a flat array, the children of an array or an object are linked through their siblings
+		struct TJsonValue
+		{
+			JsonType::Type type;
+			double number;
+			std::string string;
+
+			// Name of the value inside its parent object
+			std::string key;
+
+			uint32_t firstChild;
+			uint32_t nextSibling;
+			uint32_t numChildren;
+		};
+
+		struct TJsonParser
+		{
+			const char* cursor;
+			const char* end;
+			std::vector<TJsonValue> values;
+		};
+
+		// Parsed document and the elements of its top level arrays, so that they are indexed in constant time
+		struct TGltfDocument
+		{
+			std::vector<TJsonValue> values;
+			std::vector<uint32_t> accessors;
+			std::vector<uint32_t> bufferViews;
+			std::vector<uint32_t> materials;
+			std::vector<uint32_t> meshes;
+			std::vector<uint32_t> nodes;
+		};
+
+		// Byte range of a buffer, inside the mapping of its file
+		struct TGltfBuffer
+		{
+			const uint8_t* data;
+			uint64_t size;
+		};
+
+		// Elements of an accessor, validated against the bounds of their buffer
+		struct TGltfAccessor
+		{
+			const uint8_t* data;
+			uint64_t count;
+			uint32_t stride;
+			uint32_t componentType;
+			uint32_t numComponents;
+		};
+
+		// Triangle primitive of a mesh of the document
+		struct TGltfPrimitive
+		{
+			TGltfAccessor positions;
+			TGltfAccessor indices;
+			bool indexed;
+			uint32_t materialIndex;
+		};
+
+		struct TGltfNodeEntry
+		{
+			uint32_t node;
+			uint32_t depth;
+			float transform[12];
+		};
+
+		static void skip_whitespace(TJsonParser& parser)
+		{
+			while (parser.cursor < parser.end && (*parser.cursor == ' ' || *parser.cursor == '\t' || *parser.cursor == '\n' || *parser.cursor == '\r'))
+			{
+				parser.cursor++;
+			}
+		}
+
+		static bool parse_json_string(TJsonParser& parser, std::string& result)
+		{
+			if (parser.cursor >= parser.end || *parser.cursor != '"') return false;
+			parser.cursor++;
+			result.clear();
+			while (parser.cursor < parser.end && *parser.cursor != '"')
+			{
+				char character = *parser.cursor++;
+				if (character != '\\')
+				{
+					result.push_back(character);
+					continue;
+				}
+				if (parser.cursor >= parser.end) return false;
+				character = *parser.cursor++;
+				switch (character)
+				{
+					case 'b': result.push_back('\b'); break;
+					case 'f': result.push_back('\f'); break;
+					case 'n': result.push_back('\n'); break;
+					case 'r': result.push_back('\r'); break;
+					case 't': result.push_back('\t'); break;
+					case 'u':
+					{
+						// Code points of the basic plane are written in UTF-8, the surrogate pairs are not recombined
+						if (parser.end - parser.cursor < 4) return false;
+						char digits[5] = { parser.cursor[0], parser.cursor[1], parser.cursor[2], parser.cursor[3], 0 };
+						uint32_t codePoint = (uint32_t)strtoul(digits, nullptr, 16);
+						parser.cursor += 4;
+						if (codePoint < 0x80)
+						{
+							result.push_back((char)codePoint);
+						}
+						else if (codePoint < 0x800)
+						{
+							result.push_back((char)(0xC0 | (codePoint >> 6)));
+							result.push_back((char)(0x80 | (codePoint & 0x3F)));
+						}
+						else
+						{
+							result.push_back((char)(0xE0 | (codePoint >> 12)));
+							result.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+							result.push_back((char)(0x80 | (codePoint & 0x3F)));
+						}
+						break;
+					}
+					default: result.push_back(character); break;
+				}
+			}
+			if (parser.cursor >= parser.end) return false;
+			parser.cursor++;
+			return true;
+		}
+
+		// Parse a value and its children, returns its index or GLTF_INVALID_INDEX if the text is not valid
+		static uint32_t parse_json_value(TJsonParser& parser, uint32_t depth)
+		{
+			skip_whitespace(parser);
+			if (parser.cursor >= parser.end || depth > GLTF_MAX_JSON_DEPTH) return GLTF_INVALID_INDEX;
+
+			uint32_t valueIdx = (uint32_t)parser.values.size();
+			parser.values.push_back(TJsonValue());
+			TJsonValue& value = parser.values.back();
+			value.type = JsonType::Null;
+			value.number = 0.0;
+			value.firstChild = GLTF_INVALID_INDEX;
+			value.nextSibling = GLTF_INVALID_INDEX;
+			value.numChildren = 0;
+
+			char character = *parser.cursor;
+			if (character == '{' || character == '[')
+			{
+				// The children are appended after their parent, which can move it in memory
+				bool object = character == '{';
+				char closing = object ? '}' : ']';
+				parser.values[valueIdx].type = object ? JsonType::Object : JsonType::Array;
+				parser.cursor++;
+				skip_whitespace(parser);
+				uint32_t previousChild = GLTF_INVALID_INDEX;
+				while (parser.cursor < parser.end && *parser.cursor != closing)
+				{
+					std::string key;
+					if (object)
+					{
+						if (!parse_json_string(parser, key)) return GLTF_INVALID_INDEX;
+						skip_whitespace(parser);
+						if (parser.cursor >= parser.end || *parser.cursor != ':') return GLTF_INVALID_INDEX;
+						parser.cursor++;
+					}
+					uint32_t childIdx = parse_json_value(parser, depth + 1);
+					if (childIdx == GLTF_INVALID_INDEX) return GLTF_INVALID_INDEX;
+					parser.values[childIdx].key.swap(key);
+					if (previousChild == GLTF_INVALID_INDEX)
+					{
+						parser.values[valueIdx].firstChild = childIdx;
+					}
+					else
+					{
+						parser.values[previousChild].nextSibling = childIdx;
+					}
+					previousChild = childIdx;
+					parser.values[valueIdx].numChildren++;
+
+					skip_whitespace(parser);
+					if (parser.cursor < parser.end && *parser.cursor == ',')
+					{
+						parser.cursor++;
+						skip_whitespace(parser);
+					}
+				}
+				if (parser.cursor >= parser.end) return GLTF_INVALID_INDEX;
+				parser.cursor++;
+			}
+			else if (character == '"')
+			{
+				value.type = JsonType::String;
+				if (!parse_json_string(parser, value.string)) return GLTF_INVALID_INDEX;
+			}
+			else if (character == 't' || character == 'f' || character == 'n')
+			{
+				const char* word = character == 't' ? "true" : (character == 'f' ? "false" : "null");
+				size_t length = strlen(word);
+				if ((size_t)(parser.end - parser.cursor) < length || memcmp(parser.cursor, word, length) != 0) return GLTF_INVALID_INDEX;
+				value.type = character == 'n' ? JsonType::Null : JsonType::Boolean;
+				value.number = character == 't' ? 1.0 : 0.0;
+				parser.cursor += length;
+			}
+			else
+			{
+				// strtod needs a terminated string, numbers are short
+				char digits[64];
+				size_t length = 0;
+				while (parser.cursor < parser.end && length + 1 < sizeof(digits) && strchr("+-0123456789.eE", *parser.cursor) != nullptr)
+				{
+					digits[length++] = *parser.cursor++;
+				}
+				digits[length] = 0;
+				char* numberEnd = nullptr;
+				value.type = JsonType::Number;
+				value.number = strtod(digits, &numberEnd);
+				if (length == 0 || numberEnd != digits + length) return GLTF_INVALID_INDEX;
+			}
+			return valueIdx;
+		}
+
+		static uint32_t json_member(const std::vector<TJsonValue>& values, uint32_t objectIdx, const char* key)
+		{
+			if (objectIdx == GLTF_INVALID_INDEX || values[objectIdx].type != JsonType::Object) return GLTF_INVALID_INDEX;
+			for (uint32_t childIdx = values[objectIdx].firstChild; childIdx != GLTF_INVALID_INDEX; childIdx = values[childIdx].nextSibling)
+			{
+				if (values[childIdx].key == key) return childIdx;
+			}
+			return GLTF_INVALID_INDEX;
+		}
+
+		static uint32_t json_count(const std::vector<TJsonValue>& values, uint32_t arrayIdx)
+		{
+			return (arrayIdx != GLTF_INVALID_INDEX && values[arrayIdx].type == JsonType::Array) ? values[arrayIdx].numChildren : 0;
+		}
+
+		// Values of the elements of an array member, none if it is absent
+		static void json_elements(const std::vector<TJsonValue>& values, uint32_t objectIdx, const char* key, std::vector<uint32_t>& elements)
+		{
+			uint32_t arrayIdx = json_member(values, objectIdx, key);
+			elements.clear();
+			for (uint32_t childIdx = json_count(values, arrayIdx) ? values[arrayIdx].firstChild : GLTF_INVALID_INDEX; childIdx != GLTF_INVALID_INDEX; childIdx = values[childIdx].nextSibling)
+			{
+				elements.push_back(childIdx);
+			}
+		}
+
+		static inline uint32_t element_value(const std::vector<uint32_t>& elements, uint32_t elementIdx)
+		{
+			return elementIdx < elements.size() ? elements[elementIdx] : GLTF_INVALID_INDEX;
+		}
+
+		static double json_number(const std::vector<TJsonValue>& values, uint32_t objectIdx, const char* key, double defaultValue)
+		{
+			uint32_t memberIdx = json_member(values, objectIdx, key);
+			return (memberIdx != GLTF_INVALID_INDEX && values[memberIdx].type == JsonType::Number) ? values[memberIdx].number : defaultValue;
+		}
+
+		static uint32_t json_index(const std::vector<TJsonValue>& values, uint32_t objectIdx, const char* key)
+		{
+			double number = json_number(values, objectIdx, key, -1.0);
+			return (number >= 0.0 && number < (double)GLTF_INVALID_INDEX) ? (uint32_t)number : GLTF_INVALID_INDEX;
+		}
+
+		// Fill an array of floats from an array member, returns false if it is absent or has another size
+		static bool json_floats(const std::vector<TJsonValue>& values, uint32_t objectIdx, const char* key, float* result, uint32_t count)
+		{
+			uint32_t arrayIdx = json_member(values, objectIdx, key);
+			if (json_count(values, arrayIdx) != count) return false;
+			uint32_t childIdx = values[arrayIdx].firstChild;
+			for (uint32_t elementIdx = 0; elementIdx < count; ++elementIdx, childIdx = values[childIdx].nextSibling)
+			{
+				result[elementIdx] = (float)values[childIdx].number;
+			}
+			return true;
+		}
+
+		// The relative URIs of the buffers can be percent encoded
+		static std::string decode_uri(const std::string& uri)
+		{
+			std::string result;
+			for (size_t characterIdx = 0; characterIdx < uri.size(); ++characterIdx)
+			{
+				if (uri[characterIdx] == '%' && characterIdx + 2 < uri.size())
+				{
+					char digits[3] = { uri[characterIdx + 1], uri[characterIdx + 2], 0 };
+					result.push_back((char)strtoul(digits, nullptr, 16));
+					characterIdx += 2;
+				}
+				else
+				{
+					result.push_back(uri[characterIdx]);
+				}
+			}
+			return result;
+		}
+
+		static bool resolve_accessor(const TGltfDocument& document, uint32_t accessorIndex, const std::vector<TGltfBuffer>& buffers, TGltfAccessor& accessor)
+		{
+			const std::vector<TJsonValue>& values = document.values;
+			uint32_t accessorIdx = element_value(document.accessors, accessorIndex);
+			if (accessorIdx == GLTF_INVALID_INDEX || json_member(values, accessorIdx, "sparse") != GLTF_INVALID_INDEX) return false;
+
+			// Size of the elements
+			uint32_t typeIdx = json_member(values, accessorIdx, "type");
+			if (typeIdx == GLTF_INVALID_INDEX) return false;
+			const std::string& type = values[typeIdx].string;
+			accessor.numComponents = type == "SCALAR" ? 1 : (type == "VEC2" ? 2 : (type == "VEC3" ? 3 : (type == "VEC4" ? 4 : 0)));
+			accessor.componentType = json_index(values, accessorIdx, "componentType");
+			uint32_t componentSize = accessor.componentType == GLTF_UNSIGNED_BYTE ? 1 : (accessor.componentType == GLTF_UNSIGNED_SHORT ? 2 : ((accessor.componentType == GLTF_UNSIGNED_INT || accessor.componentType == GLTF_FLOAT) ? 4 : 0));
+			uint32_t elementSize = accessor.numComponents * componentSize;
+			double count = json_number(values, accessorIdx, "count", 0.0);
+			if (elementSize == 0 || count < 1.0) return false;
+			accessor.count = (uint64_t)count;
+
+			// Range of the buffer the elements are read from
+			uint32_t viewIdx = element_value(document.bufferViews, json_index(values, accessorIdx, "bufferView"));
+			uint32_t bufferIndex = json_index(values, viewIdx, "buffer");
+			if (viewIdx == GLTF_INVALID_INDEX || bufferIndex >= buffers.size()) return false;
+			uint64_t viewOffset = (uint64_t)json_number(values, viewIdx, "byteOffset", 0.0);
+			uint64_t viewLength = (uint64_t)json_number(values, viewIdx, "byteLength", 0.0);
+			uint64_t accessorOffset = (uint64_t)json_number(values, accessorIdx, "byteOffset", 0.0);
+			accessor.stride = (uint32_t)json_number(values, viewIdx, "byteStride", (double)elementSize);
+			accessor.stride = accessor.stride < elementSize ? elementSize : accessor.stride;
+			if (viewOffset + viewLength > buffers[bufferIndex].size || accessorOffset + (accessor.count - 1) * accessor.stride + elementSize > viewLength) return false;
+			accessor.data = buffers[bufferIndex].data + viewOffset + accessorOffset;
+			return true;
+		}
+
+		// 3x4 row major transform of a node relative to its parent, from its column major matrix or its translation, rotation and scale
+		static void node_transform(const std::vector<TJsonValue>& values, uint32_t nodeIdx, float* transform)
+		{
+			float matrix[16];
+			if (json_floats(values, nodeIdx, "matrix", matrix, 16))
+			{
+				for (uint32_t row = 0; row < 3; ++row)
+				{
+					for (uint32_t column = 0; column < 4; ++column)
+					{
+						transform[4 * row + column] = matrix[4 * column + row];
+					}
+				}
+				return;
+			}
+
+			float translation[3] = { 0.0f, 0.0f, 0.0f };
+			float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			float scale[3] = { 1.0f, 1.0f, 1.0f };
+			json_floats(values, nodeIdx, "translation", translation, 3);
+			json_floats(values, nodeIdx, "rotation", rotation, 4);
+			json_floats(values, nodeIdx, "scale", scale, 3);
+			float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+			float basis[9] = {
+				1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - z * w), 2.0f * (x * z + y * w),
+				2.0f * (x * y + z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z - x * w),
+				2.0f * (x * z - y * w), 2.0f * (y * z + x * w), 1.0f - 2.0f * (x * x + y * y) };
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				for (uint32_t column = 0; column < 3; ++column)
+				{
+					transform[4 * row + column] = basis[3 * row + column] * scale[column];
+				}
+				transform[4 * row + 3] = translation[row];
+			}
+		}
+
+		static void multiply_transforms(const float* parent, const float* local, float* result)
+		{
+			for (uint32_t row = 0; row < 3; ++row)
+			{
+				for (uint32_t column = 0; column < 4; ++column)
+				{
+					float value = column == 3 ? parent[4 * row + 3] : 0.0f;
+					for (uint32_t k = 0; k < 3; ++k)
+					{
+						value += parent[4 * row + k] * local[4 * k + column];
+					}
+					result[4 * row + column] = value;
+				}
+			}
+		}
+
+		// Index list of a primitive as 32 bit indices, the non indexed primitives use their vertices in order
+		static void read_indices(const TGltfPrimitive& primitive, std::vector<uint32_t>& indices)
+		{
+			const TGltfAccessor& accessor = primitive.indices;
+			uint64_t numIndices = primitive.indexed ? accessor.count : primitive.positions.count;
+			indices.resize((size_t)(numIndices - numIndices % 3));
+			for (size_t indexIdx = 0; indexIdx < indices.size(); ++indexIdx)
+			{
+				if (!primitive.indexed)
+				{
+					indices[indexIdx] = (uint32_t)indexIdx;
+					continue;
+				}
+				const uint8_t* element = accessor.data + indexIdx * accessor.stride;
+				if (accessor.componentType == GLTF_UNSIGNED_BYTE)
+				{
+					indices[indexIdx] = *element;
+				}
+				else if (accessor.componentType == GLTF_UNSIGNED_SHORT)
+				{
+					uint16_t index;
+					memcpy(&index, element, sizeof(index));
+					indices[indexIdx] = index;
+				}
+				else
+				{
+					memcpy(&indices[indexIdx], element, sizeof(uint32_t));
+				}
+			}
+		}
+
+		static bool import_gltf_document(const TGltfDocument& document, const std::vector<TGltfBuffer>& buffers, TTaskScheduler& taskScheduler, TImportedScene& scene)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			const std::vector<TJsonValue>& values = document.values;
+
+			// Materials of the document followed by the default one
+			uint32_t numMaterials = (uint32_t)document.materials.size();
+			for (uint32_t materialValue : document.materials)
+			{
+				float baseColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+				json_floats(values, json_member(values, materialValue, "pbrMetallicRoughness"), "baseColorFactor", baseColor, 4);
+				TSceneFileMaterial material = { { baseColor[0], baseColor[1], baseColor[2] }, SCENE_FILE_NO_TEXTURE };
+				scene.materials.push_back(material);
+			}
+			uint32_t defaultMaterial = (uint32_t)scene.materials.size();
+			TSceneFileMaterial material = { { 0.8f, 0.8f, 0.8f }, SCENE_FILE_NO_TEXTURE };
+			scene.materials.push_back(material);
+
+			// Triangle primitives of every mesh, the range of each mesh in the flat list
+			uint32_t numMeshes = (uint32_t)document.meshes.size();
+			std::vector<TGltfPrimitive> primitives;
+			std::vector<uint32_t> meshPrimitiveOffsets(numMeshes + 1, 0);
+			std::vector<uint32_t> primitiveValues;
+			for (uint32_t meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
+			{
+				json_elements(values, document.meshes[meshIdx], "primitives", primitiveValues);
+				for (uint32_t primitiveValue : primitiveValues)
+				{
+					if (json_number(values, primitiveValue, "mode", GLTF_TRIANGLES) != GLTF_TRIANGLES) continue;
+
+					TGltfPrimitive primitive = {};
+					uint32_t positionAccessor = json_index(values, json_member(values, primitiveValue, "attributes"), "POSITION");
+					if (!resolve_accessor(document, positionAccessor, buffers, primitive.positions)) return false;
+					if (primitive.positions.componentType != GLTF_FLOAT || primitive.positions.numComponents != 3) return false;
+					uint32_t indexAccessor = json_index(values, primitiveValue, "indices");
+					primitive.indexed = indexAccessor != GLTF_INVALID_INDEX;
+					if (primitive.indexed && (!resolve_accessor(document, indexAccessor, buffers, primitive.indices) || primitive.indices.numComponents != 1 || primitive.indices.componentType == GLTF_FLOAT)) return false;
+					primitive.materialIndex = json_index(values, primitiveValue, "material");
+					primitive.materialIndex = primitive.materialIndex < numMaterials ? primitive.materialIndex : defaultMaterial;
+					primitives.push_back(primitive);
+				}
+				meshPrimitiveOffsets[meshIdx + 1] = (uint32_t)primitives.size();
+			}
+			scene.statistics.parseTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// Weld and optimize the primitives in parallel, straight from the mapped buffers
+			start = std::chrono::steady_clock::now();
+			scene.meshes.resize(primitives.size());
+			std::vector<TMeshStatistics> meshStatistics(primitives.size());
+			std::vector<uint8_t> built(primitives.size());
+			taskScheduler.parallel_for((uint32_t)primitives.size(), [&](uint32_t primitiveIdx, uint32_t)
+			{
+				const TGltfPrimitive& primitive = primitives[primitiveIdx];
+				std::vector<uint32_t> indices;
+				read_indices(primitive, indices);
+				built[primitiveIdx] = build_mesh(primitive.positions.data, primitive.positions.stride, primitive.positions.count, indices.data(), indices.size(), scene.meshes[primitiveIdx], meshStatistics[primitiveIdx]) ? 1 : 0;
+			});
+			for (uint32_t primitiveIdx = 0; primitiveIdx < (uint32_t)primitives.size(); ++primitiveIdx)
+			{
+				if (!built[primitiveIdx]) return false;
+				accumulate_statistics(scene.statistics.meshes, meshStatistics[primitiveIdx]);
+				scene.statistics.sourceVertices += primitives[primitiveIdx].positions.count;
+			}
+			scene.statistics.optimizeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// Roots of the default scene, or every node that is no one's child when the document has no scene
+			uint32_t numNodes = (uint32_t)document.nodes.size();
+			std::vector<TGltfNodeEntry> stack;
+			std::vector<uint32_t> children;
+			TGltfNodeEntry entry = {};
+			entry.transform[0] = entry.transform[5] = entry.transform[10] = 1.0f;
+			std::vector<uint32_t> sceneValues;
+			json_elements(values, 0, "scenes", sceneValues);
+			uint32_t sceneIndex = json_index(values, 0, "scene");
+			uint32_t sceneValue = element_value(sceneValues, sceneIndex == GLTF_INVALID_INDEX ? 0 : sceneIndex);
+			if (json_member(values, sceneValue, "nodes") != GLTF_INVALID_INDEX)
+			{
+				json_elements(values, sceneValue, "nodes", children);
+				for (uint32_t childValue : children)
+				{
+					entry.node = (uint32_t)values[childValue].number;
+					stack.push_back(entry);
+				}
+			}
+			else
+			{
+				std::vector<uint8_t> isChild(numNodes, 0);
+				for (uint32_t nodeValue : document.nodes)
+				{
+					json_elements(values, nodeValue, "children", children);
+					for (uint32_t childValue : children)
+					{
+						uint32_t child = (uint32_t)values[childValue].number;
+						if (child < numNodes) isChild[child] = 1;
+					}
+				}
+				for (uint32_t nodeIdx = 0; nodeIdx < numNodes; ++nodeIdx)
+				{
+					entry.node = nodeIdx;
+					if (!isChild[nodeIdx]) stack.push_back(entry);
+				}
+			}
+
+			// Walk the hierarchy, a node deeper than the number of nodes means the document has a cycle
+			while (!stack.empty())
+			{
+				TGltfNodeEntry parent = stack.back();
+				stack.pop_back();
+				uint32_t nodeValue = element_value(document.nodes, parent.node);
+				if (nodeValue == GLTF_INVALID_INDEX || parent.depth >= numNodes) return false;
+
+				float local[12];
+				TGltfNodeEntry node = {};
+				node.depth = parent.depth + 1;
+				node_transform(values, nodeValue, local);
+				multiply_transforms(parent.transform, local, node.transform);
+
+				uint32_t meshIndex = json_index(values, nodeValue, "mesh");
+				if (meshIndex < numMeshes)
+				{
+					for (uint32_t primitiveIdx = meshPrimitiveOffsets[meshIndex]; primitiveIdx < meshPrimitiveOffsets[meshIndex + 1]; ++primitiveIdx)
+					{
+						TSceneFileInstance instance = {};
+						memcpy(instance.transform, node.transform, sizeof(instance.transform));
+						instance.meshIndex = primitiveIdx;
+						instance.materialIndex = primitives[primitiveIdx].materialIndex;
+						scene.instances.push_back(instance);
+					}
+				}
+
+				json_elements(values, nodeValue, "children", children);
+				for (uint32_t childValue : children)
+				{
+					node.node = (uint32_t)values[childValue].number;
+					stack.push_back(node);
+				}
+			}
+			return true;
+		}
+
+		// Locate the JSON and the binary chunks of a .glb container, returns false if the header is not valid
+		static bool read_binary_container(const TMappedFile& file, TJsonParser& parser, TGltfBuffer& binaryChunk)
+		{
+			// Magic, version, length, then the length and the type of the JSON chunk
+			uint32_t header[5];
+			memcpy(header, file.data, sizeof(header));
+			uint64_t length = header[2] < file.size ? header[2] : file.size;
+			if (header[1] != 2 || header[4] != GLB_CHUNK_JSON || sizeof(header) + (uint64_t)header[3] > length) return false;
+			parser.cursor = (const char*)file.data + sizeof(header);
+			parser.end = parser.cursor + header[3];
+
+			// The chunks are 4 bytes aligned, the binary one is optional
+			uint64_t binaryOffset = sizeof(header) + (((uint64_t)header[3] + 3) & ~3ull);
+			uint32_t chunkHeader[2];
+			if (binaryOffset + sizeof(chunkHeader) > length) return true;
+			memcpy(chunkHeader, file.data + binaryOffset, sizeof(chunkHeader));
+			if (chunkHeader[1] == GLB_CHUNK_BIN && binaryOffset + sizeof(chunkHeader) + chunkHeader[0] <= length)
+			{
+				binaryChunk.data = file.data + binaryOffset + sizeof(chunkHeader);
+				binaryChunk.size = chunkHeader[0];
+			}
+			return true;
+		}
+
+		bool import_gltf(const char* path, TTaskScheduler& taskScheduler, TImportedScene& scene)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			TMappedFile file;
+			if (!map_file(path, file)) return false;
+			scene.statistics.inputBytes += file.size;
+
+			// The JSON is either the whole file or the first chunk of a binary container, whose second chunk is the first buffer
+			TJsonParser parser;
+			parser.cursor = (const char*)file.data;
+			parser.end = parser.cursor + file.size;
+			TGltfBuffer binaryChunk = { nullptr, 0 };
+			uint32_t magic = 0;
+			memcpy(&magic, file.data, file.size < sizeof(magic) ? (size_t)file.size : sizeof(magic));
+			bool valid = magic != GLB_MAGIC || (file.size >= 20 && read_binary_container(file, parser, binaryChunk));
+			valid = valid && parse_json_value(parser, 0) == 0 && parser.values[0].type == JsonType::Object;
+
+			TGltfDocument document;
+			std::vector<uint32_t> bufferValues;
+			document.values.swap(parser.values);
+			if (valid)
+			{
+				json_elements(document.values, 0, "accessors", document.accessors);
+				json_elements(document.values, 0, "bufferViews", document.bufferViews);
+				json_elements(document.values, 0, "materials", document.materials);
+				json_elements(document.values, 0, "meshes", document.meshes);
+				json_elements(document.values, 0, "nodes", document.nodes);
+				json_elements(document.values, 0, "buffers", bufferValues);
+			}
+
+			// The external buffers are mapped next to the document
+			std::string directory(path);
+			size_t separator = directory.find_last_of("/\\");
+			directory = separator == std::string::npos ? std::string() : directory.substr(0, separator + 1);
+			std::vector<TMappedFile> bufferFiles;
+			std::vector<TGltfBuffer> buffers;
+			for (uint32_t bufferIdx = 0; valid && bufferIdx < (uint32_t)bufferValues.size(); ++bufferIdx)
+			{
+				uint32_t uriIdx = json_member(document.values, bufferValues[bufferIdx], "uri");
+				TGltfBuffer buffer = binaryChunk;
+				if (uriIdx != GLTF_INVALID_INDEX)
+				{
+					const std::string& uri = document.values[uriIdx].string;
+					TMappedFile bufferFile;
+					valid = uri.compare(0, 5, "data:") != 0 && map_file((directory + decode_uri(uri)).c_str(), bufferFile);
+					if (valid)
+					{
+						bufferFiles.push_back(bufferFile);
+						scene.statistics.inputBytes += bufferFile.size;
+						buffer.data = bufferFile.data;
+						buffer.size = bufferFile.size;
+					}
+				}
+				else
+				{
+					valid = bufferIdx == 0 && binaryChunk.data != nullptr;
+				}
+				buffers.push_back(buffer);
+			}
+			scene.statistics.parseTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			valid = valid && import_gltf_document(document, buffers, taskScheduler, scene);
+			for (TMappedFile& bufferFile : bufferFiles)
+			{
+				unmap_file(bufferFile);
+			}
+			unmap_file(file);
+			return valid;
+		}
+	}
+}
\ No newline at end of file
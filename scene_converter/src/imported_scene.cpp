@@ -0,0 +1,141 @@
+// Internal includes
+#include "imported_scene.h"
+
+// External includes
+#include <float.h>
+#include <math.h>
+
+namespace dxr_demo
+{
+	namespace converter
+	{
+		static void normalize(float* vector)
+		{
+			float length = sqrtf(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				vector[axis] /= length;
+			}
+		}
+
+		// Camera that looks at the bounds of the instances from the same direction as the built-in scene, far enough to see all of them
+		static void frame_instances(const TImportedScene& scene, TSceneFileSettings& settings)
+		{
+			// Bounds of the meshes in their own space, then of the corners of these bounds once transformed
+			std::vector<float> meshBounds(6 * scene.meshes.size());
+			for (size_t meshIdx = 0; meshIdx < scene.meshes.size(); ++meshIdx)
+			{
+				float* bounds = &meshBounds[6 * meshIdx];
+				const std::vector<float>& vertices = scene.meshes[meshIdx].vertices;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					bounds[axis] = FLT_MAX;
+					bounds[axis + 3] = -FLT_MAX;
+				}
+				for (size_t coordinateIdx = 0; coordinateIdx < vertices.size(); ++coordinateIdx)
+				{
+					uint32_t axis = (uint32_t)(coordinateIdx % 3);
+					bounds[axis] = vertices[coordinateIdx] < bounds[axis] ? vertices[coordinateIdx] : bounds[axis];
+					bounds[axis + 3] = vertices[coordinateIdx] > bounds[axis + 3] ? vertices[coordinateIdx] : bounds[axis + 3];
+				}
+			}
+			float sceneBounds[6] = { FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (const TSceneFileInstance& instance : scene.instances)
+			{
+				const float* bounds = &meshBounds[6 * instance.meshIndex];
+				if (bounds[0] > bounds[3]) continue;
+				for (uint32_t corner = 0; corner < 8; ++corner)
+				{
+					float point[3] = { bounds[(corner & 1) ? 3 : 0], bounds[(corner & 2) ? 4 : 1], bounds[(corner & 4) ? 5 : 2] };
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						const float* row = &instance.transform[4 * axis];
+						float value = row[0] * point[0] + row[1] * point[1] + row[2] * point[2] + row[3];
+						sceneBounds[axis] = value < sceneBounds[axis] ? value : sceneBounds[axis];
+						sceneBounds[axis + 3] = value > sceneBounds[axis + 3] ? value : sceneBounds[axis + 3];
+					}
+				}
+			}
+			float center[3] = { 0.0f, 0.0f, 0.0f };
+			float radius = 1.0f;
+			if (sceneBounds[0] <= sceneBounds[3])
+			{
+				float extent[3];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					center[axis] = 0.5f * (sceneBounds[axis] + sceneBounds[axis + 3]);
+					extent[axis] = 0.5f * (sceneBounds[axis + 3] - sceneBounds[axis]);
+				}
+				radius = sqrtf(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+				radius = radius > 0.0f ? radius : 1.0f;
+			}
+
+			// The bounding sphere fits in the vertical field of view
+			settings.tanHalfFov = tanf(0.5f * 60.0f * 3.14159265f / 180.0f);
+			float* forward = settings.cameraForward;
+			forward[0] = 0.0f;
+			forward[1] = -1.5f;
+			forward[2] = 5.0f;
+			normalize(forward);
+			float distance = radius / sinf(atanf(settings.tanHalfFov));
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				settings.cameraPosition[axis] = center[axis] - distance * forward[axis];
+			}
+			float* right = settings.cameraRight;
+			right[0] = forward[2];
+			right[1] = 0.0f;
+			right[2] = -forward[0];
+			normalize(right);
+			float* up = settings.cameraUp;
+			up[0] = forward[1] * right[2] - forward[2] * right[1];
+			up[1] = forward[2] * right[0] - forward[0] * right[2];
+			up[2] = forward[0] * right[1] - forward[1] * right[0];
+		}
+
+		bool write_imported_scene(const TImportedScene& scene, const char* path)
+		{
+			TSceneFileWriter writer;
+			if (!begin_scene_file(writer, path)) return false;
+
+			// None of the instances are animated
+			TSceneFileSettings settings = {};
+			frame_instances(scene, settings);
+			settings.lightDirection[0] = -0.5f;
+			settings.lightDirection[1] = 1.0f;
+			settings.lightDirection[2] = -0.3f;
+			normalize(settings.lightDirection);
+			settings.firstAnimatedInstance = (uint32_t)scene.instances.size();
+			begin_scene_section(writer, SceneSection::Settings, sizeof(TSceneFileSettings));
+			write_scene_section(writer, &settings, 1);
+
+			// The meshes are packed one after the other in the vertex and index sections
+			begin_scene_section(writer, SceneSection::Meshes, sizeof(TSceneFileMesh));
+			TSceneFileMesh fileMesh = {};
+			for (const TImportedMesh& mesh : scene.meshes)
+			{
+				fileMesh.vertexCount = (uint32_t)(mesh.vertices.size() / 3);
+				fileMesh.indexCount = (uint32_t)mesh.indices.size();
+				write_scene_section(writer, &fileMesh, 1);
+				fileMesh.firstVertex += fileMesh.vertexCount;
+				fileMesh.firstIndex += fileMesh.indexCount;
+			}
+			begin_scene_section(writer, SceneSection::Vertices, 3 * sizeof(float));
+			for (const TImportedMesh& mesh : scene.meshes)
+			{
+				write_scene_section(writer, mesh.vertices.data(), mesh.vertices.size() / 3);
+			}
+			begin_scene_section(writer, SceneSection::Indices, 3 * sizeof(uint32_t));
+			for (const TImportedMesh& mesh : scene.meshes)
+			{
+				write_scene_section(writer, mesh.indices.data(), mesh.indices.size() / 3);
+			}
+
+			begin_scene_section(writer, SceneSection::Materials, sizeof(TSceneFileMaterial));
+			write_scene_section(writer, scene.materials.data(), scene.materials.size());
+			begin_scene_section(writer, SceneSection::Instances, sizeof(TSceneFileInstance));
+			write_scene_section(writer, scene.instances.data(), scene.instances.size());
+			return end_scene_file(writer);
+		}
+	}
+}
\ No newline at end of file
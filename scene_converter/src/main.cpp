@@ -0,0 +1,98 @@
+// Internal includes
+#include "gltf_importer.h"
+#include "mesh_optimizer.h"
+#include "obj_importer.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace dxr_demo;
+using namespace dxr_demo::converter;
+
+static bool has_extension(const char* path, const char* extension)
+{
+	size_t pathLength = strlen(path);
+	size_t extensionLength = strlen(extension);
+	if (pathLength < extensionLength) return false;
+	for (size_t characterIdx = 0; characterIdx < extensionLength; ++characterIdx)
+	{
+		char character = path[pathLength - extensionLength + characterIdx];
+		character = (character >= 'A' && character <= 'Z') ? (char)(character - 'A' + 'a') : character;
+		if (character != extension[characterIdx]) return false;
+	}
+	return true;
+}
+
+static double megabytes_per_second(uint64_t bytes, double seconds)
+{
+	return seconds > 0.0 ? (double)bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("usage: scene_converter <input.obj|input.gltf|input.glb> <output.scene> [num threads]\n");
+		return 1;
+	}
+	const char* inputPath = argv[1];
+	const char* outputPath = argv[2];
+
+	// The calling thread counts as one of the threads, 0 means one per hardware thread
+	TTaskScheduler taskScheduler;
+	taskScheduler.init(argc > 3 ? (uint32_t)atoi(argv[3]) : 0);
+	uint32_t numThreads = taskScheduler.num_threads();
+
+	TImportedScene scene = {};
+	bool imported = false;
+	if (has_extension(inputPath, ".obj"))
+	{
+		imported = import_obj(inputPath, taskScheduler, scene);
+	}
+	else if (has_extension(inputPath, ".gltf") || has_extension(inputPath, ".glb"))
+	{
+		imported = import_gltf(inputPath, taskScheduler, scene);
+	}
+	else
+	{
+		printf("Unsupported input format %s\n", inputPath);
+		taskScheduler.destroy();
+		return 1;
+	}
+	taskScheduler.destroy();
+	if (!imported)
+	{
+		printf("Failed to import %s\n", inputPath);
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!write_imported_scene(scene, outputPath))
+	{
+		printf("Failed to write %s\n", outputPath);
+		return 1;
+	}
+	double writeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// The throughput of every stage is measured against the size of the sources
+	const TImportStatistics& statistics = scene.statistics;
+	const TMeshStatistics& meshes = statistics.meshes;
+	double inputMegabytes = (double)statistics.inputBytes / (1024.0 * 1024.0);
+	double totalTime = statistics.parseTime + statistics.optimizeTime + writeTime;
+	printf("Converted %s to %s with %u threads\n", inputPath, outputPath, numThreads);
+	printf("  input:     %.1f MB, %zu meshes, %zu materials, %zu instances\n", inputMegabytes, scene.meshes.size(), scene.materials.size(), scene.instances.size());
+	printf("  vertices:  %llu in the source, %llu once welded, %llu triangles\n", (unsigned long long)statistics.sourceVertices, (unsigned long long)meshes.uniqueVertices, (unsigned long long)meshes.numTriangles);
+	if (meshes.numTriangles > 0)
+	{
+		printf("  ACMR:      %.3f in the source order, %.3f optimized (%u vertex cache)\n", (double)meshes.sourceCacheMisses / meshes.numTriangles, (double)meshes.optimizedCacheMisses / meshes.numTriangles, MESH_OPTIMIZER_CACHE_SIZE);
+	}
+	printf("  parse:     %.3f s, %.1f MB/s\n", statistics.parseTime, megabytes_per_second(statistics.inputBytes, statistics.parseTime));
+	printf("  optimize:  %.3f s, %.1f MB/s\n", statistics.optimizeTime, megabytes_per_second(statistics.inputBytes, statistics.optimizeTime));
+	printf("  write:     %.3f s, %.1f MB/s\n", writeTime, megabytes_per_second(statistics.inputBytes, writeTime));
+	printf("  total:     %.3f s, %.1f MB/s\n", totalTime, megabytes_per_second(statistics.inputBytes, totalTime));
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+// Internal includes
+#include "mesh_optimizer.h"
+
+// External includes
+#include <string.h>
+
+namespace dxr_demo
+{
+	namespace converter
+	{
+		// Empty slot of the hash map, and vertex that the triangle order has no next candidate for
+		#define MESH_OPTIMIZER_INVALID_INDEX 0xFFFFFFFFu
+
+		static inline uint32_t hash_position(const uint32_t* bits)
+		{
+			uint32_t hash = (bits[0] * 0x8da6b343u) ^ (bits[1] * 0xd8163841u) ^ (bits[2] * 0xcb1ab31fu);
+			return hash ^ (hash >> 16);
+		}
+
+		bool weld_vertices(const uint8_t* positions, uint32_t stride, uint64_t numPositions, const uint32_t* indices, uint64_t numIndices, TImportedMesh& mesh)
+		{
+			mesh.vertices.clear();
+			mesh.indices.resize((size_t)numIndices);
+
+			// Open addressing over the bits of the positions, at most half full since there are no more unique vertices than indices
+			uint64_t maxVertices = numPositions < numIndices ? numPositions : numIndices;
+			uint32_t tableSize = 16;
+			while (tableSize < 2 * maxVertices)
+			{
+				tableSize *= 2;
+			}
+			std::vector<uint32_t> table(tableSize, MESH_OPTIMIZER_INVALID_INDEX);
+
+			for (uint64_t indexIdx = 0; indexIdx < numIndices; ++indexIdx)
+			{
+				uint32_t sourceIndex = indices[indexIdx];
+				if (sourceIndex >= numPositions) return false;
+
+				uint32_t bits[3];
+				memcpy(bits, positions + (size_t)sourceIndex * stride, sizeof(bits));
+				uint32_t slot = hash_position(bits) & (tableSize - 1);
+				while (table[slot] != MESH_OPTIMIZER_INVALID_INDEX && memcmp(&mesh.vertices[3 * (size_t)table[slot]], bits, sizeof(bits)) != 0)
+				{
+					slot = (slot + 1) & (tableSize - 1);
+				}
+				if (table[slot] == MESH_OPTIMIZER_INVALID_INDEX)
+				{
+					table[slot] = (uint32_t)(mesh.vertices.size() / 3);
+					mesh.vertices.resize(mesh.vertices.size() + 3);
+					memcpy(&mesh.vertices[mesh.vertices.size() - 3], bits, sizeof(bits));
+				}
+				mesh.indices[(size_t)indexIdx] = table[slot];
+			}
+			return true;
+		}
+
+		void optimize_mesh(TImportedMesh& mesh)
+		{
+			uint32_t numVertices = (uint32_t)(mesh.vertices.size() / 3);
+			size_t numTriangles = mesh.indices.size() / 3;
+			if (numTriangles == 0) return;
+
+			// Triangles of every vertex, and the number of them that are not emitted yet
+			std::vector<uint32_t> offsets(numVertices + 1, 0);
+			for (uint32_t index : mesh.indices)
+			{
+				offsets[index + 1]++;
+			}
+			std::vector<uint32_t> live(numVertices);
+			for (uint32_t vertexIdx = 0; vertexIdx < numVertices; ++vertexIdx)
+			{
+				live[vertexIdx] = offsets[vertexIdx + 1];
+				offsets[vertexIdx + 1] += offsets[vertexIdx];
+			}
+			std::vector<uint32_t> adjacency(mesh.indices.size());
+			std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+			for (size_t triangleIdx = 0; triangleIdx < numTriangles; ++triangleIdx)
+			{
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					adjacency[cursors[mesh.indices[3 * triangleIdx + corner]]++] = (uint32_t)triangleIdx;
+				}
+			}
+
+			// Tipsify: emit every triangle of a fanning vertex, then fan around the vertex of the last triangles that stays longest in the cache without being evicted
+			// The cache is modeled by the time stamp of the last miss of every vertex
+			std::vector<uint32_t> cacheTimes(numVertices, 0);
+			std::vector<uint8_t> emitted(numTriangles, 0);
+			std::vector<uint32_t> deadEnd;
+			std::vector<uint32_t> candidates;
+			std::vector<uint32_t> output;
+			output.reserve(mesh.indices.size());
+			uint32_t timeStamp = MESH_OPTIMIZER_CACHE_SIZE + 1;
+			uint32_t scanCursor = 0;
+			uint32_t fanningVertex = 0;
+			while (fanningVertex != MESH_OPTIMIZER_INVALID_INDEX)
+			{
+				candidates.clear();
+				for (uint32_t adjacencyIdx = offsets[fanningVertex]; adjacencyIdx < offsets[fanningVertex + 1]; ++adjacencyIdx)
+				{
+					uint32_t triangleIdx = adjacency[adjacencyIdx];
+					if (emitted[triangleIdx]) continue;
+					emitted[triangleIdx] = 1;
+					for (uint32_t corner = 0; corner < 3; ++corner)
+					{
+						uint32_t vertex = mesh.indices[3 * (size_t)triangleIdx + corner];
+						output.push_back(vertex);
+						deadEnd.push_back(vertex);
+						candidates.push_back(vertex);
+						live[vertex]--;
+						if (timeStamp - cacheTimes[vertex] > MESH_OPTIMIZER_CACHE_SIZE)
+						{
+							cacheTimes[vertex] = timeStamp++;
+						}
+					}
+				}
+
+				// The candidate that is still in the cache after all its remaining triangles are emitted and entered it the earliest
+				fanningVertex = MESH_OPTIMIZER_INVALID_INDEX;
+				int64_t bestPriority = -1;
+				for (uint32_t vertex : candidates)
+				{
+					if (live[vertex] == 0) continue;
+					int64_t priority = 0;
+					if (timeStamp - cacheTimes[vertex] + 2 * live[vertex] <= MESH_OPTIMIZER_CACHE_SIZE)
+					{
+						priority = timeStamp - cacheTimes[vertex];
+					}
+					if (priority > bestPriority)
+					{
+						bestPriority = priority;
+						fanningVertex = vertex;
+					}
+				}
+
+				// Dead end: the most recently used vertex that still has triangles, else the next one in the input order
+				while (fanningVertex == MESH_OPTIMIZER_INVALID_INDEX && !deadEnd.empty())
+				{
+					uint32_t vertex = deadEnd.back();
+					deadEnd.pop_back();
+					fanningVertex = live[vertex] > 0 ? vertex : MESH_OPTIMIZER_INVALID_INDEX;
+				}
+				while (fanningVertex == MESH_OPTIMIZER_INVALID_INDEX && scanCursor < numVertices)
+				{
+					fanningVertex = live[scanCursor] > 0 ? scanCursor : MESH_OPTIMIZER_INVALID_INDEX;
+					scanCursor += fanningVertex == MESH_OPTIMIZER_INVALID_INDEX ? 1 : 0;
+				}
+			}
+			mesh.indices.swap(output);
+
+			// The vertices are stored in the order the triangles first reference them, so that the fetches walk forward in memory
+			std::vector<uint32_t> remap(numVertices, MESH_OPTIMIZER_INVALID_INDEX);
+			std::vector<float> vertices(mesh.vertices.size());
+			uint32_t nextVertex = 0;
+			for (uint32_t& index : mesh.indices)
+			{
+				if (remap[index] == MESH_OPTIMIZER_INVALID_INDEX)
+				{
+					remap[index] = nextVertex;
+					memcpy(&vertices[3 * (size_t)nextVertex], &mesh.vertices[3 * (size_t)index], 3 * sizeof(float));
+					nextVertex++;
+				}
+				index = remap[index];
+			}
+			vertices.resize(3 * (size_t)nextVertex);
+			mesh.vertices.swap(vertices);
+		}
+
+		uint64_t count_cache_misses(const uint32_t* indices, uint64_t numIndices, uint32_t numVertices, uint32_t cacheSize)
+		{
+			std::vector<uint32_t> cacheTimes(numVertices, 0);
+			uint32_t timeStamp = cacheSize + 1;
+			uint64_t numMisses = 0;
+			for (uint64_t indexIdx = 0; indexIdx < numIndices; ++indexIdx)
+			{
+				uint32_t vertex = indices[indexIdx];
+				if (timeStamp - cacheTimes[vertex] > cacheSize)
+				{
+					cacheTimes[vertex] = timeStamp++;
+					numMisses++;
+				}
+			}
+			return numMisses;
+		}
+
+		bool build_mesh(const uint8_t* positions, uint32_t stride, uint64_t numPositions, const uint32_t* indices, uint64_t numIndices, TImportedMesh& mesh, TMeshStatistics& statistics)
+		{
+			statistics = TMeshStatistics();
+			if (!weld_vertices(positions, stride, numPositions, indices, numIndices, mesh)) return false;
+
+			uint32_t numVertices = (uint32_t)(mesh.vertices.size() / 3);
+			statistics.sourceCacheMisses = count_cache_misses(mesh.indices.data(), mesh.indices.size(), numVertices, MESH_OPTIMIZER_CACHE_SIZE);
+			optimize_mesh(mesh);
+			statistics.optimizedCacheMisses = count_cache_misses(mesh.indices.data(), mesh.indices.size(), numVertices, MESH_OPTIMIZER_CACHE_SIZE);
+			statistics.uniqueVertices = numVertices;
+			statistics.numTriangles = mesh.indices.size() / 3;
+			return true;
+		}
+	}
+}
\ No newline at end of file
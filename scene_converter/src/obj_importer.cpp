@@ -0,0 +1,413 @@
+// Internal includes
+#include "obj_importer.h"
+#include "mesh_optimizer.h"
+#include "task_scheduler.h"
+
+// External includes
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace dxr_demo
+{
+	namespace converter
+	{
+		// Indices relative to the vertices of their chunk are stored with this bias until the chunk is merged, the absolute ones are far below it
+		#define OBJ_CHUNK_RELATIVE_BIAS (1ll << 62)
+
+		// Largest number of vertices of a polygon
+		#define OBJ_MAX_POLYGON_SIZE 64
+
+		namespace ObjEventType
+		{
+			enum Type
+			{
+				// Object or group
+				Object,
+				Material,
+				Library
+			};
+		}
+
+		// Statement that changes the mesh or the material of the triangles that follow it
+		struct TObjEvent
+		{
+			ObjEventType::Type type;
+			uint64_t firstTriangle;
+			std::string name;
+		};
+
+		// A block of lines and what was parsed out of it
+		struct TObjChunk
+		{
+			std::vector<char> text;
+			std::vector<float> positions;
+			std::vector<int64_t> indices;
+			std::vector<TObjEvent> events;
+			bool valid;
+		};
+
+		// Triangles of a mesh and the name of their material
+		struct TObjMesh
+		{
+			uint64_t firstTriangle;
+			uint64_t numTriangles;
+			std::string material;
+		};
+
+		static inline bool is_blank(char character)
+		{
+			return character == ' ' || character == '\t' || character == '\r';
+		}
+
+		static inline const char* skip_blanks(const char* cursor, const char* end)
+		{
+			while (cursor < end && is_blank(*cursor))
+			{
+				cursor++;
+			}
+			return cursor;
+		}
+
+		// Decimal number with an optional exponent, the first 18 significant digits are kept
+		static const char* parse_float(const char* cursor, const char* end, float& value)
+		{
+			static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+			cursor = skip_blanks(cursor, end);
+			bool negative = cursor < end && *cursor == '-';
+			cursor += (cursor < end && (*cursor == '-' || *cursor == '+')) ? 1 : 0;
+
+			uint64_t mantissa = 0;
+			int32_t exponent = 0;
+			for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+			{
+				if (mantissa < 100000000000000000ull)
+				{
+					mantissa = mantissa * 10 + (*cursor - '0');
+				}
+				else
+				{
+					exponent++;
+				}
+			}
+			if (cursor < end && *cursor == '.')
+			{
+				for (++cursor; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+				{
+					if (mantissa < 100000000000000000ull)
+					{
+						mantissa = mantissa * 10 + (*cursor - '0');
+						exponent--;
+					}
+				}
+			}
+			if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+			{
+				++cursor;
+				bool negativeExponent = cursor < end && *cursor == '-';
+				cursor += (cursor < end && (*cursor == '-' || *cursor == '+')) ? 1 : 0;
+				int32_t explicitExponent = 0;
+				for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+				{
+					explicitExponent = explicitExponent < 10000 ? explicitExponent * 10 + (*cursor - '0') : explicitExponent;
+				}
+				exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			}
+
+			double result = (double)mantissa;
+			if (exponent < 0)
+			{
+				result = -exponent <= 22 ? result / powersOfTen[-exponent] : result * pow(10.0, exponent);
+			}
+			else if (exponent > 0)
+			{
+				result = exponent <= 22 ? result * powersOfTen[exponent] : result * pow(10.0, exponent);
+			}
+			value = (float)(negative ? -result : result);
+			return cursor;
+		}
+
+		// Rest of a line without its surrounding blanks
+		static std::string parse_name(const char* cursor, const char* end)
+		{
+			cursor = skip_blanks(cursor, end);
+			while (end > cursor && is_blank(end[-1]))
+			{
+				end--;
+			}
+			return std::string(cursor, end);
+		}
+
+		static inline bool starts_with(const char* cursor, const char* end, const char* keyword)
+		{
+			size_t length = strlen(keyword);
+			return (size_t)(end - cursor) > length && memcmp(cursor, keyword, length) == 0 && is_blank(cursor[length]);
+		}
+
+		static void parse_chunk(TObjChunk& chunk)
+		{
+			chunk.positions.clear();
+			chunk.indices.clear();
+			chunk.events.clear();
+			chunk.valid = true;
+
+			const char* cursor = chunk.text.data();
+			const char* textEnd = cursor + chunk.text.size();
+			int64_t polygon[OBJ_MAX_POLYGON_SIZE];
+			while (cursor < textEnd)
+			{
+				const char* lineEnd = (const char*)memchr(cursor, '\n', textEnd - cursor);
+				lineEnd = lineEnd ? lineEnd : textEnd;
+				const char* line = skip_blanks(cursor, lineEnd);
+				cursor = lineEnd + 1;
+
+				if (starts_with(line, lineEnd, "v"))
+				{
+					float position[3] = {};
+					const char* value = line + 1;
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						value = parse_float(value, lineEnd, position[axis]);
+					}
+					chunk.positions.insert(chunk.positions.end(), position, position + 3);
+				}
+				else if (starts_with(line, lineEnd, "f"))
+				{
+					// Vertices are v, v/vt, v//vn or v/vt/vn, only v is kept. The negative ones count back from the last vertex
+					uint32_t polygonSize = 0;
+					const char* vertex = skip_blanks(line + 1, lineEnd);
+					while (vertex < lineEnd && polygonSize < OBJ_MAX_POLYGON_SIZE)
+					{
+						bool negative = *vertex == '-';
+						vertex += negative ? 1 : 0;
+						int64_t index = 0;
+						for (; vertex < lineEnd && *vertex >= '0' && *vertex <= '9'; ++vertex)
+						{
+							index = index * 10 + (*vertex - '0');
+						}
+						if (index == 0)
+						{
+							chunk.valid = false;
+							return;
+						}
+						int64_t numChunkVertices = (int64_t)chunk.positions.size() / 3;
+						polygon[polygonSize++] = negative ? OBJ_CHUNK_RELATIVE_BIAS + numChunkVertices - index : index - 1;
+						while (vertex < lineEnd && !is_blank(*vertex))
+						{
+							vertex++;
+						}
+						vertex = skip_blanks(vertex, lineEnd);
+					}
+					for (uint32_t corner = 1; corner + 1 < polygonSize; ++corner)
+					{
+						chunk.indices.push_back(polygon[0]);
+						chunk.indices.push_back(polygon[corner]);
+						chunk.indices.push_back(polygon[corner + 1]);
+					}
+				}
+				else if (starts_with(line, lineEnd, "o") || starts_with(line, lineEnd, "g"))
+				{
+					TObjEvent event = { ObjEventType::Object, chunk.indices.size() / 3, parse_name(line + 1, lineEnd) };
+					chunk.events.push_back(event);
+				}
+				else if (starts_with(line, lineEnd, "usemtl"))
+				{
+					TObjEvent event = { ObjEventType::Material, chunk.indices.size() / 3, parse_name(line + 6, lineEnd) };
+					chunk.events.push_back(event);
+				}
+				else if (starts_with(line, lineEnd, "mtllib"))
+				{
+					TObjEvent event = { ObjEventType::Library, chunk.indices.size() / 3, parse_name(line + 6, lineEnd) };
+					chunk.events.push_back(event);
+				}
+			}
+		}
+
+		// Read the next chunk of whole lines, the start of the line the read ended in is carried over to the next chunk
+		static bool read_chunk(std::ifstream& file, std::vector<char>& carry, TObjChunk& chunk, uint64_t& inputBytes)
+		{
+			chunk.text.swap(carry);
+			carry.clear();
+			while (file)
+			{
+				size_t size = chunk.text.size();
+				chunk.text.resize(size + OBJ_IMPORTER_CHUNK_SIZE);
+				file.read(chunk.text.data() + size, OBJ_IMPORTER_CHUNK_SIZE);
+				size_t numRead = (size_t)file.gcount();
+				chunk.text.resize(size + numRead);
+				inputBytes += numRead;
+
+				// A line longer than a chunk grows it until its end is found
+				const char* text = chunk.text.data();
+				size_t lineStart = chunk.text.size();
+				while (lineStart > size && text[lineStart - 1] != '\n')
+				{
+					lineStart--;
+				}
+				if (lineStart > size || !file)
+				{
+					if (file)
+					{
+						carry.assign(chunk.text.begin() + lineStart, chunk.text.end());
+						chunk.text.resize(lineStart);
+					}
+					break;
+				}
+			}
+			return !chunk.text.empty();
+		}
+
+		// Diffuse colors of the materials of an MTL file
+		static void import_material_library(const std::string& path, std::map<std::string, uint32_t>& materialIndices, TImportedScene& scene, uint64_t& inputBytes)
+		{
+			std::ifstream file(path.c_str(), std::ios::binary);
+			std::string line;
+			uint32_t materialIndex = 0xFFFFFFFFu;
+			while (std::getline(file, line))
+			{
+				inputBytes += line.size() + 1;
+				const char* cursor = skip_blanks(line.data(), line.data() + line.size());
+				const char* end = line.data() + line.size();
+				if (starts_with(cursor, end, "newmtl"))
+				{
+					TSceneFileMaterial material = { { 0.8f, 0.8f, 0.8f }, SCENE_FILE_NO_TEXTURE };
+					materialIndex = (uint32_t)scene.materials.size();
+					materialIndices[parse_name(cursor + 6, end)] = materialIndex;
+					scene.materials.push_back(material);
+				}
+				else if (starts_with(cursor, end, "Kd") && materialIndex != 0xFFFFFFFFu)
+				{
+					const char* value = cursor + 2;
+					for (uint32_t channel = 0; channel < 3; ++channel)
+					{
+						value = parse_float(value, end, scene.materials[materialIndex].albedo[channel]);
+					}
+				}
+			}
+		}
+
+		bool import_obj(const char* path, TTaskScheduler& taskScheduler, TImportedScene& scene)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file) return false;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			TImportStatistics& statistics = scene.statistics;
+
+			// Positions and triangles of the whole file, and the statements that split them in meshes
+			std::vector<float> positions;
+			std::vector<uint32_t> indices;
+			std::vector<TObjEvent> events;
+
+			std::vector<TObjChunk> chunks(taskScheduler.num_threads());
+			std::vector<char> carry;
+			bool valid = true;
+			while (valid)
+			{
+				uint32_t numChunks = 0;
+				while (numChunks < (uint32_t)chunks.size() && read_chunk(file, carry, chunks[numChunks], statistics.inputBytes))
+				{
+					numChunks++;
+				}
+				if (numChunks == 0) break;
+
+				taskScheduler.parallel_for(numChunks, [&](uint32_t chunkIdx, uint32_t)
+				{
+					parse_chunk(chunks[chunkIdx]);
+				});
+
+				// The chunks are appended in order, their relative indices become absolute once the vertices before them are known
+				for (uint32_t chunkIdx = 0; chunkIdx < numChunks && valid; ++chunkIdx)
+				{
+					TObjChunk& chunk = chunks[chunkIdx];
+					int64_t firstVertex = (int64_t)positions.size() / 3;
+					uint64_t firstTriangle = indices.size() / 3;
+					for (int64_t index : chunk.indices)
+					{
+						int64_t absoluteIndex = index >= OBJ_CHUNK_RELATIVE_BIAS / 2 ? firstVertex + (index - OBJ_CHUNK_RELATIVE_BIAS) : index;
+						valid &= absoluteIndex >= 0 && absoluteIndex < 0xFFFFFFFFll;
+						indices.push_back((uint32_t)absoluteIndex);
+					}
+					for (TObjEvent& event : chunk.events)
+					{
+						event.firstTriangle += firstTriangle;
+						events.push_back(event);
+					}
+					positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+					valid &= chunk.valid;
+				}
+			}
+			chunks.clear();
+			carry.clear();
+			if (!valid) return false;
+			statistics.sourceVertices = positions.size() / 3;
+
+			// The materials of the libraries, and a default one for the triangles that have none or reference a missing one
+			std::string directory(path);
+			size_t separator = directory.find_last_of("/\\");
+			directory = separator == std::string::npos ? std::string() : directory.substr(0, separator + 1);
+			std::map<std::string, uint32_t> materialIndices;
+			for (const TObjEvent& event : events)
+			{
+				if (event.type == ObjEventType::Library)
+				{
+					import_material_library(directory + event.name, materialIndices, scene, statistics.inputBytes);
+				}
+			}
+			uint32_t defaultMaterial = (uint32_t)scene.materials.size();
+			TSceneFileMaterial material = { { 0.8f, 0.8f, 0.8f }, SCENE_FILE_NO_TEXTURE };
+			scene.materials.push_back(material);
+
+			// Split the triangles where the object or the material changes
+			std::vector<TObjMesh> meshes;
+			TObjMesh current = { 0, 0, std::string() };
+			uint64_t numTriangles = indices.size() / 3;
+			for (size_t eventIdx = 0; eventIdx <= events.size(); ++eventIdx)
+			{
+				bool last = eventIdx == events.size();
+				if (!last && events[eventIdx].type == ObjEventType::Library) continue;
+
+				uint64_t splitTriangle = last ? numTriangles : events[eventIdx].firstTriangle;
+				current.numTriangles = splitTriangle - current.firstTriangle;
+				if (current.numTriangles > 0)
+				{
+					meshes.push_back(current);
+				}
+				current.firstTriangle = splitTriangle;
+				current.material = (!last && events[eventIdx].type == ObjEventType::Material) ? events[eventIdx].name : current.material;
+			}
+			statistics.parseTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// Weld and optimize the meshes in parallel
+			start = std::chrono::steady_clock::now();
+			scene.meshes.resize(meshes.size());
+			std::vector<TMeshStatistics> meshStatistics(meshes.size());
+			std::vector<uint8_t> built(meshes.size());
+			taskScheduler.parallel_for((uint32_t)meshes.size(), [&](uint32_t meshIdx, uint32_t)
+			{
+				const TObjMesh& mesh = meshes[meshIdx];
+				built[meshIdx] = build_mesh((const uint8_t*)positions.data(), 3 * sizeof(float), positions.size() / 3, &indices[3 * mesh.firstTriangle], 3 * mesh.numTriangles, scene.meshes[meshIdx], meshStatistics[meshIdx]) ? 1 : 0;
+			});
+
+			// One instance per mesh, in place
+			for (uint32_t meshIdx = 0; meshIdx < (uint32_t)meshes.size(); ++meshIdx)
+			{
+				if (!built[meshIdx]) return false;
+				accumulate_statistics(statistics.meshes, meshStatistics[meshIdx]);
+
+				std::map<std::string, uint32_t>::const_iterator materialIt = materialIndices.find(meshes[meshIdx].material);
+				TSceneFileInstance instance = {};
+				instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.0f;
+				instance.meshIndex = meshIdx;
+				instance.materialIndex = materialIt != materialIndices.end() ? materialIt->second : defaultMaterial;
+				scene.instances.push_back(instance);
+			}
+			statistics.optimizeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return true;
+		}
+	}
+}
\ No newline at end of file